@@ -119,6 +119,25 @@ Tomahawk.timestamp = function () {
 };
 
 Tomahawk.htmlDecode = (function () {
+    // without a DOM, outside of WebKit, we only know the most common entities
+    if (typeof document === 'undefined') {
+        var entities = {amp: '&', lt: '<', gt: '>', quot: '"', apos: "'", nbsp: '\u00a0'};
+
+        return function (str) {
+            if (str && typeof str === 'string') {
+                str = str.replace(/&(#x[0-9a-f]+|#[0-9]+|[a-z]+);/gi, function (entity, name) {
+                    if (name.charAt(0) === '#') {
+                        return String.fromCharCode(name.charAt(1).toLowerCase() === 'x'
+                            ? parseInt(name.substr(2), 16) : parseInt(name.substr(1), 10));
+                    }
+                    return entities.hasOwnProperty(name) ? entities[name] : entity;
+                });
+            }
+
+            return str;
+        };
+    }
+
     // this prevents any overhead from creating the object each time
     var element = document.createElement('textarea');
 
@@ -204,11 +223,11 @@ var TomahawkResolver = {
         return {};
     },
     getUserConfig: function () {
-        return JSON.parse(window.localStorage[this.scriptPath()] || "{}");
+        return JSON.parse(window.localStorage.getItem(this.scriptPath()) || "{}");
     },
     saveUserConfig: function () {
         var configJson = JSON.stringify(Tomahawk.resolverData().config);
-        window.localStorage[this.scriptPath()] = configJson;
+        window.localStorage.setItem(this.scriptPath(), configJson);
         this.newConfigSaved();
     },
     newConfigSaved: function () {
@@ -262,10 +281,10 @@ Tomahawk.Resolver = {
         return {};
     },
     getUserConfig: function () {
-        return JSON.parse(window.localStorage[this.scriptPath()] || "{}");
+        return JSON.parse(window.localStorage.getItem(this.scriptPath()) || "{}");
     },
     saveUserConfig: function () {
-        window.localStorage[this.scriptPath()] = JSON.stringify(Tomahawk.resolverData().config);
+        window.localStorage.setItem(this.scriptPath(), JSON.stringify(Tomahawk.resolverData().config));
         this.newConfigSaved(Tomahawk.resolverData().config);
     },
     newConfigSaved: function () {
@@ -392,6 +411,11 @@ Tomahawk.retrievedMetadata = function (metadataId, metadata, error) {
  * @returns boolean indicating whether or not to do a request with the given parameters natively
  */
 var shouldDoNativeRequest = function (options) {
+    // outside of WebKit there is no XMLHttpRequest
+    if (typeof XMLHttpRequest === 'undefined') {
+        return true;
+    }
+
     var extraHeaders = options.headers;
     return (extraHeaders && (extraHeaders.hasOwnProperty("Referer")
         || extraHeaders.hasOwnProperty("referer")
@@ -426,6 +450,14 @@ var doRequest = function(options) {
                 return null;
             };
 
+            // like the XMLHttpRequest below, unless the request had to be native anyway
+            if (typeof XMLHttpRequest === 'undefined'
+                && httpSuccessStatuses.indexOf(xhr.status) == -1) {
+                Tomahawk.log("Failed to do " + options.method + " request: to: " + options.url);
+                Tomahawk.log("Status Code was: " + xhr.status);
+                throw xhr;
+            }
+
             return xhr;
         });
     } else {
@@ -532,6 +564,9 @@ Tomahawk.ajax = function (url, settings) {
             }
 
             if (~contentType.indexOf('text/xml')) {
+                if (typeof DOMParser === 'undefined') {
+                    throw new Error("Tomahawk.ajax: XML responses need the webkit runtime");
+                }
                 var domParser = new DOMParser();
                 return domParser.parseFromString(responseText, "text/xml");
             }
@@ -695,13 +730,14 @@ Tomahawk.removeDiacritics = function (str) {
 
 Tomahawk.localStorage = Tomahawk.localStorage || {
         setItem: function (key, value) {
-            window.localStorage[key] = value;
+            window.localStorage.setItem(key, value);
         },
         getItem: function (key) {
-            return window.localStorage[key];
+            var value = window.localStorage.getItem(key);
+            return value === null ? undefined : value;
         },
         removeItem: function (key) {
-            delete window.localStorage[key];
+            window.localStorage.removeItem(key);
         }
     };
 
@@ -740,7 +776,35 @@ Tomahawk.PluginManager = {
     },
 
     resolve: [],
+    /**
+     * Resolves a batch of queries with a single call from native code. Each entry of
+     * params.queries is handed to the object's resolve (or search, for full text
+     * queries). Results come back in the same order, failed entries as {error: ...}.
+     */
+    resolveBatch: function (requestId, objectId, params) {
+        var that = this;
+        return RSVP.all(params.queries.map(function (query) {
+            var methodName = query.hasOwnProperty('query') ? 'search' : 'resolve';
+            return new RSVP.Promise(function (resolve) {
+                resolve(that.invokeSync(requestId, objectId, methodName, query));
+            }).then(null, function (error) {
+                return {
+                    error: error
+                };
+            });
+        })).then(function (results) {
+            return {
+                results: results
+            };
+        });
+    },
     invokeSync: function (requestId, objectId, methodName, params) {
+        if (methodName === 'resolveBatch' && this.objects[objectId]
+            && !this.objects[objectId][methodName]
+            && !this.objects[objectId][this.wrapperPrefix + methodName]) {
+            return this.resolveBatch(requestId, objectId, params);
+        }
+
         if (this.objects[objectId][this.wrapperPrefix + methodName]) {
             methodName = this.wrapperPrefix + methodName;
         }
@@ -814,6 +878,40 @@ Tomahawk.NativeScriptJobManager = {
     }
 };
 
+// Native code hands us calls as plain values through TomahawkCallBridge (see JSCallBridge.h),
+// in batches, instead of making us evaluate new code for each of them.
+if (window.TomahawkCallBridge) {
+    TomahawkCallBridge.calls.connect(function (calls) {
+        calls.forEach(function (call) {
+            try {
+                if (call.type === 'invoke') {
+                    Tomahawk.PluginManager.invoke(call.requestId, call.objectId, call.methodName,
+                        call.params);
+                } else if (call.type === 'result') {
+                    Tomahawk.NativeScriptJobManager.reportNativeScriptJobResult(call.requestId,
+                        call.data);
+                } else if (call.type === 'error') {
+                    Tomahawk.NativeScriptJobManager.reportNativeScriptJobError(call.requestId,
+                        call.data);
+                }
+            } catch (e) {
+                Tomahawk.log("Failed to handle " + call.type + " call: " + e);
+            }
+        });
+    });
+
+    TomahawkCallBridge.syncCall.connect(function (call) {
+        var result;
+        try {
+            result = Tomahawk.PluginManager.invokeSync(0, call.objectId, call.methodName,
+                call.params);
+        } catch (e) {
+            Tomahawk.log("Failed to invoke " + call.methodName + ": " + e);
+        }
+        TomahawkCallBridge.setSyncResult(result);
+    });
+}
+
 Tomahawk.UrlType = {
     Any: 0,
     Playlist: 1,
@@ -1143,6 +1241,13 @@ Tomahawk.Collection = {
                             "UNIQUE (track, artistId, albumId) ON CONFLICT IGNORE," +
                             "FOREIGN KEY(artistId) REFERENCES artists(_id)," +
                             "FOREIGN KEY(albumId) REFERENCES albums(_id))", []);
+                        // What the fuzzy index holds of the tracks wipe() dropped, kept
+                        // until the next addTracks() updated the index with it
+                        tx.executeSql("CREATE TABLE IF NOT EXISTS fuzzyIndexed(" +
+                            "_id INTEGER PRIMARY KEY," +
+                            "artist TEXT," +
+                            "album TEXT," +
+                            "track TEXT)", []);
                     });
                 }
                 resolve(collection.cachedDbs[id]);
@@ -1267,6 +1372,28 @@ Tomahawk.Collection = {
 
     },
 
+    /**
+     * Pushes a select of what the fuzzy index holds for each track: its db id,
+     * artist, album and title
+     */
+    _sqlSelectFuzzyIndexRows: function (t) {
+        t.sql(this._fuzzyIndexRowsQuery, [], this._mapFuzzyIndexRow);
+    },
+
+    _fuzzyIndexRowsQuery: "SELECT tracks._id AS _id, artists.artist AS artist,"
+        + " albums.album AS album, tracks.track AS track FROM tracks"
+        + " INNER JOIN artists ON tracks.artistId = artists._id"
+        + " INNER JOIN albums ON tracks.albumId = albums._id",
+
+    _mapFuzzyIndexRow: function (r) {
+        return {
+            _id: r._id,
+            artist: r.artist,
+            album: r.album,
+            track: r.track
+        };
+    },
+
     addTracks: function (params) {
         var that = this;
         var id = params.id;
@@ -1274,12 +1401,25 @@ Tomahawk.Collection = {
 
         var cachedAlbumArtists = {},
             cachedArtists = {},
-            cachedAlbums = {},
-            cachedArtistIds = {},
-            cachedAlbumIds = {};
+            cachedAlbums = {};
+
+        // What the fuzzy index holds already, by db id: the tracks wipe() dropped
+        // and those still in the db
+        var indexedTracks = {};
 
         var t = new Tomahawk.Collection.Transaction(this, id);
         return t.beginTransaction().then(function () {
+            t.sql("SELECT _id, artist, album, track FROM fuzzyIndexed", [],
+                that._mapFuzzyIndexRow);
+            that._sqlSelectFuzzyIndexRows(t);
+            return t.execDeferredStatements();
+        }).then(function (results) {
+            for (var i = 0; i < results.length; i++) {
+                for (var j = 0; j < results[i].length; j++) {
+                    indexedTracks[results[i][j]._id] = results[i][j];
+                }
+            }
+
             // First we insert all artists and albumArtists
             t.sqlInsert("artists", {
                 artist: "Various Artists",
@@ -1331,10 +1471,6 @@ Tomahawk.Collection = {
             for (i = 0; i < resultsArray[1].length; i++) {
                 row = resultsArray[1][i];
                 cachedArtists[row.artist + "♣" + row.artistDisambiguation] = row._id;
-                cachedArtistIds[row._id] = {
-                    artist: row.artist,
-                    artistDisambiguation: row.artistDisambiguation
-                };
             }
 
             for (i = 0; i < tracks.length; i++) {
@@ -1382,10 +1518,6 @@ Tomahawk.Collection = {
             for (var i = 0; i < results.length; i++) {
                 var row = results[i];
                 cachedAlbums[row.album + "♣" + row.albumArtistId] = row._id;
-                cachedAlbumIds[row._id] = {
-                    album: row.album,
-                    albumArtistId: row.albumArtistId
-                };
             }
         }).then(function () {
             // Now we are ready to insert the tracks
@@ -1416,32 +1548,48 @@ Tomahawk.Collection = {
             }
             return t.execDeferredStatements();
         }).then(function () {
-            var resultMap = function (r) {
-                return {
-                    _id: r._id,
-                    artistId: r.artistId,
-                    albumId: r.albumId,
-                    track: r.track
-                };
-            };
             // Get the tracks' db ids
-            t.sqlSelect("tracks", resultMap, ["_id", "artistId", "albumId", "track"]);
+            that._sqlSelectFuzzyIndexRows(t);
             return t.execDeferredStatements();
         }).then(function (results) {
             that._trackCount = results[0].length;
             Tomahawk.log("Added " + results[0].length + " tracks to collection '" + id + "'");
-            // Add the db ids together with the basic metadata to the fuzzy index list
+            // Add the db ids together with the basic metadata to the fuzzy index list,
+            // one value after the other instead of an object per track. Unless
+            // there is no index yet only the tracks it doesn't hold like this
+            // go in there, and those gone from the db are removed.
+            var rebuild = !Tomahawk.hasFuzzyIndex();
             var fuzzyIndexList = [];
+            var ids = {};
             for (var i = 0; i < results[0].length; i++) {
                 var row = results[0][i];
-                fuzzyIndexList.push({
-                    id: row._id,
-                    artist: cachedArtistIds[row.artistId].artist,
-                    album: cachedAlbumIds[row.albumId].album,
-                    track: row.track
+                var known = indexedTracks[row._id];
+                ids[row._id] = true;
+                if (rebuild || !known || known.artist !== row.artist
+                    || known.album !== row.album || known.track !== row.track) {
+                    fuzzyIndexList.push(row._id, row.artist, row.album, row.track);
+                }
+            }
+            if (rebuild) {
+                Tomahawk.createFuzzyIndex(fuzzyIndexList);
+            } else {
+                var removedIds = Object.keys(indexedTracks).filter(function (trackId) {
+                    return !ids.hasOwnProperty(trackId);
                 });
+                if (removedIds.length > 0) {
+                    Tomahawk.removeFromFuzzyIndex(removedIds);
+                }
+                if (fuzzyIndexList.length > 0) {
+                    Tomahawk.addToFuzzyIndex(fuzzyIndexList);
+                }
+                Tomahawk.log("Updated fuzzy index of collection '" + id + "': "
+                    + fuzzyIndexList.length / 4 + " tracks added, " + removedIds.length
+                    + " removed");
             }
-            Tomahawk.createFuzzyIndex(fuzzyIndexList);
+
+            // The index is up to date with the db again
+            t.sql("DELETE FROM fuzzyIndexed", []);
+            return t.execDeferredStatements();
         });
     },
 
@@ -1452,6 +1600,11 @@ Tomahawk.Collection = {
 
         var t = new Tomahawk.Collection.Transaction(this, id);
         return t.beginTransaction().then(function () {
+            // The fuzzy index is kept, the next addTracks() only updates it
+            // with what changed since. What it holds is remembered in the db,
+            // so that works after a restart too.
+            t.sql("INSERT OR REPLACE INTO fuzzyIndexed(_id, artist, album, track) "
+                + that._fuzzyIndexRowsQuery, []);
             t.sqlDrop("artists");
             t.sqlDrop("albumArtists");
             t.sqlDrop("albums");
@@ -1466,7 +1619,6 @@ Tomahawk.Collection = {
                         reject();
                     }, function () {
                         delete that.cachedDbs[id];
-                        Tomahawk.deleteFuzzyIndex(id);
                         Tomahawk.log("Wiped collection '" + id + "'");
                         resolve();
                     });
@@ -1525,6 +1677,9 @@ Tomahawk.Collection = {
                 results.map(function (e) {
                     //every result has one track
                     return e[0];
+                }).filter(function (track) {
+                    //unless the index still holds a track wipe() dropped
+                    return typeof track !== 'undefined';
                 }));
         });
     },
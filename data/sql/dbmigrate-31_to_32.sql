@@ -0,0 +1,9 @@
+-- Script to migate from db version 31 to 32.
+
+-- Guids of ops removed by oplog compaction
+CREATE TABLE IF NOT EXISTS oplog_checkpoint (
+    guid TEXT NOT NULL PRIMARY KEY,
+    id INTEGER NOT NULL
+);
+
+UPDATE settings SET v = '32' WHERE k == 'schema_version';
@@ -20,9 +20,11 @@
 
 #include "Api_v1.h"
 #include "Result.h"
+#include "SourceList.h"
 #include "Track.h"
 
 #include "audio/AudioEngine.h"
+#include "network/Servent.h"
 #include "resolvers/Resolver.h"
 #include "utils/Json.h"
 #include "utils/Logger.h"
@@ -137,6 +139,35 @@ Api_v1_5::playback( QxtWebRequestEvent* event, const QString& command )
 }
 
 
+void
+Api_v1_5::metrics( QxtWebRequestEvent* event )
+{
+    Servent* servent = Servent::instance();
+    if ( !servent )
+    {
+        m_service->sendJsonError( event, "Networking is not available." );
+        return;
+    }
+
+    QVariantMap m;
+    if ( servent->thread() == thread() )
+        m = servent->metrics();
+    else
+        QMetaObject::invokeMethod( servent, "metrics", Qt::BlockingQueuedConnection, Q_RETURN_ARG( QVariantMap, m ) );
+
+    // how busy the script collections keep their resolvers
+    SourceList* sources = SourceList::instance();
+    QVariantMap scripts;
+    if ( sources->thread() == thread() )
+        scripts = sources->scriptCollectionMetrics();
+    else
+        QMetaObject::invokeMethod( sources, "scriptCollectionMetrics", Qt::BlockingQueuedConnection, Q_RETURN_ARG( QVariantMap, scripts ) );
+    m[ "scriptCollections" ] = scripts;
+
+    m_service->sendJSON( m, event );
+}
+
+
 void
 Api_v1_5::jsonReply( QxtWebRequestEvent* event, const char* funcInfo, const QString& errorMessage, bool isError )
 {
@@ -45,6 +45,13 @@ public slots:
      */
     void playback( QxtWebRequestEvent* event, const QString& command );
 
+    /**
+     * Traffic, queue and latency metrics of the connections to our peers,
+     * see Servent::metrics(), and the command queues of the script
+     * collections under "scriptCollections".
+     */
+    void metrics( QxtWebRequestEvent* event );
+
 protected:
     void jsonReply( QxtWebRequestEvent* event, const char* funcInfo, const QString& errorMessage, bool isError );
 
@@ -18,6 +18,7 @@
 
 #include "Pipeline_p.h"
 
+#include <QDateTime>
 #include <QMutexLocker>
 
 #include "database/Database.h"
@@ -58,10 +59,10 @@ Pipeline::Pipeline( QObject* parent )
     PipelinePrivate::s_instance = this;
 
     d->maxConcurrentQueries = 24;
-    tDebug() << Q_FUNC_INFO << "Using" << d->maxConcurrentQueries << "threads";
 
-    d->temporaryQueryTimer.setInterval( CLEANUP_TIMEOUT );
-    connect( &d->temporaryQueryTimer, SIGNAL( timeout() ), SLOT( onTemporaryQueryTimer() ) );
+    d->temporaryCleanupTimer.setSingleShot( true );
+    connect( &d->temporaryCleanupTimer, SIGNAL( timeout() ), SLOT( cleanupTemporaryQueries() ) );
+    tDebug() << Q_FUNC_INFO << "Using" << d->maxConcurrentQueries << "threads";
 }
 
 
@@ -100,7 +101,8 @@ unsigned int
 Pipeline::activeQueryCount() const
 {
     Q_D( const Pipeline );
-    return d->qidsState.uniqueKeys().count();
+    QMutexLocker lock( &d->stateMut );
+    return d->qidsState.count();
 }
 
 
@@ -179,14 +181,14 @@ Pipeline::addExternalResolverFactory( ResolverFactoryFunc resolverFactory )
 
 
 Tomahawk::ExternalResolver*
-Pipeline::addScriptResolver( const QString& accountId, const QString& path, const QStringList& additionalScriptPaths )
+Pipeline::addScriptResolver( const QString& accountId, const QString& path, const QStringList& additionalScriptPaths, const QVariantHash& options )
 {
     Q_D( Pipeline );
     ExternalResolver* res = 0;
 
     foreach ( ResolverFactoryFunc factory, d->resolverFactories )
     {
-        res = factory( accountId, path, additionalScriptPaths );
+        res = factory( accountId, path, additionalScriptPaths, options );
         if ( !res )
             continue;
 
@@ -270,7 +272,7 @@ Pipeline::resolve( const QList<query_ptr>& qlist, bool prioritized, bool tempora
         {
             if ( q->resolvingFinished() )
                 continue;
-            if ( d->qidsState.contains( q->id() ) )
+            if ( isResolving( q ) )
                 continue;
             if ( d->queries_pending.contains( q ) )
             {
@@ -289,13 +291,14 @@ Pipeline::resolve( const QList<query_ptr>& qlist, bool prioritized, bool tempora
             else
                 d->queries_pending << q;
 
-            if ( temporaryQuery )
+            if ( temporaryQuery && !d->queries_temporary.contains( q->id() ) )
             {
-                d->queries_temporary << q;
-
-                if ( d->temporaryQueryTimer.isActive() )
-                    d->temporaryQueryTimer.stop();
-                d->temporaryQueryTimer.start();
+                // Nobody else holds on to temporary queries, keep them around
+                // long enough for their results to be fetched by id
+                d->queries_temporary.insert( q->id(), q );
+                d->queries_temporary_refs << qMakePair( QDateTime::currentMSecsSinceEpoch() + CLEANUP_TIMEOUT, q );
+                if ( !d->temporaryCleanupTimer.isActive() )
+                    d->temporaryCleanupTimer.start( CLEANUP_TIMEOUT );
             }
         }
     }
@@ -309,7 +312,11 @@ Pipeline::isResolving( const query_ptr& q ) const
 {
     Q_D( const Pipeline );
 
-    return d->qids.contains( q->id() ) && d->qidsState.contains( q->id() );
+    if ( !d->qids.contains( q->id() ) )
+        return false;
+
+    QMutexLocker lock( &d->stateMut );
+    return d->qidsState.contains( q->id() );
 }
 
 
@@ -345,7 +352,9 @@ Pipeline::reportResults( QID qid, Tomahawk::Resolver* r, const QList< result_ptr
     Q_D( Pipeline );
     if ( !d->running )
         return;
-    if ( !d->qids.contains( qid ) )
+
+    const query_ptr q = d->qids.value( qid );
+    if ( q.isNull() )
     {
         if ( !results.isEmpty() )
         {
@@ -361,11 +370,6 @@ Pipeline::reportResults( QID qid, Tomahawk::Resolver* r, const QList< result_ptr
         }
         return;
     }
-    const query_ptr& q = d->qids.value( qid );
-
-    Q_ASSERT( !q.isNull() );
-    if ( q.isNull() )
-        return;
 
     QList< result_ptr > cleanResults;
     QList< result_ptr > httpResults;
@@ -418,7 +422,7 @@ Pipeline::addResultsToQuery( const query_ptr& query, const QList< result_ptr >&
     {
         query->addResults( cleanResults );
 
-        if ( d->queries_temporary.contains( query ) )
+        if ( d->queries_temporary.contains( query->id() ) )
         {
             foreach ( const result_ptr& r, cleanResults )
             {
@@ -457,12 +461,12 @@ Pipeline::reportAlbums( QID qid, const QList< album_ptr >& albums )
     if ( !d->running )
         return;
 
-    if ( !d->qids.contains( qid ) )
+    const query_ptr q = d->qids.value( qid );
+    if ( q.isNull() )
     {
         tDebug() << "Albums arrived too late for:" << qid;
         return;
     }
-    const query_ptr& q = d->qids.value( qid );
     Q_ASSERT( q->isFullTextQuery() );
 
     QList< album_ptr > cleanAlbums;
@@ -487,12 +491,12 @@ Pipeline::reportArtists( QID qid, const QList< artist_ptr >& artists )
     if ( !d->running )
         return;
 
-    if ( !d->qids.contains( qid ) )
+    const query_ptr q = d->qids.value( qid );
+    if ( q.isNull() )
     {
         tDebug() << "Artists arrived too late for:" << qid;
         return;
     }
-    const query_ptr& q = d->qids.value( qid );
     Q_ASSERT( q->isFullTextQuery() );
 
     QList< artist_ptr > cleanArtists;
@@ -517,50 +521,53 @@ Pipeline::shuntNext()
     if ( !d->running )
         return;
 
-    unsigned int rc;
-    query_ptr q;
+    // Start as many queries as we may, so their resolvers get them in one batch
+    forever
     {
-        QMutexLocker lock( &d->mut );
-
-        rc = d->resolvers.count();
-        if ( d->queries_pending.isEmpty() )
+        query_ptr q;
         {
-            if ( d->qidsState.isEmpty() )
-                emit idle();
-            return;
-        }
+            QMutexLocker lock( &d->mut );
 
-        // Check if we are ready to dispatch more queries
-        if ( activeQueryCount() >= d->maxConcurrentQueries )
-            return;
+            if ( d->queries_pending.isEmpty() )
+            {
+                if ( activeQueryCount() == 0 )
+                    emit idle();
+                return;
+            }
 
-        /*
-            Since resolvers are async, we now dispatch to the highest weighted ones
-            and after timeout, dispatch to next highest etc, aborting when solved
-        */
-        q = d->queries_pending.takeFirst();
-        q->setCurrentResolver( 0 );
-    }
+            // Check if we are ready to dispatch more queries
+            if ( activeQueryCount() >= d->maxConcurrentQueries )
+                return;
 
-    // Zero-patient, a stub so that query is not resolved until we go through
-    // all resolvers
-    // As query considered as 'finished trying to resolve' when there are no
-    // more qid entries in qidsState we'll put one as sort of 'keep this until
-    // we kick off all our resolvers' entry
-    // once we kick off all resolvers we'll remove this entry
-    incQIDState( q, nullptr );
-    checkQIDState( q );
+            /*
+                Since resolvers are async, we now dispatch to the highest weighted ones
+                and after timeout, dispatch to next highest etc, aborting when solved
+            */
+            q = d->queries_pending.takeFirst();
+            q->setCurrentResolver( 0 );
+        }
+
+        // Zero-patient, a stub so that query is not resolved until we go through
+        // all resolvers
+        // As query considered as 'finished trying to resolve' when there are no
+        // more qid entries in qidsState we'll put one as sort of 'keep this until
+        // we kick off all our resolvers' entry
+        // once we kick off all resolvers we'll remove this entry
+        incQIDState( q, nullptr );
+        checkQIDState( q );
+    }
 }
 
 
 void
-Pipeline::timeoutShunt( const query_ptr& q, Tomahawk::Resolver* r )
+Pipeline::timeoutShunt( const QList< query_ptr >& queries, Tomahawk::Resolver* r )
 {
     Q_D( Pipeline );
     if ( !d->running )
         return;
 
-    decQIDState( q, r );
+    foreach ( const query_ptr& q, queries )
+        decQIDState( q, r );
 }
 
 
@@ -581,14 +588,14 @@ Pipeline::shunt( const query_ptr& q )
 
         incQIDState( q, r );
         q->setCurrentResolver( r );
-        r->resolve( q );
-        emit resolving( q );
 
-        auto timeout = r->timeout();
-        if ( timeout == 0 )
-            timeout = DEFAULT_RESOLVER_TIMEOUT;
+        // Queries shunted during this event loop iteration are handed to their
+        // resolvers in one go
+        if ( d->batches.isEmpty() )
+            QTimer::singleShot( 0, this, SLOT( flushBatches() ) );
+        d->batches[ r ] << q;
 
-        new FuncTimeout( timeout, std::bind( &Pipeline::timeoutShunt, this, q, r ), this );
+        emit resolving( q );
     }
     else
     {
@@ -605,6 +612,94 @@ Pipeline::shunt( const query_ptr& q )
 }
 
 
+void
+Pipeline::flushBatches()
+{
+    Q_D( Pipeline );
+
+    QHash< Resolver*, QList< query_ptr > > batches = d->batches;
+    d->batches.clear();
+    if ( !d->running )
+    {
+        // stopped in the meantime, release the queries instead of leaving them resolving forever
+        foreach ( const QList< query_ptr >& queries, batches )
+        {
+            foreach ( const query_ptr& q, queries )
+            {
+                bool resolving = false;
+                {
+                    QMutexLocker lock( &d->stateMut );
+                    resolving = d->qidsState.remove( q->id() ) > 0;
+                }
+                if ( !resolving )
+                    continue;
+
+                q->onResolvingFinished();
+
+                if ( !d->queries_temporary.contains( q->id() ) )
+                    d->qids.remove( q->id() );
+            }
+        }
+        return;
+    }
+
+    QHash< Resolver*, QList< query_ptr > >::const_iterator it = batches.constBegin();
+    for ( ; it != batches.constEnd(); ++it )
+    {
+        Resolver* r = it.key();
+        const QList< query_ptr >& queries = it.value();
+
+        bool known = false;
+        {
+            QMutexLocker lock( &d->mut );
+            known = d->resolvers.contains( r );
+        }
+        if ( !known )
+        {
+            // resolver got removed in the meantime
+            foreach ( const query_ptr& q, queries )
+                decQIDState( q, r );
+            continue;
+        }
+
+        tLog( LOGVERBOSE ) << "Dispatching" << queries.count() << "queries to resolver" << r->name() << r->timeout();
+
+        if ( queries.count() == 1 )
+            r->resolve( queries.first() );
+        else
+            r->resolveBatch( queries );
+
+        auto timeout = r->timeout();
+        if ( timeout == 0 )
+            timeout = DEFAULT_RESOLVER_TIMEOUT;
+
+        new FuncTimeout( timeout, std::bind( &Pipeline::timeoutShunt, this, queries, r ), this );
+    }
+}
+
+
+void
+Pipeline::cleanupTemporaryQueries()
+{
+    Q_D( Pipeline );
+
+    // released once we're out of the lock
+    QList< query_ptr > expired;
+    {
+        QMutexLocker lock( &d->mut );
+
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        while ( !d->queries_temporary_refs.isEmpty() && d->queries_temporary_refs.first().first <= now )
+            expired << d->queries_temporary_refs.takeFirst().second;
+
+        if ( !d->queries_temporary_refs.isEmpty() )
+            d->temporaryCleanupTimer.start( d->queries_temporary_refs.first().first - now );
+    }
+
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Releasing" << expired.count() << "temporary queries";
+}
+
+
 Tomahawk::Resolver*
 Pipeline::nextResolver( const Tomahawk::query_ptr& query ) const
 {
@@ -634,11 +729,16 @@ void
 Pipeline::checkQIDState( const Tomahawk::query_ptr& query )
 {
     Q_D( Pipeline );
-    QMutexLocker lock( &d->mut );
 
-    tDebug() << Q_FUNC_INFO << query->id() << d->qidsState.count( query->id() );
+    int pending = 0;
+    {
+        QMutexLocker lock( &d->stateMut );
+        pending = d->qidsState.value( query->id() ).count();
+    }
+
+    tDebug() << Q_FUNC_INFO << query->id() << pending;
 
-    if ( d->qidsState.contains( query->id() ) )
+    if ( pending )
     {
         new FuncTimeout( 0, std::bind( &Pipeline::shunt, this, query ), this );
     }
@@ -646,7 +746,7 @@ Pipeline::checkQIDState( const Tomahawk::query_ptr& query )
     {
         query->onResolvingFinished();
 
-        if ( !d->queries_temporary.contains( query ) )
+        if ( !d->queries_temporary.contains( query->id() ) )
             d->qids.remove( query->id() );
 
         new FuncTimeout( 0, std::bind( &Pipeline::shuntNext, this ), this );
@@ -658,9 +758,12 @@ void
 Pipeline::incQIDState( const Tomahawk::query_ptr& query, Tomahawk::Resolver* r )
 {
     Q_D( Pipeline );
-    QMutexLocker lock( &d->mut );
 
-    d->qidsState.insert( query->id(), r );
+    if ( !d->qids.contains( query->id() ) )
+        d->qids.insert( query->id(), query );
+
+    QMutexLocker lock( &d->stateMut );
+    d->qidsState[ query->id() ] << r;
 }
 
 
@@ -669,35 +772,19 @@ Pipeline::decQIDState( const Tomahawk::query_ptr& query, Tomahawk::Resolver* r )
 {
     Q_D( Pipeline );
 
-    if ( d->qidsState.contains( query->id(), r ) )
     {
-        {
-            QMutexLocker lock( &d->mut );
-            d->qidsState.remove( query->id(), r ); // Removes all matching pairs
-        }
+        QMutexLocker lock( &d->stateMut );
 
-        checkQIDState( query );
-    }
-}
-
-
-void
-Pipeline::onTemporaryQueryTimer()
-{
-    Q_D( Pipeline );
-    tDebug() << Q_FUNC_INFO;
-
-    QMutexLocker lock( &d->mut );
-    d->temporaryQueryTimer.stop();
-
-    for ( int i = d->queries_temporary.count() - 1; i >= 0; i-- )
-    {
-        query_ptr q = d->queries_temporary.takeAt( i );
+        QHash< QID, QList< Resolver* > >::iterator it = d->qidsState.find( query->id() );
+        if ( it == d->qidsState.end() || !it.value().contains( r ) )
+            return;
 
-        d->qids.remove( q->id() );
-        foreach ( const Tomahawk::result_ptr& r, q->results() )
-            d->rids.remove( r->id() );
+        it.value().removeAll( r );
+        if ( it.value().isEmpty() )
+            d->qidsState.erase( it );
     }
+
+    checkQIDState( query );
 }
 
 
@@ -28,6 +28,7 @@
 #include <QObject>
 #include <QList>
 #include <QStringList>
+#include <QVariantHash>
 
 #include <functional>
 
@@ -37,7 +38,7 @@ namespace Tomahawk
 class PipelinePrivate;
 class Resolver;
 class ExternalResolver;
-typedef std::function<Tomahawk::ExternalResolver*( QString, QString, QStringList )> ResolverFactoryFunc;
+typedef std::function<Tomahawk::ExternalResolver*( QString, QString, QStringList, QVariantHash )> ResolverFactoryFunc;
 
 class DLLEXPORT Pipeline : public QObject
 {
@@ -60,7 +61,10 @@ public:
     void reportArtists( QID qid, const QList< artist_ptr >& artists );
 
     void addExternalResolverFactory( ResolverFactoryFunc resolverFactory );
-    Tomahawk::ExternalResolver* addScriptResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList() );
+    /**
+     * @p options are passed on to the resolver factories, e.g. the "runtime" of a JavaScript resolver
+     */
+    Tomahawk::ExternalResolver* addScriptResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList(), const QVariantHash& options = QVariantHash() );
     void stopScriptResolver( const QString& scriptPath );
     void removeScriptResolver( const QString& scriptPath );
     QList< QPointer< ExternalResolver > > scriptResolvers() const;
@@ -96,11 +100,12 @@ protected:
     QScopedPointer<PipelinePrivate> d_ptr;
 
 private slots:
-    void timeoutShunt( const query_ptr& q, Tomahawk::Resolver* r );
+    void timeoutShunt( const QList< query_ptr >& queries, Tomahawk::Resolver* r );
     void shunt( const query_ptr& q );
     void shuntNext();
+    void flushBatches();
+    void cleanupTemporaryQueries();
 
-    void onTemporaryQueryTimer();
     void onResultUrlCheckerDone( );
 
 private:
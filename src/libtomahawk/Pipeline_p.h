@@ -22,8 +22,10 @@
 #define PIPELINE_P_H
 
 #include "Pipeline.h"
+#include "utils/ShardedWeakHash.h"
 
 #include <QMutex>
+#include <QPair>
 #include <QTimer>
 
 namespace Tomahawk
@@ -45,20 +47,30 @@ private:
     QList< Resolver* > resolvers;
     QList< QPointer<Tomahawk::ExternalResolver> > scriptResolvers;
     QList< ResolverFactoryFunc > resolverFactories;
-    QMultiMap< QID, Tomahawk::Resolver* > qidsState;
-    QMap< QID, query_ptr > qids;
-    QMap< RID, result_ptr > rids;
+    // resolvers each query is still waiting for, a null entry keeps it alive until all got dispatched
+    QHash< QID, QList< Tomahawk::Resolver* > > qidsState;
+    mutable QMutex stateMut; // for qidsState
 
-    QMutex mut; // for m_qids, m_rids
+    // weak lookups, entries go away together with their query / result
+    Tomahawk::Utils::ShardedWeakHash< Tomahawk::Query > qids;
+    Tomahawk::Utils::ShardedWeakHash< Tomahawk::Result > rids;
+    // temporary queries, kept alive for CLEANUP_TIMEOUT by queries_temporary_refs
+    Tomahawk::Utils::ShardedWeakHash< Tomahawk::Query > queries_temporary;
+
+    QMutex mut; // for resolvers, queries_pending, queries_temporary_refs
+
+    // the only strong refs to the temporary queries, with the time (msecs since epoch)
+    // they may go, oldest first. temporaryCleanupTimer drops them when it's up.
+    QList< QPair< qint64, query_ptr > > queries_temporary_refs;
+    QTimer temporaryCleanupTimer;
 
     // store queries here until DB index is loaded, then shunt them all
     QList< query_ptr > queries_pending;
-    // store temporary queries here and clean up after timeout threshold
-    QList< query_ptr > queries_temporary;
+    // queries shunted to a resolver during this event loop iteration, see Pipeline::flushBatches()
+    QHash< Resolver*, QList< query_ptr > > batches;
 
     int maxConcurrentQueries;
     bool running;
-    QTimer temporaryQueryTimer;
 
     static Pipeline* s_instance;
 };
@@ -31,7 +31,6 @@
 #include "database/DatabaseCommand_LoadAllSources.h"
 #include "database/DatabaseCommand_SocialAction.h"
 #include "database/DatabaseCommand_SourceOffline.h"
-#include "database/DatabaseCommand_UpdateSearchIndex.h"
 #include "database/DatabaseImpl.h"
 #include "database/Database.h"
 #include "utils/Logger.h"
@@ -43,6 +42,8 @@
 #include <QtAlgorithms>
 #include <QPainter>
 
+#define MAX_COMMAND_BATCH 500
+
 using namespace Tomahawk;
 
 
@@ -659,6 +660,16 @@ Source::lastCmdGuid() const
 }
 
 
+int
+Source::pendingCommandCount() const
+{
+    Q_D( const Source );
+
+    QMutexLocker lock( &d->cmdMutex );
+    return d->cmds.count();
+}
+
+
 void
 Source::setLastCmdGuid( const QString& guid )
 {
@@ -699,6 +710,11 @@ Source::executeCommands()
         return;
     }
 
+    // Every page of a sync calls in here, only one batch is in flight at
+    // once. The rest is picked up once it finished.
+    if ( d->executing )
+        return;
+
     bool commandsAvail = false;
     {
         QMutexLocker lock( &d->cmdMutex );
@@ -708,28 +724,17 @@ Source::executeCommands()
     if ( commandsAvail )
     {
         QMutexLocker lock( &d->cmdMutex );
+
+        // Hand over a whole batch at once, so the rw worker can group-commit it
         QList< Tomahawk::dbcmd_ptr > cmdGroup;
-        Tomahawk::dbcmd_ptr cmd = d->cmds.takeFirst();
-        while ( cmd->groupable() )
-        {
-            cmdGroup << cmd;
-            if ( !d->cmds.isEmpty() && d->cmds.first()->groupable() && d->cmds.first()->commandname() == cmd->commandname() )
-                cmd = d->cmds.takeFirst();
-            else
-                break;
-        }
+        while ( !d->cmds.isEmpty() && cmdGroup.count() < MAX_COMMAND_BATCH )
+            cmdGroup << d->cmds.takeFirst();
 
         // return here when the last command finished
-        connect( cmd.data(), SIGNAL( finished() ), SLOT( executeCommands() ) );
+        d->executing = true;
+        connect( cmdGroup.last().data(), SIGNAL( finished() ), SLOT( onCommandsExecuted() ) );
 
-        if ( !cmdGroup.isEmpty() )
-        {
-            Database::instance()->enqueue( cmdGroup );
-        }
-        else
-        {
-            Database::instance()->enqueue( cmd );
-        }
+        Database::instance()->enqueue( cmdGroup );
 
         int percentage = ( float( d->commandCount - d->cmds.count() ) / (float)d->commandCount ) * 100.0;
         d->textStatus = tr( "Saving (%1%)" ).arg( percentage );
@@ -753,6 +758,16 @@ Source::executeCommands()
 }
 
 
+void
+Source::onCommandsExecuted()
+{
+    Q_D( Source );
+
+    d->executing = false;
+    executeCommands();
+}
+
+
 void
 Source::reportSocialAttributesChanged( DatabaseCommand_SocialAction* action )
 {
@@ -778,17 +793,11 @@ Source::reportSocialAttributesChanged( DatabaseCommand_SocialAction* action )
 void
 Source::updateTracks()
 {
-    {
-        DatabaseCommand* cmd = new DatabaseCommand_UpdateSearchIndex();
-        Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
-    }
-
-    {
-        // Re-calculate local db stats
-        DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( SourceList::instance()->get( id() ) );
-        connect( cmd, SIGNAL( done( QVariantMap ) ), SLOT( setStats( QVariantMap ) ), Qt::QueuedConnection );
-        Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
-    }
+    // The search index is kept up to date by DatabaseCommand_AddFiles / DeleteFiles,
+    // only re-calculate local db stats
+    DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( SourceList::instance()->get( id() ) );
+    connect( cmd, SIGNAL( done( QVariantMap ) ), SLOT( setStats( QVariantMap ) ), Qt::QueuedConnection );
+    Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
 }
 
 
@@ -148,6 +148,7 @@ private slots:
     void trackTimerFired();
 
     void executeCommands();
+    void onCommandsExecuted();
     void addCommand( const dbcmd_ptr& command );
 
 private:
@@ -158,6 +159,8 @@ private:
     QString prettyName( const QString& name ) const;
 
     void updateTracks();
+    /// number of commands added, but not handed over to the database yet
+    int pendingCommandCount() const;
     void reportSocialAttributesChanged( DatabaseCommand_SocialAction* action );
 };
 
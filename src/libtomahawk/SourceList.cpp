@@ -27,6 +27,7 @@
 #include "infosystem/InfoSystemCache.h"
 #include "resolvers/ExternalResolver.h"
 #include "resolvers/ScriptCollection.h"
+#include "resolvers/ScriptCommandQueue.h"
 #include "utils/Json.h"
 #include "utils/Logger.h"
 
@@ -262,6 +263,21 @@ SourceList::scriptCollections() const
 }
 
 
+QVariantMap
+SourceList::scriptCollectionMetrics() const
+{
+    QVariantMap m;
+    foreach ( const collection_ptr& collection, m_scriptCollections )
+    {
+        ScriptCollection* sc = qobject_cast< ScriptCollection* >( collection.data() );
+        if ( sc )
+            m[ sc->name() ] = sc->commandQueue()->metrics();
+    }
+
+    return m;
+}
+
+
 void
 SourceList::latchedOff( const source_ptr& to )
 {
@@ -55,6 +55,10 @@ public:
     void addScriptCollection( const Tomahawk::collection_ptr& collection );
     void removeScriptCollection( const Tomahawk::collection_ptr& collection );
     QList<Tomahawk::collection_ptr> scriptCollections() const;
+    /**
+     * ScriptCommandQueue::metrics() of the script collections, by name
+     */
+    Q_INVOKABLE QVariantMap scriptCollectionMetrics() const;
 
     Tomahawk::source_ptr get( const QString& username, const QString& friendlyName = QString(), bool autoCreate = false );
     Tomahawk::source_ptr get( int id ) const;
@@ -43,6 +43,7 @@ public:
         , avatarLoaded( false )
         , cc( 0 )
         , commandCount( 0 )
+        , executing( false )
     {
     }
     Source* q_ptr;
@@ -72,6 +73,7 @@ private:
     QPointer<ControlConnection> cc;
     QList< Tomahawk::dbcmd_ptr > cmds;
     int commandCount;
+    bool executing; // a batch is with the database
     QString lastCmdGuid;
     QMutex setControlConnectionMutex;
     QMutex mutex;
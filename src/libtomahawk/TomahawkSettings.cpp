@@ -771,6 +771,20 @@ TomahawkSettings::setScannerTime( uint time )
 }
 
 
+int
+TomahawkSettings::scannerTagReaders() const
+{
+    return value( "scanner/tagreaders", DEFAULT_SCANNER_TAG_READERS ).toInt();
+}
+
+
+void
+TomahawkSettings::setScannerTagReaders( int readers )
+{
+    setValue( "scanner/tagreaders", readers );
+}
+
+
 bool
 TomahawkSettings::watchForChanges() const
 {
@@ -859,6 +873,20 @@ TomahawkSettings::setHttpBindAll( bool bindAll )
 }
 
 
+uint
+TomahawkSettings::streamBufferMemory() const
+{
+    return value( "network/streambuffermemory", 32 ).toUInt();
+}
+
+
+void
+TomahawkSettings::setStreamBufferMemory( uint megabytes )
+{
+    setValue( "network/streambuffermemory", megabytes );
+}
+
+
 bool
 TomahawkSettings::crashReporterEnabled() const
 {
@@ -1532,6 +1560,20 @@ TomahawkSettings::setScriptDefaultPath( const QString& path )
 }
 
 
+QString
+TomahawkSettings::scriptRuntime() const
+{
+    return value( "script/runtime", "webkit" ).toString();
+}
+
+
+void
+TomahawkSettings::setScriptRuntime( const QString& runtime )
+{
+    setValue( "script/runtime", runtime );
+}
+
+
 QString
 TomahawkSettings::playlistDefaultPath() const
 {
@@ -32,6 +32,8 @@
 #include <QStringList>
 
 #define TOMAHAWK_SETTINGS_VERSION 17
+// threads the collection scanner reads tags with, unless configured otherwise
+#define DEFAULT_SCANNER_TAG_READERS 4
 
 /**
  * Convenience wrapper around QSettings for tomahawk-specific config
@@ -57,6 +59,9 @@ public:
     uint scannerTime() const;
     void setScannerTime( uint time );
 
+    int scannerTagReaders() const;
+    void setScannerTagReaders( int readers );
+
     QString downloadsPreferredFormat() const;
     void setDownloadsPreferredFormat( const QString& format );
 
@@ -160,6 +165,9 @@ public:
     bool httpBindAll() const; /// false by default
     void setHttpBindAll( bool bindAll );
 
+    uint streamBufferMemory() const; /// in MiB per stream received from a peer, 32 by default
+    void setStreamBufferMemory( uint megabytes );
+
     bool crashReporterEnabled() const; /// true by default
     void setCrashReporterEnabled( bool enable );
 
@@ -211,6 +219,9 @@ public:
 
     QString scriptDefaultPath() const;
     void setScriptDefaultPath( const QString& path );
+    /// Runtime for JavaScript resolvers that don't ask for one in their manifest, see JSAccount::Runtime
+    QString scriptRuntime() const;
+    void setScriptRuntime( const QString& runtime );
     QString playlistDefaultPath() const;
     void setPlaylistDefaultPath( const QString& path );
 
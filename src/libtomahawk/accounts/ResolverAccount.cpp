@@ -263,6 +263,10 @@ ResolverAccountFactory::metadataFromJsonFile( const QString& path )
                 {
                     result[ "scripts" ] = manifest[ "scripts" ]; //any additional scripts to load before
                 }
+                if ( !manifest[ "runtime" ].isNull() )
+                {
+                    result[ "runtime" ] = manifest[ "runtime" ]; //JavaScript runtime the resolver wants to run in
+                }
             }
             if ( !variant[ "version" ].isNull() )
                 result[ "version" ] = variant[ "version" ];
@@ -374,7 +378,11 @@ ResolverAccount::hookupResolver()
     if ( configuration().contains( "scripts" ) )
         additionalPaths = configuration().value( "scripts" ).toStringList();
 
-    Tomahawk::ExternalResolver* er = Pipeline::instance()->addScriptResolver( accountId(), mainScriptPath, additionalPaths );
+    QVariantHash options;
+    if ( configuration().contains( "runtime" ) )
+        options[ "runtime" ] = configuration().value( "runtime" );
+
+    Tomahawk::ExternalResolver* er = Pipeline::instance()->addScriptResolver( accountId(), mainScriptPath, additionalPaths, options );
     m_resolver = QPointer< ExternalResolverGui >( qobject_cast< ExternalResolverGui* >( er ) );
     connect( m_resolver.data(), SIGNAL( changed() ), this, SLOT( resolverChanged() ) );
 
@@ -24,6 +24,8 @@
 
 #include <QList>
 
+class QObject;
+
 namespace Tomahawk
 {
 
@@ -35,6 +37,11 @@ public:
     virtual void enqueue() = 0;
 
     virtual void setFilter( const QString& filter ) = 0;
+    /**
+     * Who waits for the result. Requests of the same requester may replace
+     * each other while they wait, those of different ones never do.
+     */
+    virtual void setRequester( QObject* /*requester*/ ) {}
 
 protected: //signals
     virtual void artists( const QList< Tomahawk::artist_ptr >& ) = 0;
@@ -0,0 +1,182 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CollectionSnapshot.h"
+
+#include "utils/Logger.h"
+
+#include <QDataStream>
+#include <QHash>
+#include <QStringList>
+
+#define SNAPSHOT_MAGIC "TSNP"
+#define SNAPSHOT_MAGIC_SIZE 4
+#define SNAPSHOT_VERSION 1
+
+using namespace Tomahawk;
+
+namespace
+{
+    // string valued file fields, stored as indexes into the chunk's string table
+    const char* const stringFields[] = { "hash", "mimetype", "artist", "albumartist", "album", "track", "composer" };
+    const int stringFieldCount = sizeof( stringFields ) / sizeof( stringFields[0] );
+}
+
+
+QByteArray
+CollectionSnapshotChunk::serialize() const
+{
+    QStringList strings;
+    QHash< QString, quint32 > stringIndex;
+    QList< quint32 > refs;
+
+    foreach ( const QVariant& v, files )
+    {
+        const QVariantMap m = v.toMap();
+        for ( int i = 0; i < stringFieldCount; i++ )
+        {
+            const QString s = m.value( stringFields[i] ).toString();
+            QHash< QString, quint32 >::const_iterator it = stringIndex.constFind( s );
+            if ( it == stringIndex.constEnd() )
+            {
+                it = stringIndex.insert( s, strings.count() );
+                strings << s;
+            }
+            refs << it.value();
+        }
+    }
+
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_4_8 );
+
+    stream.writeRawData( SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE );
+    stream << (quint8)SNAPSHOT_VERSION << first << lastop;
+
+    stream << strings;
+
+    stream << (quint32)files.count();
+    int ref = 0;
+    foreach ( const QVariant& v, files )
+    {
+        const QVariantMap m = v.toMap();
+        stream << m.value( "id" ).toUInt()
+               << m.value( "size" ).toUInt()
+               << m.value( "mtime" ).toInt()
+               << m.value( "duration" ).toUInt()
+               << m.value( "bitrate" ).toUInt()
+               << m.value( "albumpos" ).toUInt()
+               << m.value( "discnumber" ).toUInt()
+               << m.value( "year" ).toInt();
+
+        for ( int i = 0; i < stringFieldCount; i++ )
+            stream << refs.at( ref++ );
+    }
+
+    stream << (quint32)ops.count();
+    foreach ( const dbop_ptr& op, ops )
+    {
+        stream << op->guid << op->command << op->payload << op->compressed << op->singleton;
+    }
+
+    return data;
+}
+
+
+bool
+CollectionSnapshotChunk::deserialize( const QByteArray& data )
+{
+    if ( !isSnapshot( data ) )
+        return false;
+
+    QDataStream stream( data );
+    stream.setVersion( QDataStream::Qt_4_8 );
+    stream.skipRawData( SNAPSHOT_MAGIC_SIZE );
+
+    quint8 version;
+    stream >> version;
+    if ( version != SNAPSHOT_VERSION )
+    {
+        tLog() << Q_FUNC_INFO << "Unsupported snapshot version:" << version;
+        return false;
+    }
+
+    stream >> first >> lastop;
+
+    QStringList strings;
+    stream >> strings;
+
+    quint32 fileCount;
+    stream >> fileCount;
+    files.clear();
+    for ( quint32 f = 0; f < fileCount && stream.status() == QDataStream::Ok; f++ )
+    {
+        quint32 id, size, duration, bitrate, albumpos, discnumber;
+        qint32 mtime, year;
+        stream >> id >> size >> mtime >> duration >> bitrate >> albumpos >> discnumber >> year;
+
+        QVariantMap m;
+        // remote files are known by their id on the peer, see DatabaseCommand_AddFiles::files()
+        m.insert( "id", id );
+        m.insert( "url", QString::number( id ) );
+        m.insert( "size", size );
+        m.insert( "mtime", mtime );
+        m.insert( "duration", duration );
+        m.insert( "bitrate", bitrate );
+        m.insert( "albumpos", albumpos );
+        m.insert( "discnumber", discnumber );
+        m.insert( "year", year );
+
+        for ( int i = 0; i < stringFieldCount; i++ )
+        {
+            quint32 ref;
+            stream >> ref;
+            if ( ref >= (quint32)strings.count() )
+            {
+                tLog() << Q_FUNC_INFO << "Invalid string reference in snapshot";
+                return false;
+            }
+            m.insert( stringFields[i], strings.at( ref ) );
+        }
+
+        files << m;
+    }
+
+    quint32 opCount;
+    stream >> opCount;
+    ops.clear();
+    for ( quint32 o = 0; o < opCount && stream.status() == QDataStream::Ok; o++ )
+    {
+        dbop_ptr op( new DBOp );
+        stream >> op->guid >> op->command >> op->payload >> op->compressed >> op->singleton;
+        ops << op;
+    }
+
+    if ( stream.status() != QDataStream::Ok )
+    {
+        tLog() << Q_FUNC_INFO << "Truncated snapshot chunk";
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+CollectionSnapshotChunk::isSnapshot( const QByteArray& data )
+{
+    return data.startsWith( SNAPSHOT_MAGIC );
+}
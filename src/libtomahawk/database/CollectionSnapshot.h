@@ -0,0 +1,63 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLLECTIONSNAPSHOT_H
+#define COLLECTIONSNAPSHOT_H
+
+#include "Op.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVariantList>
+
+#include "DllMacro.h"
+
+namespace Tomahawk
+{
+
+/*
+    One piece of a collection snapshot, the compacted form of a source's
+    oplog that is sent to peers which have never synced with us before.
+
+    Instead of every addfiles/deletefiles op ever logged, a snapshot holds
+    the files as they are right now, in the same maps DatabaseCommand_AddFiles
+    takes, followed by all other ops. Only the last chunk carries lastop, the
+    guid of the last op the snapshot covers, syncing continues from there.
+
+    Chunks are encoded with QDataStream. Names are stored once per chunk in a
+    string table, files only reference them.
+*/
+struct DLLEXPORT CollectionSnapshotChunk
+{
+    CollectionSnapshotChunk() : first( false ) {}
+
+    bool first;
+    QString lastop;
+    QVariantList files;
+    QList< dbop_ptr > ops;
+
+    int count() const { return files.count() + ops.count(); }
+
+    QByteArray serialize() const;
+    bool deserialize( const QByteArray& data );
+
+    static bool isSnapshot( const QByteArray& data );
+};
+
+}
+
+#endif // COLLECTIONSNAPSHOT_H
@@ -25,6 +25,7 @@
 #include "DatabaseCommand.h"
 #include "DatabaseImpl.h"
 #include "DatabaseWorker.h"
+#include "DatabaseWorkQueue.h"
 #include "IdThreadWorker.h"
 #include "PlaylistEntry.h"
 
@@ -84,6 +85,7 @@ Database::Database( const QString& dbname, QObject* parent )
     , m_ready( false )
     , m_impl( new DatabaseImpl( dbname ) )
     , m_workerRW( new DatabaseWorkerThread( this, true ) )
+    , m_workQueue( new DatabaseWorkQueue() )
     , m_idWorker( new IdThreadWorker( this ) )
 {
     s_instance = this;
@@ -120,7 +122,7 @@ Database::Database( const QString& dbname, QObject* parent )
 
     while ( m_workerThreads.count() < m_maxConcurrentThreads )
     {
-        QPointer< DatabaseWorkerThread > workerThread( new DatabaseWorkerThread( this, false ) );
+        QPointer< DatabaseWorkerThread > workerThread( new DatabaseWorkerThread( this, false, m_workQueue ) );
         Q_ASSERT( workerThread );
         workerThread.data()->start();
         m_workerThreads << workerThread;
@@ -165,6 +167,7 @@ Database::~Database()
         }
     }
     m_workerThreads.clear();
+    delete m_workQueue;
 
     qDeleteAll( m_implHash.values() );
     qDeleteAll( m_commandFactories.values() );
@@ -230,50 +233,9 @@ Database::enqueue( const Tomahawk::dbcmd_ptr& lc )
     }
     else
     {
-        // find thread for commandname with lowest amount of outstanding jobs and enqueue job
-        int busyThreads = 0;
-        QPointer< DatabaseWorkerThread > workerThread;
-        QPointer< DatabaseWorker > happyWorker;
-        for ( int i = 0; i < m_workerThreads.count(); i++ )
-        {
-            workerThread = m_workerThreads.at( i );
-
-            if ( !workerThread || !workerThread->worker() )
-            {
-                // We have no valid worker for the current thread so skip it.
-                continue;
-            }
-
-            if ( !workerThread->worker()->busy() )
-            {
-                // Case 1: We have a workerThread with no outstanding jobs.
-                // As this is the optimal situation we do not need to look at
-                // the other workers.
-                happyWorker = workerThread->worker();
-                break;
-            }
-            else
-            {
-                busyThreads++;
-
-                if ( !happyWorker )
-                {
-                    // Case 2: We have not yet got a happyWorker but the current
-                    // workerThread has a worker so use it as a fallback.
-                    happyWorker = workerThread->worker();
-                }
-                else if ( workerThread->worker()->outstandingJobs() < happyWorker->outstandingJobs() )
-                {
-                    // Case 3: We have a worker and the current worker is less busy
-                    // than the previous minimum.
-                    happyWorker = workerThread->worker();
-                }
-            }
-        }
-
-        tDebug( LOGVERBOSE ) << "Enqueueing command to thread:" << happyWorker << busyThreads << lc->commandname();
-        Q_ASSERT( happyWorker );
-        happyWorker->enqueue( lc );
+        // idle workers pick the job up from the shared queue, highest priority first
+        tDebug( LOGVERBOSE ) << "Enqueueing command to ro queue:" << lc->commandname() << "priority:" << lc->priority();
+        m_workQueue->enqueue( lc );
     }
 }
 
@@ -309,6 +271,9 @@ Database::markAsReady()
     {
         m_workerThreads.first()->waitForEventLoopStart();
     }
+    // enqueue() drops mutating commands until the rw worker exists
+    if ( m_workerRW )
+        m_workerRW.data()->waitForEventLoopStart();
 
     m_ready = true;
     emit ready();
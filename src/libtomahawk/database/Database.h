@@ -35,6 +35,7 @@ class DatabaseImpl;
 class DatabaseCommand;
 class DatabaseWorkerThread;
 class DatabaseWorker;
+class DatabaseWorkQueue;
 class IdThreadWorker;
 
 class DLLEXPORT DatabaseCommandFactory : public QObject
@@ -71,6 +72,9 @@ protected:
     the queue of work. There is a threadpool responsible for exec'ing all
     the non-mutating (readonly) commands and one separate thread for mutating ones,
     so sqlite doesn't write to the Database from multiple threads.
+
+    The readonly threads share a single DatabaseWorkQueue, see
+    DatabaseCommand::priority() for how commands get scheduled on it.
 */
 class DLLEXPORT Database : public QObject
 {
@@ -129,6 +133,7 @@ private:
     DatabaseImpl* m_impl;
     QPointer< DatabaseWorkerThread > m_workerRW;
     QList< QPointer< DatabaseWorkerThread > > m_workerThreads;
+    DatabaseWorkQueue* m_workQueue;
     IdThreadWorker* m_idWorker;
     int m_maxConcurrentThreads;
 
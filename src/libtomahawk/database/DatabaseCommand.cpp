@@ -131,6 +131,14 @@ DatabaseCommand::emitFinished()
     emit finished();
 }
 
+
+void
+DatabaseCommand::emitFailed()
+{
+    emit failed();
+}
+
+
 void
 DatabaseCommand::emitCommitted()
 {
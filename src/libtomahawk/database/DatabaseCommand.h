@@ -45,6 +45,16 @@ public:
         FINISHED = 2
     };
 
+    /**
+     * Lane a read-only command is queued in. Workers always drain the
+     * interactive lane first, bulk commands never occupy every worker.
+     */
+    enum Priority {
+        InteractivePriority = 0,
+        BackgroundPriority = 1,
+        BulkPriority = 2
+    };
+
     explicit DatabaseCommand( QObject* parent = nullptr );
     explicit DatabaseCommand( const Tomahawk::source_ptr& src, QObject* parent = nullptr );
 
@@ -54,6 +64,7 @@ public:
 
     virtual QString commandname() const { return "DatabaseCommand"; }
     virtual bool doesMutates() const { return true; }
+    virtual Priority priority() const { return BackgroundPriority; }
     State state() const;
 
     // if i make this pure virtual, i get compile errors in qmetatype.h.
@@ -82,6 +93,7 @@ public:
     void setGuid( const QString& g );
 
     void emitFinished();
+    void emitFailed();
     void emitCommitted();
     void emitRunning();
 
@@ -95,6 +107,9 @@ signals:
     void finished();
     void finished( const Tomahawk::dbcmd_ptr& );
 
+    /// Right before finished(), when the command was rolled back
+    void failed();
+
     void committed();
     void committed( const Tomahawk::dbcmd_ptr& );
 protected:
@@ -26,6 +26,7 @@
 
 #include "Album.h"
 #include "Artist.h"
+#include "DatabaseCommand_UpdateSearchIndex.h"
 #include "DatabaseImpl.h"
 #include "PlaylistEntry.h"
 #include "SourceList.h"
@@ -56,6 +57,10 @@ DatabaseCommand_AddFiles::files() const
 void
 DatabaseCommand_AddFiles::postCommitHook()
 {
+    // Only now the tracks can be resolved, and a rolled back command
+    // doesn't leave them behind in the index
+    Database::instance()->impl()->updateSearchIndex( m_indexData );
+
     // make the collection object emit its tracksAdded signal, so the
     // collection browser will update/fade in etc.
     Collection* coll = source()->dbCollection().data();
@@ -85,6 +90,7 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
     query_trackattr.prepare( "INSERT INTO track_attributes(id, k, v) VALUES (?, ?, ?)" );
 
     int added = 0;
+    QHash< int, IndexData > indexTracks, indexAlbums;
     QVariant srcid = source()->isLocal() ? QVariant( QVariant::Int ) : source()->id();
     qDebug() << "Adding" << m_files.length() << "files to db for source" << srcid;
 
@@ -167,11 +173,31 @@ DatabaseCommand_AddFiles::exec( DatabaseImpl* dbi )
         query_trackattr.bindValue( 2, year );
         query_trackattr.exec();
 
+        if ( !indexTracks.contains( trackid ) )
+        {
+            IndexData ida;
+            ida.id = trackid;
+            ida.artistId = artistid;
+            ida.artist = artist;
+            ida.track = track;
+            indexTracks.insert( trackid, ida );
+        }
+        if ( albumid > 0 && !indexAlbums.contains( albumid ) )
+        {
+            IndexData ida;
+            ida.id = albumid;
+            ida.artistId = 0;
+            ida.album = album;
+            indexAlbums.insert( albumid, ida );
+        }
+
         m_ids << fileid;
         added++;
     }
 
     qDebug() << "Inserted" << added << "tracks to database";
+
+    m_indexData = indexTracks.values() + indexAlbums.values();
     tDebug() << "Committing" << added << "tracks...";
 
     emit done( m_files, source()->dbCollection() );
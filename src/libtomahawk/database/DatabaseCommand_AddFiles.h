@@ -23,6 +23,7 @@
 #include <QVariantMap>
 
 #include "database/DatabaseCommandLoggable.h"
+#include "database/DatabaseCommand_UpdateSearchIndex.h"
 #include "Typedefs.h"
 #include "Query.h"
 
@@ -51,6 +52,7 @@ public:
 
     virtual void exec( DatabaseImpl* );
     virtual bool doesMutates() const { return true; }
+    virtual bool groupable() const { return true; }
     virtual void postCommitHook();
 
     QVariantList files() const;
@@ -63,6 +65,7 @@ signals:
 private:
     QVariantList m_files;
     QList<unsigned int> m_ids;
+    QList< IndexData > m_indexData; // applied once committed
 };
 
 }
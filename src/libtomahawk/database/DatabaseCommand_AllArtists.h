@@ -52,6 +52,7 @@ public:
     void exec( DatabaseImpl* ) Q_DECL_OVERRIDE;
 
     bool doesMutates() const Q_DECL_OVERRIDE { return false; }
+    Priority priority() const Q_DECL_OVERRIDE { return BulkPriority; }
     QString commandname() const Q_DECL_OVERRIDE { return "allartists"; }
 
     void enqueue() Q_DECL_OVERRIDE { Database::instance()->enqueue( Tomahawk::dbcmd_ptr( this ) ); }
@@ -61,6 +61,7 @@ public:
     void exec( DatabaseImpl* ) override;
 
     bool doesMutates() const override { return false; }
+    Priority priority() const override { return BulkPriority; }
     QString commandname() const override { return "alltracks"; }
 
     void enqueue() override { Database::instance()->enqueue( Tomahawk::dbcmd_ptr( this ) ); }
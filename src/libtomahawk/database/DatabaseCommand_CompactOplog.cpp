@@ -0,0 +1,206 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseCommand_CompactOplog.h"
+
+#include "DatabaseImpl.h"
+#include "TomahawkSqlQuery.h"
+#include "utils/Json.h"
+#include "utils/Logger.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+
+// same as DatabaseWorker::logOp()
+#define COMPRESS_THRESHOLD 512
+
+namespace Tomahawk
+{
+
+static QVariantMap
+decodeOp( const TomahawkSqlQuery& query, int jsonColumn, int compressedColumn )
+{
+    const QByteArray payload = query.value( jsonColumn ).toByteArray();
+    const bool compressed = query.value( compressedColumn ).toBool();
+
+    return TomahawkUtils::parseJson( compressed ? qUncompress( payload ) : payload ).toMap();
+}
+
+
+static qint64
+oplogSize( DatabaseImpl* dbi )
+{
+    TomahawkSqlQuery query = dbi->newquery();
+    query.exec( "SELECT coalesce(sum(length(json)), 0) FROM oplog WHERE source IS NULL" );
+    return query.next() ? query.value( 0 ).toLongLong() : 0;
+}
+
+
+void
+DatabaseCommand_CompactOplog::exec( DatabaseImpl* dbi )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    TomahawkSqlQuery query = dbi->newquery();
+    query.exec( "SELECT v FROM settings WHERE k = 'oplog_compacted'" );
+    const int compactedId = query.next() ? query.value( 0 ).toInt() : 0;
+
+    query.exec( "SELECT coalesce(max(id), 0) FROM oplog WHERE source IS NULL" );
+    const int lastId = query.next() ? query.value( 0 ).toInt() : 0;
+
+    QVariantMap stats;
+    stats[ "removed" ] = 0;
+    stats[ "rewritten" ] = 0;
+
+    // Nothing was deleted since the last run, so nothing became obsolete either
+    query.prepare( "SELECT count(*) FROM oplog WHERE source IS NULL AND id > ? "
+                   "AND command IN ('deletefiles', 'deleteplaylist', 'deletedynamicplaylist')" );
+    query.addBindValue( compactedId );
+    query.exec();
+    if ( lastId <= compactedId || !query.next() || query.value( 0 ).toInt() == 0 )
+    {
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Nothing to compact";
+        emit done( stats );
+        return;
+    }
+
+    const qint64 sizeBefore = oplogSize( dbi );
+
+    QSet< uint > files;
+    query.exec( "SELECT id FROM file WHERE source IS NULL" );
+    while ( query.next() )
+        files << query.value( 0 ).toUInt();
+
+    // playlist guid -> id of the op that deleted it
+    QHash< QString, int > deletedPlaylists;
+    query.exec( "SELECT id, json, compressed FROM oplog WHERE source IS NULL "
+                "AND command IN ('deleteplaylist', 'deletedynamicplaylist')" );
+    while ( query.next() )
+        deletedPlaylists.insert( decodeOp( query, 1, 2 ).value( "playlistguid" ).toString(), query.value( 0 ).toInt() );
+
+    QList< QPair< int, QString > > removals;
+    QList< QPair< int, QByteArray > > rewrites;
+
+    query.exec( "SELECT id, guid, command, json, compressed FROM oplog WHERE source IS NULL "
+                "AND command IN ('addfiles', 'createplaylist', 'createdynamicplaylist', 'renameplaylist', "
+                "'setplaylistrevision', 'setdynamicplaylistrevision') "
+                "ORDER BY id ASC" );
+    while ( query.next() )
+    {
+        const int id = query.value( 0 ).toInt();
+        const QString guid = query.value( 1 ).toString();
+        const QString command = query.value( 2 ).toString();
+        QVariantMap op = decodeOp( query, 3, 4 );
+        if ( op.isEmpty() )
+            continue;
+
+        if ( command == "addfiles" )
+        {
+            const QVariantList opFiles = op.value( "files" ).toList();
+
+            QVariantList liveFiles;
+            foreach ( const QVariant& file, opFiles )
+            {
+                if ( files.contains( file.toMap().value( "id" ).toUInt() ) )
+                    liveFiles << file;
+            }
+
+            if ( liveFiles.isEmpty() )
+            {
+                removals << qMakePair( id, guid );
+            }
+            else if ( liveFiles.count() < opFiles.count() )
+            {
+                op[ "files" ] = liveFiles;
+                rewrites << qMakePair( id, TomahawkUtils::toJson( op ) );
+            }
+        }
+        else
+        {
+            QString playlist = op.value( "playlistguid" ).toString();
+            if ( playlist.isEmpty() )
+                playlist = op.value( "playlist" ).toMap().value( "guid" ).toString();
+
+            if ( deletedPlaylists.contains( playlist ) && id < deletedPlaylists.value( playlist ) )
+                removals << qMakePair( id, guid );
+        }
+    }
+
+    TomahawkSqlQuery checkpointQuery = dbi->newquery();
+    checkpointQuery.prepare( "INSERT OR REPLACE INTO oplog_checkpoint(guid, id) VALUES(?, ?)" );
+    TomahawkSqlQuery deleteQuery = dbi->newquery();
+    deleteQuery.prepare( "DELETE FROM oplog WHERE id = ?" );
+
+    for ( int i = 0; i < removals.count(); i++ )
+    {
+        checkpointQuery.bindValue( 0, removals.at( i ).second );
+        checkpointQuery.bindValue( 1, removals.at( i ).first );
+        if ( !checkpointQuery.exec() )
+            throw "Failed to add oplog checkpoint";
+
+        deleteQuery.bindValue( 0, removals.at( i ).first );
+        if ( !deleteQuery.exec() )
+            throw "Failed to remove obsolete op";
+    }
+
+    TomahawkSqlQuery updateQuery = dbi->newquery();
+    updateQuery.prepare( "UPDATE oplog SET json = ?, compressed = ? WHERE id = ?" );
+
+    for ( int i = 0; i < rewrites.count(); i++ )
+    {
+        QByteArray ba = rewrites.at( i ).second;
+        bool compressed = false;
+        if ( ba.length() >= COMPRESS_THRESHOLD )
+        {
+            ba = qCompress( ba, 9 );
+            compressed = true;
+        }
+
+        updateQuery.bindValue( 0, ba );
+        updateQuery.bindValue( 1, compressed ? "true" : "false" );
+        updateQuery.bindValue( 2, rewrites.at( i ).first );
+        if ( !updateQuery.exec() )
+            throw "Failed to rewrite op";
+    }
+
+    query.prepare( "INSERT OR REPLACE INTO settings(k, v) VALUES('oplog_compacted', ?)" );
+    query.addBindValue( QString::number( lastId ) );
+    if ( !query.exec() )
+        throw "Failed to save compacted oplog id";
+
+    const qint64 sizeAfter = oplogSize( dbi );
+
+    // What a peer syncing from scratch now has to load, see DatabaseCommand_loadOps
+    query.exec( "SELECT count(*) FROM oplog WHERE source IS NULL" );
+    const int remaining = query.next() ? query.value( 0 ).toInt() : 0;
+
+    stats[ "removed" ] = removals.count();
+    stats[ "rewritten" ] = rewrites.count();
+    stats[ "remaining" ] = remaining;
+    stats[ "sizeBefore" ] = sizeBefore;
+    stats[ "sizeAfter" ] = sizeAfter;
+    stats[ "time" ] = timer.elapsed();
+
+    tLog() << "Compacted oplog: removed" << removals.count() << "ops, rewrote" << rewrites.count()
+           << "- reclaimed" << sizeBefore - sizeAfter << "bytes," << remaining << "ops /" << sizeAfter << "bytes left"
+           << "- took" << stats[ "time" ].toLongLong() << "ms";
+
+    emit done( stats );
+}
+
+}
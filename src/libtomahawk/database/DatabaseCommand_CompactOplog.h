@@ -0,0 +1,68 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_COMPACTOPLOG_H
+#define DATABASECOMMAND_COMPACTOPLOG_H
+
+#include "DatabaseCommand.h"
+#include "Typedefs.h"
+
+#include <QVariantMap>
+
+#include "DllMacro.h"
+
+namespace Tomahawk
+{
+
+/**
+ * Drops the parts of the local oplog nobody needs anymore:
+ *  - files that have been deleted since are removed from addfiles ops,
+ *    an op left without files is removed altogether
+ *  - all ops about a playlist that has been deleted since, except for the
+ *    delete itself: peers that have the playlist still need it. Peers that
+ *    replay the compacted oplog get a delete for a playlist they never saw,
+ *    DatabaseCommand_DeletePlaylist ignores it.
+ *
+ * Peers that already applied a removed op still get everything that comes
+ * after it: the guids of removed ops are kept in oplog_checkpoint, so
+ * DatabaseCommand_loadOps can continue from them.
+ *
+ * Only does work if files or playlists have been deleted since it last ran.
+ */
+class DLLEXPORT DatabaseCommand_CompactOplog : public DatabaseCommand
+{
+Q_OBJECT
+
+public:
+    explicit DatabaseCommand_CompactOplog( QObject* parent = 0 )
+        : DatabaseCommand( parent )
+    {}
+
+    virtual void exec( DatabaseImpl* dbi );
+    virtual bool doesMutates() const { return true; }
+    virtual QString commandname() const { return "compactoplog"; }
+
+signals:
+    /**
+     * Emitted with the number of ops removed, rewritten and left, the oplog
+     * size in bytes before and after and the time compaction took in ms.
+     */
+    void done( const QVariantMap& stats );
+};
+
+}
+
+#endif // DATABASECOMMAND_COMPACTOPLOG_H
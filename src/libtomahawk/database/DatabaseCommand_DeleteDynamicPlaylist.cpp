@@ -65,7 +65,8 @@ DatabaseCommand_DeleteDynamicPlaylist::postCommitHook()
     }
     else
     {
-        tLog() << "ERROR: Just tried to load playlist for deletion:" << m_playlistguid << "Did we get a null one?" << playlist.isNull();
+        // Replaying a compacted oplog, we never saw the playlist, see DatabaseCommand_CompactOplog
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Unknown playlist, nothing to report:" << m_playlistguid;
     }
 
     if ( source()->isLocal() )
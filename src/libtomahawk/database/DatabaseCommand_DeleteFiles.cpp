@@ -23,6 +23,7 @@
 
 #include "collection/Collection.h"
 #include "database/Database.h"
+#include "database/DatabaseCommand_UpdateSearchIndex.h"
 #include "database/DatabaseImpl.h"
 #include "network/Servent.h"
 #include "utils/Logger.h"
@@ -40,6 +41,12 @@ using namespace Tomahawk;
 void
 DatabaseCommand_DeleteFiles::postCommitHook()
 {
+    if ( !m_orphans.isEmpty() )
+    {
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Removing" << m_orphans.count() << "tracks from the search index";
+        Database::instance()->impl()->removeFromSearchIndex( m_orphans );
+    }
+
     if ( m_idList.isEmpty() )
         return;
 
@@ -65,6 +72,7 @@ DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
 
     int srcid = source()->isLocal() ? 0 : source()->id();
     TomahawkSqlQuery delquery = dbi->newquery();
+    QSet< int > tracks;
 
     if ( m_deleteAll )
     {
@@ -102,6 +110,8 @@ DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
 
     if ( m_deleteAll )
     {
+        tracks = sourceTrackIds( dbi );
+
         delquery.prepare( QString( "DELETE FROM file WHERE source %1" )
                     .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) ) );
         delquery.exec();
@@ -129,14 +139,77 @@ DatabaseCommand_DeleteFiles::exec( DatabaseImpl* dbi )
             idstring.chop( 2 ); //remove the trailing ", "
         }
 
+        tracks = trackIds( dbi );
+
         delquery.prepare( QString( "DELETE FROM file WHERE source %1 AND id IN ( %2 )" )
                              .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
                              .arg( idstring ) );
         delquery.exec();
     }
 
+    findOrphanedTracks( dbi, tracks );
+
     if ( !m_idList.isEmpty() )
         source()->updateIndexWhenSynced();
 
     emit done( m_idList, source()->dbCollection() );
 }
+
+
+QSet< int >
+DatabaseCommand_DeleteFiles::trackIds( DatabaseImpl* dbi ) const
+{
+    QSet< int > tracks;
+
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( "SELECT track FROM file_join WHERE file = ?" );
+    foreach ( unsigned int fileid, m_idList )
+    {
+        query.bindValue( 0, fileid );
+        query.exec();
+        if ( query.next() )
+            tracks << query.value( 0 ).toInt();
+    }
+
+    return tracks;
+}
+
+
+QSet< int >
+DatabaseCommand_DeleteFiles::sourceTrackIds( DatabaseImpl* dbi ) const
+{
+    QSet< int > tracks;
+
+    TomahawkSqlQuery query = dbi->newquery();
+    query.exec( QString( "SELECT DISTINCT file_join.track FROM file_join, file WHERE file.id = file_join.file AND file.source %1" )
+                   .arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) ) );
+    while ( query.next() )
+        tracks << query.value( 0 ).toInt();
+
+    return tracks;
+}
+
+
+void
+DatabaseCommand_DeleteFiles::findOrphanedTracks( DatabaseImpl* dbi, const QSet< int >& tracks )
+{
+    m_orphans.clear();
+    if ( tracks.isEmpty() )
+        return;
+
+    // Track rows stay around, but tracks without any files left can't be resolved anymore
+    TomahawkSqlQuery query = dbi->newquery();
+    query.prepare( "SELECT 1 FROM file_join, file WHERE file_join.track = ? AND file.id = file_join.file LIMIT 1" );
+    foreach ( int trackid, tracks )
+    {
+        query.bindValue( 0, trackid );
+        query.exec();
+        if ( query.next() )
+            continue;
+
+        IndexData ida;
+        ida.id = trackid;
+        ida.artistId = 0;
+        m_orphans << ida;
+    }
+}
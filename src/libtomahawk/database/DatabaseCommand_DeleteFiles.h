@@ -22,9 +22,11 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QDir>
+#include <QtCore/QSet>
 #include <QtCore/QVariantMap>
 
 #include "database/DatabaseCommandLoggable.h"
+#include "database/DatabaseCommand_UpdateSearchIndex.h"
 #include "Typedefs.h"
 
 #include "DllMacro.h"
@@ -81,10 +83,16 @@ signals:
     void notify( const QList<unsigned int>& ids );
 
 private:
+    QSet< int > trackIds( DatabaseImpl* dbi ) const;
+    /// tracks of the source's files, for deleteAll
+    QSet< int > sourceTrackIds( DatabaseImpl* dbi ) const;
+    void findOrphanedTracks( DatabaseImpl* dbi, const QSet< int >& tracks );
+
     QDir m_dir;
     QVariantList m_ids;
     QList<unsigned int> m_idList;
     bool m_deleteAll;
+    QList< IndexData > m_orphans; // removed from the index once committed
 };
 
 }
@@ -62,10 +62,12 @@ DatabaseCommand_DeletePlaylist::postCommitHook()
         return;
     }
 
+    // Replaying a compacted oplog, we never saw the playlist, see DatabaseCommand_CompactOplog
     playlist_ptr playlist = source()->dbCollection()->playlist( m_playlistguid );
-    Q_ASSERT( !playlist.isNull() );
     if ( playlist )
         playlist->reportDeleted( playlist );
+    else
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Unknown playlist, nothing to report:" << m_playlistguid;
 
     if( source()->isLocal() )
         Servent::instance()->triggerDBSync();
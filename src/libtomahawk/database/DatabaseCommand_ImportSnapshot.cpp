@@ -0,0 +1,113 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseCommand_ImportSnapshot.h"
+
+#include "Database.h"
+#include "DatabaseCommand_AddFiles.h"
+#include "DatabaseCommand_DeleteFiles.h"
+#include "DatabaseImpl.h"
+#include "TomahawkSqlQuery.h"
+#include "Source.h"
+#include "utils/Json.h"
+#include "utils/Logger.h"
+
+namespace Tomahawk
+{
+
+DatabaseCommand_ImportSnapshot::DatabaseCommand_ImportSnapshot( const CollectionSnapshotChunk& chunk, const Tomahawk::source_ptr& source,
+                                                                const QSharedPointer< QAtomicInt >& failed, QObject* parent )
+    : DatabaseCommand( source, parent )
+    , m_chunk( chunk )
+    , m_failed( failed )
+{
+    // Emitted on the db thread before the next command runs, be it that exec()
+    // threw or the commit failed
+    connect( this, SIGNAL( failed() ), SLOT( markFailed() ), Qt::DirectConnection );
+}
+
+
+void
+DatabaseCommand_ImportSnapshot::exec( DatabaseImpl* dbi )
+{
+    Q_ASSERT( !source().isNull() && !source()->isLocal() );
+
+    if ( m_failed->load() )
+        throw "Skipping chunk, an earlier one of the snapshot failed";
+
+    // The snapshot replaces whatever we had of their collection
+    if ( m_chunk.first )
+    {
+        dbcmd_ptr cmd( new DatabaseCommand_DeleteFiles( source() ) );
+        cmd->_exec( dbi );
+        m_commands << cmd;
+    }
+
+    if ( !m_chunk.files.isEmpty() )
+    {
+        dbcmd_ptr cmd( new DatabaseCommand_AddFiles( m_chunk.files, source() ) );
+        cmd->_exec( dbi );
+        m_commands << cmd;
+    }
+
+    foreach ( const dbop_ptr& op, m_chunk.ops )
+    {
+        bool ok;
+        const QVariant json = TomahawkUtils::parseJson( op->compressed ? qUncompress( op->payload ) : op->payload, &ok );
+        if ( !ok )
+        {
+            tLog() << Q_FUNC_INFO << "Failed to parse op" << op->guid << "from snapshot of source" << source()->id();
+            continue;
+        }
+
+        dbcmd_ptr cmd = Database::instance()->createCommandInstance( json, source() );
+        if ( cmd.isNull() )
+            continue;
+
+        cmd->_exec( dbi );
+        m_commands << cmd;
+    }
+
+    if ( !m_chunk.lastop.isEmpty() )
+    {
+        TomahawkSqlQuery query = dbi->newquery();
+        query.prepare( "UPDATE source SET lastop = ? WHERE id = ?" );
+        query.addBindValue( m_chunk.lastop );
+        query.addBindValue( source()->id() );
+
+        if ( !query.exec() )
+            throw "Failed to set lastop";
+    }
+
+    tDebug() << Q_FUNC_INFO << "Imported" << m_chunk.files.count() << "files and" << m_chunk.ops.count() << "ops for source" << source()->id();
+}
+
+
+void
+DatabaseCommand_ImportSnapshot::markFailed()
+{
+    m_failed->store( 1 );
+}
+
+
+void
+DatabaseCommand_ImportSnapshot::postCommitHook()
+{
+    foreach ( const dbcmd_ptr& cmd, m_commands )
+        cmd->postCommit();
+}
+
+}
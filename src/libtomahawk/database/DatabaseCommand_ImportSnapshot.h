@@ -0,0 +1,68 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_IMPORTSNAPSHOT_H
+#define DATABASECOMMAND_IMPORTSNAPSHOT_H
+
+#include "DatabaseCommand.h"
+#include "CollectionSnapshot.h"
+#include "Typedefs.h"
+
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include "DllMacro.h"
+
+namespace Tomahawk
+{
+
+/**
+ * Applies a chunk of a peer's collection snapshot to our copy of their
+ * collection. The first chunk replaces all files we had for the source,
+ * the last one records the snapshot's lastop, so an interrupted transfer
+ * simply starts over on the next sync.
+ *
+ * The chunks of a snapshot share @p failed: once one of them got rolled
+ * back it is set, and the following chunks fail without touching the
+ * database, so the lastop is only recorded for a complete snapshot.
+ */
+class DLLEXPORT DatabaseCommand_ImportSnapshot : public DatabaseCommand
+{
+Q_OBJECT
+
+public:
+    explicit DatabaseCommand_ImportSnapshot( const CollectionSnapshotChunk& chunk, const Tomahawk::source_ptr& source,
+                                             const QSharedPointer< QAtomicInt >& failed, QObject* parent = 0 );
+
+    virtual void exec( DatabaseImpl* dbi );
+    virtual bool doesMutates() const { return true; }
+    virtual void postCommitHook();
+    virtual QString commandname() const { return "importsnapshot"; }
+
+    const CollectionSnapshotChunk& chunk() const { return m_chunk; }
+
+private slots:
+    void markFailed();
+
+private:
+    CollectionSnapshotChunk m_chunk;
+    QSharedPointer< QAtomicInt > m_failed;
+    QList< Tomahawk::dbcmd_ptr > m_commands;
+};
+
+}
+
+#endif // DATABASECOMMAND_IMPORTSNAPSHOT_H
@@ -30,6 +30,7 @@ void
 DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
 {
     QList< dbop_ptr > ops;
+    int sinceId = 0;
 
     if ( !m_since.isEmpty() )
     {
@@ -40,11 +41,21 @@ DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
 
         if ( !query.next() )
         {
-            tLog() << "Unknown oplog guid, requested, not replying:" << m_since;
-            Q_ASSERT( false );
-            emit done( m_since, m_since, ops );
-            return;
+            // compacted away, continue from where it used to be
+            query.prepare( QString( "SELECT id FROM oplog_checkpoint WHERE guid = ?" ) );
+            query.addBindValue( m_since );
+            query.exec();
+
+            if ( !query.next() )
+            {
+                tLog() << "Unknown oplog guid, requested, not replying:" << m_since;
+                Q_ASSERT( false );
+                emit done( m_since, m_since, ops );
+                return;
+            }
         }
+
+        sinceId = query.value( 0 ).toInt();
     }
 
     TomahawkSqlQuery query = dbi->newquery();
@@ -52,11 +63,12 @@ DatabaseCommand_loadOps::exec( DatabaseImpl* dbi )
                    "SELECT guid, command, json, compressed, singleton "
                    "FROM oplog "
                    "WHERE source %1 "
-                   "AND id > coalesce((SELECT id FROM oplog WHERE guid = ?),0) "
-                   "ORDER BY id ASC"
+                   "AND id > ? "
+                   "ORDER BY id ASC %2"
                    ).arg( source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() ) )
+                    .arg( m_limit > 0 ? QString( "LIMIT %1" ).arg( m_limit ) : QString() )
                   );
-    query.addBindValue( m_since );
+    query.addBindValue( sinceId );
     query.exec();
 
     QString lastguid = m_since;
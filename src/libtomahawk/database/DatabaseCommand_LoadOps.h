@@ -33,14 +33,19 @@ class DLLEXPORT DatabaseCommand_loadOps : public DatabaseCommand
 {
 Q_OBJECT
 public:
-    explicit DatabaseCommand_loadOps( const Tomahawk::source_ptr& src, QString since, QObject* parent = 0 )
-        : DatabaseCommand( src ), m_since( since )
+    /**
+     * Loads the ops following @p since, at most @p limit of them if it is
+     * not 0. Continue from the returned lastguid to page through the oplog.
+     */
+    explicit DatabaseCommand_loadOps( const Tomahawk::source_ptr& src, QString since, int limit = 0, QObject* parent = 0 )
+        : DatabaseCommand( src ), m_since( since ), m_limit( limit )
     {
         Q_UNUSED( parent );
     }
 
     virtual void exec( DatabaseImpl* db );
     virtual bool doesMutates() const { return false; }
+    virtual Priority priority() const { return BulkPriority; }
     virtual QString commandname() const { return "loadops"; }
 
 signals:
@@ -48,6 +53,7 @@ signals:
 
 private:
     QString m_since; // guid to load from
+    int m_limit;
 };
 
 }
@@ -0,0 +1,202 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseCommand_LoadSnapshot.h"
+
+#include "CollectionSnapshot.h"
+#include "DatabaseImpl.h"
+#include "TomahawkSqlQuery.h"
+#include "Source.h"
+#include "utils/Logger.h"
+
+// files and ops per chunk
+#define SNAPSHOT_CHUNK_SIZE 1000
+
+namespace Tomahawk
+{
+
+void
+DatabaseCommand_LoadSnapshot::exec( DatabaseImpl* dbi )
+{
+    const QString sourceClause = source()->isLocal() ? "IS NULL" : QString( "= %1" ).arg( source()->id() );
+
+    // all queries of a page have to see the same state of the collection
+    dbi->database().transaction();
+
+    TomahawkSqlQuery query = dbi->newquery();
+    if ( m_lastOpId == 0 )
+    {
+        // The snapshot ends on the newest op that is not a singleton: older
+        // singleton ops get dropped from the oplog, so the peer could not
+        // continue syncing from one of them.
+        query.exec( QString( "SELECT id, guid FROM oplog "
+                             "WHERE source %1 AND NOT (singleton = 'true' OR singleton = 1) "
+                             "ORDER BY id DESC LIMIT 1" ).arg( sourceClause ) );
+        if ( !query.next() )
+        {
+            dbi->database().commit();
+            m_done = true;
+            emit chunk( QByteArray(), true );
+            return;
+        }
+
+        m_lastOpId = query.value( 0 ).toInt();
+        m_lastop = query.value( 1 ).toString();
+
+        // files added while we page through them come with their addfiles ops
+        query.exec( QString( "SELECT MAX(id) FROM file WHERE source %1" ).arg( sourceClause ) );
+        if ( query.next() )
+            m_maxFileId = query.value( 0 ).toInt();
+    }
+
+    // rows this page may load, -1 means no limit to SQLite
+    int budget = m_pageChunks > 0 ? m_pageChunks * SNAPSHOT_CHUNK_SIZE : -1;
+
+    CollectionSnapshotChunk current;
+    current.first = ( m_chunks == 0 );
+    int files = 0, ops = 0;
+
+    if ( !m_filesDone )
+    {
+        query.prepare( QString( "SELECT file.id, file.size, file.mtime, file.md5, file.mimetype, file.duration, file.bitrate, "
+                                "artist.name, albumartist.name, album.name, track.name, composer.name, "
+                                "file_join.albumpos, file_join.discnumber, "
+                                "(SELECT v FROM track_attributes WHERE track_attributes.id = track.id AND k = 'releaseyear' LIMIT 1) "
+                                "FROM file "
+                                "JOIN file_join ON file_join.file = file.id "
+                                "JOIN artist ON artist.id = file_join.artist "
+                                "JOIN track ON track.id = file_join.track "
+                                "LEFT JOIN album ON album.id = file_join.album "
+                                "LEFT JOIN artist AS albumartist ON albumartist.id = album.artist "
+                                "LEFT JOIN artist AS composer ON composer.id = file_join.composer "
+                                "WHERE file.source %1 AND file.id > ? AND file.id <= ? "
+                                "ORDER BY file.id LIMIT ?" ).arg( sourceClause ) );
+        query.addBindValue( m_fileCursor );
+        query.addBindValue( m_maxFileId );
+        query.addBindValue( budget );
+        query.exec();
+
+        while ( query.next() )
+        {
+            QVariantMap m;
+            m[ "id" ] = query.value( 0 );
+            m[ "size" ] = query.value( 1 );
+            m[ "mtime" ] = query.value( 2 );
+            m[ "hash" ] = query.value( 3 );
+            m[ "mimetype" ] = query.value( 4 );
+            m[ "duration" ] = query.value( 5 );
+            m[ "bitrate" ] = query.value( 6 );
+            m[ "artist" ] = query.value( 7 );
+            m[ "albumartist" ] = query.value( 8 );
+            m[ "album" ] = query.value( 9 );
+            m[ "track" ] = query.value( 10 );
+            m[ "composer" ] = query.value( 11 );
+            m[ "albumpos" ] = query.value( 12 );
+            m[ "discnumber" ] = query.value( 13 );
+            m[ "year" ] = query.value( 14 );
+
+            m_fileCursor = query.value( 0 ).toInt();
+            current.files << m;
+            files++;
+
+            if ( current.count() >= SNAPSHOT_CHUNK_SIZE )
+            {
+                emit chunk( current.serialize(), false );
+                current = CollectionSnapshotChunk();
+                m_chunks++;
+            }
+        }
+
+        if ( budget < 0 || files < budget )
+            m_filesDone = true;
+        if ( budget > 0 )
+            budget -= files;
+    }
+
+    if ( m_filesDone && budget != 0 )
+    {
+        // Everything but the file ops, those are covered by the files above
+        query.prepare( QString( "SELECT id, guid, command, json, compressed, singleton "
+                                "FROM oplog "
+                                "WHERE source %1 AND id > ? AND id <= ? AND command NOT IN ('addfiles', 'deletefiles') "
+                                "ORDER BY id ASC LIMIT ?" ).arg( sourceClause ) );
+        query.addBindValue( m_opCursor );
+        query.addBindValue( m_lastOpId );
+        query.addBindValue( budget );
+        query.exec();
+
+        while ( query.next() )
+        {
+            dbop_ptr op( new DBOp );
+            op->guid = query.value( 1 ).toString();
+            op->command = query.value( 2 ).toString();
+            op->payload = query.value( 3 ).toByteArray();
+            op->compressed = query.value( 4 ).toBool();
+            op->singleton = query.value( 5 ).toBool();
+
+            m_opCursor = query.value( 0 ).toInt();
+            current.ops << op;
+            ops++;
+
+            if ( current.count() >= SNAPSHOT_CHUNK_SIZE )
+            {
+                emit chunk( current.serialize(), false );
+                current = CollectionSnapshotChunk();
+                m_chunks++;
+            }
+        }
+
+        if ( budget < 0 || ops < budget )
+            m_done = true;
+    }
+
+    dbi->database().commit();
+
+    if ( m_done )
+    {
+        current.lastop = m_lastop;
+        emit chunk( current.serialize(), true );
+        m_chunks++;
+
+        tDebug() << Q_FUNC_INFO << "Snapshot up to" << m_lastop << "done after" << m_chunks << "chunks";
+    }
+    else
+    {
+        // pages end on a chunk boundary
+        Q_ASSERT( current.count() == 0 );
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Loaded" << files << "files and" << ops << "ops of the snapshot up to" << m_lastop;
+    }
+}
+
+
+DatabaseCommand_LoadSnapshot*
+DatabaseCommand_LoadSnapshot::next() const
+{
+    Q_ASSERT( !m_done );
+
+    DatabaseCommand_LoadSnapshot* cmd = new DatabaseCommand_LoadSnapshot( source(), m_pageChunks );
+    cmd->m_lastOpId = m_lastOpId;
+    cmd->m_lastop = m_lastop;
+    cmd->m_maxFileId = m_maxFileId;
+    cmd->m_fileCursor = m_fileCursor;
+    cmd->m_opCursor = m_opCursor;
+    cmd->m_chunks = m_chunks;
+    cmd->m_filesDone = m_filesDone;
+
+    return cmd;
+}
+
+}
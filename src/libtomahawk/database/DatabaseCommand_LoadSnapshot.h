@@ -0,0 +1,93 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASECOMMAND_LOADSNAPSHOT_H
+#define DATABASECOMMAND_LOADSNAPSHOT_H
+
+#include "DatabaseCommand.h"
+#include "Typedefs.h"
+
+#include <QByteArray>
+
+#include "DllMacro.h"
+
+namespace Tomahawk
+{
+
+/**
+ * Loads a snapshot of the local collection, see CollectionSnapshotChunk.
+ *
+ * Emits the serialized chunks one by one, the last one with @p last set.
+ * If there is no op a snapshot could end on, a single empty chunk is
+ * emitted and the peer has to be sent the plain oplog instead.
+ *
+ * With a page size set, a command emits no more than that many chunks and
+ * next() continues where it stopped. Files added after the first page are
+ * left to the ops the peer fetches after the snapshot.
+ */
+class DLLEXPORT DatabaseCommand_LoadSnapshot : public DatabaseCommand
+{
+Q_OBJECT
+
+public:
+    /**
+     * @p pageChunks chunks per command, 0 for the whole snapshot at once
+     */
+    explicit DatabaseCommand_LoadSnapshot( const Tomahawk::source_ptr& src, int pageChunks = 0, QObject* parent = 0 )
+        : DatabaseCommand( src, parent )
+        , m_pageChunks( pageChunks )
+        , m_lastOpId( 0 )
+        , m_maxFileId( 0 )
+        , m_fileCursor( 0 )
+        , m_opCursor( 0 )
+        , m_chunks( 0 )
+        , m_filesDone( false )
+        , m_done( false )
+    {}
+
+    virtual void exec( DatabaseImpl* dbi );
+    virtual bool doesMutates() const { return false; }
+    virtual Priority priority() const { return BulkPriority; }
+    virtual QString commandname() const { return "loadsnapshot"; }
+
+    /**
+     * Whether the last chunk has been emitted, valid once finished
+     */
+    bool isDone() const { return m_done; }
+    /**
+     * A command loading the next page, once finished and not done
+     */
+    DatabaseCommand_LoadSnapshot* next() const;
+
+signals:
+    void chunk( const QByteArray& data, bool last );
+
+private:
+    int m_pageChunks;
+    int m_lastOpId;
+    QString m_lastop;
+    int m_maxFileId;
+    // ids of the last file and op loaded
+    int m_fileCursor;
+    int m_opCursor;
+    int m_chunks; // emitted by all pages so far
+    bool m_filesDone;
+    bool m_done;
+};
+
+}
+
+#endif // DATABASECOMMAND_LOADSNAPSHOT_H
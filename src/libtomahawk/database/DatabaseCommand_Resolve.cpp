@@ -27,15 +27,52 @@
 #include "SourceList.h"
 #include "Track.h"
 
+#include <QSqlError>
+
 using namespace Tomahawk;
 
+// Candidate tracks are bound through the resolve_candidates temp table, so this
+// statement never changes and only gets parsed and planned once per connection.
+static const char* s_resolveSql =
+    "SELECT "
+    "url, mtime, size, md5, mimetype, duration, bitrate, "  //0
+    "file_join.artist, file_join.album, file_join.track, "  //7
+    "file_join.composer, file_join.discnumber, "            //10
+    "artist.name as artname, "                              //12
+    "album.name as albname, "                               //13
+    "track.name as trkname, "                               //14
+    "composer.name as cmpname, "                            //15
+    "file.source, "                                         //16
+    "file_join.albumpos, "                                  //17
+    "artist.id as artid, "                                  //18
+    "album.id as albid, "                                   //19
+    "composer.id as cmpid, "                                //20
+    "albumArtist.id as albumartistid, "                     //21
+    "albumArtist.name as albumartistname, "                 //22
+    "resolve_candidates.query "                             //23
+    "FROM resolve_candidates "
+    "CROSS JOIN file_join ON file_join.track = resolve_candidates.track "
+    "JOIN file ON file.id = file_join.file "
+    "JOIN artist ON artist.id = file_join.artist "
+    "JOIN track ON track.id = file_join.track "
+    "LEFT JOIN album ON album.id = file_join.album "
+    "LEFT JOIN artist AS composer ON composer.id = file_join.composer "
+    "LEFT JOIN artist AS albumArtist ON albumArtist.id = album.artist";
+
 
 DatabaseCommand_Resolve::DatabaseCommand_Resolve( const query_ptr& query )
     : DatabaseCommand()
-    , m_query( query )
 {
     // FIXME: We need to run tests of this DbCmd without a Pipeline
     // Q_ASSERT( Pipeline::instance()->isRunning() );
+    m_queries << query;
+}
+
+
+DatabaseCommand_Resolve::DatabaseCommand_Resolve( const QList< query_ptr >& queries )
+    : DatabaseCommand()
+    , m_queries( queries )
+{
 }
 
 
@@ -52,202 +89,133 @@ DatabaseCommand_Resolve::exec( DatabaseImpl* lib )
      *        1) find list of trk/art/alb IDs that are reasonable matches to the metadata given
      *        2) find files in database by permitted sources and calculate score, ignoring
      *           results that are less than MINSCORE
+     *
+     *        Stage 2 runs once for all queries of this command.
      */
 
-    if ( !m_query->resultHint().isEmpty() )
+    QList< int > pending;
+    QList< QPair< int, int > > candidates;
+
+    for ( int i = 0; i < m_queries.count(); i++ )
     {
-        tDebug() << "Using result-hint to speed up resolving:" << m_query->resultHint();
+        const query_ptr& query = m_queries.at( i );
+        if ( resolveFromHint( lib, query ) )
+            continue;
+
+        // STEP 1
+        if ( query->isFullTextQuery() )
+            resolveAlbums( lib, query );
 
-        Tomahawk::result_ptr result = lib->resultFromHint( m_query );
-        if ( result && ( !result->resolvedByCollection() || result->resolvedByCollection()->isOnline() ) )
+        QList< QPair<int, float> > tracks = lib->search( query );
+        if ( tracks.isEmpty() )
         {
-            QList<Tomahawk::result_ptr> res;
-            res << result;
-            emit results( m_query->id(), res );
-            return;
+            qDebug() << "No candidates found in first pass, aborting resolve" << query->toString();
+            emit results( query->id(), QList< Tomahawk::result_ptr >() );
+            continue;
         }
+
+        pending << i;
+        for ( int k = 0; k < tracks.count(); k++ )
+            candidates << QPair< int, int >( i, tracks.at( k ).first );
     }
 
-    if ( m_query->isFullTextQuery() )
-        fullTextResolve( lib );
-    else
-        resolve( lib );
+    // STEP 2
+    if ( !pending.isEmpty() )
+        resolveCandidates( lib, pending, candidates );
 }
 
 
-void
-DatabaseCommand_Resolve::resolve( DatabaseImpl* lib )
+bool
+DatabaseCommand_Resolve::resolveFromHint( DatabaseImpl* lib, const query_ptr& query )
 {
-    QList<Tomahawk::result_ptr> res;
-
-    // STEP 1
-    QList< QPair<int, float> > tracks = lib->search( m_query );
+    if ( query->resultHint().isEmpty() )
+        return false;
 
-    if ( tracks.isEmpty() )
-    {
-        qDebug() << "No candidates found in first pass, aborting resolve" << m_query->queryTrack()->toString();
-        emit results( m_query->id(), res );
-        return;
-    }
-
-    // STEP 2
-    TomahawkSqlQuery files_query = lib->newquery();
-
-    QStringList trksl;
-    for ( int k = 0; k < tracks.count(); k++ )
-        trksl.append( QString::number( tracks.at( k ).first ) );
-
-    QString trksToken = QString( "file_join.track IN (%1)" ).arg( trksl.join( "," ) );
-
-    QString sql = QString( "SELECT "
-                            "url, mtime, size, md5, mimetype, duration, bitrate, "  //0
-                            "file_join.artist, file_join.album, file_join.track, "  //7
-                            "file_join.composer, file_join.discnumber, "            //10
-                            "artist.name as artname, "                              //12
-                            "album.name as albname, "                               //13
-                            "track.name as trkname, "                               //14
-                            "composer.name as cmpname, "                            //15
-                            "file.source, "                                         //16
-                            "file_join.albumpos, "                                  //17
-                            "artist.id as artid, "                                  //18
-                            "album.id as albid, "                                   //19
-                            "composer.id as cmpid, "                                //20
-                            "albumArtist.id as albumartistid, "                     //21
-                            "albumArtist.name as albumartistname "                  //22
-                            "FROM file, file_join, artist, track "
-                            "LEFT JOIN album ON album.id = file_join.album "
-                            "LEFT JOIN artist AS composer ON composer.id = file_join.composer "
-                            "LEFT JOIN artist AS albumArtist ON albumArtist.id = album.artist "
-                            "WHERE "
-                            "artist.id = file_join.artist AND "
-                            "track.id = file_join.track AND "
-                            "file.id = file_join.file AND "
-                            "(%1)" )
-         .arg( trksToken );
-
-    files_query.prepare( sql );
-    files_query.exec();
+    tDebug() << "Using result-hint to speed up resolving:" << query->resultHint();
 
-    while ( files_query.next() )
+    Tomahawk::result_ptr result = lib->resultFromHint( query );
+    if ( result && ( !result->resolvedByCollection() || result->resolvedByCollection()->isOnline() ) )
     {
-        QString url = files_query.value( 0 ).toString();
-        source_ptr s = SourceList::instance()->get( files_query.value( 16 ).toUInt() );
-        if ( !s )
-        {
-            tDebug() << "Could not find source" << files_query.value( 16 ).toUInt();
-            continue;
-        }
-        if ( !s->isLocal() )
-            url = QString( "servent://%1\t%2" ).arg( s->nodeId() ).arg( url );
-
-        Tomahawk::result_ptr result = Tomahawk::Result::getCached( url );
-        if ( result )
-        {
-            tDebug( LOGVERBOSE ) << "Result already cached:" << result->toString();
-            res << result;
-            continue;
-        }
-
-        track_ptr track = Track::get( files_query.value( 9 ).toUInt(), files_query.value( 12 ).toString(), files_query.value( 14 ).toString(),
-                                      files_query.value( 13 ).toString(), files_query.value( 22 ).toString(), files_query.value( 5 ).toUInt(),
-                                      files_query.value( 15 ).toString(), files_query.value( 17 ).toUInt(), files_query.value( 11 ).toUInt() );
-        if ( !track )
-            continue;
-        track->loadAttributes();
-
-        result = Result::get( url, track );
-        if ( !result )
-            continue;
-
-        result->setModificationTime( files_query.value( 1 ).toUInt() );
-        result->setSize( files_query.value( 2 ).toUInt() );
-        result->setMimetype( files_query.value( 4 ).toString() );
-        result->setBitrate( files_query.value( 6 ).toUInt() );
-        result->setRID( uuid() );
-        result->setResolvedByCollection( s->dbCollection() );
-
+        QList<Tomahawk::result_ptr> res;
         res << result;
+        emit results( query->id(), res );
+        return true;
     }
 
-    emit results( m_query->id(), res );
+    return false;
 }
 
 
 void
-DatabaseCommand_Resolve::fullTextResolve( DatabaseImpl* lib )
+DatabaseCommand_Resolve::resolveAlbums( DatabaseImpl* lib, const query_ptr& query )
 {
-    QList<Tomahawk::result_ptr> res;
     typedef QPair<int, float> scorepair_t;
 
-    // STEP 1
-    QList< QPair<int, float> > trackPairs = lib->search( m_query );
-    QList< QPair<int, float> > albumPairs = lib->searchAlbum( m_query, 20 );
+    QList< QPair<int, float> > albumPairs = lib->searchAlbum( query, 20 );
 
-    TomahawkSqlQuery query = lib->newquery();
-    query.prepare( "SELECT album.name, artist.id, artist.name FROM album, artist WHERE artist.id = album.artist AND album.id = ?" );
+    TomahawkSqlQuery& albumQuery = lib->cachedQuery( "SELECT album.name, artist.id, artist.name FROM album, artist WHERE artist.id = album.artist AND album.id = ?" );
 
     foreach ( const scorepair_t& albumPair, albumPairs )
     {
-        query.bindValue( 0, albumPair.first );
-        query.exec();
+        albumQuery.bindValue( 0, albumPair.first );
+        albumQuery.exec();
 
         QList<Tomahawk::album_ptr> albumList;
-        while ( query.next() )
+        while ( albumQuery.next() )
         {
-            Tomahawk::artist_ptr artist = Tomahawk::Artist::get( query.value( 1 ).toUInt(), query.value( 2 ).toString() );
-            Tomahawk::album_ptr album = Tomahawk::Album::get( albumPair.first, query.value( 0 ).toString(), artist );
+            Tomahawk::artist_ptr artist = Tomahawk::Artist::get( albumQuery.value( 1 ).toUInt(), albumQuery.value( 2 ).toString() );
+            Tomahawk::album_ptr album = Tomahawk::Album::get( albumPair.first, albumQuery.value( 0 ).toString(), artist );
             albumList << album;
         }
 
-        emit albums( m_query->id(), albumList );
+        emit albums( query->id(), albumList );
     }
 
-    if ( trackPairs.isEmpty() )
+    albumQuery.finish();
+}
+
+
+void
+DatabaseCommand_Resolve::resolveCandidates( DatabaseImpl* lib, const QList< int >& queries, const QList< QPair< int, int > >& candidates )
+{
+    // Fill this connection's candidate table in one (temp-only) transaction
+    bool ok = lib->database().transaction();
+    if ( ok )
+    {
+        TomahawkSqlQuery& clearQuery = lib->cachedQuery( "DELETE FROM resolve_candidates" );
+        clearQuery.exec();
+
+        TomahawkSqlQuery& candidateQuery = lib->cachedQuery( "INSERT INTO resolve_candidates( query, track ) VALUES( ?, ? )" );
+        for ( int i = 0; i < candidates.count(); i++ )
+        {
+            candidateQuery.bindValue( 0, candidates.at( i ).first );
+            candidateQuery.bindValue( 1, candidates.at( i ).second );
+            candidateQuery.exec();
+        }
+
+        ok = lib->newquery().commitTransaction();
+        if ( !ok )
+            lib->database().rollback();
+    }
+
+    if ( !ok )
     {
-        qDebug() << "No candidates found in first pass, aborting resolve" << m_query->fullTextQuery();
-        emit results( m_query->id(), res );
+        // the candidates might be stale, better no results than wrong ones
+        tLog() << Q_FUNC_INFO << "Failed to store resolve candidates:" << lib->database().lastError().text();
+        foreach ( int queryIndex, queries )
+            emit results( m_queries.at( queryIndex )->id(), QList< Tomahawk::result_ptr >() );
+
         return;
     }
 
-    // STEP 2
-    TomahawkSqlQuery files_query = lib->newquery();
-
-    QStringList trksl;
-    for ( int k = 0; k < trackPairs.count(); k++ )
-        trksl.append( QString::number( trackPairs.at( k ).first ) );
-
-    QString trksToken = QString( "file_join.track IN (%1)" ).arg( trksl.join( "," ) );
-    QString sql = QString( "SELECT "
-                            "url, mtime, size, md5, mimetype, duration, bitrate, "  //0
-                            "file_join.artist, file_join.album, file_join.track, "  //7
-                            "file_join.composer, file_join.discnumber, "            //10
-                            "artist.name as artname, "                              //12
-                            "album.name as albname, "                               //13
-                            "track.name as trkname, "                               //14
-                            "composer.name as cmpname, "                            //15
-                            "file.source, "                                         //16
-                            "file_join.albumpos, "                                  //17
-                            "artist.id as artid, "                                  //18
-                            "album.id as albid, "                                   //19
-                            "composer.id as cmpid, "                                //20
-                            "albumArtist.id as albumartistid, "                     //21
-                            "albumArtist.name as albumartistname "                  //22
-                            "FROM file, file_join, artist, track "
-                            "LEFT JOIN album ON album.id = file_join.album "
-                            "LEFT JOIN artist AS composer ON composer.id = file_join.composer "
-                            "LEFT JOIN artist AS albumArtist ON albumArtist.id = album.artist "
-                            "WHERE "
-                            "artist.id = file_join.artist AND "
-                            "track.id = file_join.track AND "
-                            "file.id = file_join.file AND "
-                            "%1" )
-                        .arg( !trksl.isEmpty() ? trksToken : QString( "0" ) );
-
-    files_query.prepare( sql );
+    QHash< int, QList< Tomahawk::result_ptr > > res;
+    TomahawkSqlQuery& files_query = lib->cachedQuery( s_resolveSql );
     files_query.exec();
 
     while ( files_query.next() )
     {
+        const int queryIndex = files_query.value( 23 ).toInt();
+
         QString url = files_query.value( 0 ).toString();
         source_ptr s = SourceList::instance()->get( files_query.value( 16 ).toUInt() );
         if ( !s )
@@ -262,16 +230,21 @@ DatabaseCommand_Resolve::fullTextResolve( DatabaseImpl* lib )
         if ( result )
         {
             tDebug( LOGVERBOSE ) << "Result already cached:" << result->toString();
-            res << result;
+            res[ queryIndex ] << result;
             continue;
         }
 
         track_ptr track = Track::get( files_query.value( 9 ).toUInt(), files_query.value( 12 ).toString(), files_query.value( 14 ).toString(),
                                       files_query.value( 13 ).toString(), files_query.value( 22 ).toString(), files_query.value( 5 ).toUInt(),
                                       files_query.value( 15 ).toString(), files_query.value( 17 ).toUInt(), files_query.value( 11 ).toUInt() );
+        if ( !track )
+            continue;
         track->loadAttributes();
 
         result = Result::get( url, track );
+        if ( !result )
+            continue;
+
         result->setModificationTime( files_query.value( 1 ).toUInt() );
         result->setSize( files_query.value( 2 ).toUInt() );
         result->setMimetype( files_query.value( 4 ).toString() );
@@ -279,8 +252,11 @@ DatabaseCommand_Resolve::fullTextResolve( DatabaseImpl* lib )
         result->setRID( uuid() );
         result->setResolvedByCollection( s->dbCollection() );
 
-        res << result;
+        res[ queryIndex ] << result;
     }
 
-    emit results( m_query->id(), res );
+    files_query.finish();
+
+    foreach ( int queryIndex, queries )
+        emit results( m_queries.at( queryIndex )->id(), res.value( queryIndex ) );
 }
@@ -37,10 +37,16 @@ class DLLEXPORT DatabaseCommand_Resolve : public DatabaseCommand
 Q_OBJECT
 public:
     explicit DatabaseCommand_Resolve( const Tomahawk::query_ptr& query );
+    /**
+     * Resolves all @p queries in one go, sharing a single pass over file_join.
+     * results() is emitted once per query.
+     */
+    explicit DatabaseCommand_Resolve( const QList< Tomahawk::query_ptr >& queries );
     virtual ~DatabaseCommand_Resolve();
 
     QString commandname() const override { return "dbresolve"; }
     bool doesMutates() const override { return false; }
+    Priority priority() const override { return InteractivePriority; }
 
     void exec( DatabaseImpl *lib ) override;
 
@@ -52,10 +58,11 @@ signals:
 private:
     DatabaseCommand_Resolve();
 
-    void fullTextResolve( DatabaseImpl* lib );
-    void resolve( DatabaseImpl* lib );
+    bool resolveFromHint( DatabaseImpl* lib, const Tomahawk::query_ptr& query );
+    void resolveAlbums( DatabaseImpl* lib, const Tomahawk::query_ptr& query );
+    void resolveCandidates( DatabaseImpl* lib, const QList< int >& queries, const QList< QPair< int, int > >& candidates );
 
-    Tomahawk::query_ptr m_query;
+    QList< Tomahawk::query_ptr > m_queries;
 };
 
 }
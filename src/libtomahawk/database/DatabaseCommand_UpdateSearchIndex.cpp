@@ -50,7 +50,9 @@ DatabaseCommand_UpdateSearchIndex::exec( DatabaseImpl* db )
     db->m_fuzzyIndex->beginIndexing();
 
     TomahawkSqlQuery q = db->newquery();
-    q.exec( "SELECT track.id, track.name, artist.name, artist.id FROM track, artist WHERE artist.id = track.artist" );
+    // tracks without any files are dropped from the index by DatabaseCommand_DeleteFiles
+    q.exec( "SELECT track.id, track.name, artist.name, artist.id FROM track, artist "
+            "WHERE artist.id = track.artist AND track.id IN ( SELECT track FROM file_join )" );
     while ( q.next() )
     {
         IndexData ida;
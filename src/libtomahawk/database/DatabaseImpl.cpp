@@ -48,7 +48,8 @@
 */
 #include "Schema.sql.h"
 
-#define CURRENT_SCHEMA_VERSION 31
+#define CURRENT_SCHEMA_VERSION 32
+#define ID_CACHE_SIZE 20000
 
 Tomahawk::DatabaseImpl::DatabaseImpl( const QString& dbname )
 {
@@ -89,7 +90,7 @@ Tomahawk::DatabaseImpl::DatabaseImpl( const QString& dbname )
     query.exec( "UPDATE source SET isonline = 'false'" );
     query.exec( "DELETE FROM oplog WHERE source IS NULL AND singleton = 'true'" );
 
-    m_fuzzyIndex = new Tomahawk::DatabaseFuzzyIndex( this, schemaUpdated );
+    m_fuzzyIndex = new Tomahawk::DatabaseFuzzyIndex( this, dbname, schemaUpdated );
 
     tDebug( LOGVERBOSE ) << "Loaded index:" << t.elapsed();
     if ( qApp->arguments().contains( "--dumpdb" ) )
@@ -111,18 +112,19 @@ Tomahawk::DatabaseImpl::DatabaseImpl( const QString& dbname, bool internal )
 void
 Tomahawk::DatabaseImpl::init()
 {
-    m_lastartid = m_lastalbid = m_lasttrkid = 0;
-
     TomahawkSqlQuery query = newquery();
 
      // make sqlite behave how we want:
     query.exec( "PRAGMA foreign_keys = ON" );
+
+    // per-connection scratch table holding the candidate tracks of DatabaseCommand_Resolve
+    query.exec( "CREATE TEMP TABLE IF NOT EXISTS resolve_candidates ( query INTEGER NOT NULL, track INTEGER NOT NULL )" );
 }
 
 
 Tomahawk::DatabaseImpl::~DatabaseImpl()
 {
-    tDebug() << "Shutting down database connection.";
+    tDebug() << "Shutting down database connection. Id cache stats:" << idCacheStats();
 
 /*
 #ifdef TOMAHAWK_QUERY_ANALYZE
@@ -156,6 +158,22 @@ Tomahawk::DatabaseImpl::database()
 }
 
 
+TomahawkSqlQuery&
+Tomahawk::DatabaseImpl::cachedQuery( const QString& sql )
+{
+    QMutexLocker lock( &m_mutex );
+
+    QHash< QString, TomahawkSqlQuery >::iterator it = m_cachedQueries.find( sql );
+    if ( it == m_cachedQueries.end() )
+    {
+        it = m_cachedQueries.insert( sql, TomahawkSqlQuery( m_db ) );
+        it.value().prepare( sql );
+    }
+
+    return it.value();
+}
+
+
 Tomahawk::DatabaseImpl*
 Tomahawk::DatabaseImpl::clone() const
 {
@@ -333,11 +351,10 @@ Tomahawk::DatabaseImpl::file( int fid )
 int
 Tomahawk::DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
 {
-    if ( m_lastart == name_orig )
-        return m_lastartid;
-
-    int id = 0;
     QString sortname = Tomahawk::DatabaseImpl::sortname( name_orig );
+    int id = m_artistCache.lookup( sortname );
+    if ( id )
+        return id;
 
     TomahawkSqlQuery query = newquery();
     query.prepare( "SELECT id FROM artist WHERE sortname = ?" );
@@ -349,8 +366,7 @@ Tomahawk::DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
     }
     if ( id )
     {
-        m_lastart = name_orig;
-        m_lastartid = id;
+        m_artistCache.insert( sortname, id );
         return id;
     }
 
@@ -367,8 +383,7 @@ Tomahawk::DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
         }
 
         id = query.lastInsertId().toInt();
-        m_lastart = name_orig;
-        m_lastartid = id;
+        m_artistCache.insert( sortname, id );
     }
 
     return id;
@@ -378,9 +393,11 @@ Tomahawk::DatabaseImpl::artistId( const QString& name_orig, bool autoCreate )
 int
 Tomahawk::DatabaseImpl::trackId( int artistid, const QString& name_orig, bool autoCreate )
 {
-    int id = 0;
     QString sortname = Tomahawk::DatabaseImpl::sortname( name_orig );
-    //if( ( id = m_artistcache[sortname] ) ) return id;
+    const QString key = QString::number( artistid ) + '\t' + sortname;
+    int id = m_trackCache.lookup( key );
+    if ( id )
+        return id;
 
     TomahawkSqlQuery query = newquery();
     query.prepare( "SELECT id FROM track WHERE artist = ? AND sortname = ?" );
@@ -394,7 +411,7 @@ Tomahawk::DatabaseImpl::trackId( int artistid, const QString& name_orig, bool au
     }
     if ( id )
     {
-        //m_trackcache[sortname]=id;
+        m_trackCache.insert( key, id );
         return id;
     }
 
@@ -412,6 +429,7 @@ Tomahawk::DatabaseImpl::trackId( int artistid, const QString& name_orig, bool au
         }
 
         id = query.lastInsertId().toInt();
+        m_trackCache.insert( key, id );
     }
 
     return id;
@@ -427,12 +445,11 @@ Tomahawk::DatabaseImpl::albumId( int artistid, const QString& name_orig, bool au
         return 0;
     }
 
-    if ( m_lastartid == artistid && m_lastalb == name_orig )
-        return m_lastalbid;
-
-    int id = 0;
     QString sortname = Tomahawk::DatabaseImpl::sortname( name_orig );
-    //if( ( id = m_albumcache[sortname] ) ) return id;
+    const QString key = QString::number( artistid ) + '\t' + sortname;
+    int id = m_albumCache.lookup( key );
+    if ( id )
+        return id;
 
     TomahawkSqlQuery query = newquery();
     query.prepare( "SELECT id FROM album WHERE artist = ? AND sortname = ?" );
@@ -445,8 +462,7 @@ Tomahawk::DatabaseImpl::albumId( int artistid, const QString& name_orig, bool au
     }
     if ( id )
     {
-        m_lastalb = name_orig;
-        m_lastalbid = id;
+        m_albumCache.insert( key, id );
         return id;
     }
 
@@ -464,14 +480,84 @@ Tomahawk::DatabaseImpl::albumId( int artistid, const QString& name_orig, bool au
         }
 
         id = query.lastInsertId().toInt();
-        m_lastalb = name_orig;
-        m_lastalbid = id;
+        m_albumCache.insert( key, id );
     }
 
     return id;
 }
 
 
+void
+Tomahawk::DatabaseImpl::clearIdCaches()
+{
+    m_artistCache.clear();
+    m_albumCache.clear();
+    m_trackCache.clear();
+}
+
+
+QVariantMap
+Tomahawk::DatabaseImpl::idCacheStats() const
+{
+    QVariantMap stats;
+    stats[ "artist" ] = m_artistCache.stats();
+    stats[ "album" ] = m_albumCache.stats();
+    stats[ "track" ] = m_trackCache.stats();
+
+    return stats;
+}
+
+
+Tomahawk::DatabaseImpl::IdCache::IdCache()
+    : ids( ID_CACHE_SIZE )
+    , hits( 0 )
+    , misses( 0 )
+{
+}
+
+
+int
+Tomahawk::DatabaseImpl::IdCache::lookup( const QString& key )
+{
+    int* id = ids.object( key );
+    if ( id )
+    {
+        hits++;
+        return *id;
+    }
+
+    misses++;
+    return 0;
+}
+
+
+void
+Tomahawk::DatabaseImpl::IdCache::insert( const QString& key, int id )
+{
+    ids.insert( key, new int( id ) );
+}
+
+
+void
+Tomahawk::DatabaseImpl::IdCache::clear()
+{
+    ids.clear();
+}
+
+
+QVariantMap
+Tomahawk::DatabaseImpl::IdCache::stats() const
+{
+    QVariantMap m;
+    m[ "size" ] = ids.count();
+    m[ "hits" ] = hits;
+    m[ "misses" ] = misses;
+    m[ "hitrate" ] = hits + misses ? double( hits ) / ( hits + misses ) : 0.0;
+
+    return m;
+}
+
+
 QList< QPair<int, float> >
 Tomahawk::DatabaseImpl::search( const Tomahawk::query_ptr& query, uint limit )
 {
@@ -522,6 +608,20 @@ Tomahawk::DatabaseImpl::searchAlbum( const Tomahawk::query_ptr& query, uint limi
 }
 
 
+void
+Tomahawk::DatabaseImpl::updateSearchIndex( const QList< Tomahawk::IndexData >& data )
+{
+    m_fuzzyIndex->updateFields( data );
+}
+
+
+void
+Tomahawk::DatabaseImpl::removeFromSearchIndex( const QList< Tomahawk::IndexData >& data )
+{
+    m_fuzzyIndex->deleteFields( data );
+}
+
+
 QList< int >
 Tomahawk::DatabaseImpl::getTrackFids( int tid )
 {
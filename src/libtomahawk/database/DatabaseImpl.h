@@ -22,6 +22,7 @@
 #define DATABASEIMPL_H
 
 #include <QObject>
+#include <QCache>
 #include <QList>
 #include <QMutex>
 #include <QPair>
@@ -43,6 +44,7 @@ namespace Tomahawk
 
 class Database;
 class DatabaseFuzzyIndex;
+struct IndexData;
 
 class DLLEXPORT DatabaseImpl : public QObject
 {
@@ -60,12 +62,33 @@ public:
     TomahawkSqlQuery newquery();
     QSqlDatabase& database();
 
+    /**
+     * Returns a query prepared with @p sql that is kept around for the lifetime
+     * of this connection, so SQLite only parses and plans it once.
+     * Call finish() on it once you are done reading its results.
+     */
+    TomahawkSqlQuery& cachedQuery( const QString& sql );
+
     int artistId( const QString& name_orig, bool autoCreate ); //also for composers!
     int trackId( int artistid, const QString& name_orig, bool autoCreate );
     int albumId( int artistid, const QString& name_orig, bool autoCreate );
 
+    /**
+     * The *Id() lookups above are cached per connection. Whoever rolls back a
+     * transaction or deletes artist/album/track rows has to clear the caches.
+     */
+    void clearIdCaches();
+    QVariantMap idCacheStats() const;
+
     QList< QPair<int, float> > search( const Tomahawk::query_ptr& query, uint limit = 0 );
     QList< QPair<int, float> > searchAlbum( const Tomahawk::query_ptr& query, uint limit = 0 );
+
+    /**
+     * Add / replace resp. remove single tracks and albums in the search index,
+     * instead of rebuilding it with DatabaseCommand_UpdateSearchIndex.
+     */
+    void updateSearchIndex( const QList< Tomahawk::IndexData >& data );
+    void removeFromSearchIndex( const QList< Tomahawk::IndexData >& data );
     QList< int > getTrackFids( int tid );
 
     static QString sortname( const QString& str, bool replaceArticle = false );
@@ -104,11 +127,28 @@ private:
     void dumpDatabase();
     QString cleanSql( const QString& sql );
 
+    // bounded LRU of sortname -> id, only positive lookups are cached
+    struct IdCache
+    {
+        IdCache();
+
+        int lookup( const QString& key );
+        void insert( const QString& key, int id );
+        void clear();
+        QVariantMap stats() const;
+
+        QCache< QString, int > ids;
+        quint64 hits;
+        quint64 misses;
+    };
+
     bool m_ready;
     QSqlDatabase m_db;
+    QHash< QString, TomahawkSqlQuery > m_cachedQueries;
 
-    QString m_lastart, m_lastalb, m_lasttrk;
-    int m_lastartid, m_lastalbid, m_lasttrkid;
+    IdCache m_artistCache;
+    IdCache m_albumCache;
+    IdCache m_trackCache;
 
     QString m_dbid;
     Tomahawk::DatabaseFuzzyIndex* m_fuzzyIndex;
@@ -27,6 +27,11 @@
 #include "PlaylistEntry.h"
 #include "Source.h"
 
+#include <QTimer>
+
+// queries per DatabaseCommand_Resolve
+#define MAX_RESOLVE_BATCH 100
+
 
 DatabaseResolver::DatabaseResolver( int weight )
     : Resolver()
@@ -38,16 +43,43 @@ DatabaseResolver::DatabaseResolver( int weight )
 void
 DatabaseResolver::resolve( const Tomahawk::query_ptr& query )
 {
-    Tomahawk::DatabaseCommand_Resolve* cmd = new Tomahawk::DatabaseCommand_Resolve( query );
+    if ( m_pending.isEmpty() )
+        QTimer::singleShot( 0, this, SLOT( flushPending() ) );
+
+    m_pending << query;
+}
 
-    connect( cmd, SIGNAL( results( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ),
-                    SLOT( gotResults( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ), Qt::QueuedConnection );
-    connect( cmd, SIGNAL( albums( Tomahawk::QID, QList< Tomahawk::album_ptr > ) ),
-                    SLOT( gotAlbums( Tomahawk::QID, QList< Tomahawk::album_ptr > ) ), Qt::QueuedConnection );
-    connect( cmd, SIGNAL( artists( Tomahawk::QID, QList< Tomahawk::artist_ptr > ) ),
-                    SLOT( gotArtists( Tomahawk::QID, QList< Tomahawk::artist_ptr > ) ), Qt::QueuedConnection );
 
-    Tomahawk::Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
+void
+DatabaseResolver::resolveBatch( const QList< Tomahawk::query_ptr >& queries )
+{
+    m_pending << queries;
+    flushPending();
+}
+
+
+void
+DatabaseResolver::flushPending()
+{
+    if ( m_pending.isEmpty() )
+        return;
+
+    // Several smaller commands, so a big playlist doesn't keep a worker
+    // to itself and its first results show up early
+    while ( !m_pending.isEmpty() )
+    {
+        Tomahawk::DatabaseCommand_Resolve* cmd = new Tomahawk::DatabaseCommand_Resolve( m_pending.mid( 0, MAX_RESOLVE_BATCH ) );
+        m_pending = m_pending.mid( MAX_RESOLVE_BATCH );
+
+        connect( cmd, SIGNAL( results( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ),
+                        SLOT( gotResults( Tomahawk::QID, QList< Tomahawk::result_ptr > ) ), Qt::QueuedConnection );
+        connect( cmd, SIGNAL( albums( Tomahawk::QID, QList< Tomahawk::album_ptr > ) ),
+                        SLOT( gotAlbums( Tomahawk::QID, QList< Tomahawk::album_ptr > ) ), Qt::QueuedConnection );
+        connect( cmd, SIGNAL( artists( Tomahawk::QID, QList< Tomahawk::artist_ptr > ) ),
+                        SLOT( gotArtists( Tomahawk::QID, QList< Tomahawk::artist_ptr > ) ), Qt::QueuedConnection );
+
+        Tomahawk::Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
+    }
 }
 
 
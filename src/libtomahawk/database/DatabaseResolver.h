@@ -39,14 +39,20 @@ public:
 
 public slots:
     virtual void resolve( const Tomahawk::query_ptr& query ) override;
+    virtual void resolveBatch( const QList< Tomahawk::query_ptr >& queries ) override;
 
 private slots:
+    void flushPending();
+
     void gotResults( const Tomahawk::QID qid, QList< Tomahawk::result_ptr> results );
     void gotAlbums( const Tomahawk::QID qid, QList< Tomahawk::album_ptr> albums );
     void gotArtists( const Tomahawk::QID qid, QList< Tomahawk::artist_ptr> artists );
 
 private:
     int m_weight;
+
+    // queries coming in during one event loop iteration share one DatabaseCommand_Resolve
+    QList< Tomahawk::query_ptr > m_pending;
 };
 
 #endif // DATABASERESOLVER_H
@@ -0,0 +1,155 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseWorkQueue.h"
+
+#include "utils/Logger.h"
+
+#include "DatabaseWorker.h"
+
+#include <QMetaObject>
+
+namespace Tomahawk
+{
+
+DatabaseWorkQueue::DatabaseWorkQueue()
+    : m_runningBulk( 0 )
+{
+}
+
+
+DatabaseWorkQueue::~DatabaseWorkQueue()
+{
+    const int pending = pendingJobs();
+    if ( pending )
+        tDebug() << Q_FUNC_INFO << "Dropping" << pending << "outstanding db commands";
+}
+
+
+void
+DatabaseWorkQueue::addWorker( DatabaseWorker* worker )
+{
+    QMutexLocker lock( &m_mutex );
+    m_workers << worker;
+    m_idleWorkers << worker;
+
+    // Commands may have been queued before any worker was around
+    if ( hasRunnableJob() )
+        wakeIdleWorker();
+}
+
+
+void
+DatabaseWorkQueue::removeWorker( DatabaseWorker* worker )
+{
+    QMutexLocker lock( &m_mutex );
+    m_workers.removeAll( worker );
+    m_idleWorkers.removeAll( worker );
+}
+
+
+void
+DatabaseWorkQueue::enqueue( const Tomahawk::dbcmd_ptr& cmd )
+{
+    QMutexLocker lock( &m_mutex );
+    m_lanes[ cmd->priority() ] << cmd;
+
+    if ( hasRunnableJob() )
+        wakeIdleWorker();
+}
+
+
+Tomahawk::dbcmd_ptr
+DatabaseWorkQueue::takeNext( DatabaseWorker* worker )
+{
+    QMutexLocker lock( &m_mutex );
+
+    for ( int lane = DatabaseCommand::InteractivePriority; lane <= DatabaseCommand::BulkPriority; lane++ )
+    {
+        if ( m_lanes[ lane ].isEmpty() )
+            continue;
+        if ( lane == DatabaseCommand::BulkPriority && !canRunBulk() )
+            break;
+
+        if ( lane == DatabaseCommand::BulkPriority )
+            m_runningBulk++;
+
+        return m_lanes[ lane ].takeFirst();
+    }
+
+    if ( !m_idleWorkers.contains( worker ) )
+        m_idleWorkers << worker;
+
+    return Tomahawk::dbcmd_ptr();
+}
+
+
+void
+DatabaseWorkQueue::done( const Tomahawk::dbcmd_ptr& cmd )
+{
+    if ( cmd->priority() != DatabaseCommand::BulkPriority )
+        return;
+
+    QMutexLocker lock( &m_mutex );
+    m_runningBulk--;
+
+    // A bulk slot just became free, hand it to a parked worker
+    if ( hasRunnableJob() )
+        wakeIdleWorker();
+}
+
+
+int
+DatabaseWorkQueue::pendingJobs() const
+{
+    QMutexLocker lock( &m_mutex );
+
+    int pending = 0;
+    for ( int lane = DatabaseCommand::InteractivePriority; lane <= DatabaseCommand::BulkPriority; lane++ )
+        pending += m_lanes[ lane ].count();
+
+    return pending;
+}
+
+
+bool
+DatabaseWorkQueue::canRunBulk() const
+{
+    // Always keep one worker free for interactive and background work
+    return m_runningBulk < qMax( 1, m_workers.count() - 1 );
+}
+
+
+bool
+DatabaseWorkQueue::hasRunnableJob() const
+{
+    return !m_lanes[ DatabaseCommand::InteractivePriority ].isEmpty() ||
+           !m_lanes[ DatabaseCommand::BackgroundPriority ].isEmpty() ||
+           ( !m_lanes[ DatabaseCommand::BulkPriority ].isEmpty() && canRunBulk() );
+}
+
+
+void
+DatabaseWorkQueue::wakeIdleWorker()
+{
+    if ( m_idleWorkers.isEmpty() )
+        return;
+
+    DatabaseWorker* worker = m_idleWorkers.takeFirst();
+    QMetaObject::invokeMethod( worker, "doWork", Qt::QueuedConnection );
+}
+
+}
@@ -0,0 +1,80 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEWORKQUEUE_H
+#define DATABASEWORKQUEUE_H
+
+#include "DatabaseCommand.h"
+
+#include <QList>
+#include <QMutex>
+
+namespace Tomahawk
+{
+
+class DatabaseWorker;
+
+/*
+    Shared queue for all read-only DatabaseWorkers.
+
+    Commands are not bound to a worker when they are enqueued: whichever
+    worker becomes idle first takes the next command, so a slow command
+    never holds up work queued behind it while other workers are free.
+    Commands are sorted into one lane per DatabaseCommand::Priority and
+    the lanes are drained strictly in order. Bulk commands may never occupy
+    all workers at once, so there is always one left for interactive work.
+*/
+class DatabaseWorkQueue
+{
+public:
+    DatabaseWorkQueue();
+    ~DatabaseWorkQueue();
+
+    void addWorker( DatabaseWorker* worker );
+    void removeWorker( DatabaseWorker* worker );
+
+    void enqueue( const Tomahawk::dbcmd_ptr& cmd );
+
+    /**
+     * Returns the next command @p worker should run. If there is nothing
+     * runnable the worker is parked and a null pointer is returned, the
+     * worker gets woken up (its doWork() slot is invoked) once new work
+     * arrives.
+     */
+    Tomahawk::dbcmd_ptr takeNext( DatabaseWorker* worker );
+
+    /**
+     * Must be called by a worker once it finished running @p cmd.
+     */
+    void done( const Tomahawk::dbcmd_ptr& cmd );
+
+    int pendingJobs() const;
+
+private:
+    bool canRunBulk() const;
+    bool hasRunnableJob() const;
+    void wakeIdleWorker();
+
+    mutable QMutex m_mutex;
+    QList< Tomahawk::dbcmd_ptr > m_lanes[ DatabaseCommand::BulkPriority + 1 ];
+    QList< DatabaseWorker* > m_workers;
+    QList< DatabaseWorker* > m_idleWorkers;
+    int m_runningBulk;
+};
+
+}
+
+#endif // DATABASEWORKQUEUE_H
@@ -25,10 +25,12 @@
 #include "Database.h"
 #include "DatabaseImpl.h"
 #include "DatabaseCommandLoggable.h"
+#include "DatabaseWorkQueue.h"
 #include "PlaylistEntry.h"
 #include "Source.h"
 #include "TomahawkSqlQuery.h"
 
+#include <QSet>
 #include <QTimer>
 #include <QTime>
 #include <QSqlQuery>
@@ -37,14 +39,18 @@
     //#define DEBUG_TIMING TRUE
 #endif
 
+#define GROUP_COMMIT_MAX_COMMANDS 500
+#define GROUP_COMMIT_MAX_LATENCY 250
+
 
 namespace Tomahawk
 {
 
-DatabaseWorkerThread::DatabaseWorkerThread( Database* db, bool mutates )
+DatabaseWorkerThread::DatabaseWorkerThread( Database* db, bool mutates, DatabaseWorkQueue* queue )
     : QThread()
     , m_db( db )
     , m_mutates( mutates )
+    , m_queue( queue )
 {
     m_startupMutex.lock();
 }
@@ -54,7 +60,7 @@ void
 DatabaseWorkerThread::run()
 {
     tDebug() << Q_FUNC_INFO << "DatabaseWorkerThread starting...";
-    m_worker = QPointer< DatabaseWorker >( new DatabaseWorker( m_db, m_mutates ) );
+    m_worker = QPointer< DatabaseWorker >( new DatabaseWorker( m_db, m_mutates, m_queue ) );
     m_startupMutex.unlock();
     exec();
     tDebug() << Q_FUNC_INFO << "DatabaseWorkerThread finishing...";
@@ -84,21 +90,32 @@ DatabaseWorkerThread::waitForEventLoopStart()
 }
 
 
-DatabaseWorker::DatabaseWorker( Database* db, bool mutates )
+DatabaseWorker::DatabaseWorker( Database* db, bool mutates, DatabaseWorkQueue* queue )
     : QObject()
     , m_db( db )
-    , m_outstanding( 0 )
+    , m_queue( queue )
+    , m_groupCommitMax( 1 )
+    , m_groupCommitLatency( 0 )
 {
-    Q_UNUSED( mutates );
+    // There is only one rw worker, so it's the one paying for every fsync
+    if ( mutates )
+        setGroupCommit( GROUP_COMMIT_MAX_COMMANDS, GROUP_COMMIT_MAX_LATENCY );
+
     tDebug() << Q_FUNC_INFO << "New db connection with name:" << Database::instance()->impl()->database().connectionName() << "on thread" << this->thread();
+
+    if ( m_queue )
+        m_queue->addWorker( this );
 }
 
 
 DatabaseWorker::~DatabaseWorker()
 {
-    tDebug() << Q_FUNC_INFO << m_outstanding;
+    tDebug() << Q_FUNC_INFO << m_commands.count();
 
-    if ( m_outstanding )
+    if ( m_queue )
+        m_queue->removeWorker( this );
+
+    if ( !m_commands.isEmpty() )
     {
         foreach ( const Tomahawk::dbcmd_ptr& cmd, m_commands )
         {
@@ -109,14 +126,22 @@ DatabaseWorker::~DatabaseWorker()
 
 
 void
-DatabaseWorker::enqueue( const QList< Tomahawk::dbcmd_ptr >& cmds )
+DatabaseWorker::setGroupCommit( int maxCommands, int maxLatency )
 {
     QMutexLocker lock( &m_mut );
-    m_outstanding += cmds.count();
-    m_commands << cmds;
+    m_groupCommitMax = maxCommands;
+    m_groupCommitLatency = maxLatency;
+}
+
 
-    if ( m_outstanding == cmds.count() )
+void
+DatabaseWorker::enqueue( const QList< Tomahawk::dbcmd_ptr >& cmds )
+{
+    QMutexLocker lock( &m_mut );
+    if ( m_commands.isEmpty() )
         QTimer::singleShot( 0, this, SLOT( doWork() ) );
+
+    m_commands << cmds;
 }
 
 
@@ -124,11 +149,10 @@ void
 DatabaseWorker::enqueue( const Tomahawk::dbcmd_ptr& cmd )
 {
     QMutexLocker lock( &m_mut );
-    m_outstanding++;
-    m_commands << cmd;
-
-    if ( m_outstanding == 1 )
+    if ( m_commands.isEmpty() )
         QTimer::singleShot( 0, this, SLOT( doWork() ) );
+
+    m_commands << cmd;
 }
 
 
@@ -141,6 +165,12 @@ DatabaseWorker::doWork()
         If the cmd is modifying local content (ie source->isLocal()) then
         log to the database oplog for replication to peers.
 
+        Mutating cmds already waiting in the queue join the same transaction
+        (see joinsGroup()), so replaying lots of ops doesn't cost one commit
+        each. finished() is still emitted per cmd, in queue order. Every cmd
+        of a group runs in a savepoint of its own, one that fails is rolled
+        back alone and reports failed() right before its finished().
+
      */
 
 #ifdef DEBUG_TIMING
@@ -148,10 +178,25 @@ DatabaseWorker::doWork()
     timer.start();
 #endif
 
+    QTime groupTimer;
+    groupTimer.start();
+
     QList< Tomahawk::dbcmd_ptr > cmdGroup;
     Tomahawk::dbcmd_ptr cmd;
+    if ( m_queue )
+    {
+        // We get parked by the queue when there's nothing to do for us
+        cmd = m_queue->takeNext( this );
+        if ( !cmd )
+            return;
+    }
+    else
     {
+        // enqueue() may have asked for us while we still were at it
         QMutexLocker lock( &m_mut );
+        if ( m_commands.isEmpty() )
+            return;
+
         cmd = m_commands.takeFirst();
     }
 
@@ -163,55 +208,25 @@ DatabaseWorker::doWork()
         Q_UNUSED( transok );
     }
 
-    unsigned int completed = 0;
+    // the cmds of the group that ran fine, only they get their postCommit()
+    QList< Tomahawk::dbcmd_ptr > succeeded;
+    QSet< Tomahawk::DatabaseCommand* > rolledBack;
+    bool groupRolledBack = false;
     try
     {
         bool finished = false;
         {
             while ( !finished )
             {
-                completed++;
-                cmd->_exec( impl ); // runs actual SQL stuff
-
-                if ( cmd->loggable() )
-                {
-                    // We only save our own ops to the oplog, since incoming ops from peers
-                    // are applied immediately.
-                    //
-                    // Crazy idea: if peers had keypairs and could sign ops/msgs, in theory it
-                    // would be safe to sync ops for friend A from friend B's cache, if he saved them,
-                    // which would mean you could get updates even if a peer was offline.
-                    if ( cmd->source()->isLocal() && !cmd->localOnly() )
-                    {
-                        // save to op-log
-                        DatabaseCommandLoggable* command = (DatabaseCommandLoggable*)cmd.data();
-                        logOp( command );
-                    }
-                    else
-                    {
-                        // Make a note of the last guid we applied for this source
-                        // so we can always request just the newer ops in future.
-                        //
-                        if ( !cmd->singletonCmd() )
-                        {
-                            TomahawkSqlQuery query = impl->newquery();
-                            query.prepare( "UPDATE source SET lastop = ? WHERE id = ?" );
-                            query.addBindValue( cmd->guid() );
-                            query.addBindValue( cmd->source()->id() );
-
-                            if ( !query.exec() )
-                            {
-                                throw "Failed to set lastop";
-                            }
-                        }
-                    }
-                }
+                if ( execCommand( impl, cmd ) )
+                    succeeded << cmd;
+                else
+                    rolledBack << cmd.data();
 
                 cmdGroup << cmd;
-                if ( cmd->groupable() && !m_commands.isEmpty() )
                 {
                     QMutexLocker lock( &m_mut );
-                    if ( m_commands.first()->groupable() )
+                    if ( !m_commands.isEmpty() && joinsGroup( cmd, m_commands.first(), cmdGroup.count(), groupTimer.elapsed() ) )
                     {
                         cmd = m_commands.takeFirst();
                     }
@@ -220,13 +235,11 @@ DatabaseWorker::doWork()
                         finished = true;
                     }
                 }
-                else
-                    finished = true;
             }
 
             if ( cmd->doesMutates() )
             {
-                qDebug() << "Committing" << cmd->commandname() << cmd->guid();
+                qDebug() << "Committing" << cmd->commandname() << cmd->guid() << "in a group of" << cmdGroup.count();
                 if ( !impl->newquery().commitTransaction() )
                 {
                     tDebug() << "FAILED TO COMMIT TRANSACTION*";
@@ -239,7 +252,7 @@ DatabaseWorker::doWork()
             tDebug() << "DBCmd Duration:" << duration << "ms, now running postcommit for" << cmd->commandname();
 #endif
 
-            foreach ( Tomahawk::dbcmd_ptr c, cmdGroup )
+            foreach ( Tomahawk::dbcmd_ptr c, succeeded )
                 c->postCommit();
 
 #ifdef DEBUG_TIMING
@@ -250,38 +263,155 @@ DatabaseWorker::doWork()
     catch ( const char * msg )
     {
         tLog() << endl
-                 << "*ERROR* processing databasecommand:"
+                 << "*ERROR* processing databasecommand group of:"
                  << cmd->commandname()
                  << msg
                  << impl->database().lastError().databaseText()
                  << impl->database().lastError().driverText()
                  << endl;
 
+        // nothing of the group made it into the database
+        groupRolledBack = true;
         if ( cmd->doesMutates() )
+        {
             impl->database().rollback();
-
-        Q_ASSERT( false );
+            impl->clearIdCaches();
+        }
     }
     catch (...)
     {
         qDebug() << "Uncaught exception processing dbcmd";
         if ( cmd->doesMutates() )
+        {
             impl->database().rollback();
+            impl->clearIdCaches();
+        }
 
         Q_ASSERT( false );
         throw;
     }
 
     foreach ( Tomahawk::dbcmd_ptr c, cmdGroup )
+    {
+        if ( groupRolledBack || rolledBack.contains( c.data() ) )
+            c->emitFailed();
         c->emitFinished();
+    }
+
+    if ( m_queue )
+    {
+        m_queue->done( cmd );
+
+        // Give the event loop a chance before asking for the next command
+        QTimer::singleShot( 0, this, SLOT( doWork() ) );
+        return;
+    }
 
     QMutexLocker lock( &m_mut );
-    m_outstanding -= completed;
-    if ( m_outstanding > 0 )
+    if ( !m_commands.isEmpty() )
         QTimer::singleShot( 0, this, SLOT( doWork() ) );
 }
 
 
+bool
+DatabaseWorker::execCommand( DatabaseImpl* impl, const Tomahawk::dbcmd_ptr& cmd )
+{
+    // Each mutating cmd runs in a savepoint of the group's transaction, so a
+    // failing one doesn't take the others of its group down with it
+    const bool mutates = cmd->doesMutates();
+    if ( mutates && !impl->newquery().exec( "SAVEPOINT dbcmd" ) )
+        throw "Failed to set savepoint";
+
+    try
+    {
+        cmd->_exec( impl ); // runs actual SQL stuff
+
+        if ( cmd->loggable() )
+        {
+            // We only save our own ops to the oplog, since incoming ops from peers
+            // are applied immediately.
+            //
+            // Crazy idea: if peers had keypairs and could sign ops/msgs, in theory it
+            // would be safe to sync ops for friend A from friend B's cache, if he saved them,
+            // which would mean you could get updates even if a peer was offline.
+            if ( cmd->source()->isLocal() && !cmd->localOnly() )
+            {
+                // save to op-log
+                DatabaseCommandLoggable* command = (DatabaseCommandLoggable*)cmd.data();
+                logOp( command );
+            }
+            else
+            {
+                // Make a note of the last guid we applied for this source
+                // so we can always request just the newer ops in future.
+                //
+                if ( !cmd->singletonCmd() )
+                {
+                    TomahawkSqlQuery query = impl->newquery();
+                    query.prepare( "UPDATE source SET lastop = ? WHERE id = ?" );
+                    query.addBindValue( cmd->guid() );
+                    query.addBindValue( cmd->source()->id() );
+
+                    if ( !query.exec() )
+                    {
+                        throw "Failed to set lastop";
+                    }
+                }
+            }
+        }
+    }
+    catch ( const char * msg )
+    {
+        tLog() << endl
+                 << "*ERROR* processing databasecommand:"
+                 << cmd->commandname()
+                 << msg
+                 << impl->database().lastError().databaseText()
+                 << impl->database().lastError().driverText()
+                 << endl;
+
+        if ( mutates )
+        {
+            if ( !impl->newquery().exec( "ROLLBACK TO SAVEPOINT dbcmd" ) ||
+                 !impl->newquery().exec( "RELEASE SAVEPOINT dbcmd" ) )
+            {
+                throw "Failed to roll back to savepoint";
+            }
+
+            // ids looked up since the savepoint might be gone again
+            impl->clearIdCaches();
+        }
+
+        return false;
+    }
+
+    if ( mutates && !impl->newquery().exec( "RELEASE SAVEPOINT dbcmd" ) )
+        throw "Failed to release savepoint";
+
+    return true;
+}
+
+
+bool
+DatabaseWorker::joinsGroup( const Tomahawk::dbcmd_ptr& previous, const Tomahawk::dbcmd_ptr& next, int groupSize, int elapsed ) const
+{
+    if ( !previous->doesMutates() || !next->doesMutates() )
+        return false;
+
+    // some commands need a transaction of their own
+    if ( !previous->groupable() || !next->groupable() )
+        return false;
+
+    if ( m_groupCommitMax > 0 && groupSize >= m_groupCommitMax )
+        return false;
+
+    if ( m_groupCommitLatency > 0 && elapsed >= m_groupCommitLatency )
+        return false;
+
+    return true;
+}
+
+
 // this should take a const command, need to check/make json stuff mutable for some objs tho maybe.
 void
 DatabaseWorker::logOp( DatabaseCommandLoggable* command )
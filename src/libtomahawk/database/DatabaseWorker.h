@@ -32,17 +32,28 @@ namespace Tomahawk
 
 class Database;
 class DatabaseCommandLoggable;
+class DatabaseWorkQueue;
 
 class DatabaseWorker : public QObject
 {
 Q_OBJECT
 
 public:
-    DatabaseWorker( Database* db, bool mutates );
+    /**
+     * Read-only workers pass the shared @p queue they take their commands
+     * from, the read-write worker keeps its own list of commands.
+     */
+    DatabaseWorker( Database* db, bool mutates, DatabaseWorkQueue* queue = 0 );
     ~DatabaseWorker();
 
-    bool busy() const { return m_outstanding > 0; }
-    unsigned int outstandingJobs() const { return m_outstanding; }
+    /**
+     * Group-commit mode: coalesce up to @p maxCommands consecutive mutating
+     * groupable() commands into one transaction, as long as the group has
+     * been running for less than @p maxLatency ms. A maxCommands of 1 runs
+     * every command in a transaction of its own, 0 or less drops the limit
+     * on the group size, as a maxLatency of 0 or less does for its duration.
+     */
+    void setGroupCommit( int maxCommands, int maxLatency );
 
 public slots:
     void enqueue( const Tomahawk::dbcmd_ptr& );
@@ -53,11 +64,18 @@ private slots:
 
 private:
     void logOp( DatabaseCommandLoggable* command );
+    /**
+     * Runs @p cmd and logs it, false if it failed and was rolled back
+     */
+    bool execCommand( DatabaseImpl* impl, const Tomahawk::dbcmd_ptr& cmd );
+    bool joinsGroup( const Tomahawk::dbcmd_ptr& previous, const Tomahawk::dbcmd_ptr& next, int groupSize, int elapsed ) const;
 
     QMutex m_mut;
     Database* m_db;
+    DatabaseWorkQueue* m_queue;
     QList< Tomahawk::dbcmd_ptr > m_commands;
-    int m_outstanding;
+    int m_groupCommitMax;
+    int m_groupCommitLatency;
 };
 
 class DatabaseWorkerThread : public QThread
@@ -65,7 +83,7 @@ class DatabaseWorkerThread : public QThread
 Q_OBJECT
 
 public:
-    DatabaseWorkerThread( Database* db, bool mutates );
+    DatabaseWorkerThread( Database* db, bool mutates, DatabaseWorkQueue* queue = 0 );
     ~DatabaseWorkerThread();
 
     QPointer< DatabaseWorker > worker() const;
@@ -84,6 +102,7 @@ private:
     QPointer< DatabaseWorker > m_worker;
     Database* m_db;
     bool m_mutates;
+    DatabaseWorkQueue* m_queue;
 
     /**
      * Locks until we've started the event loop.
@@ -14,6 +14,13 @@ CREATE TABLE IF NOT EXISTS oplog (
 CREATE UNIQUE INDEX oplog_guid ON oplog(guid);
 CREATE INDEX oplog_source ON oplog(source);
 
+-- ops removed by oplog compaction, with the id they had in the oplog,
+-- so peers that last synced up to one of them can carry on from there
+CREATE TABLE IF NOT EXISTS oplog_checkpoint (
+    guid TEXT NOT NULL PRIMARY KEY,
+    id INTEGER NOT NULL
+);
+
 
 
 -- the basic 3 catalogue tables:
@@ -300,4 +307,4 @@ CREATE TABLE IF NOT EXISTS settings (
     v TEXT NOT NULL DEFAULT ''
 );
 
-INSERT INTO settings(k,v) VALUES('schema_version', '31');
+INSERT INTO settings(k,v) VALUES('schema_version', '32');
@@ -1,5 +1,5 @@
 /*
-    This file was automatically generated from ./Schema.sql on Tue Jul 30 12:51:06 CEST 2013.
+    This file was automatically generated from ./Schema.sql on Fri Oct 16 04:08:41 UTC 2026.
 */
 
 static const char * tomahawk_schema_sql = 
@@ -14,6 +14,10 @@ static const char * tomahawk_schema_sql =
 ");"
 "CREATE UNIQUE INDEX oplog_guid ON oplog(guid);"
 "CREATE INDEX oplog_source ON oplog(source);"
+"CREATE TABLE IF NOT EXISTS oplog_checkpoint ("
+"    guid TEXT NOT NULL PRIMARY KEY,"
+"    id INTEGER NOT NULL"
+");"
 "CREATE TABLE IF NOT EXISTS artist ("
 "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
 "    name TEXT NOT NULL,"
@@ -197,7 +201,7 @@ static const char * tomahawk_schema_sql =
 "    k TEXT NOT NULL PRIMARY KEY,"
 "    v TEXT NOT NULL DEFAULT ''"
 ");"
-"INSERT INTO settings(k,v) VALUES('schema_version', '31');"
+"INSERT INTO settings(k,v) VALUES('schema_version', '32');"
     ;
 
 const char * get_tomahawk_sql()
@@ -23,18 +23,27 @@
 #include "utils/TomahawkUtils.h"
 
 #include <QDir>
+#include <QFileInfo>
 
 
 namespace Tomahawk {
 
 static QString s_indexPathName = "tomahawk.lucene";
 
-DatabaseFuzzyIndex::DatabaseFuzzyIndex( QObject* parent, bool wipe )
-    : FuzzyIndex( parent, s_indexPathName, wipe )
+DatabaseFuzzyIndex::DatabaseFuzzyIndex( QObject* parent, const QString& dbPath, bool wipe )
+    : FuzzyIndex( parent, indexPath( dbPath ), wipe )
 {
 }
 
 
+QString
+DatabaseFuzzyIndex::indexPath( const QString& dbPath )
+{
+    const QFileInfo dbInfo( dbPath );
+    return dbInfo.absoluteDir().absoluteFilePath( dbInfo.completeBaseName() + ".lucene" );
+}
+
+
 void
 DatabaseFuzzyIndex::updateIndex()
 {
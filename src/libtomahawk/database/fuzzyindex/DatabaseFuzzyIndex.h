@@ -26,10 +26,20 @@ namespace Tomahawk {
 class DatabaseFuzzyIndex : public FuzzyIndex
 {
 public:
-    explicit DatabaseFuzzyIndex( QObject* parent, bool wipe = false );
+    /**
+     * The index of the database in @p dbPath lives next to it, in
+     * tomahawk.lucene for the default tomahawk.db
+     */
+    explicit DatabaseFuzzyIndex( QObject* parent, const QString& dbPath, bool wipe = false );
 
     virtual void updateIndex();
+    /**
+     * Wipes the index of the default database
+     */
     static void wipeIndex();
+
+private:
+    static QString indexPath( const QString& dbPath );
 };
 
 } // namespace Tomahawk
@@ -31,22 +31,66 @@
 
 #include <lucene++/FuzzyQuery.h>
 
+#include <boost/smart_ptr/shared_ptr.hpp>
+
 using namespace Lucene;
 
 
-FuzzyIndex::FuzzyIndex( QObject* parent, const QString& filename, bool wipe )
+struct FuzzyIndex::Snapshot
+{
+    Snapshot( const IndexReaderPtr& r )
+        : reader( r )
+        , searcher( newLucene<IndexSearcher>( r ) )
+    {
+    }
+
+    ~Snapshot()
+    {
+        try
+        {
+            searcher->close();
+            reader->decRef();
+        }
+        catch( LuceneException& error )
+        {
+            tDebug() << "Caught Lucene error:" << QString::fromWCharArray( error.getError().c_str() );
+        }
+    }
+
+    IndexReaderPtr reader;
+    IndexSearcherPtr searcher;
+};
+
+
+FuzzyIndex::FuzzyIndex( QObject* parent, const QString& filename, bool wipe, bool deferOpen )
     : QObject( parent )
 {
     m_lucenePath = TomahawkUtils::appDataDir().absoluteFilePath( filename );
 
+    if ( !deferOpen )
+        open( wipe );
+}
+
+
+void
+FuzzyIndex::open( bool wipe )
+{
     bool failed = false;
     tDebug() << "Opening Lucene directory:" << m_lucenePath;
     try
     {
         m_analyzer = newLucene<SimpleAnalyzer>();
         m_luceneDir = FSDirectory::open( m_lucenePath.toStdWString() );
-        m_luceneReader = IndexReader::open( m_luceneDir );
-        m_luceneSearcher = newLucene<IndexSearcher>( m_luceneReader );
+        IndexReaderPtr reader = IndexReader::open( m_luceneDir );
+        setSnapshot( reader );
+
+        // Older indexes did not index the ids, so their documents can't be updated incrementally
+        const HashSet<String> indexed = reader->getFieldNames( IndexReader::FIELD_OPTION_INDEXED );
+        if ( reader->numDocs() > 0 && !indexed.contains( L"trackid" ) && !indexed.contains( L"albumid" ) )
+        {
+            tDebug() << "Lucene index has no document keys, rebuilding:" << m_lucenePath;
+            failed = true;
+        }
     }
     catch ( LuceneException& error )
     {
@@ -68,6 +112,9 @@ FuzzyIndex::FuzzyIndex( QObject* parent, const QString& filename, bool wipe )
 FuzzyIndex::~FuzzyIndex()
 {
     tLog( LOGVERBOSE ) << Q_FUNC_INFO;
+
+    QMutexLocker lock( &m_mutex );
+    closeWriter();
 }
 
 
@@ -97,6 +144,9 @@ FuzzyIndex::beginIndexing()
     emit indexStarted();
     m_mutex.lock();
 
+    // the writer used for incremental updates holds the index lock
+    closeWriter();
+
     try
     {
         tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Starting indexing:" << m_lucenePath;
@@ -118,8 +168,7 @@ FuzzyIndex::endIndexing()
     m_luceneWriter->close();
     m_luceneWriter.reset();
 
-    m_luceneReader = IndexReader::open( m_luceneDir );
-    m_luceneSearcher = newLucene<IndexSearcher>( m_luceneReader );
+    setSnapshot( IndexReader::open( m_luceneDir ) );
 
     m_mutex.unlock();
     emit indexReady();
@@ -131,37 +180,71 @@ FuzzyIndex::appendFields( const Tomahawk::IndexData& data )
 {
     try
     {
-        DocumentPtr doc = newLucene<Document>();
+        DocumentPtr doc = document( data );
+        if ( !doc )
+            return;
 
-        if ( !data.track.isEmpty() )
-        {
-            doc->add(newLucene<Field>( L"fulltext", Tomahawk::DatabaseImpl::sortname( QString( "%1 %2" ).arg( data.artist ).arg( data.track ) ).toStdWString(),
-                                       Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+        m_luceneWriter->addDocument( doc );
+    }
+    catch( LuceneException& error )
+    {
+        tDebug() << "Caught Lucene error:" << QString::fromWCharArray( error.getError().c_str() );
 
-            doc->add(newLucene<Field>( L"track", Tomahawk::DatabaseImpl::sortname( data.track ).toStdWString(),
-                                       Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+        QTimer::singleShot( 0, this, SLOT( wipeIndex() ) );
+    }
+}
 
-            doc->add(newLucene<Field>( L"artist", Tomahawk::DatabaseImpl::sortname( data.artist ).toStdWString(),
-                                       Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
 
-            doc->add(newLucene<Field>( L"artistid", QString::number( data.artistId ).toStdWString(),
-                                       Field::STORE_YES, Field::INDEX_NO ) );
+void
+FuzzyIndex::updateFields( const QList< Tomahawk::IndexData >& data )
+{
+    if ( data.isEmpty() )
+        return;
 
-            doc->add(newLucene<Field>( L"trackid", QString::number( data.id ).toStdWString(),
-                                       Field::STORE_YES, Field::INDEX_NO ) );
-        }
-        else if ( !data.album.isEmpty() )
+    QMutexLocker lock( &m_mutex );
+    try
+    {
+        openWriter();
+
+        foreach ( const Tomahawk::IndexData& d, data )
         {
-            doc->add(newLucene<Field>( L"album", Tomahawk::DatabaseImpl::sortname( data.album ).toStdWString(),
-                                       Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+            DocumentPtr doc = document( d );
+            if ( doc )
+                m_luceneWriter->updateDocument( documentKey( d ), doc );
+        }
+
+        commitChanges();
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Updated" << data.count() << "documents in" << m_lucenePath;
+    }
+    catch( LuceneException& error )
+    {
+        tDebug() << "Caught Lucene error:" << QString::fromWCharArray( error.getError().c_str() );
+
+        QTimer::singleShot( 0, this, SLOT( wipeIndex() ) );
+    }
+}
+
 
-            doc->add(newLucene<Field>( L"albumid", QString::number( data.id ).toStdWString(),
-                                       Field::STORE_YES, Field::INDEX_NO ) );
+void
+FuzzyIndex::deleteFields( const QList< Tomahawk::IndexData >& data )
+{
+    if ( data.isEmpty() )
+        return;
+
+    QMutexLocker lock( &m_mutex );
+    try
+    {
+        openWriter();
+
+        foreach ( const Tomahawk::IndexData& d, data )
+        {
+            TermPtr key = documentKey( d );
+            if ( key )
+                m_luceneWriter->deleteDocuments( key );
         }
-        else
-            return;
 
-        m_luceneWriter->addDocument( doc );
+        commitChanges();
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Removed" << data.count() << "documents from" << m_lucenePath;
     }
     catch( LuceneException& error )
     {
@@ -172,17 +255,125 @@ FuzzyIndex::appendFields( const Tomahawk::IndexData& data )
 }
 
 
+DocumentPtr
+FuzzyIndex::document( const Tomahawk::IndexData& data ) const
+{
+    DocumentPtr doc = newLucene<Document>();
+
+    if ( !data.track.isEmpty() )
+    {
+        doc->add(newLucene<Field>( L"fulltext", Tomahawk::DatabaseImpl::sortname( QString( "%1 %2" ).arg( data.artist ).arg( data.track ) ).toStdWString(),
+                                   Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+
+        doc->add(newLucene<Field>( L"track", Tomahawk::DatabaseImpl::sortname( data.track ).toStdWString(),
+                                   Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+
+        doc->add(newLucene<Field>( L"artist", Tomahawk::DatabaseImpl::sortname( data.artist ).toStdWString(),
+                                   Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+
+        doc->add(newLucene<Field>( L"artistid", QString::number( data.artistId ).toStdWString(),
+                                   Field::STORE_YES, Field::INDEX_NO ) );
+
+        doc->add(newLucene<Field>( L"trackid", QString::number( data.id ).toStdWString(),
+                                   Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+    }
+    else if ( !data.album.isEmpty() )
+    {
+        doc->add(newLucene<Field>( L"album", Tomahawk::DatabaseImpl::sortname( data.album ).toStdWString(),
+                                   Field::STORE_NO, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+
+        doc->add(newLucene<Field>( L"albumid", QString::number( data.id ).toStdWString(),
+                                   Field::STORE_YES, Field::INDEX_NOT_ANALYZED_NO_NORMS ) );
+    }
+    else
+        return DocumentPtr();
+
+    return doc;
+}
+
+
+TermPtr
+FuzzyIndex::documentKey( const Tomahawk::IndexData& data ) const
+{
+    // albums are keyed by albumid, everything else by trackid
+    if ( !data.album.isEmpty() && data.track.isEmpty() )
+        return newLucene<Term>( L"albumid", QString::number( data.id ).toStdWString() );
+
+    return newLucene<Term>( L"trackid", QString::number( data.id ).toStdWString() );
+}
+
+
+void
+FuzzyIndex::openWriter()
+{
+    if ( m_luceneWriter )
+        return;
+
+    // Opens the existing index (or creates a new one). The default merge
+    // scheduler merges segments on a background thread.
+    m_luceneWriter = newLucene<IndexWriter>( m_luceneDir, m_analyzer, IndexWriter::MaxFieldLengthLIMITED );
+}
+
+
+void
+FuzzyIndex::closeWriter()
+{
+    if ( !m_luceneWriter )
+        return;
+
+    try
+    {
+        m_luceneWriter->close();
+    }
+    catch( LuceneException& error )
+    {
+        tDebug() << "Caught Lucene error:" << QString::fromWCharArray( error.getError().c_str() );
+    }
+
+    m_luceneWriter.reset();
+}
+
+
+void
+FuzzyIndex::commitChanges()
+{
+    m_luceneWriter->commit();
+
+    // near-real-time reader, shares all unchanged segments with the writer
+    setSnapshot( m_luceneWriter->getReader() );
+}
+
+
+boost::shared_ptr< FuzzyIndex::Snapshot >
+FuzzyIndex::snapshot() const
+{
+    return boost::atomic_load( &m_snapshot );
+}
+
+
+void
+FuzzyIndex::setSnapshot( const IndexReaderPtr& reader )
+{
+    boost::shared_ptr< Snapshot > s;
+    if ( reader )
+        s = boost::shared_ptr< Snapshot >( new Snapshot( reader ) );
+
+    // the previous snapshot goes away with its last running search
+    boost::atomic_store( &m_snapshot, s );
+}
+
+
 void
 FuzzyIndex::deleteIndex()
 {
-    if ( m_luceneReader )
+    // keeps updateFields(), deleteFields() and (re-)indexing off the writer
+    QMutexLocker lock( &m_mutex );
+    closeWriter();
+
+    if ( snapshot() )
     {
         tDebug( LOGVERBOSE ) << "Deleting old lucene stuff.";
-
-        m_luceneSearcher->close();
-        m_luceneReader->close();
-        m_luceneSearcher.reset();
-        m_luceneReader.reset();
+        setSnapshot( IndexReaderPtr() );
     }
 
     TomahawkUtils::removeDirectory( m_lucenePath );
@@ -206,9 +397,9 @@ FuzzyIndex::loadLuceneIndex()
 QMap< int, float >
 FuzzyIndex::search( const Tomahawk::query_ptr& query )
 {
-//    QMutexLocker lock( &m_mutex );
     QMap< int, float > resultsmap;
-    if ( !m_luceneReader || !m_luceneSearcher )
+    const boost::shared_ptr< Snapshot > s = snapshot();
+    if ( !s )
         return resultsmap;
 
     try
@@ -244,12 +435,12 @@ FuzzyIndex::search( const Tomahawk::query_ptr& query )
         }
 
         TopScoreDocCollectorPtr collector = TopScoreDocCollector::create( 20, true );
-        m_luceneSearcher->search( qry, collector );
+        s->searcher->search( qry, collector );
         Collection<ScoreDocPtr> hits = collector->topDocs()->scoreDocs;
 
         for ( int i = 0; i < collector->getTotalHits() && i < 20; i++ )
         {
-            DocumentPtr d = m_luceneSearcher->doc( hits[i]->doc );
+            DocumentPtr d = s->searcher->doc( hits[i]->doc );
             const float score = hits[i]->score;
             const int id = QString::fromStdWString( d->get( L"trackid" ) ).toInt();
 
@@ -274,9 +465,9 @@ FuzzyIndex::searchAlbum( const Tomahawk::query_ptr& query )
 {
     Q_ASSERT( query->isFullTextQuery() );
 
-//    QMutexLocker lock( &m_mutex );
     QMap< int, float > resultsmap;
-    if ( !m_luceneReader || !m_luceneSearcher )
+    const boost::shared_ptr< Snapshot > s = snapshot();
+    if ( !s )
         return resultsmap;
 
     try
@@ -286,12 +477,12 @@ FuzzyIndex::searchAlbum( const Tomahawk::query_ptr& query )
 
         FuzzyQueryPtr qry = newLucene<FuzzyQuery>( newLucene<Term>( L"album", q.toStdWString() ) );
         TopScoreDocCollectorPtr collector = TopScoreDocCollector::create( 99999, false );
-        m_luceneSearcher->search( boost::dynamic_pointer_cast<Query>( qry ), collector );
+        s->searcher->search( boost::dynamic_pointer_cast<Query>( qry ), collector );
         Collection<ScoreDocPtr> hits = collector->topDocs()->scoreDocs;
 
         for ( int i = 0; i < collector->getTotalHits(); i++ )
         {
-            DocumentPtr d = m_luceneSearcher->doc( hits[i]->doc );
+            DocumentPtr d = s->searcher->doc( hits[i]->doc );
             float score = hits[i]->score;
             int id = QString::fromStdWString( d->get( L"albumid" ) ).toInt();
 
@@ -35,13 +35,35 @@ class FuzzyIndex : public QObject
 Q_OBJECT
 
 public:
-    explicit FuzzyIndex( QObject* parent, const QString& filename, bool wipe = false );
+    /**
+     * Unless @p deferOpen is set the index is opened right away, see open()
+     */
+    explicit FuzzyIndex( QObject* parent, const QString& filename, bool wipe = false, bool deferOpen = false );
     virtual ~FuzzyIndex();
 
+    /**
+     * Opens the index on disk, wiping it if @p wipe is set or it can't be
+     * read. Searches find nothing before.
+     */
+    void open( bool wipe );
+
+    /**
+     * Full rebuild: beginIndexing() wipes the index, every document is then
+     * fed through appendFields() and endIndexing() makes the new index
+     * searchable.
+     */
     void beginIndexing();
     void endIndexing();
     void appendFields( const Tomahawk::IndexData& data );
 
+    /**
+     * Incremental updates: add or replace (resp. remove) the documents for
+     * the given tracks / albums, keyed by their id. Changes are committed
+     * and become searchable right away, segments get merged in the background.
+     */
+    void updateFields( const QList< Tomahawk::IndexData >& data );
+    void deleteFields( const QList< Tomahawk::IndexData >& data );
+
     /**
      * Delete the index from the harddrive.
      *
@@ -66,14 +88,29 @@ private slots:
     void updateIndexSlot();
 
 private:
-    QMutex m_mutex;
+    Lucene::DocumentPtr document( const Tomahawk::IndexData& data ) const;
+    Lucene::TermPtr documentKey( const Tomahawk::IndexData& data ) const;
+    void openWriter();
+    void closeWriter();
+    void commitChanges();
+
+    /*
+        Searches run concurrently without taking m_mutex: each one grabs the
+        current snapshot and works on it, while (re-)indexing atomically swaps
+        in a new one. A snapshot's reader is released once the last search
+        using it is done.
+    */
+    struct Snapshot;
+    boost::shared_ptr< Snapshot > snapshot() const;
+    void setSnapshot( const Lucene::IndexReaderPtr& reader );
+
+    QMutex m_mutex; // for m_luceneWriter
     QString m_lucenePath;
 
     boost::shared_ptr<Lucene::SimpleAnalyzer> m_analyzer;
     Lucene::IndexWriterPtr m_luceneWriter;
-    Lucene::IndexReaderPtr m_luceneReader;
     Lucene::FSDirectoryPtr m_luceneDir;
-    Lucene::IndexSearcherPtr m_luceneSearcher;
+    boost::shared_ptr< Snapshot > m_snapshot;
 };
 
 #endif // FUZZYINDEX_H
@@ -35,8 +35,46 @@
 
 #include "config.h"
 
+#include <QElapsedTimer>
+#include <QRunnable>
+
+// files listed, but not handed on to the database yet
+#define MAX_QUEUED_FILES 1000
+// database commands in flight before we stop reading more tags
+#define MAX_PENDING_COMMANDS 2
+
 using namespace Tomahawk;
 
+
+class TagReaderJob : public QRunnable
+{
+public:
+    TagReaderJob( MusicScanner* scanner, uint sequence, const QString& path )
+        : m_scanner( scanner )
+        , m_sequence( sequence )
+        , m_path( path )
+    {
+    }
+
+    void run()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        const QVariant tags = MusicScanner::readTags( QFileInfo( m_path ) );
+        const qint64 readTime = timer.nsecsElapsed() / 1000;
+
+        QMetaObject::invokeMethod( m_scanner, "tagsRead", Qt::QueuedConnection,
+                                   Q_ARG( uint, m_sequence ), Q_ARG( QVariant, tags ), Q_ARG( qint64, readTime ) );
+    }
+
+private:
+    MusicScanner* m_scanner;
+    uint m_sequence;
+    QString m_path;
+};
+
+
 void
 DirLister::go()
 {
@@ -84,7 +122,18 @@ DirLister::scanDir( QDir dir, int depth )
     dir.setSorting( QDir::Name );
     filteredEntries = dir.entryInfoList();
     foreach ( const QFileInfo& di, filteredEntries )
+    {
+        // wait until the scanner caught up
+        while ( m_credits && !m_credits->tryAcquire( 1, 100 ) )
+        {
+            if ( isDeleting() )
+                break;
+        }
+        if ( isDeleting() )
+            break;
+
         emit fileToScan( di );
+    }
 
     dir.setFilter( QDir::Dirs | QDir::Readable | QDir::NoDotAndDotDot );
     filteredEntries = dir.entryInfoList();
@@ -106,6 +155,7 @@ DirLister::scanDir( QDir dir, int depth )
 
 DirListerThreadController::DirListerThreadController( QObject *parent )
     : QThread( parent )
+    , m_credits( 0 )
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO;
 }
@@ -120,7 +170,7 @@ DirListerThreadController::~DirListerThreadController()
 void
 DirListerThreadController::run()
 {
-    m_dirLister = QPointer< DirLister >( new DirLister( m_paths ) );
+    m_dirLister = QPointer< DirLister >( new DirLister( m_paths, m_credits ) );
     connect( m_dirLister.data(), SIGNAL( fileToScan( QFileInfo ) ),
              parent(), SLOT( scanFile( QFileInfo ) ), Qt::QueuedConnection );
 
@@ -136,17 +186,39 @@ DirListerThreadController::run()
 }
 
 
+void
+DirListerThreadController::stop()
+{
+    if ( !m_dirLister.isNull() )
+        m_dirLister.data()->setIsDeleting();
+
+    quit();
+}
+
+
 MusicScanner::MusicScanner( MusicScanner::ScanMode scanMode, const QStringList& paths, quint32 bs )
     : QObject()
     , m_scanMode( scanMode )
     , m_paths( paths )
     , m_scanned( 0 )
+    , m_skipped( 0 )
     , m_dryRun( false )
     , m_verbose( false )
     , m_cmdQueue( 0 )
     , m_batchsize( bs )
+    , m_nextSequence( 0 )
+    , m_readsInFlight( 0 )
+    , m_tagReadTime( 0 )
+    , m_listingFinished( false )
+    , m_scanFinished( false )
+    , m_listingCredits( MAX_QUEUED_FILES )
     , m_dirListerThreadController( 0 )
 {
+    m_tagReaders.setMaxThreadCount( DEFAULT_SCANNER_TAG_READERS );
+
+    // readTags() runs on several threads, fill these lazily built tables upfront
+    TomahawkUtils::supportedExtensions();
+    TomahawkUtils::extensionToMimetype( QString() );
 }
 
 
@@ -154,9 +226,12 @@ MusicScanner::~MusicScanner()
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO;
 
+    m_tagReaders.clear();
+    m_tagReaders.waitForDone();
+
     if ( m_dirListerThreadController )
     {
-        m_dirListerThreadController->quit();
+        m_dirListerThreadController->stop();
         m_dirListerThreadController->wait( 60000 );
 
         delete m_dirListerThreadController;
@@ -193,12 +268,40 @@ MusicScanner::verbose()
 }
 
 
+void
+MusicScanner::setTagReaders( int readers )
+{
+    m_tagReaders.setMaxThreadCount( qMax( 1, readers ) );
+}
+
+
+int
+MusicScanner::tagReaders() const
+{
+    return m_tagReaders.maxThreadCount();
+}
+
+
+QVariantMap
+MusicScanner::stats() const
+{
+    QVariantMap m;
+    m[ "scanned" ] = m_scanned;
+    m[ "skipped" ] = m_skipped;
+    m[ "tagReadTime" ] = m_tagReadTime / 1000;
+
+    return m;
+}
+
+
 void
 MusicScanner::startScan()
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Loading mtimes...";
     m_scanned = m_skipped = m_cmdQueue = 0;
+    m_tagReadTime = 0;
     m_skippedFiles.clear();
+    m_listingFinished = m_scanFinished = false;
 
     emit progress( m_scanned );
 
@@ -238,8 +341,16 @@ MusicScanner::scan()
         return;
     }
 
+    // a previous scan that was stopped may not have returned all credits
+    const int missing = MAX_QUEUED_FILES - m_listingCredits.available();
+    if ( missing > 0 )
+        m_listingCredits.release( missing );
+    else if ( missing < 0 )
+        m_listingCredits.acquire( -missing );
+
     m_dirListerThreadController = new DirListerThreadController( this );
     m_dirListerThreadController->setPaths( m_paths );
+    m_dirListerThreadController->setCredits( &m_listingCredits );
     m_dirListerThreadController->start( QThread::IdlePriority );
 }
 
@@ -264,6 +375,13 @@ MusicScanner::postOps()
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO;
 
+    // Listing is done, but we have to wait for the tag readers to catch up
+    m_listingFinished = true;
+    if ( !m_pendingFiles.isEmpty() )
+        return;
+    m_listingFinished = false;
+    m_scanFinished = true;
+
     if ( m_scanMode == MusicScanner::DirScan )
     {
         // any remaining stuff that wasnt emitted as a batch:
@@ -346,8 +464,10 @@ MusicScanner::commandFinished()
 {
     tDebug() << Q_FUNC_INFO << m_cmdQueue;
 
-    if ( --m_cmdQueue == 0 )
+    if ( --m_cmdQueue == 0 && m_scanFinished )
         cleanup();
+    else
+        dispatchReads();
 }
 
 
@@ -356,7 +476,10 @@ MusicScanner::scanFile( const QFileInfo& fi )
 {
     // Don't process a single file twice, this might happen if you add a subfolder of another collection folder to your collection
     if ( m_processedFiles.contains( fi.canonicalFilePath() ) )
+    {
+        releaseListingCredit();
         return;
+    }
     else
         m_processedFiles << fi.canonicalFilePath();
 
@@ -367,6 +490,7 @@ MusicScanner::scanFile( const QFileInfo& fi )
                 fi.lastModified().toUTC().toTime_t() == m_filemtimes.value( "file://" + fi.canonicalFilePath() ).values().first() )
         {
             m_filemtimes.remove( "file://" + fi.canonicalFilePath() );
+            releaseListingCredit();
             return;
         }
 
@@ -375,17 +499,64 @@ MusicScanner::scanFile( const QFileInfo& fi )
         m_filemtimes.remove( "file://" + fi.canonicalFilePath() );
     }
 
-    QVariant m = readFile( fi );
-    if ( m.toMap().isEmpty() )
-        return;
+    PendingFile file;
+    file.path = fi.canonicalFilePath();
+    file.read = false;
 
-    m_scannedfiles << m;
-    if ( m_batchsize != 0 && (quint32)m_scannedfiles.length() >= m_batchsize )
+    const uint sequence = m_nextSequence++;
+    m_pendingFiles.insert( sequence, file );
+    m_readQueue.enqueue( sequence );
+
+    dispatchReads();
+}
+
+
+void
+MusicScanner::dispatchReads()
+{
+    // Don't read ahead further than the database can keep up with
+    while ( !m_readQueue.isEmpty() &&
+            m_readsInFlight < 2 * m_tagReaders.maxThreadCount() &&
+            m_cmdQueue < MAX_PENDING_COMMANDS )
     {
-        emit batchReady( m_scannedfiles, m_filesToDelete );
-        m_scannedfiles.clear();
-        m_filesToDelete.clear();
+        const uint sequence = m_readQueue.dequeue();
+        m_readsInFlight++;
+        m_tagReaders.start( new TagReaderJob( this, sequence, m_pendingFiles.value( sequence ).path ) );
+    }
+}
+
+
+void
+MusicScanner::tagsRead( uint sequence, const QVariant& tags, qint64 readTime )
+{
+    m_readsInFlight--;
+    m_tagReadTime += readTime;
+
+    QMap< uint, PendingFile >::iterator it = m_pendingFiles.find( sequence );
+    Q_ASSERT( it != m_pendingFiles.end() );
+    it.value().tags = tags;
+    it.value().read = true;
+
+    // Hand files on in the order they were listed, so batches are deterministic
+    while ( !m_pendingFiles.isEmpty() && m_pendingFiles.constBegin().value().read )
+    {
+        const PendingFile file = m_pendingFiles.take( m_pendingFiles.constBegin().key() );
+        addScannedFile( file.path, file.tags );
+        releaseListingCredit();
     }
+
+    dispatchReads();
+
+    if ( m_listingFinished && m_pendingFiles.isEmpty() )
+        postOps();
+}
+
+
+void
+MusicScanner::releaseListingCredit()
+{
+    if ( m_scanMode == MusicScanner::DirScan )
+        m_listingCredits.release();
 }
 
 
@@ -452,28 +623,30 @@ MusicScanner::readTags( const QFileInfo& fi )
 }
 
 
-QVariant
-MusicScanner::readFile( const QFileInfo& fi )
+void
+MusicScanner::addScannedFile( const QString& path, const QVariant& tags )
 {
-    const QVariant m = readTags( fi );
-
     if ( m_scanned )
         if ( m_scanned % 3 == 0 )
             emit progress( m_scanned );
 
     if ( m_scanned % 100 == 0 || m_verbose )
-        tDebug( LOGINFO ) << Q_FUNC_INFO << "Scanning file:" << m_scanned << fi.canonicalFilePath();
+        tDebug( LOGINFO ) << Q_FUNC_INFO << "Scanning file:" << m_scanned << path;
 
-    if ( m.toMap().isEmpty() )
+    if ( tags.toMap().isEmpty() )
     {
-        m_skippedFiles << fi.canonicalFilePath();
+        m_skippedFiles << path;
         m_skipped++;
+        return;
     }
-    else
+
+    m_scanned++;
+
+    m_scannedfiles << tags;
+    if ( m_batchsize != 0 && (quint32)m_scannedfiles.length() >= m_batchsize )
     {
-        m_scanned++;
+        emit batchReady( m_scannedfiles, m_filesToDelete );
+        m_scannedfiles.clear();
+        m_filesToDelete.clear();
     }
-
-    return m;
 }
-
@@ -34,22 +34,27 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QPointer>
+#include <QQueue>
+#include <QSemaphore>
 #include <QString>
 #include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <QVariantMap>
 
 // descend dir tree comparing dir mtimes to last known mtime
 // emit signal for any dir with new content, so we can scan it.
 // finally, emit the list of new mtimes we observed.
+// If credits are given, one is taken for every file emitted, so listing
+// can't run away from the scanner.
 class DirLister : public QObject
 {
 Q_OBJECT
 
 public:
 
-    DirLister( const QStringList& dirs )
-        : QObject(), m_dirs( dirs ), m_opcount( 0 ), m_deleting( false )
+    DirLister( const QStringList& dirs, QSemaphore* credits = 0 )
+        : QObject(), m_dirs( dirs ), m_credits( credits ), m_opcount( 0 ), m_deleting( false )
     {
         qDebug() << Q_FUNC_INFO;
     }
@@ -73,6 +78,7 @@ private slots:
 private:
     QStringList m_dirs;
     QSet< QString > m_processedDirs;
+    QSemaphore* m_credits;
 
     uint m_opcount;
     QMutex m_deletingMutex;
@@ -88,11 +94,16 @@ public:
     virtual ~DirListerThreadController();
 
     void setPaths( const QStringList& paths ) { m_paths = paths; }
+    void setCredits( QSemaphore* credits ) { m_credits = credits; }
     void run();
 
+    /// Makes the lister stop, even if it is waiting for credits
+    void stop();
+
 private:
     QPointer< DirLister > m_dirLister;
     QStringList m_paths;
+    QSemaphore* m_credits;
 };
 
 class DLLEXPORT MusicScanner : public QObject
@@ -124,6 +135,19 @@ public:
     void setVerbose( bool _verbose );
     bool verbose();
 
+    /**
+     * Number of threads reading tags in parallel. Reading is mostly bound by
+     * file access latency (think network shares), not by CPU.
+     */
+    void setTagReaders( int readers );
+    int tagReaders() const;
+
+    /**
+     * Counters of the current scan: files scanned and skipped, and the time
+     * spent reading tags summed up over all tag readers (in ms).
+     */
+    QVariantMap stats() const;
+
 signals:
     //void fileScanned( QVariantMap );
     void finished();
@@ -131,12 +155,15 @@ signals:
     void progress( unsigned int files );
 
 private:
-    QVariant readFile( const QFileInfo& fi );
+    void addScannedFile( const QString& path, const QVariant& tags );
+    void dispatchReads();
+    void releaseListingCredit();
     void executeCommand( Tomahawk::dbcmd_ptr cmd );
 
 private slots:
     void postOps();
     void scanFile( const QFileInfo& fi );
+    void tagsRead( uint sequence, const QVariant& tags, qint64 readTime );
     void setFileMtimes( const QMap< QString, QMap< unsigned int, unsigned int > >& m );
     void startScan();
     void scan();
@@ -164,6 +191,25 @@ private:
     QVariantList m_filesToDelete;
     quint32 m_batchsize;
 
+    // Files waiting for / being read by m_tagReaders, by sequence number so
+    // they are handed on in the order they were listed in
+    struct PendingFile
+    {
+        QString path;
+        QVariant tags;
+        bool read;
+    };
+    QMap< uint, PendingFile > m_pendingFiles;
+    QQueue< uint > m_readQueue;
+    uint m_nextSequence;
+    int m_readsInFlight;
+    qint64 m_tagReadTime; // usecs
+    bool m_listingFinished;
+    bool m_scanFinished;
+
+    QThreadPool m_tagReaders;
+    QSemaphore m_listingCredits;
+
     DirListerThreadController* m_dirListerThreadController;
 };
 
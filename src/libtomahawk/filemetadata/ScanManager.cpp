@@ -20,6 +20,7 @@
 #include "ScanManager.h"
 
 #include "database/Database.h"
+#include "database/DatabaseCommand_CompactOplog.h"
 #include "database/DatabaseCommand_FileMTimes.h"
 #include "database/DatabaseCommand_DeleteFiles.h"
 #include "utils/Logger.h"
@@ -56,6 +57,7 @@ MusicScannerThreadController::run()
 {
     m_musicScanner = QPointer< MusicScanner >( new MusicScanner( m_mode, m_paths, m_bs ) );
     m_musicScanner->setVerbose( qApp->arguments().contains( "--verbose" ) );
+    m_musicScanner->setTagReaders( TomahawkSettings::instance()->scannerTagReaders() );
 
     connect( m_musicScanner.data(), SIGNAL( finished() ), parent(), SLOT( scannerFinished() ), Qt::QueuedConnection );
     connect( m_musicScanner.data(), SIGNAL( progress( unsigned int ) ), parent(), SIGNAL( progress( unsigned int ) ), Qt::QueuedConnection );
@@ -313,6 +315,10 @@ ScanManager::scannerFinished()
     m_updateGUI = true;
     emit finished();
 
+    // scans are what makes addfiles ops obsolete, tidy up once they are done
+    if ( m_queuedScanType == MusicScanner::None )
+        Database::instance()->enqueue( dbcmd_ptr( new DatabaseCommand_CompactOplog() ) );
+
     if ( m_queuedScanType != MusicScanner::File )
         m_currScannerPaths.clear();
     switch ( m_queuedScanType )
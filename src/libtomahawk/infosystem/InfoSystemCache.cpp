@@ -25,9 +25,16 @@
 #include "utils/Logger.h"
 #include "Source.h"
 
+#include <QDataStream>
 #include <QDir>
-#include <QSettings>
 #include <QCryptographicHash>
+#include <QSqlError>
+#include <QSqlQuery>
+
+// Connection name of the cache database, it is only used from the cache's thread
+#define CACHE_CONNECTION "InfoSystemCache"
+// Entries kept in memory in front of the database
+#define MEMORY_CACHE_SIZE 500
 
 namespace Tomahawk
 {
@@ -35,7 +42,7 @@ namespace Tomahawk
 namespace InfoSystem
 {
 
-const int InfoSystemCache::s_infosystemCacheVersion = 4;
+const int InfoSystemCache::s_infosystemCacheVersion = 5;
 
 InfoSystemCache::InfoSystemCache( QObject* parent )
     : QObject( parent )
@@ -43,12 +50,16 @@ InfoSystemCache::InfoSystemCache( QObject* parent )
 {
     tDebug() << Q_FUNC_INFO;
 
+    // also removes the file per entry caches of versions before 5
     if ( TomahawkSettings::instance()->infoSystemCacheVersion() < s_infosystemCacheVersion )
     {
         TomahawkUtils::removeDirectory( m_cacheBaseDir );
         TomahawkSettings::instance()->setInfoSystemCacheVersion( s_infosystemCacheVersion );
     }
 
+    m_dataCache.setMaxCost( MEMORY_CACHE_SIZE );
+    openDatabase();
+
     m_pruneTimer.setInterval( 300000 );
     m_pruneTimer.setSingleShot( false );
     connect( &m_pruneTimer, SIGNAL( timeout() ), SLOT( pruneTimerFired() ) );
@@ -59,6 +70,49 @@ InfoSystemCache::InfoSystemCache( QObject* parent )
 InfoSystemCache::~InfoSystemCache()
 {
     tDebug() << Q_FUNC_INFO;
+
+    m_db.close();
+    m_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase( CACHE_CONNECTION );
+}
+
+
+bool
+InfoSystemCache::openDatabase()
+{
+    if ( !QDir().mkpath( m_cacheBaseDir ) )
+    {
+        tLog() << "Failed to create cache dir" << m_cacheBaseDir << "- not caching infosystem data";
+        return false;
+    }
+
+    m_db = QSqlDatabase::addDatabase( "QSQLITE", CACHE_CONNECTION );
+    m_db.setDatabaseName( m_cacheBaseDir + "cache.db" );
+    if ( !m_db.open() )
+    {
+        tLog() << "Failed to open infosystem cache" << m_db.databaseName() << m_db.lastError().text();
+        return false;
+    }
+
+    // it's a cache, losing the last writes on a crash is fine
+    QSqlQuery query( m_db );
+    query.exec( "PRAGMA journal_mode = WAL" );
+    query.exec( "PRAGMA synchronous = NORMAL" );
+
+    if ( !query.exec( "CREATE TABLE IF NOT EXISTS infocache ("
+                      " type INTEGER NOT NULL,"
+                      " hash TEXT NOT NULL,"
+                      " expires INTEGER NOT NULL,"
+                      " data BLOB NOT NULL,"
+                      " PRIMARY KEY( type, hash ) )" ) ||
+         !query.exec( "CREATE INDEX IF NOT EXISTS infocache_expires ON infocache( expires )" ) )
+    {
+        tLog() << "Failed to create infosystem cache table:" << query.lastError().text();
+        m_db.close();
+        return false;
+    }
+
+    return true;
 }
 
 
@@ -66,29 +120,58 @@ void
 InfoSystemCache::pruneTimerFired()
 {
     qDebug() << Q_FUNC_INFO << "Pruning infosystemcache";
-    qlonglong currentMSecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    if ( !m_db.isOpen() )
+        return;
 
-    for ( int i = InfoNoInfo; i <= InfoLastInfo; i++ )
-    {
-        InfoType type = (InfoType)(i);
-        QHash< QString, QString > fileLocationHash = m_fileLocationCache[type];
-        const QString cacheDirName = m_cacheBaseDir + QString::number( (int)type );
-        QFileInfoList fileList = QDir( cacheDirName ).entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
-        foreach ( QFileInfo file, fileList )
-        {
-            QString baseName = file.baseName();
-            if ( file.suffix().toLongLong() < currentMSecsSinceEpoch )
-            {
-                if ( !QFile::remove( file.canonicalFilePath() ) )
-                    tLog() << "Failed to remove stale cache file" << file.canonicalFilePath();
-                else
-                    qDebug() << "Removed stale cache file" << file.canonicalFilePath();
-            }
-            if ( fileLocationHash.contains( baseName ) )
-                fileLocationHash.remove( baseName );
-        }
-        m_fileLocationCache[type] = fileLocationHash;
-    }
+    QSqlQuery query( m_db );
+    query.prepare( "DELETE FROM infocache WHERE expires < ?" );
+    query.addBindValue( QDateTime::currentMSecsSinceEpoch() );
+    if ( !query.exec() )
+        tLog() << "Failed to prune infosystem cache:" << query.lastError().text();
+    else
+        qDebug() << "Removed" << query.numRowsAffected() << "stale cache entries";
+
+    // stale entries in memory get dropped when they are asked for
+}
+
+
+InfoSystemCache::CacheEntry*
+InfoSystemCache::loadEntry( Tomahawk::InfoSystem::InfoType type, const QString& criteriaHashVal )
+{
+    if ( !m_db.isOpen() )
+        return 0;
+
+    QSqlQuery query( m_db );
+    query.prepare( "SELECT expires, data FROM infocache WHERE type = ? AND hash = ?" );
+    query.addBindValue( (int)type );
+    query.addBindValue( criteriaHashVal );
+    if ( !query.exec() || !query.next() )
+        return 0;
+
+    CacheEntry* entry = new CacheEntry;
+    entry->expires = query.value( 0 ).toLongLong();
+
+    QByteArray data = query.value( 1 ).toByteArray();
+    QDataStream stream( &data, QIODevice::ReadOnly );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    stream >> entry->data;
+
+    return entry;
+}
+
+
+void
+InfoSystemCache::removeEntry( Tomahawk::InfoSystem::InfoType type, const QString& criteriaHashVal )
+{
+    if ( !m_db.isOpen() )
+        return;
+
+    QSqlQuery query( m_db );
+    query.prepare( "DELETE FROM infocache WHERE type = ? AND hash = ?" );
+    query.addBindValue( (int)type );
+    query.addBindValue( criteriaHashVal );
+    if ( !query.exec() )
+        tLog() << "Failed to remove stale cache entry" << criteriaHashVal << query.lastError().text();
 }
 
 
@@ -98,90 +181,48 @@ InfoSystemCache::getCachedInfoSlot( Tomahawk::InfoSystem::InfoStringHash criteri
     QObject* sendingObj = sender();
     const QString criteriaHashVal = criteriaMd5( criteria );
     const QString criteriaHashValWithType = criteriaMd5( criteria, requestData.type );
-    QHash< QString, QString > fileLocationHash = m_fileLocationCache[ requestData.type ];
-    if ( !fileLocationHash.contains( criteriaHashVal ) )
-    {
-        if ( !fileLocationHash.isEmpty() )
-        {
-            //We already know of some values, so no need to re-read the directory again as it's already happened
-            //qDebug() << Q_FUNC_INFO << "notInCache -- filelocationhash empty";
-            notInCache( sendingObj, criteria, requestData );
-            return;
-        }
 
-        const QString cacheDir = m_cacheBaseDir + QString::number( (int)requestData.type );
-        QDir dir( cacheDir );
-        if ( !dir.exists() )
+    CacheEntry* entry = m_dataCache.object( criteriaHashValWithType );
+    if ( !entry )
+    {
+        entry = loadEntry( requestData.type, criteriaHashVal );
+        if ( !entry )
         {
-            //Dir doesn't exist so clearly not in cache
-            //qDebug() << Q_FUNC_INFO << "notInCache -- dir doesn't exist";
             notInCache( sendingObj, criteria, requestData );
             return;
         }
 
-        QFileInfoList fileList = dir.entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
-        foreach ( QFileInfo file, fileList )
-        {
-            QString baseName = file.baseName();
-            fileLocationHash[ baseName ] = file.canonicalFilePath();
-        }
-
-        //Store what we've loaded up
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
-        if ( !fileLocationHash.contains( criteriaHashVal ) )
-        {
-            //Still didn't find it? It's really not in the cache then
-            //qDebug() << Q_FUNC_INFO << "notInCache -- filelocationhash doesn't contain criteria val";
-            notInCache( sendingObj, criteria, requestData );
-            return;
-        }
+        m_dataCache.insert( criteriaHashValWithType, entry );
     }
 
-    QFileInfo file( fileLocationHash[ criteriaHashVal ] );
-    qlonglong currMaxAge = file.suffix().toLongLong();
-
-    if ( currMaxAge < QDateTime::currentMSecsSinceEpoch() )
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if ( entry->expires < now )
     {
-        if ( !QFile::remove( file.canonicalFilePath() ) )
-            tLog() << "Failed to remove stale cache file" << file.canonicalFilePath();
-        else
-            qDebug() << "Removed stale cache file" << file.canonicalFilePath();
-
-        fileLocationHash.remove( criteriaHashVal );
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
+        removeEntry( requestData.type, criteriaHashVal );
         m_dataCache.remove( criteriaHashValWithType );
 
-        qDebug() << Q_FUNC_INFO << "notInCache -- file was stale";
+        qDebug() << Q_FUNC_INFO << "notInCache -- entry was stale";
         notInCache( sendingObj, criteria, requestData );
         return;
     }
     else if ( newMaxAge > 0 )
     {
-        const QString newFilePath = QString( file.dir().canonicalPath() + '/' + criteriaHashVal + '.' + QString::number( QDateTime::currentMSecsSinceEpoch() + newMaxAge ) );
-
-        if ( !QFile::rename( file.canonicalFilePath(), newFilePath ) )
+        QSqlQuery query( m_db );
+        query.prepare( "UPDATE infocache SET expires = ? WHERE type = ? AND hash = ?" );
+        query.addBindValue( now + newMaxAge );
+        query.addBindValue( (int)requestData.type );
+        query.addBindValue( criteriaHashVal );
+        if ( !query.exec() )
         {
-            qDebug() << Q_FUNC_INFO << "notInCache -- failed to move old cache file to new location";
+            qDebug() << Q_FUNC_INFO << "notInCache -- failed to update expiry of cache entry";
             notInCache( sendingObj, criteria, requestData );
             return;
         }
 
-        fileLocationHash[ criteriaHashVal ] = newFilePath;
-        m_fileLocationCache[ requestData.type ] = fileLocationHash;
+        entry->expires = now + newMaxAge;
     }
 
-    if ( !m_dataCache.contains( criteriaHashValWithType ) )
-    {
-        QSettings cachedSettings( fileLocationHash[ criteriaHashVal ], QSettings::IniFormat );
-        QVariant output = cachedSettings.value( "data" );
-        m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
-
-        emit info( requestData, output );
-    }
-    else
-    {
-        emit info( requestData, QVariant( *( m_dataCache[ criteriaHashValWithType ] ) ) );
-    }
+    emit info( requestData, entry->data );
 }
 
 
@@ -197,50 +238,28 @@ InfoSystemCache::updateCacheSlot( Tomahawk::InfoSystem::InfoStringHash criteria,
 {
     const QString criteriaHashVal = criteriaMd5( criteria );
     const QString criteriaHashValWithType = criteriaMd5( criteria, type );
-    const QString cacheDir = m_cacheBaseDir + QString::number( (int)type );
-    const QString settingsFilePath( cacheDir + '/' + criteriaHashVal + '.' + QString::number( QDateTime::currentMSecsSinceEpoch() + maxAge ) );
-
-    QHash< QString, QString > fileLocationHash = m_fileLocationCache[ type ];
-    if ( fileLocationHash.contains( criteriaHashVal ) )
-    {
-        if ( !QFile::rename( fileLocationHash[ criteriaHashVal ], settingsFilePath ) )
-        {
-            tLog() << "Failed to move old cache file to new location!";
-            return;
-        }
-        fileLocationHash[ criteriaHashVal ] = settingsFilePath;
-        m_fileLocationCache[ type ] = fileLocationHash;
 
-        QSettings cachedSettings( fileLocationHash[ criteriaHashVal ], QSettings::IniFormat );
-        cachedSettings.setValue( "data", output );
-
-        m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
+    CacheEntry* entry = new CacheEntry;
+    entry->expires = QDateTime::currentMSecsSinceEpoch() + maxAge;
+    entry->data = output;
+    m_dataCache.insert( criteriaHashValWithType, entry );
 
+    if ( !m_db.isOpen() )
         return;
-    }
 
-    QDir dir( cacheDir );
-    if( !dir.exists( cacheDir ) )
-    {
-        qDebug() << "Creating cache directory" << cacheDir;
-        if( !dir.mkpath( cacheDir ) )
-        {
-            tLog() << "Failed to create cache dir! Bailing...";
-            return;
-        }
-    }
-
-    QSettings cachedSettings( settingsFilePath, QSettings::IniFormat );
-    QStringList keys = criteria.keys();
-    cachedSettings.beginGroup( "criteria" );
-    for( int i = 0; i < criteria.size(); i++ )
-        cachedSettings.setValue( keys.at( i ), criteria[keys.at( i )] );
-    cachedSettings.endGroup();
-    cachedSettings.setValue( "data", output );
-
-    fileLocationHash[criteriaHashVal] = settingsFilePath;
-    m_fileLocationCache[type] = fileLocationHash;
-    m_dataCache.insert( criteriaHashValWithType, new QVariant( output ) );
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_5_0 );
+    stream << output;
+
+    QSqlQuery query( m_db );
+    query.prepare( "INSERT OR REPLACE INTO infocache( type, hash, expires, data ) VALUES( ?, ?, ?, ? )" );
+    query.addBindValue( (int)type );
+    query.addBindValue( criteriaHashVal );
+    query.addBindValue( entry->expires );
+    query.addBindValue( data );
+    if ( !query.exec() )
+        tLog() << "Failed to write infosystem cache entry:" << query.lastError().text();
 }
 
 
@@ -23,6 +23,7 @@
 #include <QCache>
 #include <QDateTime>
 #include <QObject>
+#include <QSqlDatabase>
 #include <QtDebug>
 #include <QTimer>
 
@@ -34,6 +35,11 @@ namespace Tomahawk
 namespace InfoSystem
 {
 
+/**
+ * Caches info responses in a single SQLite table, keyed by the hash of
+ * their criteria and indexed by expiry, so stale entries are dropped with
+ * one query. The most recently used entries are kept in memory as well.
+ */
 class DLLEXPORT InfoSystemCache : public QObject
 {
 Q_OBJECT
@@ -54,6 +60,12 @@ private slots:
     void pruneTimerFired();
 
 private:
+    struct CacheEntry
+    {
+        qint64 expires; // ms since epoch
+        QVariant data;
+    };
+
     /**
      * Version number of the infosystem cache.
      * If you change existing cached data,
@@ -61,13 +73,17 @@ private:
      */
     static const int s_infosystemCacheVersion;
 
+    bool openDatabase();
+    CacheEntry* loadEntry( Tomahawk::InfoSystem::InfoType type, const QString& criteriaHashVal );
+    void removeEntry( Tomahawk::InfoSystem::InfoType type, const QString& criteriaHashVal );
+
     void notInCache( QObject *receiver, Tomahawk::InfoSystem::InfoStringHash criteria, Tomahawk::InfoSystem::InfoRequestData requestData );
     const QString criteriaMd5( const Tomahawk::InfoSystem::InfoStringHash &criteria, Tomahawk::InfoSystem::InfoType type = Tomahawk::InfoSystem::InfoNoInfo ) const;
 
     QString m_cacheBaseDir;
-    QHash< InfoType, QHash< QString, QString > > m_fileLocationCache;
+    QSqlDatabase m_db;
     QTimer m_pruneTimer;
-    QCache< QString, QVariant > m_dataCache;
+    QCache< QString, CacheEntry > m_dataCache;
 };
 
 } //namespace InfoSystem
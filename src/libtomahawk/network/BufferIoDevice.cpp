@@ -26,7 +26,8 @@
 
 #include "utils/Logger.h"
 
-// Msgs are framed, this is the size each msg we send containing audio data:
+// Msgs are framed, this is the size each msg we send containing audio data,
+// unless both peers agreed on a larger one:
 #define BLOCKSIZE 4096
 
 
@@ -34,6 +35,16 @@ BufferIODevice::BufferIODevice( unsigned int size, QObject* parent )
     : QIODevice( parent )
     , d_ptr( new BufferIODevicePrivate( this, size ) )
 {
+    d_ptr->buffer = QSharedPointer< StreamBuffer >( new StreamBuffer( size, BLOCKSIZE ) );
+}
+
+
+BufferIODevice::BufferIODevice( const QSharedPointer< StreamBuffer >& buffer, QObject* parent )
+    : QIODevice( parent )
+    , d_ptr( new BufferIODevicePrivate( this, buffer->size() ) )
+{
+    d_ptr->buffer = buffer;
+    d_ptr->received = buffer->received();
 }
 
 
@@ -78,7 +89,7 @@ BufferIODevice::seek( qint64 pos )
 
     int block = blockForPos( pos );
     if ( isBlockEmpty( block ) )
-        emit blockRequest( block );
+        requestBlock( block );
 
     d->pos = pos;
     qDebug() << "Finished seeking";
@@ -117,25 +128,20 @@ void
 BufferIODevice::addData( int block, const QByteArray& ba )
 {
     Q_D( BufferIODevice );
-    {
-        QMutexLocker lock( &d->mut );
-
-        while ( d->buffer.count() <= block )
-            d->buffer << QByteArray();
+    // clear() may swap it meanwhile
+    const QSharedPointer< StreamBuffer > buffer = this->buffer();
+    buffer->addBlock( block, ba );
 
-        d->buffer.replace( block, ba );
-    }
-
-    // If this was the last block of the transfer, check if we need to fill up gaps
-    if ( block + 1 == maxBlocks() )
+    // If this was the last block of the transfer, or the transfer ran into data we
+    // already have, continue with the next gap, starting from where we are reading
+    if ( block + 1 == buffer->maxBlocks() || !buffer->isBlockEmpty( block + 1 ) )
     {
-        if ( nextEmptyBlock() >= 0 )
-        {
-            emit blockRequest( nextEmptyBlock() );
-        }
+        const int next = buffer->emptyBlockFrom( blockForPos( d->pos ) );
+        if ( next >= 0 )
+            requestBlock( next );
     }
 
-    d->received += ba.count();
+    d->received = buffer->received();
     emit bytesWritten( ba.count() );
     emit readyRead();
 }
@@ -159,14 +165,17 @@ BufferIODevice::readData( char* data, qint64 maxSize )
     if ( atEnd() )
         return 0;
 
-    QByteArray ba;
-    ba.append( getData( d->pos, maxSize ) );
-    d->pos += ba.count();
+    const qint64 read = buffer()->read( d->pos, data, qMin( maxSize, bytesAvailable() ) );
+    d->pos += read;
 
-//    qDebug() << Q_FUNC_INFO << maxSize << ba.count() << 2;
-    memcpy( data, ba.data(), ba.count() );
+    // count each time we run dry once, not every read while waiting
+    if ( read == 0 && maxSize > 0 && !d->stalled )
+        d->stalls.ref();
+    d->stalled = read == 0 && maxSize > 0;
 
-    return ba.count();
+    requestReadAhead();
+
+    return read;
 }
 
 
@@ -214,7 +223,7 @@ BufferIODevice::clear()
     QMutexLocker lock( &d->mut );
 
     d->pos = 0;
-    d->buffer.clear();
+    d->buffer = QSharedPointer< StreamBuffer >( new StreamBuffer( d->buffer->size(), d->buffer->blockSize() ) );
 }
 
 
@@ -225,13 +234,45 @@ BufferIODevice::openMode() const
 }
 
 
+QSharedPointer< StreamBuffer >
+BufferIODevice::buffer() const
+{
+    Q_D( const BufferIODevice );
+    QMutexLocker lock( &d->mut );
+    return d->buffer;
+}
+
+
+unsigned int
+BufferIODevice::blockSize() const
+{
+    return buffer()->blockSize();
+}
+
+
+void
+BufferIODevice::setBlockSize( unsigned int size )
+{
+    if ( !buffer()->setBlockSize( size ) )
+        tLog() << Q_FUNC_INFO << "Can't change block size to" << size << "after data has been added";
+}
+
+
 unsigned int
-BufferIODevice::blockSize()
+BufferIODevice::defaultBlockSize()
 {
     return BLOCKSIZE;
 }
 
 
+void
+BufferIODevice::setReadAhead( qint64 bytes )
+{
+    Q_D( BufferIODevice );
+    d->readAhead = bytes;
+}
+
+
 int
 BufferIODevice::blockForPos( qint64 pos ) const
 {
@@ -239,88 +280,77 @@ BufferIODevice::blockForPos( qint64 pos ) const
     // 4095 / 4096 -> block 0
     // 4096 / 4096 -> block 1
 
-    return pos / BLOCKSIZE;
+    return pos / buffer()->blockSize();
 }
 
 
 int
-BufferIODevice::offsetForPos( qint64 pos ) const
+BufferIODevice::nextEmptyBlock() const
 {
-    // 0 % 4096 -> offset 0
-    // 4095 % 4096 -> offset 4095
-    // 4096 % 4096 -> offset 0
-
-    return pos % BLOCKSIZE;
+    return buffer()->emptyBlockFrom( 0 );
 }
 
 
 int
-BufferIODevice::nextEmptyBlock() const
+BufferIODevice::stalls() const
 {
     Q_D( const BufferIODevice );
-
-    int i = 0;
-    foreach( const QByteArray& ba, d->buffer )
-    {
-        if ( ba.isEmpty() )
-            return i;
-
-        i++;
-    }
-
-    if ( i == maxBlocks() )
-        return -1;
-
-    return i;
+    return d->stalls.load();
 }
 
 
 int
 BufferIODevice::maxBlocks() const
 {
-    Q_D( const BufferIODevice );
-
-    int i = d->size / BLOCKSIZE;
-
-    if ( ( d->size % BLOCKSIZE ) > 0 )
-        i++;
-
-    return i;
+    return buffer()->maxBlocks();
 }
 
 
 bool
 BufferIODevice::isBlockEmpty( int block ) const
 {
-    Q_D( const BufferIODevice );
-    if ( block >= d->buffer.count() )
-        return true;
+    return buffer()->isBlockEmpty( block );
+}
 
-    return d->buffer.at( block ).isEmpty();
+
+void
+BufferIODevice::requestBlock( int block )
+{
+    Q_D( BufferIODevice );
+    {
+        QMutexLocker lock( &d->mut );
+
+        // already on its way
+        if ( block == d->requestedBlock && d->buffer->isBlockEmpty( block ) )
+            return;
+
+        d->requestedBlock = block;
+    }
+
+    emit blockRequest( block );
 }
 
 
-QByteArray
-BufferIODevice::getData( qint64 pos, qint64 size )
+void
+BufferIODevice::requestReadAhead()
 {
     Q_D( BufferIODevice );
-//    qDebug() << Q_FUNC_INFO << pos << size << 1;
-    QByteArray ba;
-    int block = blockForPos( pos );
-    int offset = offsetForPos( pos );
+    if ( d->readAhead <= 0 || atEnd() )
+        return;
 
-    QMutexLocker lock( &d->mut );
-    while( ba.count() < size )
-    {
-        if ( block > maxBlocks() )
-            break;
+    const int first = blockForPos( d->pos );
+    const int last = blockForPos( qMin( (qint64)d->pos + d->readAhead, (qint64)d->size - 1 ) );
 
-        if ( isBlockEmpty( block ) )
-            break;
+    const int gap = buffer()->emptyBlockFrom( first );
+    if ( gap < first || gap > last )
+        return;
 
-        ba.append( d->buffer.at( block++ ).mid( offset ) );
+    {
+        // we are just waiting for the transfer to catch up
+        QMutexLocker lock( &d->mut );
+        if ( gap == d->requestedBlock )
+            return;
     }
 
-//    qDebug() << Q_FUNC_INFO << pos << size << 2;
-    return ba.left( size );
+    requestBlock( gap );
 }
@@ -21,8 +21,10 @@
 #define BUFFERIODEVICE_H
 
 #include <QIODevice>
+#include <QSharedPointer>
 
 class BufferIODevicePrivate;
+class StreamBuffer;
 
 class BufferIODevice : public QIODevice
 {
@@ -30,6 +32,10 @@ Q_OBJECT
 
 public:
     explicit BufferIODevice( unsigned int size = 0, QObject* parent = 0 );
+    /**
+     * Reads from an existing buffer, e.g. the one of a finished transfer.
+     */
+    explicit BufferIODevice( const QSharedPointer< StreamBuffer >& buffer, QObject* parent = 0 );
     ~BufferIODevice();
 
     virtual bool open( OpenMode mode );
@@ -46,13 +52,32 @@ public:
     void addData( int block, const QByteArray& ba );
     void clear();
 
+    QSharedPointer< StreamBuffer > buffer() const;
+
     OpenMode openMode() const;
 
     void inputComplete( const QString& errmsg = "" );
 
     virtual bool isSequential() const;
 
-    static unsigned int blockSize();
+    /**
+     * Size of the blocks the data is added in, defaults to
+     * defaultBlockSize(). Can only be changed before any data was added.
+     */
+    unsigned int blockSize() const;
+    void setBlockSize( unsigned int size );
+    static unsigned int defaultBlockSize();
+
+    /**
+     * Requests missing data up to @p bytes ahead of the read position,
+     * so playback doesn't run into a gap left by seeking around.
+     */
+    void setReadAhead( qint64 bytes );
+
+    /**
+     * How often reading ran into data that hadn't arrived yet.
+     */
+    int stalls() const;
 
     int maxBlocks() const;
     int nextEmptyBlock() const;
@@ -67,8 +92,8 @@ protected:
 
 private:
     int blockForPos( qint64 pos ) const;
-    int offsetForPos( qint64 pos ) const;
-    QByteArray getData( qint64 pos, qint64 size );
+    void requestBlock( int block );
+    void requestReadAhead();
 
     Q_DECLARE_PRIVATE( BufferIODevice )
     BufferIODevicePrivate* d_ptr;
@@ -21,7 +21,9 @@
 #define BUFFERIODEVICE_P_H
 
 #include "BufferIoDevice.h"
+#include "StreamBuffer.h"
 
+#include <QAtomicInt>
 #include <QMutex>
 
 class BufferIODevicePrivate
@@ -32,18 +34,24 @@ public:
         , size( size )
         , received( 0 )
         , pos( 0 )
-
+        , readAhead( 0 )
+        , requestedBlock( -1 )
+        , stalled( false )
     {
     }
     BufferIODevice* q_ptr;
     Q_DECLARE_PUBLIC ( BufferIODevice )
 
 private:
-    QList<QByteArray> buffer;
+    QSharedPointer< StreamBuffer > buffer;
     mutable QMutex mut;
     unsigned int size;
     unsigned int received;
     unsigned int pos;
+    qint64 readAhead;
+    int requestedBlock;
+    bool stalled;
+    QAtomicInt stalls; // read from the network thread
 };
 
 #endif // BUFFERIODEVICE_P_H
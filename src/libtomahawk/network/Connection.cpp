@@ -24,6 +24,7 @@
 #include "network/acl/AclRequest.h"
 #include "network/Servent.h"
 #include "network/Msg.h"
+#include "network/MsgCodec.h"
 #include "utils/Logger.h"
 #include "utils/Json.h"
 #include "utils/TomahawkUtils.h"
@@ -34,7 +35,11 @@
 #include <QTime>
 #include <QThread>
 
+#include <cstring>
+
 #define PROTOVER "4" // must match remote peer, or we can't talk.
+// Smallest buffer we read msgs into, larger msgs get one of their size
+#define RX_BUFFER_SIZE 65536
 
 
 Connection::Connection( Servent* parent )
@@ -92,7 +97,18 @@ Connection::handleIncomingQueueEmpty()
 void
 Connection::setFirstMessage( const QVariant& m )
 {
-    const QByteArray ba = TomahawkUtils::toJson( m );
+    QVariant msg = m;
+    if ( msg.type() == QVariant::Map )
+    {
+        // let the peer know which protocol extensions we support, see doSetup()
+        QVariantMap map = msg.toMap();
+        const QVariantMap ours = features();
+        for ( QVariantMap::const_iterator it = ours.constBegin(); it != ours.constEnd(); ++it )
+            map.insert( it.key(), it.value() );
+        msg = map;
+    }
+
+    const QByteArray ba = TomahawkUtils::toJson( msg );
     //qDebug() << "first msg json len:" << ba.length();
     setFirstMessage( Msg::factory( ba, Msg::JSON ) );
 }
@@ -285,7 +301,9 @@ Connection::bytesReceived() const
 void
 Connection::setMsgProcessorModeOut(quint32 m)
 {
-    d_func()->msgprocessor_out.setMode( m );
+    Q_D( Connection );
+
+    d->msgprocessor_out.setMode( d->msgcodec > 0 ? m | MsgProcessor::ENCODE_BINARY : m );
 }
 
 void
@@ -294,6 +312,83 @@ Connection::setMsgProcessorModeIn(quint32 m)
     d_func()->msgprocessor_in.setMode( m );
 }
 
+void
+Connection::setPeerFeatures( const QVariantMap& features )
+{
+    d_func()->peer_features = features;
+}
+
+
+QVariantMap
+Connection::features() const
+{
+    QVariantMap f;
+    f.insert( "msgcodec", (int)MsgCodec::Version );
+    return f;
+}
+
+
+int
+Connection::feature( const QString& name ) const
+{
+    return d_func()->features.value( name ).toInt();
+}
+
+
+qint64
+Connection::bytesQueued() const
+{
+    Q_D( const Connection );
+
+    return d->tx_bytes_requested - d->tx_bytes;
+}
+
+
+QVariantMap
+Connection::metrics() const
+{
+    Q_D( const Connection );
+
+    QVariantMap m;
+    m[ "id" ] = d->id;
+    m[ "type" ] = metaObject()->className();
+    m[ "name" ] = d->name;
+    m[ "outbound" ] = d->outbound;
+    m[ "ready" ] = d->ready;
+    m[ "channel" ] = d->channel;
+    m[ "bytes_sent" ] = d->tx_bytes;
+    m[ "bytes_received" ] = d->rx_bytes;
+    m[ "bytes_queued" ] = bytesQueued();
+    m[ "msgs_sent" ] = d->tx_msgs;
+    m[ "msgs_received" ] = d->rx_msgs;
+    m[ "tx_bytes_sec" ] = d->stats_tx_bytes_per_sec;
+    m[ "rx_bytes_sec" ] = d->stats_rx_bytes_per_sec;
+    m[ "queue_out" ] = d->msgprocessor_out.length();
+    m[ "queue_in" ] = d->msgprocessor_in.length();
+
+    // what compression and binary encoding left of the msgs we sent
+    if ( d->msgprocessor_out.bytesIn() > 0 )
+        m[ "compression_ratio" ] = double( d->msgprocessor_out.bytesOut() ) / d->msgprocessor_out.bytesIn();
+
+    return m;
+}
+
+
+void
+Connection::enableMsgCodec( int version )
+{
+    Q_D( Connection );
+
+    if ( version < 1 || version > MsgCodec::Version )
+        return;
+
+    tDebug( LOGVERBOSE ) << "Connection" << id() << "using binary msgs, codec version" << version;
+
+    d->msgcodec = version;
+    d->msgprocessor_out.setMode( d->msgprocessor_out.mode() | MsgProcessor::ENCODE_BINARY );
+}
+
+
 const QHostAddress
 Connection::peerIpAddress() const
 {
@@ -310,6 +405,7 @@ Connection::start( QTcpSocket* sock )
     Q_ASSERT( sock->isValid() );
 
     d->sock = sock;
+    d->channel = sock->inherits( "MuxChannel" );
 
     if ( d->name.isEmpty() )
     {
@@ -449,7 +545,28 @@ Connection::doSetup()
         }
         else
         {
-            sendMsg( Msg::factory( PROTOVER, Msg::SETUP ) );
+            // Peers that didn't announce any features must get the bare version, they compare it as a whole
+            QByteArray setupMsg = PROTOVER;
+            const QVariantMap ours = features();
+            for ( QVariantMap::const_iterator it = ours.constBegin(); it != ours.constEnd(); ++it )
+            {
+                const int value = qMin( it.value().toInt(), d->peer_features.value( it.key() ).toInt() );
+                if ( value <= 0 )
+                    continue;
+
+                d->features.insert( it.key(), value );
+                setupMsg += ";" + it.key().toLatin1() + "=" + QByteArray::number( value );
+            }
+
+            sendMsg( Msg::factory( setupMsg, Msg::SETUP ) );
+
+            // Channels run over a connection that has been set up already. The peer
+            // can't refuse our version anymore, so we don't wait for its "ok".
+            if ( d->channel )
+            {
+                enableMsgCodec( feature( "msgcodec" ) );
+                setReady();
+            }
         }
     }
     else
@@ -542,42 +659,76 @@ Connection::readyRead()
 //    qDebug() << "readyRead, bytesavail:" << m_sock->bytesAvailable();
     Q_D( Connection );
 
-    if ( d->msg.isNull() )
+    if ( d->sock.isNull() )
+        return;
+
+    const qint64 available = d->sock->bytesAvailable();
+    if ( available > 0 )
     {
-        if ( d->sock->bytesAvailable() < Msg::headerSize() )
-            return;
+        const int pending = d->rxend - d->rxpos;
+        const int needed = pending + int( available );
+
+        // Msgs we handed out earlier may still point into the buffer, only reuse it once they're gone.
+        // Otherwise continue in a new one, only the incomplete msg at the end gets copied over.
+        if ( d->rxbuf.isDetached() && d->rxbuf.size() >= needed )
+        {
+            if ( d->rxpos > 0 && pending > 0 )
+                memmove( d->rxbuf.data(), d->rxbuf.constData() + d->rxpos, pending );
+        }
+        else
+        {
+            // grow geometrically towards the size of a large msg we are in the middle of
+            int size = qMax( needed, RX_BUFFER_SIZE );
+            if ( !d->msg.isNull() )
+                size = qMax( size, int( qMin( qint64( d->msg->length() ), 2 * qint64( d->rxbuf.size() ) ) ) );
+
+            QByteArray buf( size, Qt::Uninitialized );
+            if ( pending > 0 )
+                memcpy( buf.data(), d->rxbuf.constData() + d->rxpos, pending );
+            d->rxbuf = buf;
+        }
+        d->rxpos = 0;
+        d->rxend = pending;
 
-        char msgheader[ Msg::headerSize() ];
-        if ( d->sock->read( (char*) &msgheader, Msg::headerSize() ) != Msg::headerSize() )
+        const qint64 read = d->sock->read( d->rxbuf.data() + d->rxend, available );
+        if ( read < 0 )
         {
-            tDebug() << "Failed reading msg header";
+            tDebug() << "Failed reading from socket";
             this->markAsFailed();
             return;
         }
-
-        d->msg = Msg::begin( (char*) &msgheader );
-        d->rx_bytes += Msg::headerSize();
+        d->rxend += read;
     }
 
-    if ( d->sock->bytesAvailable() < d->msg->length() )
-        return;
-
-    QByteArray ba = d->sock->read( d->msg->length() );
-    if ( ba.length() != (qint32)d->msg->length() )
+    // handle all complete msgs we have, their payloads are slices of the buffer
+    while ( !d->sock.isNull() )
     {
-        tDebug() << "Failed to read full msg payload";
-        this->markAsFailed();
-        return;
-    }
-    d->msg->fill( ba );
-    d->rx_bytes += ba.length();
+        if ( d->msg.isNull() )
+        {
+            if ( d->rxend - d->rxpos < Msg::headerSize() )
+                break;
+
+            d->msg = Msg::begin( d->rxbuf.constData() + d->rxpos );
+            d->rxpos += Msg::headerSize();
+            d->rx_bytes += Msg::headerSize();
+        }
+
+        if ( quint32( d->rxend - d->rxpos ) < d->msg->length() )
+            break;
 
-    handleReadMsg(); // process m_msg and clear() it
+        d->msg->fill( d->rxbuf, d->rxpos );
+        d->rxpos += d->msg->length();
+        d->rx_bytes += d->msg->length();
+        d->rx_msgs++;
 
-    // since there is no explicit threading, use the event loop to schedule this:
-    if ( d->sock->bytesAvailable() )
+        handleReadMsg(); // process m_msg and clear() it
+    }
+
+    // we can't reuse a buffer msgs still hold on to, let it go away together with them
+    if ( d->rxpos == d->rxend && !d->rxbuf.isDetached() )
     {
-        QTimer::singleShot( 0, this, SLOT( readyRead() ) );
+        d->rxbuf.clear();
+        d->rxpos = d->rxend = 0;
     }
 }
 
@@ -591,22 +742,30 @@ Connection::handleReadMsg()
         d->msg->is( Msg::SETUP ) &&
         d->msg->payload() == "ok" )
     {
-        d->ready = true;
-        tDebug( LOGVERBOSE ) << "Connection" << id() << "READY";
-        setup();
-        emit ready();
+        enableMsgCodec( feature( "msgcodec" ) );
+        setReady();
     }
     else if ( !d->ready &&
              outbound() &&
              d->msg->is( Msg::SETUP ) )
     {
-        if ( d->msg->payload() == PROTOVER )
+        const QList< QByteArray > setupParts = d->msg->payload().split( ';' );
+        if ( setupParts.first() == PROTOVER )
         {
-            sendMsg( Msg::factory( "ok", Msg::SETUP ) );
-            d->ready = true;
-            tDebug( LOGVERBOSE ) << "Connection" << id() << "READY";
-            setup();
-            emit ready();
+            // the peer already picked the smaller value, we only accept what we offered
+            const QVariantMap ours = features();
+            foreach ( const QByteArray& part, setupParts.mid( 1 ) )
+            {
+                const QString name = QString::fromLatin1( part.left( part.indexOf( '=' ) ) );
+                const int value = part.mid( part.indexOf( '=' ) + 1 ).toInt();
+                if ( value > 0 && value <= ours.value( name ).toInt() )
+                    d->features.insert( name, value );
+            }
+            enableMsgCodec( feature( "msgcodec" ) );
+
+            if ( !d->channel )
+                sendMsg( Msg::factory( "ok", Msg::SETUP ) );
+            setReady();
         }
         else
         {
@@ -623,6 +782,18 @@ Connection::handleReadMsg()
 }
 
 
+void
+Connection::setReady()
+{
+    Q_D( Connection );
+
+    d->ready = true;
+    tDebug( LOGVERBOSE ) << "Connection" << id() << "READY";
+    setup();
+    emit ready();
+}
+
+
 void
 Connection::sendMsg( QVariant j )
 {
@@ -631,6 +802,13 @@ Connection::sendMsg( QVariant j )
     if ( d->do_shutdown )
         return;
 
+    if ( d->msgcodec > 0 )
+    {
+        tLog( LOGVERBOSE ) << Q_FUNC_INFO << "Sending to" << id() << ":" << j;
+        sendMsg( Msg::factory( MsgCodec::encode( j ), Msg::JSON | Msg::BINARY ) );
+        return;
+    }
+
     const QByteArray payload = TomahawkUtils::toJson( j );
     tLog( LOGVERBOSE ) << Q_FUNC_INFO << "Sending to" << id() << ":" << payload;
     sendMsg( Msg::factory( payload, Msg::JSON ) );
@@ -672,6 +850,8 @@ Connection::sendMsg_now( msg_ptr msg )
         shutdown( false );
         return;
     }
+
+    d->tx_msgs++;
 }
 
 
@@ -681,7 +861,12 @@ Connection::bytesWritten( qint64 i )
     d_func()->tx_bytes += i;
     // if we are waiting to shutdown, and have sent all queued data, do actual shutdown:
     if ( d_func()->do_shutdown && d_func()->tx_bytes == d_func()->tx_bytes_requested )
+    {
         actualShutdown();
+        return;
+    }
+
+    emit bytesSent( bytesQueued() );
 }
 
 
@@ -80,9 +80,21 @@ public:
     qint64 bytesSent() const;
     qint64 bytesReceived() const;
 
+    /**
+     * Traffic counters and queue state of this connection, as reported by
+     * Servent::metrics(). Subclasses add what is specific to them.
+     */
+    virtual QVariantMap metrics() const;
+
     void setMsgProcessorModeOut( quint32 m );
     void setMsgProcessorModeIn( quint32 m );
 
+    /**
+     * Protocol extensions the peer announced in the first msg of an inbound
+     * connection. We offer the ones we support as well during setup.
+     */
+    void setPeerFeatures( const QVariantMap& features );
+
     const QHostAddress peerIpAddress() const;
 
     QString bareName() const;
@@ -109,12 +121,34 @@ signals:
     void failed();
     void finished();
     void statsTick( qint64 tx_bytes_sec, qint64 rx_bytes_sec );
+    /**
+     * Emitted whenever the socket wrote some of what sendMsg() queued
+     */
+    void bytesSent( qint64 bytesQueued );
     void socketClosed();
     void socketErrored( QAbstractSocket::SocketError );
 
 protected:
     virtual void setup() = 0;
 
+    /**
+     * Protocol extensions this connection supports, mapped to the highest
+     * version or size it can handle. They are announced in the first msg of
+     * outbound connections, both sides use the smaller value of the two.
+     */
+    virtual QVariantMap features() const;
+
+    /**
+     * Value agreed on with the peer for the protocol extension @p name,
+     * 0 if either side doesn't support it. Valid once the connection is ready.
+     */
+    int feature( const QString& name ) const;
+
+    /**
+     * Bytes passed to sendMsg() that haven't been written to the socket yet.
+     */
+    qint64 bytesQueued() const;
+
 protected slots:
     virtual void handleMsg( msg_ptr msg ) = 0;
     virtual void authCheckTimeout();
@@ -126,6 +160,9 @@ public slots:
 
     void shutdown( bool waitUntilSentAll = false );
 
+private:
+    void enableMsgCodec( int version );
+
 private slots:
     void handleIncomingQueueEmpty();
     void sendMsg_now( msg_ptr );
@@ -144,6 +181,7 @@ private:
 
     void handleReadMsg();
     void actualShutdown();
+    void setReady();
 };
 
 #endif // CONNECTION_H
@@ -42,11 +42,17 @@ public:
         , ready( false )
         , onceonly( true )
         , setup( false )
+        , channel( false )
         , tx_bytes( 0 )
         , tx_bytes_requested( 0 )
         , rx_bytes( 0 )
+        , tx_msgs( 0 )
+        , rx_msgs( 0 )
+        , rxpos( 0 )
+        , rxend( 0 )
         , id( "Connection()" )
         , peerport( 0 )
+        , msgcodec( 0 )
         , statstimer( 0 )
         , stats_tx_bytes_per_sec( 0 )
         , stats_rx_bytes_per_sec( 0 )
@@ -69,16 +75,25 @@ private:
     bool ready;
     bool onceonly;
     bool setup;
+    bool channel; // carried over a ControlConnection, see MuxChannel
     qint64 tx_bytes;
     qint64 tx_bytes_requested;
     qint64 rx_bytes;
+    qint64 tx_msgs;
+    qint64 rx_msgs;
     QString id;
     QString name;
     QString nodeid;
     mutable QReadWriteLock nodeidLock;
-    msg_ptr msg;
+    msg_ptr msg; // the msg we are reading
+    QByteArray rxbuf; // what we read from the socket, payloads of the msgs we received point into it
+    int rxpos; // start of what hasn't been parsed yet
+    int rxend; // end of what we read
     msg_ptr firstmsg;
     int peerport;
+    int msgcodec; // MsgCodec version used for JSON msgs we send, 0 for plain JSON
+    QVariantMap peer_features; // protocol extensions the peer announced in its first msg
+    QVariantMap features; // protocol extensions agreed on during setup
 
     QTimer* statstimer;
     QTime statstimer_mark;
@@ -22,6 +22,7 @@
 
 #include "database/Database.h"
 #include "database/DatabaseCommand_CollectionStats.h"
+#include "database/DatabaseImpl.h"
 #include "network/DbSyncConnection.h"
 #include "network/Msg.h"
 #include "network/MsgProcessor.h"
@@ -29,11 +30,21 @@
 #include "sip/PeerInfo.h"
 #include "utils/Logger.h"
 
+#include "MuxChannel.h"
 #include "PlaylistEntry.h"
 #include "StreamConnection.h"
 #include "SourceList.h"
 
+#include <QThread>
+#include <QtEndian>
+
 #define TCP_TIMEOUT 600
+// Version of the channel layer we support, see MuxChannel
+#define MUX_VERSION 1
+// Version of the ping echo we support, used to measure the round trip time
+#define RTT_VERSION 1
+#define PING_REQUEST 'q'
+#define PING_REPLY 'r'
 
 using namespace Tomahawk;
 
@@ -66,6 +77,13 @@ ControlConnection::~ControlConnection()
         }
     }
 
+    // whatever runs over our channels has lost its peer now
+    foreach ( const QPointer< MuxChannel >& channel, d->channels.values() )
+    {
+        if ( !channel.isNull() )
+            channel->remoteClosed();
+    }
+
     delete d->pingtimer;
     servent()->unregisterControlConnection( this );
     if ( d->dbsyncconn )
@@ -142,6 +160,7 @@ ControlConnection::setup()
         connect( d->pingtimer, SIGNAL( timeout() ), SLOT( onPingTimer() ) );
         d->pingtimer->start();
         d->pingtimer_mark.start();
+        d->rttclock.start();
         d->sourceLock.unlock();
     }
     else
@@ -271,6 +290,31 @@ ControlConnection::handleMsg( msg_ptr msg )
     {
         // qDebug() << "Received Connection PING, nice." << m_pingtimer_mark.elapsed();
         d->pingtimer_mark.restart();
+
+        // pings of peers that support "rtt" carry the time they were sent, which we echo back
+        const QByteArray& payload = msg->payload();
+        if ( payload.size() == 1 + (int)sizeof( qint64 ) && payload.at( 0 ) == PING_REQUEST )
+        {
+            QByteArray reply = payload;
+            reply[ 0 ] = PING_REPLY;
+            sendMsg( Msg::factory( reply, Msg::PING ) );
+        }
+        else if ( payload.size() == 1 + (int)sizeof( qint64 ) && payload.at( 0 ) == PING_REPLY )
+        {
+            const qint64 rtt = d->rttclock.elapsed() - qFromBigEndian< qint64 >( (const uchar*)payload.constData() + 1 );
+            if ( rtt >= 0 )
+            {
+                d->rtt = rtt;
+                d->srtt = d->srtt < 0 ? rtt : ( 7 * d->srtt + rtt ) / 8;
+            }
+        }
+        return;
+    }
+
+    // Channels are the only thing we send RAW
+    if ( msg->is( Msg::RAW ) && supportsChannels() )
+    {
+        handleChannelFrame( msg );
         return;
     }
 
@@ -346,7 +390,15 @@ ControlConnection::onPingTimer()
         shutdown( true );
     }
 
-    sendMsg( Msg::factory( QByteArray(), Msg::PING ) );
+    QByteArray payload;
+    if ( feature( "rtt" ) > 0 && d->rttclock.isValid() )
+    {
+        const qint64 now = qToBigEndian< qint64 >( d->rttclock.elapsed() );
+        payload.append( PING_REQUEST );
+        payload.append( (const char*)&now, sizeof( now ) );
+    }
+
+    sendMsg( Msg::factory( payload, Msg::PING ) );
 }
 
 
@@ -396,3 +448,156 @@ ControlConnection::peerInfos() const
     Q_D( const ControlConnection );
     return d->peerInfos;
 }
+
+
+QVariantMap
+ControlConnection::features() const
+{
+    QVariantMap f = Connection::features();
+    f.insert( "mux", MUX_VERSION );
+    f.insert( "rtt", RTT_VERSION );
+    return f;
+}
+
+
+QVariantMap
+ControlConnection::metrics() const
+{
+    Q_D( const ControlConnection );
+
+    QVariantMap m = Connection::metrics();
+    m[ "rtt_ms" ] = d->rtt;
+    m[ "srtt_ms" ] = d->srtt;
+    m[ "channels" ] = d->channels.count();
+
+    if ( d->dbsyncconn )
+        m[ "dbsync" ] = d->dbsyncconn->metrics();
+
+    return m;
+}
+
+
+bool
+ControlConnection::supportsChannels() const
+{
+    return feature( "mux" ) > 0;
+}
+
+
+void
+ControlConnection::openChannel( Connection* conn, const QString& key )
+{
+    Q_D( ControlConnection );
+
+    if ( QThread::currentThread() != thread() )
+    {
+        QMetaObject::invokeMethod( this, "openChannel", Qt::QueuedConnection, Q_ARG( Connection*, conn ), Q_ARG( QString, key ) );
+        return;
+    }
+
+    if ( conn->firstMessage().isNull() )
+    {
+        QVariantMap m;
+        m["conntype"]  = "accept-offer";
+        m["key"]       = key;
+        m["controlid"] = Database::instance()->impl()->dbid();
+        conn->setFirstMessage( m );
+    }
+
+    // the side that connected uses odd channel ids, the other one even ids
+    if ( d->nextChannel == 0 )
+        d->nextChannel = outbound() ? 1 : 2;
+
+    MuxChannel* channel = new MuxChannel( this, d->nextChannel );
+    d->nextChannel += 2;
+    d->channels.insert( channel->channelId(), channel );
+
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Opening channel" << channel->channelId() << "to" << name() << "for" << key;
+
+    channel->_outbound = true;
+    channel->_conn = conn;
+    sendChannelFrame( ChannelOpen, channel->channelId() );
+
+    // the first msg of conn follows right away, no need to wait for the peer
+    servent()->handoverSocket( conn, channel );
+}
+
+
+void
+ControlConnection::sendChannelFrame( ChannelFrame type, quint32 channel, const QByteArray& data )
+{
+    const quint32 id = qToBigEndian( channel );
+
+    QByteArray frame;
+    frame.reserve( 1 + sizeof( id ) + data.size() );
+    frame.append( char( type ) );
+    frame.append( (const char*)&id, sizeof( id ) );
+    frame.append( data );
+
+    sendMsg( Msg::factory( frame, Msg::RAW ) );
+}
+
+
+void
+ControlConnection::removeChannel( quint32 channel )
+{
+    Q_D( ControlConnection );
+    d->channels.remove( channel );
+}
+
+
+void
+ControlConnection::handleChannelFrame( msg_ptr msg )
+{
+    Q_D( ControlConnection );
+
+    const QByteArray& payload = msg->payload();
+    if ( payload.size() < 5 )
+    {
+        tLog() << Q_FUNC_INFO << "Invalid channel frame from" << name();
+        return;
+    }
+
+    const int type = payload.at( 0 );
+    const quint32 id = qFromBigEndian< quint32 >( (const uchar*)payload.constData() + 1 );
+    QPointer< MuxChannel > channel = d->channels.value( id );
+
+    switch ( type )
+    {
+        case ChannelOpen:
+        {
+            // the peer picks ids of the other parity than ours
+            if ( !channel.isNull() || ( id % 2 == 1 ) == outbound() )
+            {
+                tLog() << Q_FUNC_INFO << "Refusing channel" << id << "from" << name();
+                sendChannelFrame( ChannelClose, id );
+                return;
+            }
+
+            channel = new MuxChannel( this, id );
+            d->channels.insert( id, channel );
+
+            // from here on it is handled like a new connection to us
+            servent()->acceptChannel( channel );
+            break;
+        }
+
+        case ChannelData:
+            if ( !channel.isNull() )
+                channel->receive( payload.mid( 5 ) );
+            break;
+
+        case ChannelGrant:
+            if ( !channel.isNull() && payload.size() >= 9 )
+                channel->grant( qFromBigEndian< quint32 >( (const uchar*)payload.constData() + 5 ) );
+            break;
+
+        case ChannelClose:
+            if ( !channel.isNull() )
+                channel->remoteClosed();
+            break;
+
+        default:
+            tLog() << Q_FUNC_INFO << "Unknown channel frame" << type << "from" << name();
+    }
+}
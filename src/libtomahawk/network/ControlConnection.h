@@ -34,6 +34,7 @@
 
 class ControlConnectionPrivate;
 class DBSyncConnection;
+class MuxChannel;
 class Servent;
 
 class DLLEXPORT ControlConnection : public Connection
@@ -41,6 +42,15 @@ class DLLEXPORT ControlConnection : public Connection
 Q_OBJECT
 
 public:
+    // frames of the channels carried over this connection, see MuxChannel
+    enum ChannelFrame
+    {
+        ChannelOpen = 1,
+        ChannelData = 2,
+        ChannelGrant = 3,
+        ChannelClose = 4
+    };
+
     ControlConnection( Servent* parent );
     ~ControlConnection();
     Connection* clone();
@@ -59,8 +69,32 @@ public:
     void setShutdownOnEmptyPeerInfos( bool shutdownOnEmptyPeerInfos );
     const QSet< Tomahawk::peerinfo_ptr > peerInfos() const;
 
+    /**
+     * Whether the peer can take other connections over this one, instead
+     * of us connecting to it again.
+     */
+    bool supportsChannels() const;
+
+    /**
+     * Adds the round trip time measured with our pings, and the metrics of
+     * the DB sync connection to the peer.
+     */
+    virtual QVariantMap metrics() const;
+
+    // used by MuxChannel
+    void sendChannelFrame( ChannelFrame type, quint32 channel, const QByteArray& data = QByteArray() );
+    void removeChannel( quint32 channel );
+
+public slots:
+    /**
+     * Runs @p conn over a new channel of this connection, as if it had
+     * connected to the peer to claim the offer @p key.
+     */
+    void openChannel( Connection* conn, const QString& key );
+
 protected:
     virtual void setup();
+    virtual QVariantMap features() const;
 
 protected slots:
     virtual void handleMsg( msg_ptr msg );
@@ -76,6 +110,7 @@ private:
     ControlConnectionPrivate* d_ptr;
 
     void setupDbSyncConnection( bool ondemand = false );
+    void handleChannelFrame( msg_ptr msg );
 };
 
 #endif // CONTROLCONNECTION_H
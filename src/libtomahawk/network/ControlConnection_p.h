@@ -23,6 +23,9 @@
 
 #include "ControlConnection.h"
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
 #include <QReadWriteLock>
 #include <QTime>
 #include <QTimer>
@@ -36,6 +39,9 @@ public:
         , registered( false )
         , shutdownOnEmptyPeerInfos( true )
         , pingtimer( 0 )
+        , rtt( -1 )
+        , srtt( -1 )
+        , nextChannel( 0 )
     {
     }
     ControlConnection* q_ptr;
@@ -56,8 +62,14 @@ private:
 
     QTimer* pingtimer;
     QTime pingtimer_mark;
+    QElapsedTimer rttclock; // time base of the pings we send
+    qint64 rtt; // ms, of the last ping, -1 until we know
+    qint64 srtt; // ms, smoothed like TCP does
 
     QSet< Tomahawk::peerinfo_ptr > peerInfos;
+
+    QHash< quint32, QPointer< MuxChannel > > channels;
+    quint32 nextChannel;
 };
 
 #endif // CONTROLCONNECTION_P_H
@@ -21,11 +21,25 @@
     Database syncing using the oplog table.
     =======================================
     Load the last GUID we applied for the peer, tell them it.
-    In return, they send us all new ops since that guid.
+    In return, they send us up to "window" new ops since that guid.
 
-    We then apply those new ops to our cache of their data
+    We then apply those new ops to our cache of their data. If the page was
+    full, we ask for the next one (since the last guid we got) while the
+    current one is still being applied.
 
-    Synced.
+    Once they have nothing new for us: synced.
+
+    Peers that don't know about "window" send all their ops at once.
+
+    If we never synced with them, we ask for a snapshot instead: their
+    current collection plus all ops that aren't about files, sent in
+    chunks, the last one carrying the guid of the op the snapshot ends on.
+    The sender loads a few chunks at a time, the next ones only once the
+    socket has caught up with them.
+    We replace our copy of their collection with it and carry on syncing
+    ops from that guid. Should any chunk fail to import, we don't take the
+    guid and ask for the snapshot again. Peers that don't know about snapshots just send
+    their whole oplog.
 
 */
 
@@ -33,8 +47,11 @@
 
 #include "database/Database.h"
 #include "database/DatabaseCommand.h"
+#include "database/CollectionSnapshot.h"
 #include "database/DatabaseCommand_CollectionStats.h"
+#include "database/DatabaseCommand_ImportSnapshot.h"
 #include "database/DatabaseCommand_LoadOps.h"
+#include "database/DatabaseCommand_LoadSnapshot.h"
 #include "utils/Logger.h"
 
 #include "Msg.h"
@@ -43,13 +60,32 @@
 #include "Source.h"
 #include "SourceList.h"
 
+// ops per fetchops request
+#define DEFAULT_SYNC_WINDOW 1000
+// times we ask again for a snapshot that failed to import, before waiting for the next sync
+#define SNAPSHOT_MAX_RETRIES 2
+// chunks of a snapshot we send loaded at a time
+#define SNAPSHOT_PAGE_CHUNKS 4
+// bytes waiting for the socket before we load the next page of a snapshot
+#define SNAPSHOT_MAX_QUEUED ( 1024 * 1024 )
+
 using namespace Tomahawk;
 
 
 DBSyncConnection::DBSyncConnection( Servent* s, const source_ptr& src )
     : Connection( s )
     , m_fetchCount( 0 )
+    , m_syncWindow( DEFAULT_SYNC_WINDOW )
+    , m_pageOps( 0 )
+    , m_fetching( false )
+    , m_fetchDeferred( false )
+    , m_applying( false )
+    , m_peerSynced( false )
+    , m_snapshotFailed( false )
     , m_source( src )
+    , m_snapshotRetries( 0 )
+    , m_snapshotWindow( 0 )
+    , m_snapshotPaused( false )
     , m_state( UNKNOWN )
 {
     qDebug() << Q_FUNC_INFO << src->id() << thread();
@@ -59,6 +95,9 @@ DBSyncConnection::DBSyncConnection( Servent* s, const source_ptr& src )
              m_source.data(),   SLOT( onStateChanged( Tomahawk::DBSyncConnectionState, Tomahawk::DBSyncConnectionState, QString ) ) );
     connect( m_source.data(), SIGNAL( commandsFinished() ),
              this,              SLOT( lastOpApplied() ) );
+    connect( m_source.data(), SIGNAL( stateChanged() ),
+             this,              SLOT( commandsProgressed() ) );
+    connect( this, SIGNAL( bytesSent( qint64 ) ), SLOT( onBytesSent( qint64 ) ) );
 
     this->setMsgProcessorModeIn( MsgProcessor::PARSE_JSON | MsgProcessor::UNCOMPRESS_ALL );
 
@@ -87,6 +126,25 @@ DBSyncConnection::changeState( DBSyncConnectionState newstate )
 }
 
 
+void
+DBSyncConnection::setSyncWindow( int ops )
+{
+    m_syncWindow = qMax( 1, ops );
+}
+
+
+QVariantMap
+DBSyncConnection::metrics() const
+{
+    QVariantMap m = Connection::metrics();
+    m[ "sync_state" ] = (int)m_state;
+    m[ "sync_fetching" ] = m_fetching;
+    m[ "sync_lag_ops" ] = m_source.isNull() ? 0 : m_source->pendingCommandCount();
+
+    return m;
+}
+
+
 void
 DBSyncConnection::setup()
 {
@@ -155,13 +213,34 @@ DBSyncConnection::fetchOpsData( const QString& sinceguid )
 
     tLog() << "Sending a FETCHOPS cmd since:" << sinceguid << "- source:" << m_source->id();
 
+    m_fetching = true;
+    m_pageOps = 0;
+
     QVariantMap msg;
     msg.insert( "method", "fetchops" );
     msg.insert( "lastop", sinceguid );
+    msg.insert( "window", m_syncWindow );
+    if ( sinceguid.isEmpty() )
+        msg.insert( "snapshot", true );
     sendMsg( msg );
 }
 
 
+void
+DBSyncConnection::fetchNextPage()
+{
+    // Don't let ops pile up faster than we can apply them
+    if ( m_source->pendingCommandCount() > m_syncWindow )
+    {
+        m_fetchDeferred = true;
+        return;
+    }
+
+    m_fetchDeferred = false;
+    fetchOpsData( m_source->lastCmdGuid() );
+}
+
+
 void
 DBSyncConnection::handleMsg( msg_ptr msg )
 {
@@ -175,14 +254,25 @@ DBSyncConnection::handleMsg( msg_ptr msg )
          msg->is( Msg::DBOP ) &&
          msg->payload() == "ok" )
     {
-        changeState( SYNCED );
-
-        // calc the collection stats, to updates the "X tracks" in the sidebar etc
-        // this is done automatically if you run a dbcmd to add files.
-        DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( m_source );
-        connect( cmd,           SIGNAL( done( const QVariantMap & ) ),
-                 m_source.data(), SLOT( setStats( const QVariantMap& ) ), Qt::QueuedConnection );
-        Database::instance()->enqueue( Tomahawk::dbcmd_ptr(cmd) );
+        m_fetching = false;
+
+        // Still applying a previous page, we are synced once lastOpApplied().
+        // The state doesn't tell, it is FETCHING again while a page is applied.
+        if ( m_applying )
+        {
+            m_peerSynced = true;
+            return;
+        }
+
+        synced();
+        return;
+    }
+
+    if ( !msg->is( Msg::JSON ) &&
+         msg->is( Msg::DBOP ) &&
+         CollectionSnapshotChunk::isSnapshot( msg->payload() ) )
+    {
+        importSnapshotChunk( msg );
         return;
     }
 
@@ -204,11 +294,18 @@ DBSyncConnection::handleMsg( msg_ptr msg )
         {
             m_source->addCommand( cmd );
         }
+        m_pageOps++;
 
         if ( !msg->is( Msg::FRAGMENT ) ) // last msg in this batch
         {
+            m_fetching = false;
+            m_applying = true;
             changeState( SAVING ); // just DB work left to complete
             m_source->executeCommands();
+
+            // a full page, there's probably more to come
+            if ( m_pageOps >= m_syncWindow )
+                fetchNextPage();
         }
         return;
     }
@@ -234,33 +331,255 @@ DBSyncConnection::handleMsg( msg_ptr msg )
 }
 
 
+void
+DBSyncConnection::importSnapshotChunk( const msg_ptr& msg )
+{
+    const bool last = !msg->is( Msg::FRAGMENT );
+
+    CollectionSnapshotChunk chunk;
+    if ( !chunk.deserialize( msg->payload() ) )
+    {
+        tLog() << "Failed to parse snapshot chunk from:" << m_source->id() << m_source->friendlyName();
+        m_snapshotFailed = true;
+    }
+    else if ( chunk.first )
+    {
+        m_snapshotFailed = false;
+        m_snapshotImportFailed = QSharedPointer< QAtomicInt >( new QAtomicInt( 0 ) );
+    }
+
+    // The remaining chunks are dropped, those already queued fail without
+    // touching the db and no lastop gets recorded
+    if ( m_snapshotFailed || !m_snapshotImportFailed )
+    {
+        if ( m_snapshotImportFailed )
+            m_snapshotImportFailed->store( 1 );
+        if ( last )
+            snapshotFailed();
+        return;
+    }
+
+    DatabaseCommand_ImportSnapshot* cmd = new DatabaseCommand_ImportSnapshot( chunk, m_source, m_snapshotImportFailed );
+    connect( cmd, SIGNAL( failed() ), SLOT( snapshotChunkFailed() ) );
+    if ( last )
+    {
+        m_snapshotLastop = chunk.lastop;
+        changeState( SAVING );
+        connect( cmd, SIGNAL( finished() ), SLOT( snapshotImported() ) );
+    }
+
+    // not added to the source, the snapshot is no op of its own and mustn't become its lastCmdGuid
+    Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
+}
+
+
+void
+DBSyncConnection::snapshotChunkFailed()
+{
+    // chunks of an earlier snapshot have a flag of their own
+    if ( m_snapshotImportFailed && m_snapshotImportFailed->load() )
+        m_snapshotFailed = true;
+}
+
+
+void
+DBSyncConnection::snapshotImported()
+{
+    // every chunk has run by now, any of them failing marked the snapshot
+    if ( m_snapshotFailed || !m_snapshotImportFailed || m_snapshotImportFailed->load() )
+    {
+        m_snapshotFailed = true;
+        snapshotFailed();
+        return;
+    }
+
+    tLog() << "Imported snapshot of" << m_source->id() << m_source->friendlyName() << "up to" << m_snapshotLastop;
+
+    m_snapshotImportFailed.clear();
+    m_snapshotRetries = 0;
+    m_fetching = false;
+    m_source->setLastCmdGuid( m_snapshotLastop );
+
+    changeState( SYNCED );
+    // pick up the ops that happened since the snapshot was taken
+    check();
+}
+
+
+void
+DBSyncConnection::snapshotFailed()
+{
+    m_snapshotImportFailed.clear();
+    m_fetching = false;
+
+    // we may hold a part of their collection now, but without a lastop it
+    // isn't taken for synced
+    if ( m_snapshotRetries < SNAPSHOT_MAX_RETRIES )
+    {
+        m_snapshotRetries++;
+        tLog() << "Snapshot of" << m_source->id() << m_source->friendlyName() << "failed, asking for it again";
+        fetchOpsData( QString() );
+        return;
+    }
+
+    tLog() << "Snapshot of" << m_source->id() << m_source->friendlyName() << "failed, trying again on the next sync";
+    m_snapshotRetries = 0;
+    changeState( UNKNOWN );
+}
+
+
 void
 DBSyncConnection::lastOpApplied()
 {
+    m_applying = false;
+
+    // the next page is on its way already
+    if ( m_fetching )
+        return;
+
+    if ( m_fetchDeferred )
+    {
+        fetchNextPage();
+        return;
+    }
+
+    // the peer has no more ops for us
+    if ( m_peerSynced )
+    {
+        synced();
+        return;
+    }
+
     changeState( SYNCED );
     // check again, until peer responds we have no new ops to process
     check();
 }
 
 
+void
+DBSyncConnection::synced()
+{
+    m_peerSynced = false;
+    changeState( SYNCED );
+
+    // calc the collection stats, to updates the "X tracks" in the sidebar etc
+    // this is done automatically if you run a dbcmd to add files.
+    DatabaseCommand_CollectionStats* cmd = new DatabaseCommand_CollectionStats( m_source );
+    connect( cmd,           SIGNAL( done( const QVariantMap & ) ),
+             m_source.data(), SLOT( setStats( const QVariantMap& ) ), Qt::QueuedConnection );
+    Database::instance()->enqueue( Tomahawk::dbcmd_ptr(cmd) );
+}
+
+
+void
+DBSyncConnection::commandsProgressed()
+{
+    if ( m_fetchDeferred && m_source->pendingCommandCount() <= m_syncWindow )
+        fetchNextPage();
+}
+
+
 /// request new copies of anything we've cached that is stale
 void
 DBSyncConnection::sendOps()
 {
-    tLog() << "Will send peer" << m_source->id() << "all ops since" << m_uscache.value( "lastop" ).toString();
+    const QString lastop = m_uscache.value( "lastop" ).toString();
+    // peers that predate paging don't send a window and get everything at once
+    const int window = m_uscache.value( "window", 0 ).toInt();
+    const bool snapshot = lastop.isEmpty() && m_uscache.value( "snapshot", false ).toBool();
+
+    m_uscache.clear();
+
+    if ( snapshot )
+    {
+        tLog() << "Will send peer" << m_source->id() << "a snapshot of our collection";
+
+        m_snapshotWindow = window;
+        m_snapshotCmd = dbcmd_ptr( new DatabaseCommand_LoadSnapshot( SourceList::instance()->getLocal(), SNAPSHOT_PAGE_CHUNKS ) );
+        loadSnapshotPage();
+        return;
+    }
+
+    sendOpsSince( lastop, window );
+}
+
+
+void
+DBSyncConnection::sendOpsSince( const QString& sinceguid, int window )
+{
+    tLog() << "Will send peer" << m_source->id() << "all ops since" << sinceguid;
 
     source_ptr src = SourceList::instance()->getLocal();
 
-    DatabaseCommand_loadOps* cmd = new DatabaseCommand_loadOps( src, m_uscache.value( "lastop" ).toString() );
+    DatabaseCommand_loadOps* cmd = new DatabaseCommand_loadOps( src, sinceguid, window );
     connect( cmd, SIGNAL( done( QString, QString, QList< dbop_ptr > ) ),
                     SLOT( sendOpsData( QString, QString, QList< dbop_ptr > ) ) );
 
-    m_uscache.clear();
-
     Database::instance()->enqueue( Tomahawk::dbcmd_ptr( cmd ) );
 }
 
 
+void
+DBSyncConnection::loadSnapshotPage()
+{
+    // Like with fetching pages, we don't load more than the peer takes in
+    if ( bytesQueued() > SNAPSHOT_MAX_QUEUED )
+    {
+        m_snapshotPaused = true;
+        return;
+    }
+
+    m_snapshotPaused = false;
+    connect( m_snapshotCmd.data(), SIGNAL( chunk( QByteArray, bool ) ),
+                                   SLOT( sendSnapshotChunk( QByteArray, bool ) ) );
+    connect( m_snapshotCmd.data(), SIGNAL( finished() ),
+                                   SLOT( snapshotPageLoaded() ) );
+
+    Database::instance()->enqueue( m_snapshotCmd );
+}
+
+
+void
+DBSyncConnection::snapshotPageLoaded()
+{
+    DatabaseCommand_LoadSnapshot* cmd = qobject_cast< DatabaseCommand_LoadSnapshot* >( m_snapshotCmd.data() );
+    if ( !cmd || cmd->isDone() )
+    {
+        m_snapshotCmd.clear();
+        return;
+    }
+
+    m_snapshotCmd = dbcmd_ptr( cmd->next() );
+    loadSnapshotPage();
+}
+
+
+void
+DBSyncConnection::onBytesSent( qint64 bytesQueued )
+{
+    if ( m_snapshotPaused && bytesQueued <= SNAPSHOT_MAX_QUEUED )
+        loadSnapshotPage();
+}
+
+
+void
+DBSyncConnection::sendSnapshotChunk( const QByteArray& data, bool last )
+{
+    // nothing a snapshot could end on, the plain oplog it is
+    if ( data.isEmpty() )
+    {
+        sendOpsSince( QString(), m_snapshotWindow );
+        return;
+    }
+
+    quint8 flags = Msg::DBOP;
+    if ( !last )
+        flags |= Msg::FRAGMENT;
+
+    sendMsg( Msg::factory( data, flags ) );
+}
+
+
 void
 DBSyncConnection::sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops )
 {
@@ -25,6 +25,7 @@
 #include "database/Op.h"
 #include "Typedefs.h"
 
+#include <QAtomicInt>
 #include <QObject>
 #include <QTimer>
 #include <QSharedPointer>
@@ -45,6 +46,18 @@ public:
     void setup() override;
     Connection* clone() override;
 
+    /**
+     * Number of ops we ask the peer for per request. The next page is
+     * requested while the previous one is being applied, but only as long as
+     * no more than one page of ops is waiting to be applied.
+     */
+    void setSyncWindow( int ops );
+
+    /**
+     * Adds how far behind the peer we are, in ops received but not applied yet.
+     */
+    QVariantMap metrics() const override;
+
 signals:
     void stateChanged( Tomahawk::DBSyncConnectionState newstate, Tomahawk::DBSyncConnectionState oldstate, const QString& info );
 
@@ -61,19 +74,49 @@ private slots:
 
     void fetchOpsData( const QString& sinceguid );
     void sendOpsData( QString sinceguid, QString lastguid, QList< dbop_ptr > ops );
+    void sendSnapshotChunk( const QByteArray& data, bool last );
+    void snapshotPageLoaded();
+    void onBytesSent( qint64 bytesQueued );
+    void snapshotImported();
+    void snapshotChunkFailed();
     void lastOpApplied();
+    void commandsProgressed();
 
     void check();
 
 private:
+    /**
+     * We have all of the peer's ops, updates the collection stats
+     */
     void synced();
     void changeState( Tomahawk::DBSyncConnectionState newstate );
+    void fetchNextPage();
+    void importSnapshotChunk( const msg_ptr& msg );
+    /**
+     * The snapshot didn't make it in completely, asks for it again
+     */
+    void snapshotFailed();
+    void sendOpsSince( const QString& sinceguid, int window );
+    void loadSnapshotPage();
 
     int m_fetchCount;
+    int m_syncWindow;
+    int m_pageOps; // ops received for the current fetchops request
+    bool m_fetching;
+    bool m_fetchDeferred;
+    bool m_applying; // ops received are being applied
+    bool m_peerSynced; // the peer said "ok" while we applied the ops it sent before
+    bool m_snapshotFailed;
     Tomahawk::source_ptr m_source;
     QVariantMap m_uscache;
 
     QString m_lastSentOp;
+    QString m_snapshotLastop; // lastop of the snapshot being imported
+    QSharedPointer< QAtomicInt > m_snapshotImportFailed; // shared by the chunks of the snapshot being imported
+    int m_snapshotRetries;
+    int m_snapshotWindow; // window of the fetchops request a snapshot is sent for
+    Tomahawk::dbcmd_ptr m_snapshotCmd; // loads the next page of the snapshot we send
+    bool m_snapshotPaused; // until the socket caught up
 
     Tomahawk::DBSyncConnectionState m_state;
 };
@@ -18,6 +18,7 @@
  */
 
 #include "Msg_p.h"
+#include "MsgCodec.h"
 
 #include "utils/Json.h"
 
@@ -36,6 +37,8 @@ Msg::Msg( quint32 len, quint8 flags )
 
 Msg::~Msg()
 {
+    // a copy of a payload sliced from the receive buffer would dangle from here on, see payload()
+    Q_ASSERT( d_ptr->buffer.isNull() || d_ptr->payload.isDetached() );
     delete d_ptr;
 }
 
@@ -48,11 +51,12 @@ Msg::factory( const QByteArray& ba, char f )
 
 
 msg_ptr
-Msg::begin( char* headerToParse )
+Msg::begin( const char* headerToParse )
 {
-    quint32 lenBE = *( (quint32*) headerToParse );
-    quint8 flags = *( (quint8*) (headerToParse+4) );
-    return msg_ptr( new Msg( qFromBigEndian(lenBE), flags ) );
+    // not necessarily aligned, e.g. when parsed straight from the receive buffer
+    quint32 len = qFromBigEndian< quint32 >( (const uchar*) headerToParse );
+    quint8 flags = *( (const quint8*) (headerToParse+4) );
+    return msg_ptr( new Msg( len, flags ) );
 }
 
 
@@ -67,6 +71,18 @@ Msg::fill( const QByteArray& ba )
 }
 
 
+void
+Msg::fill( const QByteArray& buffer, int offset )
+{
+    Q_D( Msg );
+    Q_ASSERT( d->incomplete );
+    Q_ASSERT( offset >= 0 && offset + (qint64)d->length <= buffer.size() );
+    d->buffer = buffer;
+    d->payload = QByteArray::fromRawData( buffer.constData() + offset, d->length );
+    d->incomplete = false;
+}
+
+
 bool
 Msg::write( QIODevice * device )
 {
@@ -124,7 +140,10 @@ Msg::json()
     if( !d->json_parsed )
     {
         bool ok;
-        d->json = TomahawkUtils::parseJson( d->payload, &ok );
+        if ( is( BINARY ) )
+            d->json = MsgCodec::decode( d->payload, &ok );
+        else
+            d->json = TomahawkUtils::parseJson( d->payload, &ok );
         d->json_parsed = true;
     }
     return d->json;
@@ -52,7 +52,7 @@ public:
         COMPRESSED = 8,
         DBOP = 16,
         PING = 32,
-        RESERVED_1 = 64,
+        BINARY = 64, // with JSON: the payload is encoded with MsgCodec, only sent if negotiated during setup
         SETUP = 128 // used to handshake/auth the connection prior to handing over to Connection subclass
     };
 
@@ -66,13 +66,20 @@ public:
     /**
      * constructs an incomplete new msg that is missing the payload data
      */
-    static msg_ptr begin( char* headerToParse );
+    static msg_ptr begin( const char* headerToParse );
 
     /**
      * completes msg construction by providing payload data
      */
     void fill( const QByteArray& ba );
 
+    /**
+     * completes msg construction with the payload at @p offset of @p buffer,
+     * without copying it. The msg keeps a reference to the buffer, so the
+     * owner must not write to it while it is shared, see QByteArray::isDetached().
+     */
+    void fill( const QByteArray& buffer, int offset );
+
     /**
      * frames the msg and writes to the wire:
      */
@@ -85,6 +92,14 @@ public:
 
     bool is( Flag flag );
 
+    /**
+     * May be a slice of the buffer the msg was received in (see fill()),
+     * which is only valid as long as the msg is: a plain copy of it shares
+     * the slice. Keep data beyond that in a deep copy, like
+     * QByteArray( payload.constData(), payload.size() ); mid() and left()
+     * return a plain copy when they cover the whole payload. Debug builds
+     * assert that no plain copy is left when the msg goes away.
+     */
     const QByteArray& payload() const;
 
     QVariant& json();
@@ -0,0 +1,436 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MsgCodec.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QtEndian>
+
+#include <climits>
+#include <cstring>
+
+#define MAX_DEPTH 64
+
+namespace
+{
+
+enum Tag
+{
+    TagNull = 0,
+    TagFalse = 1,
+    TagTrue = 2,
+    TagInt = 3,     // zigzag varint
+    TagDouble = 4,  // 8 bytes, big endian
+    TagString = 5,  // varint length + UTF-8
+    TagBytes = 6,   // varint length + data
+    TagList = 7,    // varint count + values
+    TagMap = 8,     // varint count + (key, value) pairs
+    TagWord = 9     // varint dictionary index
+};
+
+// append only, see MsgCodec.h
+const char* const dictionary[] =
+{
+    // control and dbsync msgs
+    "method", "conntype", "key", "nodeid", "controlid", "port", "offer",
+    "fetchops", "trigger", "lastop", "window", "snapshot", "msgcodec",
+
+    // ops
+    "command", "guid", "addfiles", "deletefiles", "setplaylistrevision", "createplaylist",
+    "deleteplaylist", "renameplaylist", "createdynamicplaylist", "setdynamicplaylistrevision",
+    "deletedynamicplaylist", "logplayback", "socialaction", "setcollectionattributes",
+    "settrackattributes", "sharetrack",
+
+    // files
+    "files", "ids", "deleteAll", "id", "url", "size", "mtime", "hash", "mimetype", "duration",
+    "bitrate", "artist", "albumartist", "album", "track", "albumpos", "composer", "discnumber", "year",
+
+    // playlists
+    "playlistguid", "playlist", "newrev", "oldrev", "orderedguids", "addedentries", "metadataUpdate",
+    "playlistTitle", "title", "info", "creator", "createdOn", "shared", "currentrevision",
+    "query", "annotation", "lastmodified", "resulthint", "addedBy",
+
+    // social actions and playback
+    "action", "comment", "timestamp", "playtime", "secsPlayed", "trackDuration"
+};
+const int dictionarySize = sizeof( dictionary ) / sizeof( dictionary[0] );
+
+
+const QHash< QString, int >&
+dictionaryIndex()
+{
+    static const QHash< QString, int > index = []
+    {
+        QHash< QString, int > h;
+        for ( int i = 0; i < dictionarySize; i++ )
+            h.insert( QString::fromLatin1( dictionary[i] ), i );
+        return h;
+    }();
+
+    return index;
+}
+
+
+void
+writeVarint( QByteArray& out, quint64 v )
+{
+    while ( v >= 0x80 )
+    {
+        out.append( char( ( v & 0x7f ) | 0x80 ) );
+        v >>= 7;
+    }
+    out.append( char( v ) );
+}
+
+
+void
+writeString( QByteArray& out, const QString& s )
+{
+    const QByteArray utf8 = s.toUtf8();
+    writeVarint( out, utf8.size() );
+    out.append( utf8 );
+}
+
+
+void
+writeKey( QByteArray& out, const QString& key )
+{
+    // 0 is followed by the key itself, anything else is dictionary index + 1
+    const int i = dictionaryIndex().value( key, -1 );
+    if ( i >= 0 )
+    {
+        writeVarint( out, i + 1 );
+    }
+    else
+    {
+        writeVarint( out, 0 );
+        writeString( out, key );
+    }
+}
+
+
+void
+writeValue( QByteArray& out, const QVariant& v )
+{
+    switch ( (int)v.type() )
+    {
+        case QVariant::Invalid:
+            out.append( char( TagNull ) );
+            break;
+
+        case QVariant::Bool:
+            out.append( char( v.toBool() ? TagTrue : TagFalse ) );
+            break;
+
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::Long:
+        case QMetaType::ULong:
+        {
+            const qint64 i = v.toLongLong();
+            out.append( char( TagInt ) );
+            writeVarint( out, ( quint64( i ) << 1 ) ^ quint64( i >> 63 ) );
+            break;
+        }
+
+        case QVariant::Double:
+        case QMetaType::Float:
+        {
+            const double d = v.toDouble();
+            quint64 bits;
+            memcpy( &bits, &d, sizeof( bits ) );
+            bits = qToBigEndian( bits );
+
+            out.append( char( TagDouble ) );
+            out.append( (const char*)&bits, sizeof( bits ) );
+            break;
+        }
+
+        case QVariant::ByteArray:
+        {
+            const QByteArray ba = v.toByteArray();
+            out.append( char( TagBytes ) );
+            writeVarint( out, ba.size() );
+            out.append( ba );
+            break;
+        }
+
+        case QVariant::List:
+        case QVariant::StringList:
+        {
+            const QVariantList list = v.toList();
+            out.append( char( TagList ) );
+            writeVarint( out, list.count() );
+            foreach ( const QVariant& item, list )
+                writeValue( out, item );
+            break;
+        }
+
+        case QVariant::Map:
+        {
+            const QVariantMap map = v.toMap();
+            out.append( char( TagMap ) );
+            writeVarint( out, map.count() );
+            for ( QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it )
+            {
+                writeKey( out, it.key() );
+                writeValue( out, it.value() );
+            }
+            break;
+        }
+
+        case QVariant::Hash:
+        {
+            const QVariantHash hash = v.toHash();
+            out.append( char( TagMap ) );
+            writeVarint( out, hash.count() );
+            for ( QVariantHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it )
+            {
+                writeKey( out, it.key() );
+                writeValue( out, it.value() );
+            }
+            break;
+        }
+
+        default:
+        {
+            // strings, and everything the JSON serializer would send as one
+            if ( !v.canConvert< QString >() )
+            {
+                out.append( char( TagNull ) );
+                break;
+            }
+
+            const QString s = v.toString();
+            const int i = dictionaryIndex().value( s, -1 );
+            if ( i >= 0 )
+            {
+                out.append( char( TagWord ) );
+                writeVarint( out, i );
+            }
+            else
+            {
+                out.append( char( TagString ) );
+                writeString( out, s );
+            }
+            break;
+        }
+    }
+}
+
+
+class Reader
+{
+public:
+    Reader( const QByteArray& data )
+        : m_p( data.constData() )
+        , m_end( data.constData() + data.size() )
+        , m_ok( true )
+    {}
+
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_p == m_end; }
+
+    quint64 readVarint()
+    {
+        quint64 v = 0;
+        for ( int shift = 0; m_p < m_end && shift < 64; shift += 7 )
+        {
+            const uchar b = *m_p++;
+            v |= quint64( b & 0x7f ) << shift;
+            if ( !( b & 0x80 ) )
+                return v;
+        }
+
+        m_ok = false;
+        return 0;
+    }
+
+    // length prefixed data, points into the buffer
+    const char* readData( int* length )
+    {
+        const quint64 len = readVarint();
+        if ( !m_ok || len > quint64( m_end - m_p ) )
+        {
+            m_ok = false;
+            *length = 0;
+            return 0;
+        }
+
+        const char* data = m_p;
+        m_p += len;
+        *length = int( len );
+        return data;
+    }
+
+    QString readString()
+    {
+        int len;
+        const char* data = readData( &len );
+        return m_ok ? QString::fromUtf8( data, len ) : QString();
+    }
+
+    QString readWord( quint64 i )
+    {
+        if ( i >= quint64( dictionarySize ) )
+        {
+            m_ok = false;
+            return QString();
+        }
+        return QString::fromLatin1( dictionary[i] );
+    }
+
+    // every element takes up at least one byte
+    int readCount()
+    {
+        const quint64 count = readVarint();
+        if ( !m_ok || count > quint64( m_end - m_p ) )
+        {
+            m_ok = false;
+            return 0;
+        }
+        return int( count );
+    }
+
+    QVariant readValue( int depth )
+    {
+        if ( m_p >= m_end || depth > MAX_DEPTH )
+        {
+            m_ok = false;
+            return QVariant();
+        }
+
+        switch ( *m_p++ )
+        {
+            case TagNull:
+                return QVariant();
+
+            case TagFalse:
+                return false;
+
+            case TagTrue:
+                return true;
+
+            case TagInt:
+            {
+                const quint64 z = readVarint();
+                const qint64 i = qint64( z >> 1 ) ^ -qint64( z & 1 );
+                if ( i >= INT_MIN && i <= INT_MAX )
+                    return int( i );
+                return i;
+            }
+
+            case TagDouble:
+            {
+                if ( m_end - m_p < 8 )
+                {
+                    m_ok = false;
+                    return QVariant();
+                }
+
+                quint64 bits;
+                memcpy( &bits, m_p, sizeof( bits ) );
+                m_p += sizeof( bits );
+                bits = qFromBigEndian( bits );
+
+                double d;
+                memcpy( &d, &bits, sizeof( d ) );
+                return d;
+            }
+
+            case TagString:
+                return readString();
+
+            case TagBytes:
+            {
+                int len;
+                const char* data = readData( &len );
+                return m_ok ? QByteArray( data, len ) : QByteArray();
+            }
+
+            case TagWord:
+                return readWord( readVarint() );
+
+            case TagList:
+            {
+                const int count = readCount();
+                QVariantList list;
+                list.reserve( count );
+                for ( int i = 0; i < count && m_ok; i++ )
+                    list << readValue( depth + 1 );
+                return list;
+            }
+
+            case TagMap:
+            {
+                const int count = readCount();
+                QVariantMap map;
+                for ( int i = 0; i < count && m_ok; i++ )
+                {
+                    const quint64 k = readVarint();
+                    const QString key = k == 0 ? readString() : readWord( k - 1 );
+                    map.insert( key, readValue( depth + 1 ) );
+                }
+                return map;
+            }
+
+            default:
+                m_ok = false;
+                return QVariant();
+        }
+    }
+
+private:
+    const char* m_p;
+    const char* m_end;
+    bool m_ok;
+};
+
+}
+
+
+QByteArray
+MsgCodec::encode( const QVariant& v )
+{
+    QByteArray out;
+    out.append( char( Version ) );
+    writeValue( out, v );
+
+    return out;
+}
+
+
+QVariant
+MsgCodec::decode( const QByteArray& data, bool* ok )
+{
+    Reader reader( data );
+
+    QVariant v;
+    const bool known = reader.readVarint() == Version;
+    if ( known )
+        v = reader.readValue( 0 );
+
+    const bool success = known && reader.ok() && reader.atEnd();
+    if ( ok )
+        *ok = success;
+
+    return success ? v : QVariant();
+}
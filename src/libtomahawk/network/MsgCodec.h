@@ -0,0 +1,54 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+    MsgCodec is a compact binary encoding for the payload of JSON msgs,
+    used instead of JSON text with peers that negotiated it during setup.
+    Such msgs carry the Msg::BINARY flag in addition to Msg::JSON.
+
+    The payload starts with the codec version, followed by one tagged value.
+    Integers are varints, strings are length prefixed UTF-8. Map keys and
+    string values that are common in DB ops and control msgs (property and
+    command names) are sent as an index into a fixed dictionary.
+
+    The dictionary is part of the format: only ever append to it, and bump
+    Version when changing anything else.
+*/
+
+#ifndef MSGCODEC_H
+#define MSGCODEC_H
+
+#include <QByteArray>
+#include <QVariant>
+
+#include "DllMacro.h"
+
+class DLLEXPORT MsgCodec
+{
+public:
+    enum { Version = 1 };
+
+    static QByteArray encode( const QVariant& v );
+
+    /**
+     * Decodes straight from @p data, there is no intermediate copy of the
+     * buffer. Sets @p ok to false and returns a null QVariant if @p data
+     * is malformed or of an unknown version.
+     */
+    static QVariant decode( const QByteArray& data, bool* ok = 0 );
+};
+
+#endif // MSGCODEC_H
@@ -19,18 +19,20 @@
 #include "MsgProcessor.h"
 
 #include "network/Msg_p.h"
+#include "network/MsgCodec.h"
 #include "network/Servent.h"
 #include "utils/Json.h"
 #include "utils/Logger.h"
 #include "utils/TomahawkUtils.h"
 
+#include <QtEndian>
 #include <QThread>
 #include <QFuture>
 #include <QFutureWatcher>
 #include <qtconcurrentrun.h>
 
 MsgProcessor::MsgProcessor( quint32 mode, quint32 t ) :
-    QObject(), m_mode( mode ), m_threshold( t ), m_totmsgsize( 0 )
+    QObject(), m_mode( mode ), m_threshold( t ), m_totmsgsize( 0 ), m_bytesIn( 0 ), m_bytesOut( 0 )
 {
     moveToThread( Servent::instance()->thread() );
 }
@@ -50,10 +52,11 @@ MsgProcessor::append( msg_ptr msg )
     m_msg_ready.insert( msg.data(), false );
 
     m_totmsgsize += msg->payload().length();
+    m_uncompressedLengths.insert( msg.data(), uncompressedLength( msg ) );
 
-    if( m_mode & NOTHING )
+    // skip the round trip through the thread pool for msgs we leave alone anyway, like stream data
+    if( !needsProcessing( msg, m_mode, m_threshold ) )
     {
-        //qDebug() << "MsgProcessor::NOTHING";
         handleProcessedMsg( msg );
         return;
     }
@@ -91,6 +94,9 @@ MsgProcessor::handleProcessedMsg( msg_ptr msg )
         {
             msg_ptr m = m_msgs.takeFirst();
             m_msg_ready.remove( m.data() );
+            // both sizes of the same msg, so already compressed ones don't count as compressed by us
+            m_bytesIn += m_uncompressedLengths.take( m.data() );
+            m_bytesOut += m->length();
             //qDebug() << Q_FUNC_INFO << "totmsgsize:" << m_totmsgsize;
             emit ready( m );
         }
@@ -105,6 +111,31 @@ MsgProcessor::handleProcessedMsg( msg_ptr msg )
 }
 
 
+qint64
+MsgProcessor::uncompressedLength( const msg_ptr& msg )
+{
+    // qCompress() puts the uncompressed length in front
+    const QByteArray& payload = msg->payload();
+    if ( msg->is( Msg::COMPRESSED ) && payload.size() >= 4 )
+        return qFromBigEndian< quint32 >( (const uchar*)payload.constData() );
+
+    return msg->length();
+}
+
+
+bool
+MsgProcessor::needsProcessing( msg_ptr msg, quint32 mode, quint32 threshold )
+{
+    if( (mode & UNCOMPRESS_ALL) && msg->is( Msg::COMPRESSED ) )
+        return true;
+
+    if( (mode & (PARSE_JSON | ENCODE_BINARY)) && msg->is( Msg::JSON ) )
+        return true;
+
+    return (mode & COMPRESS_IF_LARGE) && msg->is( Msg::JSON ) && !msg->is( Msg::COMPRESSED ) && msg->length() > threshold;
+}
+
+
 /// This method is run by QtConcurrent:
 msg_ptr
 MsgProcessor::process( msg_ptr msg, quint32 mode, quint32 threshold )
@@ -116,6 +147,8 @@ MsgProcessor::process( msg_ptr msg, quint32 mode, quint32 threshold )
         msg->d_func()->payload = qUncompress( msg->payload() );
         msg->d_func()->length  = msg->d_func()->payload.length();
         msg->d_func()->flags ^= Msg::COMPRESSED;
+        // no slice of the receive buffer anymore, let the connection reuse it
+        msg->d_func()->buffer.clear();
     }
 
     // parse json payload into qvariant if needed
@@ -125,12 +158,39 @@ MsgProcessor::process( msg_ptr msg, quint32 mode, quint32 threshold )
     {
 //        qDebug() << "MsgProcessor::PARSING JSON";
         bool ok;
-        msg->d_func()->json = TomahawkUtils::parseJson( msg->payload(), &ok );
+        if ( msg->is( Msg::BINARY ) )
+            msg->d_func()->json = MsgCodec::decode( msg->payload(), &ok );
+        else
+            msg->d_func()->json = TomahawkUtils::parseJson( msg->payload(), &ok );
         msg->d_func()->json_parsed = true;
     }
 
+    // transcode JSON, typically ops straight from the oplog, setup msgs stay as they are
+    if( (mode & ENCODE_BINARY) &&
+        msg->is( Msg::JSON ) &&
+        !msg->is( Msg::BINARY ) &&
+        !msg->is( Msg::SETUP ) )
+    {
+        bool ok = true;
+        QVariant v = msg->d_func()->json;
+        if ( !msg->d_func()->json_parsed )
+        {
+            const QByteArray json = msg->is( Msg::COMPRESSED ) ? qUncompress( msg->payload() ) : msg->payload();
+            v = TomahawkUtils::parseJson( json, &ok );
+        }
+
+        if ( ok )
+        {
+            msg->d_func()->payload = MsgCodec::encode( v );
+            msg->d_func()->length  = msg->d_func()->payload.length();
+            msg->d_func()->flags = char( ( msg->d_func()->flags & ~Msg::COMPRESSED ) | Msg::BINARY );
+        }
+    }
+
     // compress if needed
+    // only JSON is worth it, RAW msgs carry audio data or channels of it
     if( (mode & COMPRESS_IF_LARGE) &&
+        msg->is( Msg::JSON ) &&
         !msg->is( Msg::COMPRESSED )
         && msg->length() > threshold )
     {
@@ -33,6 +33,7 @@
 #include "Typedefs.h"
 #include "Msg.h" // Needed because we have msg_ptr in a slot
 
+#include <QHash>
 #include <QObject>
 
 class MsgProcessor : public QObject
@@ -44,17 +45,32 @@ public:
         NOTHING = 0,
         COMPRESS_IF_LARGE = 1,
         UNCOMPRESS_ALL = 2,
-        PARSE_JSON = 4
+        PARSE_JSON = 4,
+        ENCODE_BINARY = 8 // JSON msgs get sent as MsgCodec encoded Msg::BINARY msgs
     };
 
     explicit MsgProcessor( quint32 mode = NOTHING, quint32 t = 512 );
 
     void setMode( quint32 m ) { m_mode = m ; }
+    quint32 mode() const { return m_mode; }
 
     static msg_ptr process( msg_ptr msg, quint32 mode, quint32 threshold );
+    static bool needsProcessing( msg_ptr msg, quint32 mode, quint32 threshold );
 
     int length() const { return m_msgs.length(); }
 
+    /**
+     * Payload bytes of all msgs that came out, uncompressed as they went in
+     * (see uncompressedLength()), and as they came out, e.g. compressed.
+     */
+    qint64 bytesIn() const { return m_bytesIn; }
+    qint64 bytesOut() const { return m_bytesOut; }
+
+    /**
+     * Payload length of @p msg, by what it inflates to if it is compressed
+     */
+    static qint64 uncompressedLength( const msg_ptr& msg );
+
 signals:
     void ready( msg_ptr );
     void empty();
@@ -70,7 +86,10 @@ private:
     quint32 m_threshold;
     QList<msg_ptr> m_msgs;
     QMap< Msg*, bool> m_msg_ready;
+    QHash< Msg*, qint64 > m_uncompressedLengths; // of the msgs in m_msgs, as appended
     unsigned int m_totmsgsize;
+    qint64 m_bytesIn;
+    qint64 m_bytesOut;
 };
 
 #endif // MSGPROCESSOR_H
@@ -51,6 +51,7 @@ public:
 
 private:
     QByteArray payload;
+    QByteArray buffer; // keeps the buffer alive payload points into, if filled from one
     quint32 length;
     char flags;
     bool incomplete;
@@ -0,0 +1,233 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MuxChannel.h"
+
+#include "ControlConnection.h"
+#include "utils/Logger.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+// Bytes in flight per channel and direction
+#define CHANNEL_WINDOW 1048576
+// Largest chunk of channel data we put into one msg of the control connection
+#define MAX_FRAME 65536
+
+
+MuxChannel::MuxChannel( ControlConnection* control, quint32 id )
+    : QTcpSocketExtra()
+    , m_control( control )
+    , m_id( id )
+    , m_closed( false )
+    , m_closing( false )
+    , m_inOffset( 0 )
+    , m_inSize( 0 )
+    , m_consumed( 0 )
+    , m_credit( CHANNEL_WINDOW )
+{
+    if ( !control->socket().isNull() )
+    {
+        setPeerAddress( control->socket()->peerAddress() );
+        setPeerPort( control->socket()->peerPort() );
+        setPeerName( control->socket()->peerName() );
+    }
+
+    setSocketState( QAbstractSocket::ConnectedState );
+    QIODevice::open( QIODevice::ReadWrite | QIODevice::Unbuffered );
+}
+
+
+MuxChannel::~MuxChannel()
+{
+    if ( !m_closed && !m_control.isNull() )
+    {
+        m_control->sendChannelFrame( ControlConnection::ChannelClose, m_id );
+        m_control->removeChannel( m_id );
+    }
+}
+
+
+ControlConnection*
+MuxChannel::controlConnection() const
+{
+    return m_control.data();
+}
+
+
+qint64
+MuxChannel::window()
+{
+    return CHANNEL_WINDOW;
+}
+
+
+void
+MuxChannel::receive( const QByteArray& data )
+{
+    if ( m_closed || data.isEmpty() )
+        return;
+
+    m_in << data;
+    m_inSize += data.size();
+
+    emit readyRead();
+}
+
+
+void
+MuxChannel::grant( qint64 bytes )
+{
+    m_credit += bytes;
+    flush();
+}
+
+
+void
+MuxChannel::remoteClosed()
+{
+    // what we received so far can still be read
+    closeChannel( false );
+}
+
+
+qint64
+MuxChannel::bytesAvailable() const
+{
+    return m_inSize + QIODevice::bytesAvailable();
+}
+
+
+qint64
+MuxChannel::bytesToWrite() const
+{
+    return m_out.size();
+}
+
+
+void
+MuxChannel::close()
+{
+    closeChannel( true );
+    QIODevice::close();
+}
+
+
+void
+MuxChannel::disconnectFromHost()
+{
+    // like a socket, send what is pending first
+    if ( !m_out.isEmpty() && !m_closed && !m_control.isNull() )
+    {
+        m_closing = true;
+        setSocketState( QAbstractSocket::ClosingState );
+        return;
+    }
+
+    closeChannel( true );
+}
+
+
+qint64
+MuxChannel::readData( char* data, qint64 maxSize )
+{
+    qint64 read = 0;
+    while ( read < maxSize && !m_in.isEmpty() )
+    {
+        const QByteArray& chunk = m_in.first();
+        const int n = qMin( qint64( chunk.size() - m_inOffset ), maxSize - read );
+        memcpy( data + read, chunk.constData() + m_inOffset, n );
+
+        read += n;
+        m_inOffset += n;
+        if ( m_inOffset == chunk.size() )
+        {
+            m_in.removeFirst();
+            m_inOffset = 0;
+        }
+    }
+
+    m_inSize -= read;
+    m_consumed += read;
+
+    // let the peer send more once half of its window has been used up
+    if ( m_consumed >= CHANNEL_WINDOW / 2 && !m_closed && !m_control.isNull() )
+    {
+        const quint32 granted = qToBigEndian( quint32( m_consumed ) );
+        m_control->sendChannelFrame( ControlConnection::ChannelGrant, m_id, QByteArray( (const char*)&granted, sizeof( granted ) ) );
+        m_consumed = 0;
+    }
+
+    return read;
+}
+
+
+qint64
+MuxChannel::writeData( const char* data, qint64 maxSize )
+{
+    if ( m_closed || m_closing || m_control.isNull() )
+        return -1;
+
+    m_out.append( data, maxSize );
+    flush();
+
+    return maxSize;
+}
+
+
+void
+MuxChannel::flush()
+{
+    qint64 written = 0;
+    while ( !m_out.isEmpty() && m_credit > 0 && !m_closed && !m_control.isNull() )
+    {
+        const int n = qMin( qint64( m_out.size() ), qMin( m_credit, qint64( MAX_FRAME ) ) );
+        m_control->sendChannelFrame( ControlConnection::ChannelData, m_id, m_out.left( n ) );
+        m_out.remove( 0, n );
+
+        m_credit -= n;
+        written += n;
+    }
+
+    if ( written > 0 )
+        emit bytesWritten( written );
+
+    if ( m_closing && m_out.isEmpty() )
+        closeChannel( true );
+}
+
+
+void
+MuxChannel::closeChannel( bool notifyPeer )
+{
+    if ( m_closed )
+        return;
+
+    m_closed = true;
+    m_closing = false;
+
+    if ( !m_control.isNull() )
+    {
+        if ( notifyPeer )
+            m_control->sendChannelFrame( ControlConnection::ChannelClose, m_id );
+
+        m_control->removeChannel( m_id );
+    }
+
+    setSocketState( QAbstractSocket::UnconnectedState );
+    emit disconnected();
+}
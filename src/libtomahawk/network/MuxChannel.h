@@ -0,0 +1,90 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+    A MuxChannel is a socket that is carried over the ControlConnection to
+    a peer, instead of having a TCP connection of its own. Stream and DB sync
+    connections run over one if the peer supports it, see
+    ControlConnection::openChannel(), without any changes to them.
+
+    Every channel has its own flow control: we only send as much as the
+    peer granted us, and grant it more once the connection on top of the
+    channel read what it received.
+*/
+
+#ifndef MUXCHANNEL_H
+#define MUXCHANNEL_H
+
+#include "QTcpSocketExtra.h"
+
+#include <QList>
+#include <QPointer>
+
+#include "DllMacro.h"
+
+class ControlConnection;
+
+class DLLEXPORT MuxChannel : public QTcpSocketExtra
+{
+Q_OBJECT
+
+public:
+    MuxChannel( ControlConnection* control, quint32 id );
+    virtual ~MuxChannel();
+
+    quint32 channelId() const { return m_id; }
+    ControlConnection* controlConnection() const;
+
+    /**
+     * Bytes we may send before the peer grants more, and the peer may
+     * send us before we do.
+     */
+    static qint64 window();
+
+    // called by the ControlConnection for frames of this channel:
+    void receive( const QByteArray& data );
+    void grant( qint64 bytes );
+    void remoteClosed();
+
+    virtual qint64 bytesAvailable() const;
+    virtual qint64 bytesToWrite() const;
+    virtual bool isSequential() const { return true; }
+    virtual void close();
+    virtual void disconnectFromHost();
+
+protected:
+    virtual qint64 readData( char* data, qint64 maxSize );
+    virtual qint64 writeData( const char* data, qint64 maxSize );
+
+private:
+    void flush();
+    void closeChannel( bool notifyPeer );
+
+    QPointer< ControlConnection > m_control;
+    const quint32 m_id;
+    bool m_closed;
+    bool m_closing; // waiting for the peer to take what we still have to send
+
+    QList< QByteArray > m_in;
+    int m_inOffset; // into m_in.first()
+    qint64 m_inSize;
+    qint64 m_consumed; // read since we last granted the peer more
+
+    QByteArray m_out;
+    qint64 m_credit;
+};
+
+#endif // MUXCHANNEL_H
@@ -38,12 +38,15 @@
 #include "utils/NetworkAccessManager.h"
 #include "utils/NetworkReply.h"
 
+#include "BufferIoDevice.h"
 #include "Connection.h"
 #include "ControlConnection.h"
+#include "MuxChannel.h"
 #include "PortFwdThread.h"
 #include "QTcpSocketExtra.h"
 #include "Source.h"
 #include "SourceList.h"
+#include "StreamBuffer.h"
 #include "StreamConnection.h"
 #include "UrlHandler.h"
 
@@ -56,6 +59,13 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 
+// Number of finished file transfers we keep around
+#define STREAM_CACHE_SIZE 3
+
+// per connection counters that are summed up per peer in Servent::metrics()
+static const char* const s_peerTotals[] = { "bytes_sent", "bytes_received", "bytes_queued", "msgs_sent", "msgs_received",
+                                            "tx_bytes_sec", "rx_bytes_sec", "queue_out", "queue_in", "stalls" };
+
 
 typedef QPair< QList< SipInfo >, Connection* > sipConnectionPair;
 Q_DECLARE_METATYPE( sipConnectionPair )
@@ -723,6 +733,10 @@ Servent::readyRead()
         }
     }
 
+    // channels belong to the control connection they are carried over
+    if ( MuxChannel* channel = qobject_cast< MuxChannel* >( sock.data() ) )
+        cc = channel->controlConnection();
+
     // they connected to us and want something we are offering
     if ( conntype == "accept-offer" || conntype == "push-offer" )
     {
@@ -746,6 +760,8 @@ Servent::readyRead()
         }
         tDebug( LOGVERBOSE ) << "claimOffer OK:" << key << nodeid;
 
+        conn->setPeerFeatures( m );
+
         if ( !nodeid.isEmpty() )
         {
             conn->setId( nodeid );
@@ -774,6 +790,15 @@ void
 Servent::createParallelConnection( Connection* orig_conn, Connection* new_conn, const QString& key )
 {
     tDebug( LOGVERBOSE ) << Q_FUNC_INFO << ", key:" << key << thread() << orig_conn;
+
+    // if they can take it over the connection we already have:
+    ControlConnection* cc = qobject_cast< ControlConnection* >( orig_conn );
+    if ( cc && cc->supportsChannels() )
+    {
+        cc->openChannel( new_conn, key );
+        return;
+    }
+
     // if we can connect to them directly:
     if ( orig_conn && orig_conn->outbound() )
     {
@@ -846,6 +871,20 @@ Servent::handoverSocket( Connection* conn, QTcpSocketExtra* sock )
 }
 
 
+void
+Servent::acceptChannel( QTcpSocketExtra* sock )
+{
+    Q_ASSERT( this->thread() == QThread::currentThread() );
+
+    sock->_disowned = false;
+    sock->_outbound = false;
+
+    // we get the first msg just like from a new socket
+    connect( sock, SIGNAL( readyRead() ), SLOT( readyRead() ) );
+    connect( sock, SIGNAL( disconnected() ), sock, SLOT( deleteLater() ) );
+}
+
+
 void
 Servent::cleanupSocket( QTcpSocketExtra* sock )
 {
@@ -1249,8 +1288,31 @@ void
 Servent::remoteIODeviceFactory( const Tomahawk::result_ptr& result, const QString& url,
                                 std::function< void ( const QString&, QSharedPointer< QIODevice >& ) > callback )
 {
+    Q_D( Servent );
     QSharedPointer<QIODevice> sp;
 
+    {
+        QMutexLocker lock( &d->ftsession_mut );
+        for ( int i = d->streamcache.count() - 1; i >= 0; i-- )
+        {
+            const QSharedPointer< StreamBuffer > buffer = d->streamcache.at( i ).second;
+            if ( d->streamcache.at( i ).first != result->url() || buffer->size() != qint64( result->size() ) )
+                continue;
+
+            tDebug( LOGVERBOSE ) << "Playing" << result->url() << "from the stream cache";
+            d->streamcache.append( d->streamcache.takeAt( i ) );
+
+            sp = QSharedPointer<QIODevice>( new BufferIODevice( buffer ), &QObject::deleteLater );
+            sp->open( QIODevice::ReadOnly );
+            break;
+        }
+    }
+    if ( !sp.isNull() )
+    {
+        callback( result->url(), sp );
+        return;
+    }
+
     QStringList parts = url.mid( QString( "servent://" ).length() ).split( "\t" );
     const QString sourceName = parts.at( 0 );
     const QString fileId = parts.at( 1 );
@@ -1299,6 +1361,102 @@ Servent::onStreamFinished( StreamConnection* sc )
 }
 
 
+void
+Servent::addToStreamCache( const Tomahawk::result_ptr& result, const QSharedPointer< StreamBuffer >& buffer )
+{
+    Q_D( Servent );
+    QMutexLocker lock( &d->ftsession_mut );
+
+    for ( int i = 0; i < d->streamcache.count(); i++ )
+    {
+        if ( d->streamcache.at( i ).first == result->url() )
+        {
+            d->streamcache.removeAt( i );
+            break;
+        }
+    }
+
+    d->streamcache.append( qMakePair( result->url(), buffer ) );
+    while ( d->streamcache.count() > STREAM_CACHE_SIZE )
+        d->streamcache.removeFirst();
+}
+
+
+static void
+addToTotals( QVariantMap& totals, const QVariantMap& m )
+{
+    for ( unsigned int i = 0; i < sizeof( s_peerTotals ) / sizeof( s_peerTotals[0] ); i++ )
+    {
+        const QString key = QString::fromLatin1( s_peerTotals[i] );
+        if ( m.contains( key ) )
+            totals[ key ] = totals.value( key ).toLongLong() + m.value( key ).toLongLong();
+    }
+}
+
+
+QVariantMap
+Servent::metrics()
+{
+    Q_D( Servent );
+    Q_ASSERT( QThread::currentThread() == thread() );
+
+    // connections are only deleted in our thread, so they stay valid without holding the locks
+    QList< ControlConnection* > controls;
+    {
+        QMutexLocker lock( &d->controlconnectionsMutex );
+        controls = d->controlconnections;
+    }
+    QList< StreamConnection* > streams;
+    {
+        QMutexLocker lock( &d->ftsession_mut );
+        streams = d->scsessions;
+    }
+
+    QVariantList peers;
+    foreach ( ControlConnection* cc, controls )
+    {
+        const QVariantMap control = cc->metrics();
+        const QVariantMap dbsync = control.value( "dbsync" ).toMap();
+
+        QVariantMap totals;
+        addToTotals( totals, control );
+        addToTotals( totals, dbsync );
+
+        QVariantList peerStreams;
+        foreach ( StreamConnection* sc, streams )
+        {
+            if ( sc->controlConnection() != cc )
+                continue;
+
+            const QVariantMap stream = sc->metrics();
+            addToTotals( totals, stream );
+            peerStreams << stream;
+            streams.removeOne( sc );
+        }
+
+        QVariantMap peer;
+        peer[ "name" ] = cc->name();
+        peer[ "nodeid" ] = cc->nodeId();
+        peer[ "rtt_ms" ] = control.value( "srtt_ms" );
+        peer[ "sync_lag_ops" ] = dbsync.value( "sync_lag_ops", 0 );
+        peer[ "totals" ] = totals;
+        peer[ "control" ] = control;
+        peer[ "streams" ] = peerStreams;
+        peers << peer;
+    }
+
+    // streams whose control connection is gone already
+    QVariantList otherStreams;
+    foreach ( StreamConnection* sc, streams )
+        otherStreams << sc->metrics();
+
+    QVariantMap m;
+    m[ "peers" ] = peers;
+    m[ "streams" ] = otherStreams;
+    return m;
+}
+
+
 // used for debug output:
 void
 Servent::printCurrentTransfers()
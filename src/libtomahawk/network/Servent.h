@@ -45,6 +45,7 @@ class ProxyConnection;
 class QTcpSocketExtra;
 class RemoteCollectionConnection;
 class SipInfo;
+class StreamBuffer;
 class StreamConnection;
 
 class ServentPrivate;
@@ -99,6 +100,15 @@ public:
     void handleSipInfo( const Tomahawk::peerinfo_ptr& peerInfo );
 
     void initiateConnection( const SipInfo& sipInfo, Connection* conn );
+
+    // transfers ownership of socket to the connection and inits the connection
+    void handoverSocket( Connection* conn, QTcpSocketExtra* sock );
+
+    /**
+     * Treats a channel the peer opened over a ControlConnection like a new
+     * incoming connection.
+     */
+    void acceptChannel( QTcpSocketExtra* sock );
     void reverseOfferRequest( ControlConnection* orig_conn, const QString &theirdbid, const QString& key, const QString& theirkey );
 
     bool visibleExternally() const;
@@ -137,8 +147,20 @@ public:
 
     QList< StreamConnection* > streams() const;
 
+    /**
+     * Keeps the data of a track we just streamed from a peer around for a
+     * while, so playing it again doesn't fetch it again.
+     */
+    void addToStreamCache( const Tomahawk::result_ptr& result, const QSharedPointer< StreamBuffer >& buffer );
+
     bool isReady() const;
 
+    /**
+     * Metrics of all connections, see Connection::metrics(), grouped by the
+     * peer they go to, with totals per peer. Call from the Servent's thread.
+     */
+    Q_INVOKABLE QVariantMap metrics();
+
     QList<SipInfo> getLocalSipInfos(const QString& nodeid, const QString &key);
 
     void queueForAclResult( const QString& username, const QSet<Tomahawk::peerinfo_ptr>& peerInfos );
@@ -185,7 +207,6 @@ private:
     Q_DECLARE_PRIVATE( Servent )
     ServentPrivate* d_ptr;
 
-    void handoverSocket( Connection* conn, QTcpSocketExtra* sock );
     void cleanupSocket( QTcpSocketExtra* sock );
     void printCurrentTransfers();
 
@@ -87,6 +87,8 @@ private:
     // currently active file transfers:
     QList< StreamConnection* > scsessions;
     QMutex ftsession_mut;
+    // recently finished file transfers, most recent last, guarded by ftsession_mut:
+    QList< QPair< QString, QSharedPointer< StreamBuffer > > > streamcache;
     // username -> nodeid -> PeerInfos
     QMap<QString, QMap<QString, QSet<Tomahawk::peerinfo_ptr> > > queuedForACLResult;
 
@@ -0,0 +1,345 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StreamBuffer.h"
+
+#include "utils/Logger.h"
+#include "TomahawkSettings.h"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+
+#include <cstring>
+
+
+StreamBuffer::StreamBuffer( qint64 size, unsigned int blockSize, qint64 memoryBudget )
+    : m_size( size )
+    , m_blockSize( blockSize )
+    , m_received( 0 )
+    , m_memory( 0 )
+    , m_memoryBudget( memoryBudget )
+    , m_clock( 0 )
+    , m_file( 0 )
+    , m_map( 0 )
+    , m_spillFailed( false )
+{
+    if ( m_memoryBudget <= 0 )
+        m_memoryBudget = qint64( TomahawkSettings::instance()->streamBufferMemory() ) * 1024 * 1024;
+}
+
+
+StreamBuffer::~StreamBuffer()
+{
+    // unmaps and removes the file
+    delete m_file;
+}
+
+
+unsigned int
+StreamBuffer::blockSize() const
+{
+    QMutexLocker lock( &m_mutex );
+    return m_blockSize;
+}
+
+
+bool
+StreamBuffer::setBlockSize( unsigned int blockSize )
+{
+    QMutexLocker lock( &m_mutex );
+
+    if ( !m_ranges.isEmpty() || blockSize == 0 )
+        return false;
+
+    m_blockSize = blockSize;
+    return true;
+}
+
+
+int
+StreamBuffer::maxBlocks() const
+{
+    QMutexLocker lock( &m_mutex );
+    return blockCount();
+}
+
+
+int
+StreamBuffer::blockCount() const
+{
+    int i = m_size / m_blockSize;
+
+    if ( ( m_size % m_blockSize ) > 0 )
+        i++;
+
+    return i;
+}
+
+
+int
+StreamBuffer::expectedLength( int block ) const
+{
+    return qMin( qint64( m_blockSize ), m_size - qint64( block ) * m_blockSize );
+}
+
+
+int
+StreamBuffer::spilledLength( int block ) const
+{
+    return m_shortBlocks.value( block, expectedLength( block ) );
+}
+
+
+bool
+StreamBuffer::hasBlock( int block ) const
+{
+    // the last range starting at or before block
+    QMap< int, int >::const_iterator it = m_ranges.upperBound( block );
+    if ( it == m_ranges.constBegin() )
+        return false;
+
+    --it;
+    return block < it.value();
+}
+
+
+void
+StreamBuffer::addBlock( int block, const QByteArray& data )
+{
+    QMutexLocker lock( &m_mutex );
+
+    if ( block < 0 || data.isEmpty() || hasBlock( block ) )
+        return;
+
+    m_blocks.insert( block, data );
+    m_memory += data.size();
+    m_received += data.size();
+    touch( block );
+
+    // join with the adjacent ranges
+    QMap< int, int >::iterator next = m_ranges.upperBound( block );
+    const bool joinsNext = next != m_ranges.end() && next.key() == block + 1;
+    if ( next != m_ranges.begin() && ( next - 1 ).value() == block )
+    {
+        QMap< int, int >::iterator prev = next - 1;
+        prev.value() = joinsNext ? next.value() : block + 1;
+        if ( joinsNext )
+            m_ranges.erase( next );
+    }
+    else if ( joinsNext )
+    {
+        const int end = next.value();
+        m_ranges.erase( next );
+        m_ranges.insert( block, end );
+    }
+    else
+    {
+        m_ranges.insert( block, block + 1 );
+    }
+
+    if ( m_memory > m_memoryBudget )
+        spill();
+}
+
+
+qint64
+StreamBuffer::read( qint64 pos, char* data, qint64 maxSize )
+{
+    QMutexLocker lock( &m_mutex );
+
+    qint64 copied = 0;
+    int block = pos / m_blockSize;
+    int offset = pos % m_blockSize;
+
+    while ( copied < maxSize && hasBlock( block ) )
+    {
+        const char* src;
+        int length;
+
+        QHash< int, QByteArray >::const_iterator it = m_blocks.constFind( block );
+        QByteArray spilled;
+        if ( it != m_blocks.constEnd() )
+        {
+            src = it.value().constData();
+            length = it.value().size();
+            touch( block );
+        }
+        else if ( m_map )
+        {
+            src = (const char*)m_map + qint64( block ) * m_blockSize;
+            length = spilledLength( block );
+        }
+        else
+        {
+            m_file->seek( qint64( block ) * m_blockSize );
+            spilled = m_file->read( spilledLength( block ) );
+            src = spilled.constData();
+            length = spilled.size();
+        }
+
+        if ( offset >= length )
+            break;
+
+        const qint64 n = qMin( qint64( length - offset ), maxSize - copied );
+        memcpy( data + copied, src + offset, n );
+        copied += n;
+
+        block++;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+
+bool
+StreamBuffer::isBlockEmpty( int block ) const
+{
+    QMutexLocker lock( &m_mutex );
+    return !hasBlock( block );
+}
+
+
+int
+StreamBuffer::emptyBlockFrom( int block ) const
+{
+    QMutexLocker lock( &m_mutex );
+
+    const int blocks = blockCount();
+    if ( blocks == 0 )
+        return -1;
+    if ( block < 0 || block >= blocks )
+        block = 0;
+
+    if ( !hasBlock( block ) )
+        return block;
+
+    // the end of the range containing block is the next gap, ranges are never adjacent
+    int end = ( --m_ranges.upperBound( block ) ).value();
+    if ( end < blocks )
+        return end;
+
+    if ( !hasBlock( 0 ) )
+        return 0;
+
+    end = m_ranges.constBegin().value();
+    return end < blocks ? end : -1;
+}
+
+
+bool
+StreamBuffer::isComplete() const
+{
+    QMutexLocker lock( &m_mutex );
+
+    return m_ranges.count() == 1 && m_ranges.constBegin().key() == 0 &&
+           m_ranges.constBegin().value() >= blockCount();
+}
+
+
+qint64
+StreamBuffer::received() const
+{
+    QMutexLocker lock( &m_mutex );
+    return m_received;
+}
+
+
+qint64
+StreamBuffer::memoryUsage() const
+{
+    QMutexLocker lock( &m_mutex );
+    return m_memory;
+}
+
+
+void
+StreamBuffer::touch( int block )
+{
+    QHash< int, quint64 >::iterator it = m_lastUse.find( block );
+    if ( it != m_lastUse.end() )
+    {
+        m_lru.remove( it.value() );
+        it.value() = ++m_clock;
+    }
+    else
+    {
+        m_lastUse.insert( block, ++m_clock );
+    }
+
+    m_lru.insert( m_clock, block );
+}
+
+
+void
+StreamBuffer::spill()
+{
+    // without knowing the size we don't know where blocks go in the file
+    if ( m_size <= 0 || m_spillFailed || ( !m_file && !openSpillFile() ) )
+        return;
+
+    while ( m_memory > m_memoryBudget && !m_lru.isEmpty() )
+    {
+        const int block = m_lru.begin().value();
+        m_lru.erase( m_lru.begin() );
+        m_lastUse.remove( block );
+
+        // A short block in the middle of the file goes to its slot all the
+        // same, we remember its length. What doesn't fit the slot is lost.
+        const QByteArray data = m_blocks.value( block );
+        const int length = qMin( data.size(), expectedLength( block ) );
+
+        const qint64 offset = qint64( block ) * m_blockSize;
+        if ( m_map )
+        {
+            memcpy( m_map + offset, data.constData(), length );
+        }
+        else if ( !m_file->seek( offset ) || m_file->write( data.constData(), length ) != length )
+        {
+            tLog() << Q_FUNC_INFO << "Failed writing to" << m_file->fileName() << m_file->errorString();
+            m_spillFailed = true;
+            return;
+        }
+
+        if ( length != expectedLength( block ) )
+            m_shortBlocks.insert( block, length );
+        m_blocks.remove( block );
+        m_memory -= data.size();
+    }
+}
+
+
+bool
+StreamBuffer::openSpillFile()
+{
+    m_file = new QTemporaryFile( QDir::tempPath() + "/tomahawk-stream-XXXXXX" );
+    if ( !m_file->open() || !m_file->resize( m_size ) )
+    {
+        tLog() << Q_FUNC_INFO << "Can't create file to spill stream buffer to, keeping it in memory:" << m_file->errorString();
+        delete m_file;
+        m_file = 0;
+        m_spillFailed = true;
+        return false;
+    }
+
+    // fall back to reading and writing the file if we can't map it, e.g. out of address space
+    m_map = m_file->map( 0, m_size );
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Spilling stream buffer of" << m_size << "bytes to" << m_file->fileName()
+                         << ( m_map ? "(mapped)" : "(not mapped)" );
+
+    return true;
+}
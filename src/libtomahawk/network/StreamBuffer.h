@@ -0,0 +1,114 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+#include "DllMacro.h"
+
+class QTemporaryFile;
+
+/**
+ * Holds the blocks of a file streamed from a peer, which may arrive in any
+ * order and leave gaps after seeking.
+ *
+ * Which blocks we have is kept as a map of received ranges, so lookups are
+ * O(log n) in the number of gaps. Blocks are kept in memory up to a budget,
+ * beyond that the least recently used ones are moved to a memory mapped
+ * temporary file.
+ *
+ * Threadsafe, it is filled from the network thread and read by the audio engine.
+ */
+class DLLEXPORT StreamBuffer
+{
+public:
+    /**
+     * @p memoryBudget in bytes, 0 means TomahawkSettings::streamBufferMemory()
+     */
+    explicit StreamBuffer( qint64 size, unsigned int blockSize, qint64 memoryBudget = 0 );
+    ~StreamBuffer();
+
+    qint64 size() const { return m_size; }
+
+    unsigned int blockSize() const;
+    /**
+     * Only possible as long as no data was added, returns false otherwise.
+     */
+    bool setBlockSize( unsigned int blockSize );
+
+    int maxBlocks() const;
+
+    void addBlock( int block, const QByteArray& data );
+
+    /**
+     * Copies up to @p maxSize bytes starting at @p pos into @p data, stops
+     * at the first block we don't have. Returns the number of bytes copied.
+     */
+    qint64 read( qint64 pos, char* data, qint64 maxSize );
+
+    bool isBlockEmpty( int block ) const;
+
+    /**
+     * The first block we don't have, starting at @p block and wrapping
+     * around at the end. -1 if we have all of them.
+     */
+    int emptyBlockFrom( int block ) const;
+    bool isComplete() const;
+
+    qint64 received() const;
+    /**
+     * Bytes of the received blocks that are kept in memory, the rest is spilled
+     */
+    qint64 memoryUsage() const;
+
+private:
+    int blockCount() const;
+    bool hasBlock( int block ) const;
+    int expectedLength( int block ) const;
+    int spilledLength( int block ) const;
+    void touch( int block );
+    void spill();
+    bool openSpillFile();
+
+    mutable QMutex m_mutex;
+    const qint64 m_size;
+    unsigned int m_blockSize;
+    qint64 m_received;
+
+    // first block -> one past the last block of each received range
+    QMap< int, int > m_ranges;
+
+    QHash< int, QByteArray > m_blocks;
+    qint64 m_memory;
+    qint64 m_memoryBudget;
+
+    // least recently used blocks first
+    QMap< quint64, int > m_lru;
+    QHash< int, quint64 > m_lastUse;
+    quint64 m_clock;
+
+    QTemporaryFile* m_file;
+    uchar* m_map;
+    bool m_spillFailed;
+    QHash< int, int > m_shortBlocks; // spilled blocks not of the expected length
+};
+
+#endif // STREAMBUFFER_H
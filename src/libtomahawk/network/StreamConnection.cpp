@@ -27,6 +27,7 @@
 #include "utils/Logger.h"
 
 #include "BufferIoDevice.h"
+#include "StreamBuffer.h"
 #include "Msg.h"
 #include "MsgProcessor.h"
 #include "Result.h"
@@ -34,7 +35,15 @@
 #include "UrlHandler.h"
 
 #include <QFile>
-#include <QTimer>
+
+// Largest block size we offer peers, each block is sent as one msg
+#define MAX_BLOCKSIZE 65536
+// Blocks we hand to the socket ahead of what it has actually written
+#define SEND_WINDOW 8
+// Seconds of audio we try to have received ahead of the playback position
+#define READ_AHEAD_SECS 10
+// Read-ahead if we don't know the bitrate, about 10 seconds of lossless audio
+#define READ_AHEAD_DEFAULT 1048576
 
 using namespace Tomahawk;
 
@@ -45,6 +54,8 @@ StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString f
     , m_fid( fid )
     , m_type( RECEIVING )
     , m_curBlock( 0 )
+    , m_blockSize( BufferIODevice::defaultBlockSize() )
+    , m_sentAll( false )
     , m_badded( 0 )
     , m_bsent( 0 )
     , m_allok( false )
@@ -54,6 +65,7 @@ StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString f
     qDebug() << Q_FUNC_INFO;
 
     BufferIODevice* bio = new BufferIODevice( result->size() );
+    bio->setReadAhead( result->bitrate() > 0 ? qint64( result->bitrate() ) * 1000 / 8 * READ_AHEAD_SECS : READ_AHEAD_DEFAULT );
     m_iodev = QSharedPointer<QIODevice>( bio, &QObject::deleteLater ); // device audio data gets written to
     m_iodev->open( QIODevice::ReadWrite );
 
@@ -78,6 +90,9 @@ StreamConnection::StreamConnection( Servent* s, ControlConnection* cc, QString f
     , m_cc( cc )
     , m_fid( fid )
     , m_type( SENDING )
+    , m_curBlock( 0 )
+    , m_blockSize( BufferIODevice::defaultBlockSize() )
+    , m_sentAll( false )
     , m_badded( 0 )
     , m_bsent( 0 )
     , m_allok( false )
@@ -103,6 +118,10 @@ StreamConnection::~StreamConnection()
         if ( !m_iodev.isNull() )
             ((BufferIODevice*)m_iodev.data())->inputComplete();
     }
+    else if ( m_type == RECEIVING && ( (BufferIODevice*)m_iodev.data() )->buffer()->isComplete() )
+    {
+        Servent::instance()->addToStreamCache( m_result, ( (BufferIODevice*)m_iodev.data() )->buffer() );
+    }
 
     Servent::instance()->onStreamFinished( this );
 }
@@ -139,6 +158,34 @@ StreamConnection::showStats( qint64 tx, qint64 rx )
 }
 
 
+QVariantMap
+StreamConnection::metrics() const
+{
+    QVariantMap m = Connection::metrics();
+    m[ "id" ] = id();
+    m[ "direction" ] = m_type == RECEIVING ? "receiving" : "sending";
+    m[ "block_size" ] = m_blockSize;
+    m[ "complete" ] = m_allok;
+
+    if ( !m_result.isNull() )
+        m[ "size" ] = m_result->size();
+
+    BufferIODevice* bio = qobject_cast< BufferIODevice* >( m_iodev.data() );
+    m[ "stalls" ] = bio ? bio->stalls() : 0;
+
+    return m;
+}
+
+
+QVariantMap
+StreamConnection::features() const
+{
+    QVariantMap f = Connection::features();
+    f.insert( "blocksize", MAX_BLOCKSIZE );
+    return f;
+}
+
+
 void
 StreamConnection::setup()
 {
@@ -156,15 +203,23 @@ StreamConnection::setup()
         }
     }
 
+    // peers that don't know about larger blocks stick to the default
+    if ( feature( "blocksize" ) > 0 )
+        m_blockSize = feature( "blocksize" );
+
     connect( this, SIGNAL( statsTick( qint64, qint64 ) ), SLOT( showStats( qint64, qint64 ) ) );
     if ( m_type == RECEIVING )
     {
-        qDebug() << "in RX mode";
+        qDebug() << "in RX mode, block size:" << m_blockSize;
+        ( (BufferIODevice*)m_iodev.data() )->setBlockSize( m_blockSize );
         emit updated();
         return;
     }
 
-    qDebug() << "in TX mode, fid:" << m_fid;
+    qDebug() << "in TX mode, fid:" << m_fid << "block size:" << m_blockSize;
+
+    // keep the socket busy, but don't buffer the whole file in it
+    connect( socket().data(), SIGNAL( bytesWritten( qint64 ) ), SLOT( sendSome() ), Qt::QueuedConnection );
 
     DatabaseCommand_LoadFiles* cmd = new DatabaseCommand_LoadFiles( m_fid.toUInt() );
     connect( cmd, SIGNAL( result( Tomahawk::result_ptr ) ), SLOT( startSending( Tomahawk::result_ptr ) ) );
@@ -207,6 +262,7 @@ StreamConnection::reallyStartSending( const Tomahawk::result_ptr result, const Q
     }
 
     m_readdev = QSharedPointer<QIODevice>( io );
+    connect( m_readdev.data(), SIGNAL( readyRead() ), SLOT( sendSome() ) );
     sendSome();
 
     emit updated();
@@ -221,7 +277,8 @@ StreamConnection::handleMsg( msg_ptr msg )
     if ( msg->payload().startsWith( "block" ) )
     {
         int block = QString( msg->payload() ).mid( 5 ).toInt();
-        m_readdev->seek( block * BufferIODevice::blockSize() );
+        m_readdev->seek( qint64( block ) * m_blockSize );
+        m_sentAll = false;
 
         qDebug() << "Seeked to block:" << block;
 
@@ -229,7 +286,7 @@ StreamConnection::handleMsg( msg_ptr msg )
         sm.append( QString( "doneblock%1" ).arg( block ) );
 
         sendMsg( Msg::factory( sm, Msg::RAW | Msg::FRAGMENT ) );
-        QTimer::singleShot( 0, this, SLOT( sendSome() ) );
+        sendSome();
     }
     else if ( msg->payload().startsWith( "doneblock" ) )
     {
@@ -274,24 +331,33 @@ StreamConnection::sendSome()
 {
     Q_ASSERT( m_type == StreamConnection::SENDING );
 
-    QByteArray ba = "data";
-    ba.append( m_readdev->read( BufferIODevice::blockSize() ) );
-    m_bsent += ba.length() - 4;
-
-    if ( m_readdev->atEnd() )
-    {
-        sendMsg( Msg::factory( ba, Msg::RAW ) );
+    // called for every chunk the socket wrote, so also before we started and after we're done
+    if ( m_readdev.isNull() || m_sentAll )
         return;
-    }
-    else
+
+    // HINT: this is where upload throttling could be implemented, by limiting the window
+    qint64 window = qint64( SEND_WINDOW ) * m_blockSize - bytesQueued();
+    while ( window > 0 )
     {
+        const QByteArray data = m_readdev->read( m_blockSize );
+        if ( data.isEmpty() && !m_readdev->atEnd() )
+            return; // sequential source, wait for its readyRead()
+
+        QByteArray ba = "data";
+        ba.append( data );
+        m_bsent += ba.length() - 4;
+        window -= ba.length() + Msg::headerSize();
+
+        if ( m_readdev->atEnd() )
+        {
+            m_sentAll = true;
+            sendMsg( Msg::factory( ba, Msg::RAW ) );
+            return;
+        }
+
         // more to come -> FRAGMENT
         sendMsg( Msg::factory( ba, Msg::RAW | Msg::FRAGMENT ) );
     }
-
-    // HINT: change the 0 to 50 to transmit at 640Kbps, for example
-    //       (this is where upload throttling could be implemented)
-    QTimer::singleShot( 0, this, SLOT( sendSome() ) );
 }
 
 
@@ -300,7 +366,8 @@ StreamConnection::onBlockRequest( int block )
 {
     qDebug() << Q_FUNC_INFO << block;
 
-    if ( m_curBlock == block )
+    // the transfer is already heading there, or got there meanwhile
+    if ( m_curBlock == block || !( (BufferIODevice*)m_iodev.data() )->isBlockEmpty( block ) )
         return;
 
     QByteArray sm;
@@ -65,9 +65,17 @@ public:
     Type type() const { return m_type; }
     QString fid() const { return m_fid; }
 
+    /**
+     * Adds how often playback ran out of received data, for RX.
+     */
+    virtual QVariantMap metrics() const;
+
 signals:
     void updated();
 
+protected:
+    virtual QVariantMap features() const;
+
 protected slots:
     virtual void handleMsg( msg_ptr msg );
 
@@ -87,6 +95,8 @@ private:
     QSharedPointer<QIODevice> m_readdev;
 
     int m_curBlock;
+    unsigned int m_blockSize;
+    bool m_sentAll;
 
     int m_badded, m_bsent;
     bool m_allok; // got last msg ok, transfer complete?
@@ -35,7 +35,6 @@
 
 TreeProxyModel::TreeProxyModel( QObject* parent )
     : PlayableProxyModel( parent )
-    , m_artistsFilterCmd( 0 )
     , m_model( 0 )
 {
     setPlaylistInterface( Tomahawk::playlistinterface_ptr( new Tomahawk::TreeProxyModelPlaylistInterface( this ) ) );
@@ -81,6 +80,7 @@ TreeProxyModel::onRowsInserted( const QModelIndex& parent, int /* start */, int
         cmd = new Tomahawk::DatabaseCommand_AllAlbums( Tomahawk::collection_ptr(), pi->artist() );
 
     cmd->setFilter( m_filter );
+    cmd->setRequester( this );
 
     connect( dynamic_cast< QObject* >( cmd ), SIGNAL( albums( QList<Tomahawk::album_ptr> ) ),
              SLOT( onFilterAlbums( QList<Tomahawk::album_ptr> ) ) );
@@ -111,10 +111,9 @@ TreeProxyModel::setFilter( const QString& pattern )
 
     if ( m_artistsFilterCmd )
     {
-        disconnect( dynamic_cast< QObject* >( m_artistsFilterCmd ), SIGNAL( artists( QList<Tomahawk::artist_ptr> ) ),
+        disconnect( m_artistsFilterCmd, SIGNAL( artists( QList<Tomahawk::artist_ptr> ) ),
                     this, SLOT( onFilterArtists( QList<Tomahawk::artist_ptr> ) ) );
 
-        delete m_artistsFilterCmd;
         m_artistsFilterCmd = 0;
     }
 
@@ -131,7 +130,8 @@ TreeProxyModel::setFilter( const QString& pattern )
             cmd = new Tomahawk::DatabaseCommand_AllArtists(); //for SuperCollection, TODO: replace with a proper proxy-ArtistsRequest
 
         cmd->setFilter( pattern );
-        m_artistsFilterCmd = cmd;
+        cmd->setRequester( this );
+        m_artistsFilterCmd = dynamic_cast< QObject* >( cmd );
 
         connect( dynamic_cast< QObject* >( cmd ), SIGNAL( artists( QList<Tomahawk::artist_ptr> ) ),
                  SLOT( onFilterArtists( QList<Tomahawk::artist_ptr> ) ) );
@@ -164,6 +164,7 @@ TreeProxyModel::onFilterArtists( const QList<Tomahawk::artist_ptr>& artists )
 
             Tomahawk::AlbumsRequest* cmd = m_model->collection()->requestAlbums( artist );
             cmd->setFilter( m_filter );
+            cmd->setRequester( this );
 
             connect( dynamic_cast< QObject* >( cmd ), SIGNAL( albums( QList<Tomahawk::album_ptr> ) ),
                      SLOT( onFilterAlbums( QList<Tomahawk::album_ptr> ) ) );
@@ -194,10 +195,9 @@ TreeProxyModel::filterFinished()
 {
     if ( m_artistsFilterCmd )
     {
-        disconnect( dynamic_cast< QObject* >( m_artistsFilterCmd ), SIGNAL( artists( QList<Tomahawk::artist_ptr> ) ),
+        disconnect( m_artistsFilterCmd, SIGNAL( artists( QList<Tomahawk::artist_ptr> ) ),
                     this, SLOT( onFilterArtists( QList<Tomahawk::artist_ptr> ) ) );
 
-        delete m_artistsFilterCmd;
         m_artistsFilterCmd = 0;
     }
 
@@ -75,7 +75,8 @@ private:
 
     QList<Tomahawk::artist_ptr> m_artistsFilter;
     QList<Tomahawk::album_ptr> m_albumsFilter;
-    Tomahawk::ArtistsRequest* m_artistsFilterCmd;
+    // owned by the collection or the database, which drop it once it is done
+    QPointer< QObject > m_artistsFilterCmd;
 
     QString m_filter;
     QPointer<TreeModel> m_model;
@@ -20,6 +20,8 @@
 
 #include "../utils/Json.h"
 #include "../utils/Logger.h"
+#include "JSCallBridge.h"
+#include "JSContext.h"
 #include "ScriptEngine.h"
 #include "ScriptJob.h"
 #include "ScriptObject.h"
@@ -31,17 +33,61 @@
 
 using namespace Tomahawk;
 
-JSAccount::JSAccount( const QString& name )
+JSAccount::JSAccount( const QString& name, Runtime runtime )
     : ScriptAccount( name )
-    , m_engine( new ScriptEngine( this ) )
+    , m_engine( 0 )
+    , m_bridge( 0 )
+    , m_lastRequestId( 0 )
 {
+    if ( runtime == WebKitRuntime )
+    {
+        m_engine = new ScriptEngine( this );
+        m_bridge = new JSCallBridge( this );
+        connect( m_engine->mainFrame(), SIGNAL( javaScriptWindowObjectCleared() ), SLOT( exposeCallBridge() ) );
+        exposeCallBridge();
+    }
+    else
+    {
+        // runs in a thread of its own, or the one of the shared engine, and brings its own bridge
+        m_channel = QSharedPointer< JSContextChannel >( new JSContextChannel() );
+        new JSContext( name, runtime == SharedRuntime, m_channel );
+    }
+}
+
+
+JSAccount::~JSAccount()
+{
+    if ( m_channel )
+        m_channel->deleteContext();
+}
+
+
+JSAccount::Runtime
+JSAccount::runtimeFromName( const QString& name )
+{
+    if ( name == "headless" )
+        return HeadlessRuntime;
+    if ( name == "shared" )
+        return SharedRuntime;
+
+    return WebKitRuntime;
+}
+
+
+void
+JSAccount::exposeCallBridge()
+{
+    addToJavaScriptWindowObject( "TomahawkCallBridge", m_bridge );
 }
 
 
 void
 JSAccount::addToJavaScriptWindowObject( const QString& name, QObject* object )
 {
-    m_engine->mainFrame()->addToJavaScriptWindowObject( name, object );
+    if ( m_channel )
+        m_channel->post( "addObject", Q_ARG( QString, name ), Q_ARG( QObject*, object ) );
+    else
+        m_engine->mainFrame()->addToJavaScriptWindowObject( name, object );
 }
 
 
@@ -71,12 +117,28 @@ void
 JSAccount::showDebugger()
 {
     tLog() << Q_FUNC_INFO << name() << "Show debugger";
+
+    if ( m_channel )
+    {
+        tLog() << Q_FUNC_INFO << name() << "There is no debugger for scripts outside of WebKit";
+        return;
+    }
+
     m_engine->showWebInspector();
 }
 
 
 QString
 JSAccount::serializeQVariantMap( const QVariantMap& map )
+{
+    QByteArray serialized = TomahawkUtils::toJson( scriptArguments( map ) );
+
+    return QString( "JSON.parse('%1')" ).arg( JSAccount::escape( QString::fromUtf8( serialized ) ) );
+}
+
+
+QVariantMap
+JSAccount::scriptArguments( const QVariantMap& map )
 {
     QVariantMap localMap = map;
 
@@ -91,9 +153,7 @@ JSAccount::serializeQVariantMap( const QVariantMap& map )
         }
     }
 
-    QByteArray serialized = TomahawkUtils::toJson( localMap );
-
-    return QString( "JSON.parse('%1')" ).arg( JSAccount::escape( QString::fromUtf8( serialized ) ) );
+    return localMap;
 }
 
 
@@ -119,8 +179,15 @@ JSAccount::loadScript( const QString& path )
 
     const QByteArray contents = file.readAll();
 
-    m_engine->setScriptPath( path );
-    m_engine->mainFrame()->evaluateJavaScript( contents );
+    if ( m_channel )
+    {
+        m_channel->post( "loadScript", Q_ARG( QString, path ), Q_ARG( QString, QString::fromUtf8( contents ) ) );
+    }
+    else
+    {
+        m_engine->setScriptPath( path );
+        m_engine->mainFrame()->evaluateJavaScript( contents );
+    }
 
     file.close();
 }
@@ -139,84 +206,117 @@ JSAccount::loadScripts( const QStringList& paths )
 void
 JSAccount::startJob( ScriptJob* scriptJob )
 {
-    QString eval = QString(
-        "Tomahawk.PluginManager.invoke("
-        "'%1'," // requestId
-        "'%2'," // objectId
-        "'%3'," // methodName
-        "%4"    // arguments
-        ");"
-    ).arg( scriptJob->id() )
-    .arg( scriptJob->scriptObject()->id() )
-    .arg( scriptJob->methodName() )
-    .arg( serializeQVariantMap( scriptJob->arguments() ) );
-
     // Remove when new scripting api turned out to work reliably
-    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << eval;
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << scriptJob->id() << scriptJob->scriptObject()->id() << scriptJob->methodName();
+
+    QVariantMap call;
+    call[ "type" ] = "invoke";
+    call[ "requestId" ] = scriptJob->id();
+    call[ "objectId" ] = scriptJob->scriptObject()->id();
+    call[ "methodName" ] = scriptJob->methodName();
+    call[ "params" ] = scriptArguments( scriptJob->arguments() );
 
-    evaluateJavaScript( eval );
+    queueCall( call );
 }
 
 
 QVariant
 JSAccount::syncInvoke( const scriptobject_ptr& scriptObject, const QString& methodName, const QVariantMap& arguments )
 {
-    QString eval = QString(
-        "Tomahawk.PluginManager.invokeSync("
-        "0, " // requestId
-        "'%1'," // objectId
-        "'%2'," // methodName
-        "%3"    // arguments
-        ");"
-    ).arg( scriptObject->id() )
-    .arg( methodName )
-    .arg( serializeQVariantMap( arguments ) );
+    Q_ASSERT( QThread::currentThread() == thread() );
 
     // Remove when new scripting api turned out to work reliably
-    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << eval;
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << scriptObject->id() << methodName;
+
+    // keep the order of the calls the script sees
+    flushCalls();
+
+    QVariantMap call;
+    call[ "objectId" ] = scriptObject->id();
+    call[ "methodName" ] = methodName;
+    call[ "params" ] = scriptArguments( arguments );
 
-    return evaluateJavaScriptWithResult( eval );
+    if ( m_channel )
+        return m_channel->call( "syncCall", ++m_lastRequestId, Q_ARG( QVariantMap, call ) );
+
+    // handled right away, the script hands the result back before we return
+    emit m_bridge->syncCall( call );
+    return m_bridge->takeSyncResult();
 }
 
+
 void
 JSAccount::reportNativeScriptJobResult( int resultId, const QVariantMap& result )
 {
-    QString eval = QString(
-        "Tomahawk.NativeScriptJobManager.reportNativeScriptJobResult("
-        "%1," // requestId
-        "%2"    // results
-        ");"
-    ).arg( resultId )
-    .arg( serializeQVariantMap( result ) );
-
     // Remove when new scripting api turned out to work reliably
-    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << eval;
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << resultId;
 
-    evaluateJavaScript( eval );
+    QVariantMap call;
+    call[ "type" ] = "result";
+    call[ "requestId" ] = resultId;
+    call[ "data" ] = scriptArguments( result );
+
+    queueCall( call );
 }
 
 
 void
 JSAccount::reportNativeScriptJobError( int resultId, const QVariantMap& error )
 {
-    QString eval = QString(
-        "Tomahawk.NativeScriptJobManager.reportNativeScriptJobError("
-        "%1," // requestId
-        "%2"    // results
-        ");"
-    ).arg( resultId )
-    .arg( serializeQVariantMap( error ) );
-
     // Remove when new scripting api turned out to work reliably
-    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << eval;
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << resultId;
 
-    evaluateJavaScript( eval );
+    QVariantMap call;
+    call[ "type" ] = "error";
+    call[ "requestId" ] = resultId;
+    call[ "data" ] = scriptArguments( error );
+
+    queueCall( call );
+}
+
+
+void
+JSAccount::queueCall( const QVariantMap& call )
+{
+    if ( QThread::currentThread() != thread() )
+    {
+        QMetaObject::invokeMethod( this, "queueCall", Qt::QueuedConnection, Q_ARG( QVariantMap, call ) );
+        return;
+    }
+
+    // whatever else gets queued before we are back in the event loop goes along
+    if ( m_pendingCalls.isEmpty() )
+        QMetaObject::invokeMethod( this, "flushCalls", Qt::QueuedConnection );
+
+    m_pendingCalls << call;
+}
+
+
+void
+JSAccount::flushCalls()
+{
+    if ( m_pendingCalls.isEmpty() )
+        return;
+
+    QVariantList calls;
+    calls.swap( m_pendingCalls );
+
+    if ( m_channel )
+        m_channel->post( "calls", Q_ARG( QVariantList, calls ) );
+    else
+        emit m_bridge->calls( calls );
 }
 
 
 QVariant
 JSAccount::evaluateJavaScriptInternal( const QString& scriptSource )
 {
+    // calls queued earlier go first
+    flushCalls();
+
+    if ( m_channel )
+        return m_channel->call( "evaluate", ++m_lastRequestId, Q_ARG( QString, scriptSource ) );
+
     return m_engine->mainFrame()->evaluateJavaScript( scriptSource );
 }
 
@@ -230,6 +330,14 @@ JSAccount::evaluateJavaScript( const QString& scriptSource )
         return;
     }
 
+    if ( m_channel )
+    {
+        // nobody waits for the result
+        flushCalls();
+        m_channel->post( "evaluate", Q_ARG( int, 0 ), Q_ARG( QString, scriptSource ) );
+        return;
+    }
+
     evaluateJavaScriptInternal( scriptSource );
 }
 
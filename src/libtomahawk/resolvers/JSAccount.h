@@ -24,6 +24,7 @@
 
 #include <QVariantMap>
 #include <QObject>
+#include <QSharedPointer>
 
 //TODO: pimple
 #include <memory>
@@ -35,24 +36,39 @@ namespace Tomahawk
 //TODO: pimple
 class ScriptEngine;
 class JSResolver;
+class JSCallBridge;
+class JSContextChannel;
 
 class DLLEXPORT JSAccount : public ScriptAccount
 {
     Q_OBJECT
 
 public:
-    JSAccount( const QString& name );
+    /**
+     * Where the scripts run: a WebKit page, a QJSEngine of their own, or the
+     * QJSEngine shared by all accounts with SharedRuntime, see JSContext
+     */
+    enum Runtime { WebKitRuntime, HeadlessRuntime, SharedRuntime };
+
+    JSAccount( const QString& name, Runtime runtime = WebKitRuntime );
+    virtual ~JSAccount();
+
+    /**
+     * The Runtime for "webkit", "headless" or "shared", WebKitRuntime for anything else
+     */
+    static Runtime runtimeFromName( const QString& name );
 
     void startJob( ScriptJob* scriptJob ) override;
     QVariant syncInvoke( const scriptobject_ptr& scriptObject, const QString& methodName, const QVariantMap& arguments ) override;
 
     /**
-    *  Evaluate JavaScript on the WebKit thread
+    *  Evaluate JavaScript on the WebKit thread, or hand it to the JSContext
     */
     Q_INVOKABLE void evaluateJavaScript( const QString& scriptSource );
 
     /**
-    * This method must be called from the WebKit thread
+    * This method must be called from the WebKit thread, it blocks until the
+    * JSContext is done, see JSContextChannel
     */
     QVariant evaluateJavaScriptWithResult( const QString& scriptSource );
 
@@ -76,13 +92,36 @@ public:
     void reportNativeScriptJobResult( int resultId, const QVariantMap& result ) override;
     void reportNativeScriptJobError( int resultId, const QVariantMap& error ) override;
 
+private slots:
+    void exposeCallBridge();
+
 private:
     /**
         * Wrap the pure evaluateJavaScript call in here, while the threadings guards are in public methods
         */
     QVariant evaluateJavaScriptInternal( const QString& scriptSource );
 
+    /**
+     * Queues @p call for the script, all calls queued until we get back to
+     * the event loop are handed over together, see JSCallBridge
+     */
+    Q_INVOKABLE void queueCall( const QVariantMap& call );
+    Q_INVOKABLE void flushCalls();
+
+    /**
+     * Drops values that can't be handed to the script
+     */
+    static QVariantMap scriptArguments( const QVariantMap& map );
+
+    // one of them, depending on the Runtime
     ScriptEngine* m_engine;
+    QSharedPointer< JSContextChannel > m_channel;
+
+    // WebKitRuntime only, a JSContext has its own
+    JSCallBridge* m_bridge;
+
+    int m_lastRequestId;
+    QVariantList m_pendingCalls;
     // HACK: the order of initializen is flawed, tbr
     JSResolver* m_resolver;
 };
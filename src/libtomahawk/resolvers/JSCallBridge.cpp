@@ -0,0 +1,48 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "JSCallBridge.h"
+
+#include <QJSValue>
+
+using namespace Tomahawk;
+
+
+JSCallBridge::JSCallBridge( QObject* parent )
+    : QObject( parent )
+{
+}
+
+
+QVariant
+JSCallBridge::takeSyncResult()
+{
+    QVariant result = m_syncResult;
+    m_syncResult = QVariant();
+    return result;
+}
+
+
+void
+JSCallBridge::setSyncResult( const QVariant& result )
+{
+    // a QJSEngine hands us objects as they are, WebKit converts them to maps
+    if ( result.userType() == qMetaTypeId< QJSValue >() )
+        m_syncResult = result.value< QJSValue >().toVariant();
+    else
+        m_syncResult = result;
+}
@@ -0,0 +1,63 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TOMAHAWK_JSCALLBRIDGE_H
+#define TOMAHAWK_JSCALLBRIDGE_H
+
+#include <QObject>
+#include <QVariantList>
+#include <QVariantMap>
+
+namespace Tomahawk
+{
+
+/**
+ * Hands calls from native code to the script as plain values, instead of
+ * building script source for each of them. It is added to the script's
+ * window as TomahawkCallBridge, tomahawk.js connects to its signals.
+ */
+class JSCallBridge : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JSCallBridge( QObject* parent = 0 );
+
+    /**
+     * The value the script passed to setSyncResult() for the last syncCall(),
+     * invalid if it didn't.
+     */
+    QVariant takeSyncResult();
+
+public slots:
+    // called from JavaScript
+    void setSyncResult( const QVariant& result );
+
+signals:
+    /**
+     * A batch of calls, each a map with a "type" of "invoke", "result" or "error".
+     */
+    void calls( const QVariantList& calls );
+    void syncCall( const QVariantMap& call );
+
+private:
+    QVariant m_syncResult;
+};
+
+}
+
+#endif // TOMAHAWK_JSCALLBRIDGE_H
@@ -0,0 +1,930 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "JSContext.h"
+
+#include "utils/Logger.h"
+#include "config.h"
+#include "JSCallBridge.h"
+#include "JSLocalStorage.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QJSEngine>
+#include <QMetaMethod>
+#include <QQmlEngine>
+#include <QRegExp>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTimer>
+#include <QTimerEvent>
+
+// Scripts in here don't depend on the context, the shared engine loads them once
+#define SHARED_LIBRARIES RESPATH "js/cryptojs"
+// QMetaMethod::invoke() takes no more
+#define MAX_ARGUMENTS 10
+// Where openDatabase() keeps its databases, in the app data dir
+#define SCRIPT_DATABASES "scriptdatabases"
+
+using namespace Tomahawk;
+
+// SHARED_LIBRARIES loaded into the shared engine so far
+static QSet< QString > s_libraries;
+
+// What the scripts expect to find in a browser window, called with the
+// window and the context
+static const char* s_windowSetup =
+    "(function (window, host) {\n"
+    "    window.window = window;\n"
+    "    window.console = {\n"
+    "        log: function () {\n"
+    "            host.log(Array.prototype.join.call(arguments, ' '));\n"
+    "        }\n"
+    "    };\n"
+    "    window.console.debug = window.console.info = window.console.warn = window.console.error = window.console.log;\n"
+    "    window.setTimeout = function (callback, msecs) {\n"
+    "        var args = Array.prototype.slice.call(arguments, 2);\n"
+    "        return host.addTimer(function () { callback.apply(window, args); }, msecs || 0, false);\n"
+    "    };\n"
+    "    window.setInterval = function (callback, msecs) {\n"
+    "        var args = Array.prototype.slice.call(arguments, 2);\n"
+    "        return host.addTimer(function () { callback.apply(window, args); }, msecs || 0, true);\n"
+    "    };\n"
+    "    window.clearTimeout = window.clearInterval = function (id) {\n"
+    "        host.removeTimer(id || 0);\n"
+    "    };\n"
+    "    window.atob = function (data) { return host.atob(data); };\n"
+    "    window.btoa = function (data) { return host.btoa(data); };\n"
+    "    var localStorage = {\n"
+    "        getItem: function (key) {\n"
+    "            var value = host.storageItem(String(key));\n"
+    "            return value === undefined ? null : value;\n"
+    "        },\n"
+    "        setItem: function (key, value) { host.setStorageItem(String(key), String(value)); },\n"
+    "        removeItem: function (key) { host.removeStorageItem(String(key)); },\n"
+    "        clear: function () { host.clearStorage(); }\n"
+    "    };\n"
+    // scripts use localStorage like a plain object, too
+    "    window.localStorage = typeof Proxy === 'undefined' ? localStorage : new Proxy(localStorage, {\n"
+    "        get: function (target, key) {\n"
+    "            if (target.hasOwnProperty(key)) {\n"
+    "                return target[key];\n"
+    "            }\n"
+    "            var value = target.getItem(key);\n"
+    "            return value === null ? undefined : value;\n"
+    "        },\n"
+    "        set: function (target, key, value) { target.setItem(key, value); return true; },\n"
+    "        deleteProperty: function (target, key) { target.removeItem(key); return true; }\n"
+    "    });\n"
+    // Web SQL, enough for Tomahawk.Collection. A transaction runs at once when
+    // its turn comes, the statements its callbacks add included.
+    "    window.openDatabase = function (name) {\n"
+    "        name = String(name);\n"
+    "        return {\n"
+    "            transaction: function (callback, errorCallback, successCallback) {\n"
+    "                window.setTimeout(function () {\n"
+    "                    var statements = [];\n"
+    "                    var tx = {\n"
+    "                        executeSql: function (sql, args, success, error) {\n"
+    "                            statements.push({ sql: String(sql), args: args || [], success: success, error: error });\n"
+    "                        }\n"
+    "                    };\n"
+    "                    var failure = null;\n"
+    "                    host.executeSql(name, 'BEGIN', []);\n"
+    "                    try {\n"
+    "                        callback(tx);\n"
+    "                        while (statements.length && !failure) {\n"
+    "                            var statement = statements.shift();\n"
+    "                            var result = host.executeSql(name, statement.sql, statement.args);\n"
+    "                            if (result.error !== undefined) {\n"
+    "                                var error = { code: 0, message: result.error };\n"
+    "                                if (!statement.error || statement.error(tx, error) !== false) {\n"
+    "                                    failure = error;\n"
+    "                                }\n"
+    "                            } else if (statement.success) {\n"
+    "                                statement.success(tx, {\n"
+    "                                    insertId: result.insertId,\n"
+    "                                    rowsAffected: result.rowsAffected,\n"
+    "                                    rows: {\n"
+    "                                        length: result.rows.length,\n"
+    "                                        item: function (i) { return result.rows[i]; }\n"
+    "                                    }\n"
+    "                                });\n"
+    "                            }\n"
+    "                        }\n"
+    "                    } catch (e) {\n"
+    "                        failure = { code: 0, message: String(e) };\n"
+    "                    }\n"
+    "                    host.executeSql(name, failure ? 'ROLLBACK' : 'COMMIT', []);\n"
+    "                    if (failure && errorCallback) {\n"
+    "                        errorCallback(failure);\n"
+    "                    } else if (!failure && successCallback) {\n"
+    "                        successCallback();\n"
+    "                    }\n"
+    "                }, 0);\n"
+    "            }\n"
+    "        };\n"
+    "    };\n"
+    "})";
+
+// Stands in for an object of another thread, called with the context, the
+// index of the object and the names of its methods
+static const char* s_remoteObject =
+    "(function (host, object, methods) {\n"
+    "    var remote = {};\n"
+    "    methods.forEach(function (method) {\n"
+    "        remote[method] = function () {\n"
+    "            return host.invoke(object, method, Array.prototype.slice.call(arguments));\n"
+    "        };\n"
+    "    });\n"
+    "    return remote;\n"
+    "})";
+
+
+JSContext::JSContext( const QString& name, bool shared, const QSharedPointer< JSContextChannel >& channel )
+    : QObject( 0 )
+    , m_name( name )
+    , m_shared( shared )
+    , m_channel( channel )
+    , m_engine( 0 )
+    , m_bridge( 0 )
+{
+    // reads the storage file, better here than in the middle of a script
+    JSLocalStorage::instance();
+    m_channel->open( this );
+
+    QThread* thread = m_shared ? sharedThread() : new JSEngineThread( m_name );
+    if ( !m_shared )
+    {
+        connect( this, SIGNAL( destroyed() ), thread, SLOT( quit() ) );
+        connect( thread, SIGNAL( finished() ), thread, SLOT( deleteLater() ) );
+    }
+
+    moveToThread( thread );
+    QMetaObject::invokeMethod( this, "setup", Qt::QueuedConnection );
+}
+
+
+JSContext::~JSContext()
+{
+    // nobody waits for us anymore
+    m_channel->close();
+
+    foreach ( const QString& connection, m_databases )
+        QSqlDatabase::removeDatabase( connection );
+}
+
+
+void
+JSContext::setup()
+{
+    JSEngineThread* engineThread = static_cast< JSEngineThread* >( thread() );
+    setParent( engineThread->contexts() );
+    m_engine = engineThread->engine();
+
+    if ( m_shared )
+    {
+        // globals not set up by the scripts of this context are those of the engine
+        m_window = m_engine->newObject();
+        m_window.setPrototype( m_engine->globalObject() );
+    }
+    else
+    {
+        m_window = m_engine->globalObject();
+    }
+
+    QQmlEngine::setObjectOwnership( this, QQmlEngine::CppOwnership );
+
+    QJSValueList args;
+    args << m_window << m_engine->newQObject( this );
+    check( m_engine->evaluate( s_windowSetup ).call( args ) );
+
+    m_bridge = new JSCallBridge( this );
+    addObject( "TomahawkCallBridge", m_bridge );
+}
+
+
+void
+JSContext::addObject( const QString& name, QObject* object )
+{
+    QJSValue value;
+    if ( object->thread() == thread() )
+    {
+        // the objects have parents of their own
+        QQmlEngine::setObjectOwnership( object, QQmlEngine::CppOwnership );
+        value = m_engine->newQObject( object );
+    }
+    else
+    {
+        // Scripts must not touch the object from this thread, they get a
+        // plain object with its methods which calls them through invoke()
+        QStringList methods;
+        const QMetaObject* mo = object->metaObject();
+        for ( int i = QObject::staticMetaObject.methodCount(); i < mo->methodCount(); i++ )
+        {
+            const QMetaMethod method = mo->method( i );
+            if ( method.access() == QMetaMethod::Public && method.methodType() != QMetaMethod::Signal )
+            {
+                const QString methodName = QString::fromLatin1( method.name() );
+                if ( !methods.contains( methodName ) )
+                    methods << methodName;
+            }
+        }
+
+        QJSValueList args;
+        args << m_engine->newQObject( this ) << m_remotes.count() << m_engine->toScriptValue( methods );
+        m_remotes << object;
+
+        value = m_engine->evaluate( s_remoteObject ).call( args );
+        if ( !check( value ) )
+            return;
+    }
+
+    m_window.setProperty( name, value );
+
+    if ( m_shared )
+    {
+        const int i = m_names.indexOf( name );
+        if ( i < 0 )
+        {
+            m_names << name;
+            m_objects << value;
+        }
+        else
+        {
+            m_objects[ i ] = value;
+        }
+    }
+}
+
+
+void
+JSContext::loadScript( const QString& path, const QString& source )
+{
+    if ( !m_shared )
+    {
+        check( m_engine->evaluate( source, path ) );
+        return;
+    }
+
+    if ( path.startsWith( SHARED_LIBRARIES ) )
+    {
+        if ( s_libraries.contains( path ) )
+            return;
+
+        s_libraries.insert( path );
+        check( m_engine->evaluate( source, path ) );
+        return;
+    }
+
+    // run together with the other scripts of this context as soon as we need them
+    m_paths << path;
+    m_sources << source;
+}
+
+
+void
+JSContext::evaluate( int requestId, const QString& source )
+{
+    const QVariant result = run( source );
+    if ( requestId )
+        m_channel->reportResult( requestId, result );
+}
+
+
+void
+JSContext::calls( const QVariantList& calls )
+{
+    // tomahawk.js connects to the bridge once it ran
+    compile();
+    emit m_bridge->calls( calls );
+}
+
+
+void
+JSContext::syncCall( int requestId, const QVariantMap& call )
+{
+    compile();
+    emit m_bridge->syncCall( call );
+    m_channel->reportResult( requestId, m_bridge->takeSyncResult() );
+}
+
+
+QVariant
+JSContext::run( const QString& source )
+{
+    QJSValue result;
+    if ( m_shared )
+    {
+        compile();
+        if ( !m_eval.isCallable() )
+            return QVariant();
+
+        result = m_eval.call( QJSValueList() << QJSValue( source ) );
+    }
+    else
+    {
+        result = m_engine->evaluate( source );
+    }
+
+    if ( !check( result ) )
+        return QVariant();
+
+    return result.toVariant();
+}
+
+
+void
+JSContext::compile()
+{
+    if ( m_sources.isEmpty() )
+        return;
+
+    // The objects of the window are parameters, a "var Tomahawk" in a script
+    // must not hide them. The function returned at the end evaluates code in
+    // the scope of the scripts later on.
+    QString source = QString( "(function (window) { with (window) { return function (%1) {\n" ).arg( m_names.join( ", " ) );
+    int lines = 1;
+
+    m_lines.clear();
+    foreach ( const QString& script, m_sources )
+    {
+        m_lines << lines;
+        lines += script.count( '\n' ) + 2;
+
+        source += script;
+        source += "\n;\n";
+    }
+    source += "return function (__tomahawkSource) { return eval(__tomahawkSource); };\n}; } })";
+
+    m_compiledPaths = m_paths;
+    m_paths.clear();
+    m_sources.clear();
+
+    QJSValue scope = m_engine->evaluate( source, m_name );
+    if ( !check( scope ) )
+        return;
+
+    scope = scope.call( QJSValueList() << m_window );
+    if ( !check( scope ) )
+        return;
+
+    const QJSValue eval = scope.callWithInstance( m_window, m_objects );
+    if ( check( eval ) )
+        m_eval = eval;
+}
+
+
+bool
+JSContext::check( const QJSValue& value ) const
+{
+    if ( !value.isError() )
+        return true;
+
+    const int line = value.property( "lineNumber" ).toInt();
+    const QString where = m_shared ? location( line ) : QString( "%1:%2" ).arg( value.property( "fileName" ).toString() ).arg( line );
+
+    tLog() << "JAVASCRIPT:" << m_name << where << value.toString();
+    return false;
+}
+
+
+QString
+JSContext::location( int line ) const
+{
+    for ( int i = m_lines.count() - 1; i >= 0; i-- )
+    {
+        if ( line > m_lines.at( i ) )
+            return QString( "%1:%2" ).arg( m_compiledPaths.at( i ) ).arg( line - m_lines.at( i ) );
+    }
+
+    return QString::number( line );
+}
+
+
+void
+JSContext::log( const QString& message )
+{
+    tLog() << "JAVASCRIPT:" << m_name << message;
+}
+
+
+int
+JSContext::addTimer( const QJSValue& callback, int msecs, bool repeat )
+{
+    const int id = startTimer( qMax( msecs, 0 ) );
+    if ( id == 0 )
+        return 0;
+
+    m_timers.insert( id, callback );
+    if ( !repeat )
+        m_singleShots.insert( id );
+
+    return id;
+}
+
+
+void
+JSContext::removeTimer( int id )
+{
+    if ( m_timers.remove( id ) )
+        killTimer( id );
+
+    m_singleShots.remove( id );
+}
+
+
+void
+JSContext::timerEvent( QTimerEvent* event )
+{
+    const int id = event->timerId();
+    if ( !m_timers.contains( id ) )
+    {
+        QObject::timerEvent( event );
+        return;
+    }
+
+    QJSValue callback = m_timers.value( id );
+    if ( m_singleShots.contains( id ) )
+        removeTimer( id );
+
+    check( callback.call() );
+}
+
+
+QString
+JSContext::atob( const QString& data ) const
+{
+    return QString::fromLatin1( QByteArray::fromBase64( data.toLatin1() ) );
+}
+
+
+QString
+JSContext::btoa( const QString& data ) const
+{
+    return QString::fromLatin1( data.toLatin1().toBase64() );
+}
+
+
+QVariant
+JSContext::storageItem( const QString& key ) const
+{
+    return JSLocalStorage::instance()->getItem( key );
+}
+
+
+void
+JSContext::setStorageItem( const QString& key, const QString& value )
+{
+    JSLocalStorage::instance()->setItem( key, value );
+}
+
+
+void
+JSContext::removeStorageItem( const QString& key )
+{
+    JSLocalStorage::instance()->removeItem( key );
+}
+
+
+void
+JSContext::clearStorage()
+{
+    JSLocalStorage::instance()->clear();
+}
+
+
+QVariantMap
+JSContext::executeSql( const QString& database, const QString& statement, const QVariantList& args )
+{
+    QVariantMap result;
+
+    // one SQLite file per database, the connection belongs to this instance and its thread
+    const QString connection = QString( "JSContext %1 %2 %3" ).arg( m_name ).arg( (quintptr) this, 0, 16 ).arg( database );
+    QSqlDatabase db = QSqlDatabase::database( connection, false );
+    if ( !db.isValid() )
+    {
+        QDir dir = JSLocalStorage::storageDir();
+        dir.mkpath( SCRIPT_DATABASES );
+
+        QString fileName = database;
+        fileName.replace( QRegExp( "[^A-Za-z0-9_-]" ), "_" );
+
+        db = QSqlDatabase::addDatabase( "QSQLITE", connection );
+        db.setDatabaseName( dir.absoluteFilePath( QString( "%1/%2.sqlite" ).arg( SCRIPT_DATABASES ).arg( fileName ) ) );
+        m_databases << connection;
+    }
+
+    if ( !db.isOpen() && !db.open() )
+    {
+        result[ "error" ] = db.lastError().text();
+        return result;
+    }
+
+    QSqlQuery query( db );
+    query.prepare( statement );
+    foreach ( QVariant arg, args )
+    {
+        if ( arg.userType() == qMetaTypeId< QJSValue >() )
+            arg = arg.value< QJSValue >().toVariant();
+
+        query.addBindValue( arg );
+    }
+
+    if ( !query.exec() )
+    {
+        result[ "error" ] = query.lastError().text();
+        return result;
+    }
+
+    QVariantList rows;
+    while ( query.next() )
+    {
+        const QSqlRecord record = query.record();
+
+        QVariantMap row;
+        for ( int i = 0; i < record.count(); i++ )
+            row[ record.fieldName( i ) ] = record.value( i );
+
+        rows << row;
+    }
+
+    result[ "rows" ] = rows;
+    result[ "insertId" ] = query.lastInsertId();
+    result[ "rowsAffected" ] = query.numRowsAffected();
+    return result;
+}
+
+
+QVariant
+JSContext::invoke( int object, const QString& method, const QVariantList& arguments )
+{
+    // the object's thread might not handle calls anymore
+    QObject* target = m_remotes.value( object ).data();
+    if ( !target || QCoreApplication::closingDown() )
+        return QVariant();
+
+    if ( arguments.count() > MAX_ARGUMENTS )
+    {
+        tLog() << "JAVASCRIPT:" << m_name << "Too many arguments for" << method;
+        return QVariant();
+    }
+
+    // overloads only differ in their number of arguments
+    const QByteArray name = method.toLatin1();
+    const QMetaObject* mo = target->metaObject();
+    QMetaMethod metaMethod;
+    for ( int i = 0; i < mo->methodCount(); i++ )
+    {
+        const QMetaMethod candidate = mo->method( i );
+        if ( candidate.name() == name && candidate.parameterCount() == arguments.count() )
+        {
+            metaMethod = candidate;
+            break;
+        }
+    }
+
+    if ( !metaMethod.isValid() )
+    {
+        tLog() << "JAVASCRIPT:" << m_name << "No method" << method << "taking" << arguments.count() << "arguments";
+        return QVariant();
+    }
+
+    // blocking calls use the values in place, queued ones copy them
+    QVariantList values = arguments;
+    QGenericArgument args[ MAX_ARGUMENTS ];
+    for ( int i = 0; i < values.count(); i++ )
+    {
+        QVariant& value = values[ i ];
+        if ( value.userType() == qMetaTypeId< QJSValue >() )
+            value = value.value< QJSValue >().toVariant();
+
+        const int type = metaMethod.parameterType( i );
+        if ( type == QMetaType::QVariant )
+        {
+            args[ i ] = QGenericArgument( "QVariant", &value );
+            continue;
+        }
+
+        if ( !value.convert( type ) )
+            value = QVariant( type, (const void*)0 );
+
+        args[ i ] = QGenericArgument( metaMethod.parameterTypes().at( i ).constData(), value.constData() );
+    }
+
+    QVariant result;
+    QGenericReturnArgument resultArg;
+    if ( metaMethod.returnType() == QMetaType::QVariant )
+    {
+        resultArg = QGenericReturnArgument( "QVariant", &result );
+    }
+    else if ( metaMethod.returnType() != QMetaType::Void )
+    {
+        result = QVariant( metaMethod.returnType(), (const void*)0 );
+        resultArg = QGenericReturnArgument( metaMethod.typeName(), result.data() );
+    }
+
+    // Unless the object's thread waits for a context right now, there is no
+    // need to wait for methods without a result
+    if ( metaMethod.returnType() == QMetaType::Void && !m_channel->isWaiting( target->thread() ) )
+    {
+        metaMethod.invoke( target, Qt::QueuedConnection,
+                           args[ 0 ], args[ 1 ], args[ 2 ], args[ 3 ], args[ 4 ],
+                           args[ 5 ], args[ 6 ], args[ 7 ], args[ 8 ], args[ 9 ] );
+        return QVariant();
+    }
+
+    // Not a blocking queued call: the thread might start to wait for us in
+    // JSContextChannel::call() before it gets to its event loop
+    m_channel->runInThread( target, [&]()
+    {
+        metaMethod.invoke( target, Qt::DirectConnection, resultArg,
+                           args[ 0 ], args[ 1 ], args[ 2 ], args[ 3 ], args[ 4 ],
+                           args[ 5 ], args[ 6 ], args[ 7 ], args[ 8 ], args[ 9 ] );
+    } );
+
+    return result;
+}
+
+
+QMutex JSContextChannel::s_mutex;
+QWaitCondition JSContextChannel::s_condition;
+QHash< QThread*, int > JSContextChannel::s_waiting;
+QList< QSharedPointer< JSContextChannel::Task > > JSContextChannel::s_tasks;
+QList< JSContextChannel::Task* > JSContextChannel::s_running;
+
+
+JSContextChannel::JSContextChannel()
+    : m_context( 0 )
+{
+}
+
+
+bool
+JSContextChannel::post( const char* method, QGenericArgument arg1, QGenericArgument arg2 )
+{
+    // the context can't be deleted while we hold the lock
+    QMutexLocker locker( &s_mutex );
+    if ( !m_context )
+        return false;
+
+    return QMetaObject::invokeMethod( m_context, method, Qt::QueuedConnection, arg1, arg2 );
+}
+
+
+QVariant
+JSContextChannel::call( const char* method, int requestId, QGenericArgument arg1 )
+{
+    QThread* thread = QThread::currentThread();
+
+    QMutexLocker locker( &s_mutex );
+    if ( !m_context )
+        return QVariant();
+
+    // before the call, the context may call back into us right away
+    s_waiting[ thread ]++;
+
+    // If we got here from a task the context waits for, like a plugin it
+    // registers, it doesn't get to its event loop before we are done. It runs
+    // the call while it waits instead, and it can't go away meanwhile.
+    bool calledBack = false;
+    foreach ( Task* running, s_running )
+    {
+        if ( running->thread == thread && running->caller == m_context->thread() )
+        {
+            calledBack = true;
+            break;
+        }
+    }
+
+    QSharedPointer< Task > task;
+    if ( calledBack )
+    {
+        JSContext* context = m_context;
+        task = QSharedPointer< Task >( new Task );
+        task->run = [&]()
+        {
+            QMetaObject::invokeMethod( context, method, Qt::DirectConnection, Q_ARG( int, requestId ), arg1 );
+        };
+        task->thread = context->thread();
+        task->caller = thread;
+        task->done = false;
+
+        s_tasks << task;
+        s_condition.wakeAll();
+    }
+    else
+    {
+        QMetaObject::invokeMethod( m_context, method, Qt::QueuedConnection, Q_ARG( int, requestId ), arg1 );
+    }
+
+    // the contexts that called us before we are done get their answer
+    runTasks( locker, thread, [&]()
+    {
+        return ( !m_context || m_results.contains( requestId ) ) && ( !task || task->done );
+    } );
+
+    if ( --s_waiting[ thread ] == 0 )
+        s_waiting.remove( thread );
+
+    return m_results.take( requestId );
+}
+
+
+void
+JSContextChannel::deleteContext()
+{
+    QMutexLocker locker( &s_mutex );
+    if ( m_context )
+        m_context->deleteLater();
+}
+
+
+void
+JSContextChannel::open( JSContext* context )
+{
+    QMutexLocker locker( &s_mutex );
+    m_context = context;
+}
+
+
+void
+JSContextChannel::reportResult( int requestId, const QVariant& result )
+{
+    QMutexLocker locker( &s_mutex );
+    m_results.insert( requestId, result );
+    s_condition.wakeAll();
+}
+
+
+bool
+JSContextChannel::isWaiting( QThread* thread ) const
+{
+    QMutexLocker locker( &s_mutex );
+    return s_waiting.contains( thread );
+}
+
+
+void
+JSContextChannel::runInThread( QObject* target, const std::function< void() >& task )
+{
+    QThread* thread = QThread::currentThread();
+
+    QSharedPointer< Task > t( new Task );
+    t->run = task;
+    t->thread = target->thread();
+    t->caller = thread;
+    t->done = false;
+
+    // If the thread waits, or starts to wait before it gets to its event
+    // loop, it runs the task from s_tasks. Whoever is first takes it.
+    QMutexLocker locker( &s_mutex );
+    s_waiting[ thread ]++;
+    s_tasks << t;
+    s_condition.wakeAll();
+    locker.unlock();
+
+    // Once the event is gone, run or not, nobody else gets to the task. It
+    // only holds the task through this, it is dropped with the event.
+    QSharedPointer< Task > posted( t.data(), [t]( Task* )
+    {
+        QMutexLocker dropLocker( &s_mutex );
+        if ( s_tasks.removeOne( t ) )
+        {
+            t->done = true;
+            s_condition.wakeAll();
+        }
+    } );
+    QTimer::singleShot( 0, target, [posted]() { runPosted( posted ); } );
+    posted.clear();
+
+    locker.relock();
+    runTasks( locker, thread, [&]() { return t->done; } );
+
+    if ( --s_waiting[ thread ] == 0 )
+        s_waiting.remove( thread );
+}
+
+
+void
+JSContextChannel::runTasks( QMutexLocker& locker, QThread* thread, const std::function< bool() >& finished )
+{
+    forever
+    {
+        QSharedPointer< Task > task;
+        foreach ( const QSharedPointer< Task >& t, s_tasks )
+        {
+            if ( t->thread == thread )
+            {
+                task = t;
+                break;
+            }
+        }
+
+        if ( !task )
+        {
+            if ( finished() )
+                break;
+
+            s_condition.wait( &s_mutex );
+            continue;
+        }
+
+        s_tasks.removeOne( task );
+        run( locker, task );
+    }
+}
+
+
+void
+JSContextChannel::runPosted( const QSharedPointer< Task >& task )
+{
+    QMutexLocker locker( &s_mutex );
+    if ( s_tasks.removeOne( task ) )
+        run( locker, task );
+}
+
+
+void
+JSContextChannel::run( QMutexLocker& locker, const QSharedPointer< Task >& task )
+{
+    s_running << task.data();
+    locker.unlock();
+    task->run();
+    locker.relock();
+    s_running.removeOne( task.data() );
+
+    task->done = true;
+    s_condition.wakeAll();
+}
+
+
+void
+JSContextChannel::close()
+{
+    QMutexLocker locker( &s_mutex );
+    m_context = 0;
+    s_condition.wakeAll();
+}
+
+
+QThread*
+JSContext::sharedThread()
+{
+    static QPointer< JSEngineThread > thread;
+    if ( thread.isNull() )
+    {
+        thread = new JSEngineThread( "shared" );
+        s_libraries.clear();
+    }
+
+    return thread.data();
+}
+
+
+JSEngineThread::JSEngineThread( const QString& name )
+    : QThread( QCoreApplication::instance() )
+    , m_engine( 0 )
+    , m_contexts( 0 )
+{
+    setObjectName( QString( "JSEngineThread %1" ).arg( name ) );
+    start();
+}
+
+
+JSEngineThread::~JSEngineThread()
+{
+    quit();
+    wait();
+}
+
+
+void
+JSEngineThread::run()
+{
+    m_engine = new QJSEngine();
+    m_contexts = new QObject();
+
+    exec();
+
+    // the contexts hold values of the engine
+    delete m_contexts;
+    m_contexts = 0;
+    delete m_engine;
+    m_engine = 0;
+}
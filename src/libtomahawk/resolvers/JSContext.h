@@ -0,0 +1,265 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TOMAHAWK_JSCONTEXT_H
+#define TOMAHAWK_JSCONTEXT_H
+
+#include <QHash>
+#include <QJSValue>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QVariant>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+#include <functional>
+
+#include "DllMacro.h"
+
+class QJSEngine;
+
+namespace Tomahawk
+{
+
+class JSCallBridge;
+class JSContextChannel;
+
+/**
+ * Runs the scripts of a JSAccount in a QJSEngine instead of a WebKit page.
+ * Scripts get a window with console, timers, atob/btoa, localStorage and
+ * openDatabase(), but no DOM and no XMLHttpRequest, tomahawk.js does its
+ * requests natively. The databases are not those of the WebKit pages,
+ * collections fill theirs anew.
+ *
+ * A context either has an engine of its own, or lives with all other shared
+ * contexts in one engine. In the shared engine every context gets a window of
+ * its own, and the scripts loaded into it are run together in one function
+ * scope, so their globals stay apart from those of other contexts. Libraries
+ * that don't depend on the context, like CryptoJS, are loaded only once.
+ *
+ * Each engine runs in a JSEngineThread. Apart from the constructor the
+ * context is only used in there, the JSAccount calls in through its
+ * JSContextChannel. Objects of other threads given to addObject() are called
+ * the same way: methods without a result are queued, the others block until
+ * the object's thread handled them. If that thread waits for a result of
+ * a context in JSContextChannel::call(), it runs them right there. While the
+ * context blocks, it runs the calls made to it the same way, so the object
+ * may call back into the context, like a resolver registering a plugin.
+ */
+class DLLEXPORT JSContext : public QObject
+{
+    Q_OBJECT
+
+public:
+    JSContext( const QString& name, bool shared, const QSharedPointer< JSContextChannel >& channel );
+    virtual ~JSContext();
+
+    /**
+     * Makes @p object available to the scripts as window.<name>
+     */
+    Q_INVOKABLE void addObject( const QString& name, QObject* object );
+    Q_INVOKABLE void loadScript( const QString& path, const QString& source );
+    /**
+     * Unless @p requestId is 0 the result is handed back through the channel
+     */
+    Q_INVOKABLE void evaluate( int requestId, const QString& source );
+    /**
+     * Hands @p calls to the script, see JSCallBridge
+     */
+    Q_INVOKABLE void calls( const QVariantList& calls );
+    Q_INVOKABLE void syncCall( int requestId, const QVariantMap& call );
+
+    // called from JavaScript
+    Q_INVOKABLE void log( const QString& message );
+    Q_INVOKABLE int addTimer( const QJSValue& callback, int msecs, bool repeat );
+    Q_INVOKABLE void removeTimer( int id );
+    Q_INVOKABLE QString atob( const QString& data ) const;
+    Q_INVOKABLE QString btoa( const QString& data ) const;
+    Q_INVOKABLE QVariant storageItem( const QString& key ) const;
+    Q_INVOKABLE void setStorageItem( const QString& key, const QString& value );
+    Q_INVOKABLE void removeStorageItem( const QString& key );
+    Q_INVOKABLE void clearStorage();
+    /**
+     * Runs @p statement with @p args on @p database, the result has the
+     * "rows", "insertId" and "rowsAffected", or an "error"
+     */
+    Q_INVOKABLE QVariantMap executeSql( const QString& database, const QString& statement, const QVariantList& args );
+    /**
+     * Calls @p method of the @p object'th object addObject() got from another thread
+     */
+    Q_INVOKABLE QVariant invoke( int object, const QString& method, const QVariantList& arguments );
+
+protected:
+    void timerEvent( QTimerEvent* event ) override;
+
+private slots:
+    void setup();
+
+private:
+    QVariant run( const QString& source );
+    /**
+     * Runs the scripts loaded since the last call in a new function scope of
+     * the window, shared contexts only
+     */
+    void compile();
+    /**
+     * Logs @p value if it is an error
+     */
+    bool check( const QJSValue& value ) const;
+    /**
+     * The path and line of @p line in the scripts compile() ran together
+     */
+    QString location( int line ) const;
+
+    static QThread* sharedThread();
+
+    QString m_name;
+    bool m_shared;
+    QSharedPointer< JSContextChannel > m_channel;
+    QJSEngine* m_engine;
+    QJSValue m_window;
+    JSCallBridge* m_bridge;
+    QList< QPointer< QObject > > m_remotes;
+    QStringList m_databases; // connection names
+
+    // shared contexts only
+    QStringList m_names;
+    QList< QJSValue > m_objects;
+    QStringList m_paths; // not compiled yet
+    QStringList m_sources;
+    QStringList m_compiledPaths;
+    QList< int > m_lines; // lines before each of m_compiledPaths in the compiled source
+    QJSValue m_eval;
+
+    QHash< int, QJSValue > m_timers;
+    QSet< int > m_singleShots;
+};
+
+
+/**
+ * How a JSAccount talks to its JSContext from another thread, it outlives
+ * the context.
+ *
+ * call() blocks until the context handed back the result, without handling
+ * any events. Only the calls any context makes to objects of the waiting
+ * thread are run meanwhile, so the thread neither deadlocks on the context
+ * nor gets re-entered by anything else. A context blocked in runInThread()
+ * runs the calls made to it the same way.
+ */
+class DLLEXPORT JSContextChannel
+{
+public:
+    JSContextChannel();
+
+    /**
+     * Queues a call of @p method on the context, false if it is gone
+     */
+    bool post( const char* method, QGenericArgument arg1 = QGenericArgument( 0 ), QGenericArgument arg2 = QGenericArgument( 0 ) );
+    /**
+     * Calls @p method with @p requestId and @p arg1 and waits for its result,
+     * an invalid one if the context is gone
+     */
+    QVariant call( const char* method, int requestId, QGenericArgument arg1 );
+    /**
+     * Deletes the context later, in its thread
+     */
+    void deleteContext();
+
+    // used by the context
+    void open( JSContext* context );
+    void reportResult( int requestId, const QVariant& result );
+    /**
+     * Whether @p thread waits for a context or for another thread right now
+     */
+    bool isWaiting( QThread* thread ) const;
+    /**
+     * Runs @p task in the thread of @p target and waits until it ran. If that
+     * thread waits, it runs the task right away, otherwise in its event loop.
+     * Tasks for the calling thread are run meanwhile.
+     */
+    void runInThread( QObject* target, const std::function< void() >& task );
+    void close();
+
+private:
+    struct Task
+    {
+        std::function< void() > run;
+        QThread* thread; // runs it
+        QThread* caller; // waits for it
+        bool done;
+    };
+
+    /**
+     * Runs the tasks for @p thread until @p finished returns true, with
+     * s_mutex held by @p locker
+     */
+    static void runTasks( QMutexLocker& locker, QThread* thread, const std::function< bool() >& finished );
+    /**
+     * Takes @p task off s_tasks and runs it, unless a waiting thread got to it first
+     */
+    static void runPosted( const QSharedPointer< Task >& task );
+    static void run( QMutexLocker& locker, const QSharedPointer< Task >& task );
+
+    JSContext* m_context;
+    QHash< int, QVariant > m_results;
+
+    // Shared by all channels: the contexts of the shared engine run in one
+    // thread, any of them may call into a thread waiting for another one
+    static QMutex s_mutex;
+    static QWaitCondition s_condition;
+    static QHash< QThread*, int > s_waiting; // nested calls count twice
+    static QList< QSharedPointer< Task > > s_tasks;
+    static QList< Task* > s_running; // by any thread, innermost last
+};
+
+
+/**
+ * Thread with the QJSEngine of a headless context, or of all shared ones
+ */
+class JSEngineThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit JSEngineThread( const QString& name );
+    virtual ~JSEngineThread();
+
+    /**
+     * Only valid within the thread
+     */
+    QJSEngine* engine() const { return m_engine; }
+    /**
+     * Parent of the contexts, they are deleted before the engine
+     */
+    QObject* contexts() const { return m_contexts; }
+
+protected:
+    void run() override;
+
+private:
+    QJSEngine* m_engine;
+    QObject* m_contexts;
+};
+
+}
+
+#endif // TOMAHAWK_JSCONTEXT_H
@@ -0,0 +1,316 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "JSLocalStorage.h"
+
+#include "utils/Json.h"
+#include "utils/Logger.h"
+#include "utils/TomahawkUtils.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+// Writes are batched, scripts tend to save their config key by key
+#define SAVE_DELAY 1000
+// Where the WebKit pages the scripts ran in kept their local storage, see ScriptEngine
+#define WEBKIT_STORAGE "file__0.localstorage"
+
+using namespace Tomahawk;
+
+JSLocalStorage* JSLocalStorage::s_instance = 0;
+QString JSLocalStorage::s_storageDir;
+
+
+JSLocalStorage*
+JSLocalStorage::instance()
+{
+    if ( !s_instance )
+        s_instance = new JSLocalStorage( QCoreApplication::instance() );
+
+    return s_instance;
+}
+
+
+QDir
+JSLocalStorage::storageDir()
+{
+    if ( s_storageDir.isEmpty() )
+        return TomahawkUtils::appDataDir();
+
+    return QDir( s_storageDir );
+}
+
+
+void
+JSLocalStorage::setStorageDir( const QDir& dir )
+{
+    s_storageDir = dir.absolutePath();
+}
+
+
+JSLocalStorage::JSLocalStorage( QObject* parent )
+    : QObject( parent )
+    , m_path( storageDir().absoluteFilePath( "scriptstorage.json" ) )
+    , m_webKitPath( storageDir().absoluteFilePath( WEBKIT_STORAGE ) )
+{
+    m_saveTimer.setSingleShot( true );
+    m_saveTimer.setInterval( SAVE_DELAY );
+    connect( &m_saveTimer, SIGNAL( timeout() ), SLOT( save() ) );
+
+    QFile file( m_path );
+    if ( file.open( QIODevice::ReadOnly ) )
+    {
+        bool ok;
+        m_items = TomahawkUtils::parseJson( file.readAll(), &ok ).toMap();
+        if ( !ok )
+            tLog() << Q_FUNC_INFO << "Could not parse" << m_path;
+    }
+
+    // Whichever storage was written to last wins for the items both have,
+    // the others are copied over
+    const bool webKitNewer = QFileInfo( m_webKitPath ).lastModified() > QFileInfo( m_path ).lastModified();
+    m_webKitModified = QFileInfo( m_webKitPath ).lastModified();
+    m_webKitItems = webKitItems();
+
+    bool changed = false;
+    foreach ( const QString& key, m_webKitItems.keys() )
+    {
+        const QVariant value = m_webKitItems.value( key );
+        if ( !m_items.contains( key ) || ( webKitNewer && m_items.value( key ) != value ) )
+        {
+            m_items[ key ] = value;
+            changed = true;
+        }
+    }
+    foreach ( const QString& key, m_items.keys() )
+    {
+        if ( m_items.value( key ) != m_webKitItems.value( key ) )
+            m_changedKeys.insert( key );
+    }
+
+    if ( changed || !m_changedKeys.isEmpty() )
+        save();
+}
+
+
+JSLocalStorage::~JSLocalStorage()
+{
+    if ( m_saveTimer.isActive() )
+        save();
+
+    s_instance = 0;
+}
+
+
+QVariant
+JSLocalStorage::getItem( const QString& key )
+{
+    QMutexLocker locker( &m_mutex );
+    updateFromWebKit();
+
+    return m_items.value( key );
+}
+
+
+void
+JSLocalStorage::setItem( const QString& key, const QString& value )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_items.contains( key ) && m_items.value( key ).toString() == value )
+        return;
+
+    m_items[ key ] = value;
+    scheduleSave( key );
+}
+
+
+void
+JSLocalStorage::removeItem( const QString& key )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_items.remove( key ) )
+        scheduleSave( key );
+}
+
+
+void
+JSLocalStorage::clear()
+{
+    QMutexLocker locker( &m_mutex );
+    foreach ( const QString& key, m_items.keys() )
+        scheduleSave( key );
+
+    m_items.clear();
+}
+
+
+void
+JSLocalStorage::scheduleSave( const QString& key )
+{
+    m_changedKeys.insert( key );
+
+    // the timer belongs to the thread which created us
+    QMetaObject::invokeMethod( &m_saveTimer, "start", Qt::QueuedConnection );
+}
+
+
+void
+JSLocalStorage::save()
+{
+    m_saveTimer.stop();
+
+    QMutexLocker locker( &m_mutex );
+    saveToWebKit();
+
+    QSaveFile file( m_path );
+    if ( !file.open( QIODevice::WriteOnly ) )
+    {
+        tLog() << Q_FUNC_INFO << "Could not write" << m_path << file.errorString();
+        return;
+    }
+
+    file.write( TomahawkUtils::toJson( m_items ) );
+    if ( !file.commit() )
+        tLog() << Q_FUNC_INFO << "Could not write" << m_path << file.errorString();
+}
+
+
+void
+JSLocalStorage::updateFromWebKit()
+{
+    const QDateTime modified = QFileInfo( m_webKitPath ).lastModified();
+    if ( modified == m_webKitModified )
+        return;
+
+    m_webKitModified = modified;
+
+    const QVariantMap items = webKitItems();
+    foreach ( const QString& key, items.keys() )
+    {
+        const QVariant value = items.value( key );
+        if ( m_webKitItems.value( key ) != value && !m_changedKeys.contains( key ) )
+        {
+            m_items[ key ] = value;
+            scheduleSave( key );
+        }
+    }
+    foreach ( const QString& key, m_webKitItems.keys() )
+    {
+        if ( !items.contains( key ) && !m_changedKeys.contains( key ) && m_items.remove( key ) )
+            scheduleSave( key );
+    }
+
+    m_webKitItems = items;
+}
+
+
+void
+JSLocalStorage::saveToWebKit()
+{
+    // until WebKit created its storage
+    if ( !QFile::exists( m_webKitPath ) )
+        return;
+
+    // those we took over from the WebKit storage are in there already
+    QSet< QString > keys;
+    foreach ( const QString& key, m_changedKeys )
+    {
+        if ( m_items.value( key ) != m_webKitItems.value( key ) )
+            keys << key;
+    }
+    m_changedKeys.clear();
+
+    if ( keys.isEmpty() )
+        return;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", "JSLocalStorageExport" );
+        db.setDatabaseName( m_webKitPath );
+        if ( db.open() )
+        {
+            QSqlQuery update( db );
+            update.prepare( "INSERT OR REPLACE INTO ItemTable(key, value) VALUES(?, ?)" );
+            QSqlQuery remove( db );
+            remove.prepare( "DELETE FROM ItemTable WHERE key = ?" );
+
+            db.transaction();
+            foreach ( const QString& key, keys )
+            {
+                if ( m_items.contains( key ) )
+                {
+                    // see webKitItems()
+                    const QString value = m_items.value( key ).toString();
+                    update.bindValue( 0, key );
+                    update.bindValue( 1, QByteArray( (const char*)value.utf16(), value.size() * 2 ) );
+                    update.exec();
+
+                    m_webKitItems[ key ] = value;
+                }
+                else
+                {
+                    remove.bindValue( 0, key );
+                    remove.exec();
+
+                    m_webKitItems.remove( key );
+                }
+            }
+            if ( !db.commit() )
+                tLog() << Q_FUNC_INFO << "Could not write" << m_webKitPath << db.lastError().text();
+
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase( "JSLocalStorageExport" );
+
+    // our own changes are no news
+    m_webKitModified = QFileInfo( m_webKitPath ).lastModified();
+}
+
+
+QVariantMap
+JSLocalStorage::webKitItems() const
+{
+    QVariantMap items;
+    if ( !QFile::exists( m_webKitPath ) )
+        return items;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", "JSLocalStorageImport" );
+        db.setDatabaseName( m_webKitPath );
+        if ( db.open() )
+        {
+            // WebKit keeps the values as UTF-16 in host byte order
+            QSqlQuery query( "SELECT key, value FROM ItemTable", db );
+            while ( query.next() )
+            {
+                const QByteArray value = query.value( 1 ).toByteArray();
+                items[ query.value( 0 ).toString() ] = QString::fromUtf16( (const ushort*)value.constData(), value.size() / 2 );
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase( "JSLocalStorageImport" );
+
+    return items;
+}
@@ -0,0 +1,97 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TOMAHAWK_JSLOCALSTORAGE_H
+#define TOMAHAWK_JSLOCALSTORAGE_H
+
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVariantMap>
+
+namespace Tomahawk
+{
+
+/**
+ * window.localStorage for scripts in a JSContext. Like the storage of the
+ * WebKit pages it is shared by all scripts. It is kept in step with the
+ * storage of the WebKit pages, so resolvers can move between runtimes: items
+ * the pages change are taken over, and what is saved here is written to the
+ * WebKit storage too. Pages running right now only see the latter once they
+ * are loaded again. The items may be used from any thread.
+ */
+class JSLocalStorage : public QObject
+{
+    Q_OBJECT
+
+public:
+    static JSLocalStorage* instance();
+
+    /**
+     * Where script storage is kept, localStorage as well as the databases of
+     * openDatabase(). Defaults to the app data dir, an instance created
+     * before it is changed keeps the old one.
+     */
+    static QDir storageDir();
+    static void setStorageDir( const QDir& dir );
+
+    virtual ~JSLocalStorage();
+
+    /**
+     * The value stored for @p key, invalid if there is none
+     */
+    QVariant getItem( const QString& key );
+    void setItem( const QString& key, const QString& value );
+    void removeItem( const QString& key );
+    void clear();
+
+private slots:
+    void save();
+
+private:
+    explicit JSLocalStorage( QObject* parent );
+
+    void scheduleSave( const QString& key );
+    /**
+     * Takes over the items the WebKit pages changed since we last looked,
+     * with m_mutex held
+     */
+    void updateFromWebKit();
+    void saveToWebKit();
+
+    QVariantMap webKitItems() const;
+
+    QString m_path;
+    QString m_webKitPath;
+    QMutex m_mutex;
+    QVariantMap m_items;
+    QTimer m_saveTimer;
+
+    QVariantMap m_webKitItems; // as we last saw them
+    QDateTime m_webKitModified;
+    QSet< QString > m_changedKeys; // not in the WebKit storage yet
+
+    static JSLocalStorage* s_instance;
+    static QString s_storageDir;
+};
+
+}
+
+#endif // TOMAHAWK_JSLOCALSTORAGE_H
@@ -62,7 +62,7 @@
 
 using namespace Tomahawk;
 
-JSResolver::JSResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths )
+JSResolver::JSResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths, const QVariantHash& options )
     : Tomahawk::ExternalResolverGui( scriptPath )
     , ScriptPlugin( scriptobject_ptr() )
     , d_ptr( new JSResolverPrivate( this, accountId, scriptPath, additionalScriptPaths ) )
@@ -71,7 +71,11 @@ JSResolver::JSResolver( const QString& accountId, const QString& scriptPath, con
     tLog() << Q_FUNC_INFO << "Loading JS resolver:" << scriptPath;
 
     d->name = QFileInfo( filePath() ).baseName();
-    d->scriptAccount.reset( new JSAccount( d->name ) );
+
+    QString runtime = options.value( "runtime" ).toString();
+    if ( runtime.isEmpty() )
+        runtime = TomahawkSettings::instance()->scriptRuntime();
+    d->scriptAccount.reset( new JSAccount( d->name, JSAccount::runtimeFromName( runtime ) ) );
     d->scriptAccount->setResolver( this );
     d->scriptAccount->setFilePath( filePath() );
     d->scriptAccount->setIcon( icon( QSize( 0, 0 ) ) );
@@ -99,14 +103,14 @@ JSResolver::~JSResolver()
 }
 
 
-Tomahawk::ExternalResolver* JSResolver::factory( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths )
+Tomahawk::ExternalResolver* JSResolver::factory( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths, const QVariantHash& options )
 {
     ExternalResolver* res = nullptr;
 
     const QFileInfo fi( scriptPath );
     if ( fi.suffix() == "js" || fi.suffix() == "script" )
     {
-        res = new JSResolver( accountId, scriptPath, additionalScriptPaths );
+        res = new JSResolver( accountId, scriptPath, additionalScriptPaths, options );
         tLog() << Q_FUNC_INFO << scriptPath << "Loaded.";
     }
 
@@ -205,7 +209,7 @@ JSResolver::init()
     QDir luceneDir( TomahawkUtils::appDataDir().absoluteFilePath( lucenePath ) );
     if ( luceneDir.exists() )
     {
-        d->fuzzyIndex.reset( new FuzzyIndex( this, lucenePath, false ) );
+        d->fuzzyIndex = QSharedPointer< FuzzyIndex >( new FuzzyIndex( 0, lucenePath, false ), &QObject::deleteLater );
     }
 
     QFile scriptFile( filePath() );
@@ -257,7 +261,8 @@ JSResolver::init()
     d->scriptAccount->loadScript( filePath() );
 
     // HACK: register resolver object
-    d->scriptAccount->evaluateJavaScript( "Tomahawk.PluginManager.registerPlugin('resolver', Tomahawk.resolver.instance);" );
+    // waits for scripts in a JSContext, scriptObject() is set once they registered it
+    d->scriptAccount->evaluateJavaScriptWithResult( "Tomahawk.PluginManager.registerPlugin('resolver', Tomahawk.resolver.instance);" );
     // init resolver
     scriptObject()->syncInvoke( "init" );
 
@@ -546,11 +551,21 @@ JSResolver::resolve( const Tomahawk::query_ptr& query )
     job->start();
 }
 
+void
+JSResolver::resolveBatch( const QList< Tomahawk::query_ptr >& queries )
+{
+    ScriptJob* job = scriptAccount()->resolveBatch( scriptObject(), queries, "resolver" );
+    job->setProperty( "queries", QVariant::fromValue( queries ) );
+    connect( job, SIGNAL( done( QVariantMap ) ), SLOT( onResolveBatchRequestDone( QVariantMap ) ) );
+
+    job->start();
+}
+
+
 void
 JSResolver::onResolveRequestDone( const QVariantMap& data )
 {
     Q_ASSERT( QThread::currentThread() == thread() );
-    Q_D( JSResolver );
 
     ScriptJob* job = qobject_cast< ScriptJob* >( sender() );
 
@@ -562,30 +577,71 @@ JSResolver::onResolveRequestDone( const QVariantMap& data )
     }
     else
     {
-        if ( !data.value( "artists" ).isNull() )
-        {
-            QList< artist_ptr > artists = scriptAccount()->parseArtistVariantList( data.value( "artists" ).toList() );
-            Tomahawk::Pipeline::instance()->reportArtists( qid, artists );
-        }
+        reportResolveResult( qid, data );
+    }
+
+    sender()->deleteLater();
+}
 
-        if ( !data.value( "albums" ).isNull() )
-        {
-            QList< album_ptr > albums = scriptAccount()->parseAlbumVariantList( data.value( "albums" ).toList() );
-            Tomahawk::Pipeline::instance()->reportAlbums( qid, albums );
-        }
 
-        QList< Tomahawk::result_ptr > results = scriptAccount()->parseResultVariantList( data.value( "tracks" ).toList() );
-        foreach( const result_ptr& result, results )
+void
+JSResolver::onResolveBatchRequestDone( const QVariantMap& data )
+{
+    Q_ASSERT( QThread::currentThread() == thread() );
+
+    ScriptJob* job = qobject_cast< ScriptJob* >( sender() );
+
+    if ( job->error() )
+    {
+        // Resolvers written against an API without resolveBatch, ask them one by one
+        tDebug( LOGVERBOSE ) << Q_FUNC_INFO << "Batch resolve failed, falling back to single queries:" << name();
+        foreach ( const Tomahawk::query_ptr& query, job->property( "queries" ).value< QList< Tomahawk::query_ptr > >() )
+            resolve( query );
+    }
+    else
+    {
+        const QStringList qids = job->property( "qids" ).toStringList();
+        const QVariantList results = data.value( "results" ).toList();
+
+        for ( int i = 0; i < qids.count(); i++ )
         {
-            result->setResolvedByResolver( this );
-            result->setFriendlySource( name() );
+            const QVariantMap result = results.value( i ).toMap();
+            if ( result.contains( "error" ) )
+                Tomahawk::Pipeline::instance()->reportError( qids.at( i ), this );
+            else
+                reportResolveResult( qids.at( i ), result );
         }
-        Tomahawk::Pipeline::instance()->reportResults( qid, this, results );
     }
 
     sender()->deleteLater();
 }
 
+
+void
+JSResolver::reportResolveResult( const QString& qid, const QVariantMap& data )
+{
+    if ( !data.value( "artists" ).isNull() )
+    {
+        QList< artist_ptr > artists = scriptAccount()->parseArtistVariantList( data.value( "artists" ).toList() );
+        Tomahawk::Pipeline::instance()->reportArtists( qid, artists );
+    }
+
+    if ( !data.value( "albums" ).isNull() )
+    {
+        QList< album_ptr > albums = scriptAccount()->parseAlbumVariantList( data.value( "albums" ).toList() );
+        Tomahawk::Pipeline::instance()->reportAlbums( qid, albums );
+    }
+
+    QList< Tomahawk::result_ptr > results = scriptAccount()->parseResultVariantList( data.value( "tracks" ).toList() );
+    foreach( const result_ptr& result, results )
+    {
+        result->setResolvedByResolver( this );
+        result->setFriendlySource( name() );
+    }
+    Tomahawk::Pipeline::instance()->reportResults( qid, this, results );
+}
+
+
 void
 JSResolver::stop()
 {
@@ -49,9 +49,13 @@ friend class JSResolverHelper;
 friend class JSAccount;
 
 public:
-    explicit JSResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList() );
+    /**
+     * The "runtime" in @p options picks the JSAccount::Runtime the resolver runs in,
+     * falls back to TomahawkSettings::scriptRuntime()
+     */
+    explicit JSResolver( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList(), const QVariantHash& options = QVariantHash() );
     virtual ~JSResolver();
-    static ExternalResolver* factory( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList() );
+    static ExternalResolver* factory( const QString& accountId, const QString& scriptPath, const QStringList& additionalScriptPaths = QStringList(), const QVariantHash& options = QVariantHash() );
 
     Capabilities capabilities() const override;
 
@@ -81,6 +85,7 @@ public:
 
 public slots:
     void resolve( const Tomahawk::query_ptr& query ) override;
+    void resolveBatch( const QList< Tomahawk::query_ptr >& queries ) override;
     void stop() override;
     void start() override;
 
@@ -95,10 +100,12 @@ protected:
 
 private slots:
     void onResolveRequestDone(const QVariantMap& data);
+    void onResolveBatchRequestDone( const QVariantMap& data );
     void onLookupUrlRequestDone(const QVariantMap& data);
 
 private:
     void init();
+    void reportResolveResult( const QString& qid, const QVariantMap& data );
 
     void loadUi();
     void onCapabilitiesChanged( Capabilities capabilities );
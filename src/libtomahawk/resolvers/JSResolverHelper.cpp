@@ -42,12 +42,15 @@
 #include "../Result.h"
 #include "../Track.h"
 
+#include <QCoreApplication>
 #include <QFile>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QMap>
 #include <QWebFrame>
 #include <QLocale>
 #include <QNetworkReply>
+#include <qtconcurrentrun.h>
 
 #include <taglib/asffile.h>
 #include <taglib/flacfile.h>
@@ -68,14 +71,40 @@
     #include <winnls.h>
 #endif
 
+// Values per track in the flat lists createFuzzyIndex() takes
+#define FUZZY_INDEX_ROW_SIZE 4
+// Threads reading tags for nativeRetrieveMetadata(), each keeps a QNetworkAccessManager
+#define METADATA_THREADS 2
+
 using namespace Tomahawk;
 
+
+// Tomahawk::Utils::nam() creates a QNetworkAccessManager for every thread it
+// is used in, so the threads stay around instead of expiring like the ones
+// of the global pool
+static QThreadPool*
+metadataPool()
+{
+    static QThreadPool* pool = 0;
+    if ( !pool )
+    {
+        pool = new QThreadPool( QCoreApplication::instance() );
+        pool->setMaxThreadCount( METADATA_THREADS );
+        pool->setExpiryTimeout( -1 );
+    }
+
+    return pool;
+}
+
+
 JSResolverHelper::JSResolverHelper( const QString& scriptPath, JSResolver* parent )
     : QObject( parent )
     , m_resolver( parent )
     , m_scriptPath( scriptPath )
     , m_stopped( false )
 {
+    // keeps the index updates in order
+    m_fuzzyIndexPool.setMaxThreadCount( 1 );
 }
 
 
@@ -523,13 +552,36 @@ void
 JSResolverHelper::nativeRetrieveMetadata( int metadataId, const QString& url,
                                           const QString& mime_type, int sizehint,
                                           const QVariantMap& options )
+{
+    // fetching and parsing the tags takes a while, neither the UI nor the script should wait for it
+    QFutureWatcher< QString >* watcher = new QFutureWatcher< QString >( this );
+    connect( watcher, SIGNAL( finished() ), SLOT( nativeRetrieveMetadataDone() ) );
+
+    watcher->setFuture( QtConcurrent::run( metadataPool(), &JSResolverHelper::retrieveMetadata, metadataId, url, mime_type, sizehint, options ) );
+}
+
+
+void
+JSResolverHelper::nativeRetrieveMetadataDone()
+{
+    QFutureWatcher< QString >* watcher = static_cast< QFutureWatcher< QString >* >( sender() );
+    watcher->deleteLater();
+
+    m_resolver->d_func()->scriptAccount->evaluateJavaScript( watcher->result() );
+}
+
+
+/// This method is run by QtConcurrent:
+QString
+JSResolverHelper::retrieveMetadata( int metadataId, const QString& url,
+                                    const QString& mime_type, int sizehint,
+                                    const QVariantMap& options )
 {
     if ( sizehint <= 0 )
     {
         QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Supplied size is not (yet) supported');" )
                 .arg( metadataId );
-        m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
-        return;
+        return javascript;
     }
 
     if ( TomahawkUtils::isHttpResult( url ) || TomahawkUtils::isHttpsResult( url ) )
@@ -595,8 +647,7 @@ JSResolverHelper::nativeRetrieveMetadata( int metadataId, const QString& url,
         {
             QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Unknown mime type for tagging: %2');" )
                     .arg( metadataId ).arg( mime_type );
-            m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
-            return;
+            return javascript;
         }
 
         if ( stream.num_requests() > 2)
@@ -610,8 +661,7 @@ JSResolverHelper::nativeRetrieveMetadata( int metadataId, const QString& url,
         {
             QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Could not read tag information.');" )
                     .arg( metadataId );
-            m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
-            return;
+            return javascript;
         }
 
         QVariantMap m;
@@ -624,16 +674,14 @@ JSResolverHelper::nativeRetrieveMetadata( int metadataId, const QString& url,
         {
             QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Empty track returnd');" )
                     .arg( metadataId );
-            m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
-            return;
+            return javascript;
         }
 
         if ( m["artist"].toString().isEmpty() )
         {
             QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Empty artist returnd');" )
                     .arg( metadataId );
-            m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
-            return;
+            return javascript;
         }
 
         if ( tag->audioProperties() )
@@ -647,13 +695,13 @@ JSResolverHelper::nativeRetrieveMetadata( int metadataId, const QString& url,
         QString javascript = QString( "Tomahawk.retrievedMetadata( %1, %2 );" )
                 .arg( metadataId )
                 .arg( QString::fromLatin1( TomahawkUtils::toJson( m ) ) );
-        m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
+        return javascript;
     }
     else
     {
         QString javascript = QString( "Tomahawk.retrievedMetadata( %1, null, 'Protocol not supported');" )
                 .arg( metadataId );
-        m_resolver->d_func()->scriptAccount->evaluateJavaScript( javascript );
+        return javascript;
     }
 }
 
@@ -711,6 +759,15 @@ JSResolverHelper::nativeAsyncRequest( const int requestId, const QVariantMap& op
     {
         reply = new NetworkReply( Tomahawk::Utils::nam()->head( req ) );
     }
+    // scripts outside of WebKit do all their requests through here
+    else if ( options.contains( "method") && options["method"].toString().toUpper() == "PUT" )
+    {
+        reply = new NetworkReply( Tomahawk::Utils::nam()->put( req, options["data"].toString().toUtf8() ) );
+    }
+    else if ( options.contains( "method") && options["method"].toString().toUpper() == "DELETE" )
+    {
+        reply = new NetworkReply( Tomahawk::Utils::nam()->deleteResource( req ) );
+    }
     else
     {
         reply = new NetworkReply( Tomahawk::Utils::nam()->get( req ) );
@@ -798,19 +855,60 @@ JSResolverHelper::indexDataFromVariant( const QVariantMap &map, struct Tomahawk:
 }
 
 
-void
-JSResolverHelper::createFuzzyIndex( const QVariantList& list )
+QList< IndexData >
+JSResolverHelper::indexDataFromList( const QVariantList& list )
 {
-    if ( hasFuzzyIndex() )
+    QList< IndexData > data;
+    if ( list.isEmpty() )
+        return data;
+
+    if ( list.first().canConvert( QVariant::Map ) )
     {
-        m_resolver->d_func()->fuzzyIndex->wipeIndex();
+        data.reserve( list.count() );
+        foreach ( const QVariant& variant, list )
+        {
+            // Convert each entry and do multiple checks that we have valid data.
+            struct IndexData indexData;
+            if ( variant.canConvert( QVariant::Map ) && indexDataFromVariant( variant.toMap(), indexData ) )
+                data << indexData;
+        }
+
+        return data;
     }
-    else
+
+    if ( list.count() % FUZZY_INDEX_ROW_SIZE != 0 )
+        tLog() << Q_FUNC_INFO << "Ignoring incomplete entry at the end of the list";
+
+    data.reserve( list.count() / FUZZY_INDEX_ROW_SIZE );
+    for ( int i = 0; i + FUZZY_INDEX_ROW_SIZE <= list.count(); i += FUZZY_INDEX_ROW_SIZE )
     {
-        m_resolver->d_func()->fuzzyIndex.reset( new FuzzyIndex( m_resolver, accountId() + ".lucene", true ) );
+        struct IndexData indexData;
+        bool ok;
+        indexData.id = list.at( i ).toInt( &ok );
+        indexData.artistId = 0;
+        indexData.artist = list.at( i + 1 ).toString().trimmed();
+        indexData.album = list.at( i + 2 ).toString();
+        indexData.track = list.at( i + 3 ).toString().trimmed();
+
+        if ( ok && !indexData.artist.isEmpty() && !indexData.track.isEmpty() )
+            data << indexData;
     }
 
-    addToFuzzyIndex( list );
+    return data;
+}
+
+
+void
+JSResolverHelper::createFuzzyIndex( const QVariantList& list )
+{
+    if ( !hasFuzzyIndex() )
+    {
+        // Opened in the pool, after a deleted index is gone from the same directory
+        m_resolver->d_func()->fuzzyIndex = QSharedPointer< FuzzyIndex >( new FuzzyIndex( 0, accountId() + ".lucene", true, true ), &QObject::deleteLater );
+        QtConcurrent::run( &m_fuzzyIndexPool, &JSResolverHelper::openFuzzyIndex, m_resolver->d_func()->fuzzyIndex );
+    }
+
+    QtConcurrent::run( &m_fuzzyIndexPool, &JSResolverHelper::rebuildFuzzyIndex, m_resolver->d_func()->fuzzyIndex, indexDataFromList( list ) );
 }
 
 
@@ -823,26 +921,79 @@ JSResolverHelper::addToFuzzyIndex( const QVariantList& list )
         return;
     }
 
-    m_resolver->d_func()->fuzzyIndex->beginIndexing();
+    QtConcurrent::run( &m_fuzzyIndexPool, &JSResolverHelper::updateFuzzyIndex, m_resolver->d_func()->fuzzyIndex, indexDataFromList( list ) );
+}
+
 
-    foreach ( const QVariant& variant, list )
+void
+JSResolverHelper::removeFromFuzzyIndex( const QVariantList& ids )
+{
+    if ( !hasFuzzyIndex() )
     {
-        // Convert each entry to IndexData
-        if ( variant.canConvert( QVariant::Map ) )
-        {
-            QVariantMap map = variant.toMap();
+        tLog() << Q_FUNC_INFO << "Cannot remove entries from non-existing index.";
+        return;
+    }
 
-            // Convert each entry and do multiple checks that we have valid data.
-            struct IndexData indexData;
+    QList< IndexData > data;
+    foreach ( const QVariant& id, ids )
+    {
+        // without a track or album name the id is taken for a track id
+        struct IndexData indexData;
+        bool ok;
+        indexData.id = id.toInt( &ok );
+        indexData.artistId = 0;
+        if ( ok )
+            data << indexData;
+    }
 
-            if ( indexDataFromVariant( map, indexData ) )
-            {
-                m_resolver->d_func()->fuzzyIndex->appendFields( indexData );
-            }
-        }
+    QtConcurrent::run( &m_fuzzyIndexPool, &JSResolverHelper::pruneFuzzyIndex, m_resolver->d_func()->fuzzyIndex, data );
+}
+
+
+/// This method is run by QtConcurrent:
+void
+JSResolverHelper::openFuzzyIndex( const QSharedPointer< FuzzyIndex >& index )
+{
+    index->open( true );
+}
+
+
+/// This method is run by QtConcurrent:
+void
+JSResolverHelper::rebuildFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< IndexData >& data )
+{
+    index->beginIndexing();
+
+    foreach ( const IndexData& indexData, data )
+    {
+        index->appendFields( indexData );
     }
 
-    m_resolver->d_func()->fuzzyIndex->endIndexing();
+    index->endIndexing();
+}
+
+
+/// This method is run by QtConcurrent:
+void
+JSResolverHelper::updateFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< IndexData >& data )
+{
+    index->updateFields( data );
+}
+
+
+/// This method is run by QtConcurrent:
+void
+JSResolverHelper::pruneFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< IndexData >& data )
+{
+    index->deleteFields( data );
+}
+
+
+/// This method is run by QtConcurrent:
+void
+JSResolverHelper::deleteFuzzyIndexFiles( const QSharedPointer< FuzzyIndex >& index )
+{
+    index->deleteIndex();
 }
 
 
@@ -904,9 +1055,9 @@ JSResolverHelper::deleteFuzzyIndex()
 {
     if ( m_resolver->d_func()->fuzzyIndex )
     {
-        m_resolver->d_func()->fuzzyIndex->deleteIndex();
-        m_resolver->d_func()->fuzzyIndex->deleteLater();
-        m_resolver->d_func()->fuzzyIndex.reset();
+        // after whatever indexing is still pending
+        QtConcurrent::run( &m_fuzzyIndexPool, &JSResolverHelper::deleteFuzzyIndexFiles, m_resolver->d_func()->fuzzyIndex );
+        m_resolver->d_func()->fuzzyIndex.clear();
     }
 }
 
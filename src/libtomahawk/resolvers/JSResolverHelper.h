@@ -29,6 +29,7 @@
 #include "utils/NetworkReply.h"
 
 #include <QObject>
+#include <QThreadPool>
 #include <QVariantMap>
 
 #include <functional>
@@ -98,8 +99,26 @@ public:
      **/
 
     Q_INVOKABLE bool hasFuzzyIndex();
+    /**
+     * Replaces the index with the tracks in @p list. It holds either a map
+     * with id, artist, album and track for each of them, or, cheaper to
+     * hand over, just their values one after the other:
+     *
+     *     [ id1, artist1, album1, track1, id2, artist2, album2, track2, ... ]
+     *
+     * Indexing happens in the background, searches see the old index
+     * until it is done.
+     */
     Q_INVOKABLE void createFuzzyIndex( const QVariantList& list );
+    /**
+     * Adds the tracks in @p list, see createFuzzyIndex(), replacing those
+     * indexed with the same id already
+     */
     Q_INVOKABLE void addToFuzzyIndex( const QVariantList& list );
+    /**
+     * Removes the tracks with the given @p ids
+     */
+    Q_INVOKABLE void removeFromFuzzyIndex( const QVariantList& ids );
     Q_INVOKABLE QVariantList searchFuzzyIndex( const QString& query );
     Q_INVOKABLE QVariantList resolveFromFuzzyIndex( const QString& artist, const QString& album, const QString& tracks );
     Q_INVOKABLE void deleteFuzzyIndex();
@@ -132,19 +151,37 @@ public slots:
 
 private slots:
     void nativeAsyncRequestDone( int requestId, NetworkReply* reply );
+    void nativeRetrieveMetadataDone();
 
 private:
     bool indexDataFromVariant( const QVariantMap& map, struct Tomahawk::IndexData& indexData );
+    QList< Tomahawk::IndexData > indexDataFromList( const QVariantList& list );
     QVariantList searchInFuzzyIndex( const Tomahawk::query_ptr& query );
 
+    /**
+     * The script that hands the metadata of @p url to the resolver
+     */
+    static QString retrieveMetadata( int metadataId, const QString& url,
+                                     const QString& mimetype,
+                                     int sizehint,
+                                     const QVariantMap& options );
+
     // native script jobs
     void nativeAsyncRequest( int requestId, const QVariantMap& options );
 
+    // run one after the other in m_fuzzyIndexPool
+    static void openFuzzyIndex( const QSharedPointer< FuzzyIndex >& index );
+    static void rebuildFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< Tomahawk::IndexData >& data );
+    static void updateFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< Tomahawk::IndexData >& data );
+    static void pruneFuzzyIndex( const QSharedPointer< FuzzyIndex >& index, const QList< Tomahawk::IndexData >& data );
+    static void deleteFuzzyIndexFiles( const QSharedPointer< FuzzyIndex >& index );
+
 
     QVariantMap m_resolverConfig;
     JSResolver* m_resolver;
     QString m_scriptPath;
     bool m_stopped;
+    QThreadPool m_fuzzyIndexPool;
 };
 
 } // ns: Tomahawk
@@ -27,6 +27,8 @@
 #include "JSResolverHelper.h"
 #include "database/fuzzyindex/FuzzyIndex.h"
 
+#include <QSharedPointer>
+
 #include <memory> // unique_ptr
 
 namespace Tomahawk
@@ -61,7 +63,8 @@ private:
     Tomahawk::ExternalResolver::ErrorState error;
 
     JSResolverHelper* resolverHelper;
-    QScopedPointer<FuzzyIndex> fuzzyIndex;
+    // background indexing holds on to it, see JSResolverHelper
+    QSharedPointer< FuzzyIndex > fuzzyIndex;
     QPointer< AccountConfigWidget > configWidget;
     QList< QVariant > dataWidgets;
     QStringList requiredScriptPaths;
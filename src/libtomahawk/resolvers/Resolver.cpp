@@ -37,6 +37,14 @@ Tomahawk::Resolver::icon( const QSize& ) const
 }
 
 
+void
+Tomahawk::Resolver::resolveBatch( const QList< Tomahawk::query_ptr >& queries )
+{
+    foreach ( const Tomahawk::query_ptr& query, queries )
+        resolve( query );
+}
+
+
 Tomahawk::ScriptJob*
 Tomahawk::Resolver::getStreamUrl( const result_ptr& result )
 {
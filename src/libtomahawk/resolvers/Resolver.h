@@ -52,6 +52,12 @@ public:
     virtual unsigned int timeout() const = 0;
 
     virtual void resolve( const Tomahawk::query_ptr& query ) = 0;
+    /**
+     * Resolves several queries at once. Resolvers that can answer many
+     * queries cheaper in one go should reimplement this, the default just
+     * calls resolve() for each of them.
+     */
+    virtual void resolveBatch( const QList< Tomahawk::query_ptr >& queries );
     virtual ScriptJob* getStreamUrl( const result_ptr& result );
     virtual ScriptJob* getDownloadUrl( const result_ptr& result, const DownloadFormat& format );
 };
@@ -414,29 +414,54 @@ ScriptAccount::parseResultVariantList( const QVariantList& reslist )
 }
 
 
-ScriptJob*
-ScriptAccount::resolve( const scriptobject_ptr& scriptObject, const query_ptr& query, const QString& resolveType )
+static QVariantMap
+resolveArguments( const query_ptr& query, const QString& resolveType )
 {
-    ScriptJob* job = nullptr;
+    QVariantMap arguments;
     if ( !query->isFullTextQuery() )
     {
-        QVariantMap arguments;
         arguments["artist"] = query->queryTrack()->artist();
         arguments["album"] = query->queryTrack()->album();
         arguments["track"] = query->queryTrack()->track();
-        arguments["type"] = resolveType;
-
-        job = scriptObject->invoke( "resolve", arguments );
     }
     else
     {
-        QVariantMap arguments;
         arguments["query"] = query->fullTextQuery();
-        arguments["type"] = resolveType;
-        job = scriptObject->invoke( "search", arguments );
     }
+    arguments["type"] = resolveType;
+
+    return arguments;
+}
+
+
+ScriptJob*
+ScriptAccount::resolve( const scriptobject_ptr& scriptObject, const query_ptr& query, const QString& resolveType )
+{
+    ScriptJob* job = scriptObject->invoke( query->isFullTextQuery() ? "search" : "resolve",
+                                           resolveArguments( query, resolveType ) );
 
     job->setProperty( "qid", query->id() );
 
     return job;
 }
+
+
+ScriptJob*
+ScriptAccount::resolveBatch( const scriptobject_ptr& scriptObject, const QList< query_ptr >& queries, const QString& resolveType )
+{
+    QVariantList queryList;
+    QStringList qids;
+    foreach ( const query_ptr& query, queries )
+    {
+        queryList << resolveArguments( query, resolveType );
+        qids << query->id();
+    }
+
+    QVariantMap arguments;
+    arguments["queries"] = queryList;
+
+    ScriptJob* job = scriptObject->invoke( "resolveBatch", arguments );
+    job->setProperty( "qids", qids );
+
+    return job;
+}
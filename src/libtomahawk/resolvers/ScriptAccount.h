@@ -83,6 +83,11 @@ public:
     QList< Tomahawk::album_ptr > parseAlbumVariantList( const QVariantList& albumList );
     QList< Tomahawk::result_ptr > parseResultVariantList( const QVariantList& reslist );
     ScriptJob* resolve( const scriptobject_ptr& scriptObject, const query_ptr& query, const QString& resolveType );
+    /**
+     * One script call for all @p queries, the job's data carries a "results"
+     * list in the same order. The qids are stored in the job's "qids" property.
+     */
+    ScriptJob* resolveBatch( const scriptobject_ptr& scriptObject, const QList< query_ptr >& queries, const QString& resolveType );
 
 private slots:
     void onJobDeleted( const QString& jobId );
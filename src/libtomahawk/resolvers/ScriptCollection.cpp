@@ -26,6 +26,7 @@
 #include "resolvers/ScriptCommand_AllArtists.h"
 #include "resolvers/ScriptCommand_AllAlbums.h"
 #include "resolvers/ScriptCommand_AllTracks.h"
+#include "resolvers/ScriptCommandQueue.h"
 #include "resolvers/ScriptJob.h"
 #include "ScriptAccount.h"
 #include "Result.h"
@@ -35,6 +36,10 @@
 #include <QPainter>
 #include <QFileInfo>
 
+// Commands running at the same time unless the script says otherwise, so
+// listing a large collection doesn't hold up browsing it
+#define DEFAULT_CONCURRENCY 2
+
 
 using namespace Tomahawk;
 
@@ -46,6 +51,7 @@ ScriptCollection::ScriptCollection( const scriptobject_ptr& scriptObject,
     : Collection( source, QString( "scriptcollection:" + scriptAccount->name() + ":" + uuid() ), parent )
     , ScriptPlugin( scriptObject )
     , m_scriptAccount( scriptAccount )
+    , m_commandQueue( new ScriptCommandQueue( this ) )
     , m_trackCount( -1 ) //null value
     , m_isOnline( true )
 {
@@ -53,6 +59,7 @@ ScriptCollection::ScriptCollection( const scriptobject_ptr& scriptObject,
     qDebug() << Q_FUNC_INFO << scriptAccount->name() << Collection::name();
 
     m_servicePrettyName = scriptAccount->name();
+    m_commandQueue->setMaxRunning( DEFAULT_CONCURRENCY );
     m_weight  = readMetaData().value( "weight", 99 ).toUInt();
 }
 
@@ -201,6 +208,20 @@ ScriptCollection::requestTracks( const Tomahawk::album_ptr& album )
 }
 
 
+void
+ScriptCollection::enqueue( const QSharedPointer< ScriptCommand >& command )
+{
+    m_commandQueue->enqueue( command );
+}
+
+
+ScriptCommandQueue*
+ScriptCollection::commandQueue() const
+{
+    return m_commandQueue;
+}
+
+
 void
 ScriptCollection::setTrackCount( int count )
 {
@@ -266,6 +287,14 @@ ScriptCollection::parseMetaData( const QVariantMap& metadata )
             setTrackCount( trackCount );
     }
 
+    if ( metadata.contains( "concurrency" ) )
+    {
+        bool ok = false;
+        int concurrency = metadata.value( "concurrency" ).toInt( &ok );
+        if ( ok && concurrency > 0 )
+            m_commandQueue->setMaxRunning( concurrency );
+    }
+
     if ( metadata.contains( "iconfile" ) )
     {
         QString iconPath = QFileInfo( scriptAccount()->filePath() ).path() + "/"
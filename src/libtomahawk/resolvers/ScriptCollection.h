@@ -35,6 +35,8 @@
 namespace Tomahawk
 {
 class ScriptAccount;
+class ScriptCommand;
+class ScriptCommandQueue;
 
 class DLLEXPORT ScriptCollection : public Collection, public ScriptPlugin
 {
@@ -84,6 +86,13 @@ public:
     Tomahawk::AlbumsRequest*  requestAlbums( const Tomahawk::artist_ptr& artist ) override;
     Tomahawk::TracksRequest*  requestTracks( const Tomahawk::album_ptr& album ) override;
 
+    /**
+     * Runs @p command once it is its turn. The script reports with
+     * "concurrency" in its collection info how many run at the same time.
+     */
+    void enqueue( const QSharedPointer< ScriptCommand >& command );
+    ScriptCommandQueue* commandQueue() const;
+
     void setTrackCount( int count );
     int trackCount() const override;
 
@@ -104,6 +113,7 @@ private slots:
 
 private:
     ScriptAccount* m_scriptAccount;
+    ScriptCommandQueue* m_commandQueue;
     QString m_servicePrettyName;
     QString m_description;
     int m_trackCount;
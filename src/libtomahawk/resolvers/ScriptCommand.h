@@ -27,9 +27,28 @@ namespace Tomahawk
 class ScriptCommand : public QObject
 {
 public:
+    /**
+     * Queued commands of a higher priority run first, see ScriptCommandQueue
+     */
+    enum Priority
+    {
+        BulkPriority,       // whole collection listings
+        BrowsePriority,     // what a view shows next
+        InteractivePriority // what the user waits for right now
+    };
+
     explicit ScriptCommand( QObject* parent = 0 ) : QObject( parent ) {}
     virtual ~ScriptCommand() {}
 
+    virtual Priority priority() const { return BrowsePriority; }
+
+    /**
+     * A command still waiting in the queue is dropped when another one with
+     * the same key gets enqueued, it reports a failure instead of running.
+     * Empty keys never match
+     */
+    virtual QString supersedeKey() const { return QString(); }
+
 signals:
     virtual void done() = 0;
 
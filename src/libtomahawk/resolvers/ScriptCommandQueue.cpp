@@ -18,90 +18,223 @@
 
 #include "ScriptCommandQueue.h"
 
+#include "utils/Logger.h"
+
 #include <QMetaType>
-#include <QMutex>
+
+// ms a running command gets before we report it as failed
+#define COMMAND_TIMEOUT 20000
 
 using namespace  Tomahawk;
 
 ScriptCommandQueue::ScriptCommandQueue( QObject* parent )
     : QObject( parent )
-    , m_timer( new QTimer( this ) )
+    , m_maxRunning( 1 )
+    , m_finished( 0 )
+    , m_timeouts( 0 )
+    , m_superseded( 0 )
+    , m_totalWait( 0 )
+    , m_maxWait( 0 )
+    , m_totalRun( 0 )
+    , m_maxRun( 0 )
 {
-    m_timer->setSingleShot( true );
 }
 
 
 void
-ScriptCommandQueue::enqueue( const QSharedPointer< ScriptCommand >& req )
+ScriptCommandQueue::setMaxRunning( int maxRunning )
 {
-    QMutexLocker locker( &m_mutex );
-    m_queue.append( req );
-    locker.unlock();
-
-    if ( m_queue.count() == 1 )
-        nextCommand();
+    m_maxRunning = qMax( maxRunning, 1 );
+    nextCommand();
 }
 
 
-void
-ScriptCommandQueue::nextCommand()
+int
+ScriptCommandQueue::maxRunning() const
 {
-    if ( m_queue.isEmpty() )
-        return;
+    return m_maxRunning;
+}
 
-    QSharedPointer< ScriptCommand > req = m_queue.first();
 
-    connect( req.data(), SIGNAL( done() ),
-             this, SLOT( onCommandDone() ) );
-    connect( m_timer, SIGNAL( timeout() ),
-             this, SLOT( onTimeout() ) );
+void
+ScriptCommandQueue::enqueue( const QSharedPointer< ScriptCommand >& req )
+{
+    // whoever asked again doesn't wait for the older answer anymore
+    QList< QSharedPointer< ScriptCommand > > superseded;
+    const QString key = req->supersedeKey();
+    if ( !key.isEmpty() )
+    {
+        for ( int priority = 0; priority <= ScriptCommand::InteractivePriority; priority++ )
+        {
+            QMutableListIterator< Entry > it( m_queues[ priority ] );
+            while ( it.hasNext() )
+            {
+                if ( it.next().command->supersedeKey() == key )
+                {
+                    superseded << it.value().command;
+                    it.remove();
+                    m_superseded++;
+                }
+            }
+        }
+    }
+
+    Entry entry;
+    entry.command = req;
+    entry.elapsed.start();
+    entry.waited = 0;
+    entry.timer = 0;
+    m_queues[ req->priority() ].enqueue( entry );
+
+    // still answer them, empty, so nobody keeps waiting for them
+    foreach ( const QSharedPointer< ScriptCommand >& command, superseded )
+        command->reportFailure();
+
+    nextCommand();
+}
 
-    m_timer->start( 20000 );
 
-    req->exec();
+void
+ScriptCommandQueue::nextCommand()
+{
+    while ( m_running.count() < m_maxRunning )
+    {
+        int priority = ScriptCommand::InteractivePriority;
+        while ( priority >= 0 && m_queues[ priority ].isEmpty() )
+            priority--;
+        if ( priority < 0 )
+            return;
+
+        Entry entry = m_queues[ priority ].dequeue();
+        entry.waited = entry.elapsed.restart();
+        entry.timer = new QTimer( this );
+        entry.timer->setSingleShot( true );
+
+        connect( entry.command.data(), SIGNAL( done() ),
+                 this, SLOT( onCommandDone() ) );
+        connect( entry.timer, SIGNAL( timeout() ),
+                 this, SLOT( onTimeout() ) );
+
+        entry.timer->start( COMMAND_TIMEOUT );
+        m_running << entry;
+
+        // might be done right away and finish() in here
+        entry.command->exec();
+    }
 }
 
 
 void
 ScriptCommandQueue::onCommandDone()
 {
-    if ( m_queue.isEmpty() || !m_timer->isActive() ) //the timeout already happened or some other weird thing
-        return;                                      //nothing to do here
-
-    m_timer->stop();
-
-    QMutexLocker locker( &m_mutex );
-    const QSharedPointer< ScriptCommand > req = m_queue.first();
-    m_queue.removeAll( req );
-    locker.unlock();
+    for ( int i = 0; i < m_running.count(); i++ )
+    {
+        if ( m_running.at( i ).command.data() == sender() )
+        {
+            finish( m_running.at( i ).command.data(), false );
+            return;
+        }
+    }
+
+    // the timeout already happened, it can go now, but not while it emits done()
+    for ( int i = 0; i < m_timedOut.count(); i++ )
+    {
+        if ( m_timedOut.at( i ).data() == sender() )
+        {
+            m_released << m_timedOut.takeAt( i );
+            QMetaObject::invokeMethod( this, "releaseCommands", Qt::QueuedConnection );
+            return;
+        }
+    }
+}
 
-    disconnect( req.data(), SIGNAL( done() ),
-                this, SLOT( onCommandDone() ) );
-    disconnect( m_timer, SIGNAL( timeout() ),
-                this, SLOT( onTimeout() ) );
 
-    if ( !m_queue.isEmpty() )
-        nextCommand();
+void
+ScriptCommandQueue::onTimeout()
+{
+    for ( int i = 0; i < m_running.count(); i++ )
+    {
+        if ( m_running.at( i ).timer == sender() )
+        {
+            finish( m_running.at( i ).command.data(), true );
+            return;
+        }
+    }
 }
 
 
 void
-ScriptCommandQueue::onTimeout()
+ScriptCommandQueue::releaseCommands()
 {
-    m_timer->stop();
+    m_released.clear();
+}
 
-    QMutexLocker locker( &m_mutex );
-    const QSharedPointer< ScriptCommand > req = m_queue.first();
-    m_queue.removeAll( req );
-    locker.unlock();
 
-    req->reportFailure();
+void
+ScriptCommandQueue::finish( ScriptCommand* command, bool timedOut )
+{
+    int index = 0;
+    while ( m_running.at( index ).command.data() != command )
+        index++;
+
+    const Entry entry = m_running.takeAt( index );
+    const qint64 ran = entry.elapsed.elapsed();
+
+    m_finished++;
+    if ( timedOut )
+        m_timeouts++;
+    m_totalWait += entry.waited;
+    m_maxWait = qMax( m_maxWait, entry.waited );
+    m_totalRun += ran;
+    m_maxRun = qMax( m_maxRun, ran );
+
+    tDebug( LOGVERBOSE ) << Q_FUNC_INFO << entry.command->metaObject()->className()
+                         << "waited" << entry.waited << "ms, ran" << ran << "ms" << ( timedOut ? "and timed out" : "" );
+
+    // we might be in its timeout()
+    entry.timer->stop();
+    entry.timer->deleteLater();
+
+    if ( timedOut )
+    {
+        // it is in neither list while it reports
+        entry.command->reportFailure();
+
+        // Whatever it comes up with later goes nowhere, we only wait for it
+        // to be done before we let it go
+        entry.command->disconnect();
+        connect( entry.command.data(), SIGNAL( done() ),
+                 this, SLOT( onCommandDone() ) );
+        m_timedOut << entry.command;
+    }
+    else
+    {
+        disconnect( entry.command.data(), SIGNAL( done() ),
+                    this, SLOT( onCommandDone() ) );
+    }
+
+    nextCommand();
+}
 
-    disconnect( req.data(), SIGNAL( done() ),
-                this, SLOT( onCommandDone() ) );
-    disconnect( m_timer, SIGNAL( timeout() ),
-                this, SLOT( onTimeout() ) );
 
-    if ( !m_queue.isEmpty() )
-        nextCommand();
+QVariantMap
+ScriptCommandQueue::metrics() const
+{
+    QVariantList waiting;
+    for ( int priority = 0; priority <= ScriptCommand::InteractivePriority; priority++ )
+        waiting << m_queues[ priority ].count();
+
+    QVariantMap m;
+    m[ "waiting" ] = waiting; // by priority, lowest first
+    m[ "running" ] = m_running.count();
+    m[ "maxRunning" ] = m_maxRunning;
+    m[ "finished" ] = m_finished;
+    m[ "timeouts" ] = m_timeouts;
+    m[ "superseded" ] = m_superseded;
+    m[ "averageWait" ] = m_finished ? m_totalWait / m_finished : 0;
+    m[ "maxWait" ] = m_maxWait;
+    m[ "averageRun" ] = m_finished ? m_totalRun / m_finished : 0;
+    m[ "maxRun" ] = m_maxRun;
+
+    return m;
 }
@@ -21,33 +21,79 @@
 
 #include "ScriptCommand.h"
 
+#include <QElapsedTimer>
 #include <QQueue>
 #include <QSharedPointer>
 #include <QTimer>
 #include <QMetaType>
-#include <QMutex>
+#include <QVariantMap>
+
+#include "DllMacro.h"
 
 namespace Tomahawk
 {
 
-class ScriptCommandQueue : public QObject
+/**
+ * Runs the ScriptCommands of a resolver or collection, up to maxRunning()
+ * at a time. Waiting commands of a higher ScriptCommand::Priority go first,
+ * the queue takes over ownership of all of them.
+ */
+class DLLEXPORT ScriptCommandQueue : public QObject
 {
     Q_OBJECT
 public:
     explicit ScriptCommandQueue( QObject* parent = 0 );
     virtual ~ScriptCommandQueue() {}
 
+    /**
+     * How many commands run at the same time, 1 by default
+     */
+    void setMaxRunning( int maxRunning );
+    int maxRunning() const;
+
     void enqueue( const QSharedPointer< ScriptCommand >& req );
 
+    /**
+     * Waiting and running commands, and how long the finished ones waited
+     * in the queue compared to how long they ran, in ms
+     */
+    QVariantMap metrics() const;
+
 private slots:
     void nextCommand();
     void onCommandDone();
     void onTimeout();
+    void releaseCommands();
 
 private:
-    QQueue< QSharedPointer< ScriptCommand > > m_queue;
-    QTimer* m_timer;
-    QMutex m_mutex;
+    struct Entry
+    {
+        QSharedPointer< ScriptCommand > command;
+        QElapsedTimer elapsed; // since it was enqueued, then since it started
+        qint64 waited;
+        QTimer* timer;
+    };
+
+    /**
+     * Takes the running @p command out
+     */
+    void finish( ScriptCommand* command, bool timedOut );
+
+    QQueue< Entry > m_queues[ ScriptCommand::InteractivePriority + 1 ];
+    QList< Entry > m_running;
+    // kept until they are done after all, their results go nowhere
+    QList< QSharedPointer< ScriptCommand > > m_timedOut;
+    // done after they timed out, released once their done() is over
+    QList< QSharedPointer< ScriptCommand > > m_released;
+    int m_maxRunning;
+
+    int m_finished;
+    int m_timeouts;
+    int m_superseded;
+    qint64 m_totalWait;
+    qint64 m_maxWait;
+    qint64 m_totalRun;
+    qint64 m_maxRun;
 };
 
 } // ns: Tomahawk
@@ -50,7 +50,27 @@ ScriptCommand_AllAlbums::enqueue()
         return;
     }
 
-    exec();
+    collection->enqueue( QSharedPointer< ScriptCommand >( this, &QObject::deleteLater ) );
+}
+
+
+ScriptCommand::Priority
+ScriptCommand_AllAlbums::priority() const
+{
+    // filtering happens while the user types
+    return m_filter.isEmpty() ? BrowsePriority : InteractivePriority;
+}
+
+
+QString
+ScriptCommand_AllAlbums::supersedeKey() const
+{
+    if ( m_filter.isEmpty() || !m_requester )
+        return QString();
+
+    return QString( "albums?filter&requester=%1&artist=%2" )
+              .arg( quintptr( m_requester.data() ) )
+              .arg( m_artist ? m_artist->name() : QString() );
 }
 
 
@@ -61,6 +81,13 @@ ScriptCommand_AllAlbums::setFilter( const QString& filter )
 }
 
 
+void
+ScriptCommand_AllAlbums::setRequester( QObject* requester )
+{
+    m_requester = requester;
+}
+
+
 void
 ScriptCommand_AllAlbums::exec()
 {
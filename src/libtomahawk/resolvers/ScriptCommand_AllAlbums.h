@@ -24,6 +24,8 @@
 #include "collection/Collection.h"
 #include "resolvers/ScriptCommand.h"
 
+#include <QPointer>
+
 namespace Tomahawk
 {
 
@@ -39,6 +41,14 @@ public:
     void enqueue() override;
 
     void setFilter( const QString& filter ) override;
+    void setRequester( QObject* requester ) override;
+
+    Priority priority() const override;
+    /**
+     * A newer filter of the same requester for the same artist replaces a
+     * waiting one
+     */
+    QString supersedeKey() const override;
 
 signals:
     void albums( const QList< Tomahawk::album_ptr >& ) override;
@@ -57,6 +67,7 @@ private:
     Tomahawk::collection_ptr m_collection;
     Tomahawk::artist_ptr m_artist;
     QString m_filter;
+    QPointer< QObject > m_requester;
 };
 
 } // ns: Tomahawk
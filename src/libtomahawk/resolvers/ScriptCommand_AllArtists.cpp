@@ -47,7 +47,26 @@ ScriptCommand_AllArtists::enqueue()
         return;
     }
 
-    exec();
+    collection->enqueue( QSharedPointer< ScriptCommand >( this, &QObject::deleteLater ) );
+}
+
+
+ScriptCommand::Priority
+ScriptCommand_AllArtists::priority() const
+{
+    // filtering happens while the user types
+    return m_filter.isEmpty() ? BrowsePriority : InteractivePriority;
+}
+
+
+QString
+ScriptCommand_AllArtists::supersedeKey() const
+{
+    // a newer filter of the same requester replaces a waiting one
+    if ( m_filter.isEmpty() || !m_requester )
+        return QString();
+
+    return QString( "artists?filter&requester=%1" ).arg( quintptr( m_requester.data() ) );
 }
 
 
@@ -58,6 +77,13 @@ ScriptCommand_AllArtists::setFilter( const QString& filter )
 }
 
 
+void
+ScriptCommand_AllArtists::setRequester( QObject* requester )
+{
+    m_requester = requester;
+}
+
+
 void
 ScriptCommand_AllArtists::exec()
 {
@@ -24,6 +24,8 @@
 #include "collection/Collection.h"
 #include "resolvers/ScriptCommand.h"
 
+#include <QPointer>
+
 namespace Tomahawk
 {
 
@@ -40,6 +42,10 @@ public:
     void enqueue() override;
 
     void setFilter( const QString& filter ) override;
+    void setRequester( QObject* requester ) override;
+
+    Priority priority() const override;
+    QString supersedeKey() const override;
 
 signals:
     void artists( const QList< Tomahawk::artist_ptr >& ) override;
@@ -57,6 +63,7 @@ private:
 
     Tomahawk::collection_ptr m_collection;
     QString m_filter;
+    QPointer< QObject > m_requester;
 };
 
 } // ns: Tomahawk
@@ -52,7 +52,15 @@ ScriptCommand_AllTracks::enqueue()
         return;
     }
 
-    exec();
+    collection->enqueue( QSharedPointer< ScriptCommand >( this, &QObject::deleteLater ) );
+}
+
+
+ScriptCommand::Priority
+ScriptCommand_AllTracks::priority() const
+{
+    // all tracks of a large collection take a while, albums should not wait for them
+    return m_album ? BrowsePriority : BulkPriority;
 }
 
 
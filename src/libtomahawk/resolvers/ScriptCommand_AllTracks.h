@@ -38,6 +38,8 @@ public:
 
     void enqueue() override;
 
+    Priority priority() const override;
+
 signals:
     void tracks( const QList< Tomahawk::query_ptr >& ) override;
     void done() override;
@@ -42,6 +42,14 @@ ScriptCommand_LookupUrl::enqueue()
 }
 
 
+ScriptCommand::Priority
+ScriptCommand_LookupUrl::priority() const
+{
+    // someone dropped or opened the url and waits for it
+    return InteractivePriority;
+}
+
+
 void
 ScriptCommand_LookupUrl::exec()
 {
@@ -43,6 +43,8 @@ public:
 
     void enqueue();
 
+    Priority priority() const override;
+
 signals:
     void information( const QString& url, const QSharedPointer<QObject>& variant );
     void done() override;
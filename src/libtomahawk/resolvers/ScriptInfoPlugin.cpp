@@ -37,7 +37,7 @@ ScriptInfoPlugin::ScriptInfoPlugin( const scriptobject_ptr& scriptObject, const
 {
     Q_ASSERT( scriptObject );
 
-    // read in supported GetTypes and PushTypes - we can do this safely because we are still in WebKit thread here
+    // read in supported GetTypes and PushTypes - we can do this safely even though the script is still registering us, a JSContext runs these calls while it waits
     m_supportedGetTypes = parseSupportedTypes( m_scriptObject->syncInvoke( "supportedGetTypes" ) );
     m_supportedPushTypes = parseSupportedTypes( m_scriptObject->syncInvoke( "supportedPushTypes" ) );
 
@@ -103,10 +103,11 @@ ScriptResolver::~ScriptResolver()
 
 
 Tomahawk::ExternalResolver*
-ScriptResolver::factory( const QString& accountId, const QString& exe, const QStringList& unused )
+ScriptResolver::factory( const QString& accountId, const QString& exe, const QStringList& unused, const QVariantHash& options )
 {
     Q_UNUSED( accountId )
     Q_UNUSED( unused )
+    Q_UNUSED( options )
 
     ExternalResolver* res = 0;
 
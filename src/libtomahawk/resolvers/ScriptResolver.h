@@ -42,7 +42,7 @@ Q_OBJECT
 public:
     explicit ScriptResolver( const QString& exe );
     virtual ~ScriptResolver();
-    static ExternalResolver* factory( const QString& accountId, const QString& exe, const QStringList& );
+    static ExternalResolver* factory( const QString& accountId, const QString& exe, const QStringList&, const QVariantHash& );
 
     QString name() const Q_DECL_OVERRIDE { return m_name; }
     QPixmap icon( const QSize& size ) const Q_DECL_OVERRIDE;
@@ -0,0 +1,126 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARDEDWEAKHASH_H
+#define SHARDEDWEAKHASH_H
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QString>
+
+namespace Tomahawk
+{
+
+namespace Utils
+{
+
+/*
+    Thread-safe QString -> QWeakPointer<T> hash.
+
+    Keys are spread over a fixed number of shards, each with its own mutex,
+    so concurrent lookups of different keys rarely contend. The hash never
+    keeps its values alive: entries whose object got destroyed are dropped
+    when they are looked up, and a shard purges all of its dead entries
+    once it has doubled in size since the last purge.
+*/
+template<class T>
+class ShardedWeakHash
+{
+public:
+    enum { ShardCount = 16 };
+
+    ShardedWeakHash() {}
+
+    void insert( const QString& key, const QSharedPointer<T>& value )
+    {
+        Shard& s = shard( key );
+        QMutexLocker lock( &s.mutex );
+
+        s.hash.insert( key, value.toWeakRef() );
+        if ( s.hash.count() >= 2 * s.purgedSize )
+            s.purge();
+    }
+
+    QSharedPointer<T> value( const QString& key ) const
+    {
+        Shard& s = shard( key );
+        QMutexLocker lock( &s.mutex );
+
+        typename QHash< QString, QWeakPointer<T> >::iterator it = s.hash.find( key );
+        if ( it == s.hash.end() )
+            return QSharedPointer<T>();
+
+        QSharedPointer<T> strong = it.value().toStrongRef();
+        if ( strong.isNull() )
+            s.hash.erase( it );
+
+        return strong;
+    }
+
+    bool contains( const QString& key ) const
+    {
+        return !value( key ).isNull();
+    }
+
+    void remove( const QString& key )
+    {
+        Shard& s = shard( key );
+        QMutexLocker lock( &s.mutex );
+
+        s.hash.remove( key );
+    }
+
+private:
+    Q_DISABLE_COPY( ShardedWeakHash )
+
+    struct Shard
+    {
+        Shard() : purgedSize( 64 ) {}
+
+        void purge()
+        {
+            typename QHash< QString, QWeakPointer<T> >::iterator it = hash.begin();
+            while ( it != hash.end() )
+            {
+                if ( it.value().isNull() )
+                    it = hash.erase( it );
+                else
+                    ++it;
+            }
+
+            purgedSize = qMax( 64, hash.count() );
+        }
+
+        QMutex mutex;
+        QHash< QString, QWeakPointer<T> > hash;
+        int purgedSize;
+    };
+
+    Shard& shard( const QString& key ) const
+    {
+        return m_shards[ qHash( key ) % ShardCount ];
+    }
+
+    mutable Shard m_shards[ ShardCount ];
+};
+
+}
+
+}
+
+#endif // SHARDEDWEAKHASH_H
@@ -0,0 +1,149 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTCOLLECTIONSNAPSHOT_H
+#define TOMAHAWK_TESTCOLLECTIONSNAPSHOT_H
+
+#include <QtTest>
+
+#include "database/CollectionSnapshot.h"
+
+
+class TestCollectionSnapshot : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVariantMap file( uint id, const QString& artist, const QString& album, const QString& track )
+    {
+        QVariantMap m;
+        m[ "id" ] = id;
+        m[ "size" ] = 1000 + id;
+        m[ "mtime" ] = 1400000000 + (int)id;
+        m[ "duration" ] = 200 + id;
+        m[ "bitrate" ] = 320;
+        m[ "albumpos" ] = id;
+        m[ "discnumber" ] = 1;
+        m[ "year" ] = 2014;
+        m[ "hash" ] = QString();
+        m[ "mimetype" ] = "audio/mpeg";
+        m[ "artist" ] = artist;
+        m[ "albumartist" ] = artist;
+        m[ "album" ] = album;
+        m[ "track" ] = track;
+        m[ "composer" ] = QString();
+        return m;
+    }
+
+    static Tomahawk::CollectionSnapshotChunk chunk()
+    {
+        Tomahawk::CollectionSnapshotChunk c;
+        c.first = true;
+        c.lastop = "{00000000-0000-0000-0000-000000000042}";
+        c.files << file( 1, "Artist", "Album", "One" )
+                << file( 2, "Artist", "Album", "Two" )
+                << file( 3, QString::fromUtf8( "Ärtist" ), "Other Album", "One" );
+
+        dbop_ptr op( new DBOp );
+        op->guid = "{00000000-0000-0000-0000-000000000041}";
+        op->command = "createplaylist";
+        op->payload = "{\"title\":\"Playlist\"}";
+        op->compressed = false;
+        op->singleton = true;
+        c.ops << op;
+
+        return c;
+    }
+
+private slots:
+    void testRoundTrip()
+    {
+        const Tomahawk::CollectionSnapshotChunk c = chunk();
+        const QByteArray data = c.serialize();
+        QVERIFY( Tomahawk::CollectionSnapshotChunk::isSnapshot( data ) );
+
+        Tomahawk::CollectionSnapshotChunk parsed;
+        QVERIFY( parsed.deserialize( data ) );
+        QCOMPARE( parsed.first, c.first );
+        QCOMPARE( parsed.lastop, c.lastop );
+        QCOMPARE( parsed.count(), c.count() );
+        QCOMPARE( parsed.files.count(), c.files.count() );
+
+        const char* const fields[] = { "id", "size", "mtime", "duration", "bitrate", "albumpos", "discnumber", "year",
+                                       "hash", "mimetype", "artist", "albumartist", "album", "track", "composer" };
+        for ( int i = 0; i < c.files.count(); i++ )
+        {
+            const QVariantMap expected = c.files.at( i ).toMap();
+            const QVariantMap actual = parsed.files.at( i ).toMap();
+            for ( unsigned int f = 0; f < sizeof( fields ) / sizeof( fields[0] ); f++ )
+                QCOMPARE( actual.value( fields[f] ).toString(), expected.value( fields[f] ).toString() );
+
+            // peers know remote files by their id
+            QCOMPARE( actual.value( "url" ).toString(), expected.value( "id" ).toString() );
+        }
+
+        QCOMPARE( parsed.ops.count(), 1 );
+        QCOMPARE( parsed.ops.first()->guid, c.ops.first()->guid );
+        QCOMPARE( parsed.ops.first()->command, c.ops.first()->command );
+        QCOMPARE( parsed.ops.first()->payload, c.ops.first()->payload );
+        QCOMPARE( parsed.ops.first()->compressed, c.ops.first()->compressed );
+        QCOMPARE( parsed.ops.first()->singleton, c.ops.first()->singleton );
+    }
+
+    void testEmpty()
+    {
+        Tomahawk::CollectionSnapshotChunk c;
+        Tomahawk::CollectionSnapshotChunk parsed;
+        parsed.first = true;
+
+        QVERIFY( parsed.deserialize( c.serialize() ) );
+        QVERIFY( !parsed.first );
+        QVERIFY( parsed.lastop.isEmpty() );
+        QCOMPARE( parsed.count(), 0 );
+    }
+
+    void testIsSnapshot()
+    {
+        // what plain ops look like on the wire
+        QVERIFY( !Tomahawk::CollectionSnapshotChunk::isSnapshot( "{\"command\":\"addfiles\"}" ) );
+        QVERIFY( !Tomahawk::CollectionSnapshotChunk::isSnapshot( QByteArray() ) );
+
+        Tomahawk::CollectionSnapshotChunk parsed;
+        QVERIFY( !parsed.deserialize( "{\"command\":\"addfiles\"}" ) );
+    }
+
+    void testTruncated()
+    {
+        const QByteArray data = chunk().serialize();
+
+        for ( int i = 0; i < data.size(); i++ )
+        {
+            Tomahawk::CollectionSnapshotChunk parsed;
+            QVERIFY2( !parsed.deserialize( data.left( i ) ), qPrintable( QString( "accepted %1 of %2 bytes" ).arg( i ).arg( data.size() ) ) );
+        }
+    }
+
+    void testInvalidVersion()
+    {
+        QByteArray data = chunk().serialize();
+        data[ 4 ] = data.at( 4 ) + 1;
+
+        Tomahawk::CollectionSnapshotChunk parsed;
+        QVERIFY( !parsed.deserialize( data ) );
+    }
+};
+
+#endif // TOMAHAWK_TESTCOLLECTIONSNAPSHOT_H
@@ -0,0 +1,142 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTIDCACHE_H
+#define TOMAHAWK_TESTIDCACHE_H
+
+#include <QtTest>
+
+#include "database/Database.h"
+#include "database/DatabaseImpl.h"
+
+
+class TestIdCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir* dir;
+    Tomahawk::Database* db;
+
+    QVariantMap stats( const QString& cache )
+    {
+        return db->impl()->idCacheStats().value( cache ).toMap();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        // the search index is kept next to the database, so nothing outside dir is touched
+        dir = new QTemporaryDir();
+        QVERIFY( dir->isValid() );
+
+        db = new Tomahawk::Database( QDir( dir->path() ).absoluteFilePath( "idcache.db" ) );
+        db->loadIndex();
+    }
+
+    void cleanupTestCase()
+    {
+        delete db;
+        delete dir;
+    }
+
+    void init()
+    {
+        db->impl()->clearIdCaches();
+    }
+
+    void testArtist()
+    {
+        Tomahawk::DatabaseImpl* impl = db->impl();
+        const quint64 hits = stats( "artist" ).value( "hits" ).toULongLong();
+        const quint64 misses = stats( "artist" ).value( "misses" ).toULongLong();
+
+        const int id = impl->artistId( "Some Artist", true );
+        QVERIFY( id > 0 );
+        QCOMPARE( stats( "artist" ).value( "misses" ).toULongLong(), misses + 1 );
+        QCOMPARE( stats( "artist" ).value( "size" ).toInt(), 1 );
+
+        // looked up by sortname
+        QCOMPARE( impl->artistId( "  some   ARTIST ", false ), id );
+        QCOMPARE( impl->artistId( "Some Artist", true ), id );
+        QCOMPARE( stats( "artist" ).value( "hits" ).toULongLong(), hits + 2 );
+        QCOMPARE( stats( "artist" ).value( "size" ).toInt(), 1 );
+
+        // unknown names aren't cached
+        QCOMPARE( impl->artistId( "Unknown Artist", false ), 0 );
+        QCOMPARE( impl->artistId( "Unknown Artist", false ), 0 );
+        QCOMPARE( stats( "artist" ).value( "misses" ).toULongLong(), misses + 3 );
+        QCOMPARE( stats( "artist" ).value( "size" ).toInt(), 1 );
+
+        // still found in the database
+        impl->clearIdCaches();
+        QCOMPARE( stats( "artist" ).value( "size" ).toInt(), 0 );
+        QCOMPARE( impl->artistId( "Some Artist", false ), id );
+        QCOMPARE( stats( "artist" ).value( "size" ).toInt(), 1 );
+    }
+
+    void testTrackAndAlbum()
+    {
+        Tomahawk::DatabaseImpl* impl = db->impl();
+        const int artist = impl->artistId( "Track Artist", true );
+        const int otherArtist = impl->artistId( "Other Artist", true );
+        QVERIFY( artist > 0 && otherArtist > 0 && artist != otherArtist );
+
+        const int track = impl->trackId( artist, "Some Track", true );
+        const int album = impl->albumId( artist, "Some Album", true );
+        QVERIFY( track > 0 );
+        QVERIFY( album > 0 );
+
+        const quint64 trackHits = stats( "track" ).value( "hits" ).toULongLong();
+        const quint64 albumHits = stats( "album" ).value( "hits" ).toULongLong();
+        QCOMPARE( impl->trackId( artist, "some track", false ), track );
+        QCOMPARE( impl->albumId( artist, "SOME ALBUM", false ), album );
+        QCOMPARE( stats( "track" ).value( "hits" ).toULongLong(), trackHits + 1 );
+        QCOMPARE( stats( "album" ).value( "hits" ).toULongLong(), albumHits + 1 );
+
+        // the same names of another artist are other tracks and albums
+        QCOMPARE( impl->trackId( otherArtist, "Some Track", false ), 0 );
+        QCOMPARE( impl->albumId( otherArtist, "Some Album", false ), 0 );
+        const int otherTrack = impl->trackId( otherArtist, "Some Track", true );
+        const int otherAlbum = impl->albumId( otherArtist, "Some Album", true );
+        QVERIFY( otherTrack > 0 && otherTrack != track );
+        QVERIFY( otherAlbum > 0 && otherAlbum != album );
+        QCOMPARE( stats( "track" ).value( "size" ).toInt(), 2 );
+        QCOMPARE( stats( "album" ).value( "size" ).toInt(), 2 );
+
+        impl->clearIdCaches();
+        QCOMPARE( stats( "track" ).value( "size" ).toInt(), 0 );
+        QCOMPARE( stats( "album" ).value( "size" ).toInt(), 0 );
+        QCOMPARE( impl->trackId( artist, "Some Track", false ), track );
+        QCOMPARE( impl->albumId( otherArtist, "Some Album", false ), otherAlbum );
+    }
+
+    void testHitrate()
+    {
+        Tomahawk::DatabaseImpl* impl = db->impl();
+        QVERIFY( impl->artistId( "Hitrate Artist", true ) > 0 );
+        for ( int i = 0; i < 10; i++ )
+            impl->artistId( "Hitrate Artist", false );
+
+        const QVariantMap artist = stats( "artist" );
+        const double hits = artist.value( "hits" ).toULongLong();
+        const double misses = artist.value( "misses" ).toULongLong();
+        QVERIFY( misses > 0 );
+        QCOMPARE( artist.value( "hitrate" ).toDouble(), hits / ( hits + misses ) );
+    }
+};
+
+#endif // TOMAHAWK_TESTIDCACHE_H
@@ -0,0 +1,139 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTJSCONTEXT_H
+#define TOMAHAWK_TESTJSCONTEXT_H
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "resolvers/JSContext.h"
+#include "resolvers/JSLocalStorage.h"
+
+
+/**
+ * Stands in for JSResolverHelper, scripts call it from the context's thread
+ */
+class JSContextTestHost : public QObject
+{
+Q_OBJECT
+
+public:
+    explicit JSContextTestHost( const QSharedPointer< Tomahawk::JSContextChannel >& channel )
+        : m_channel( channel ), m_lastRequestId( 1000 ) {}
+
+    QString pluginName;
+
+    // Like ScriptCollectionFactory::createPlugin(), it asks the script
+    // about the plugin right away
+    Q_INVOKABLE void registerScriptPlugin( const QString& type, const QString& objectId )
+    {
+        Q_UNUSED( type );
+        pluginName = m_channel->call( "evaluate", ++m_lastRequestId, Q_ARG( QString, objectId + ".name()" ) ).toString();
+    }
+
+    Q_INVOKABLE QString value() const { return "value"; }
+
+private:
+    QSharedPointer< Tomahawk::JSContextChannel > m_channel;
+    int m_lastRequestId;
+};
+
+
+class TestJSContext : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir* dir;
+    QSharedPointer< Tomahawk::JSContextChannel > channel;
+    QPointer< Tomahawk::JSContext > context;
+    JSContextTestHost* host;
+
+    QVariant evaluate( const QString& source )
+    {
+        static int requestId = 0;
+        return channel->call( "evaluate", ++requestId, Q_ARG( QString, source ) );
+    }
+
+private slots:
+    void init()
+    {
+        // scripts store things, keep them out of the user's profile
+        dir = new QTemporaryDir();
+        QVERIFY( dir->isValid() );
+        Tomahawk::JSLocalStorage::setStorageDir( QDir( dir->path() ) );
+
+        channel = QSharedPointer< Tomahawk::JSContextChannel >( new Tomahawk::JSContextChannel() );
+        context = new Tomahawk::JSContext( "test", false, channel );
+
+        host = new JSContextTestHost( channel );
+        channel->post( "addObject", Q_ARG( QString, "host" ), Q_ARG( QObject*, host ) );
+    }
+
+    void cleanup()
+    {
+        channel->deleteContext();
+        // closes the databases it opened
+        QTRY_VERIFY( context.isNull() );
+        channel.clear();
+        delete host;
+
+        // the next test starts with a storage of its own
+        delete Tomahawk::JSLocalStorage::instance();
+        delete dir;
+    }
+
+    void testRegisterPluginFromInit()
+    {
+        const QString script =
+            "var collection = { name: function () { return 'test collection'; } };\n"
+            "function init() { host.registerScriptPlugin('collection', 'collection'); return 'initialized'; }\n";
+        channel->post( "loadScript", Q_ARG( QString, "test.js" ), Q_ARG( QString, script ) );
+
+        // the context waits for the registration while the host calls back into it
+        QCOMPARE( evaluate( "init()" ).toString(), QString( "initialized" ) );
+        QCOMPARE( host->pluginName, QString( "test collection" ) );
+    }
+
+    void testCallWhileContextWaits()
+    {
+        // the context asks for the value before or after we start to wait,
+        // either way our call comes after it
+        channel->post( "evaluate", Q_ARG( int, 0 ), Q_ARG( QString, "var v = host.value();" ) );
+        QCOMPARE( evaluate( "v" ).toString(), QString( "value" ) );
+    }
+
+    void testOpenDatabase()
+    {
+        evaluate( "var rows = null;\n"
+                  "var db = openDatabase('testjscontext', '', 'Test', 1024);\n"
+                  "db.transaction(function (tx) {\n"
+                  "    tx.executeSql('DROP TABLE IF EXISTS items', []);\n"
+                  "    tx.executeSql('CREATE TABLE items(name TEXT)', []);\n"
+                  "    tx.executeSql('INSERT INTO items(name) VALUES(?)', ['a'], function (tx) {\n"
+                  "        tx.executeSql('SELECT name FROM items', [], function (tx, results) {\n"
+                  "            rows = results.rows.length + ':' + results.rows.item(0).name;\n"
+                  "        });\n"
+                  "    });\n"
+                  "});" );
+
+        // the transaction runs in a timer of the context
+        QTRY_COMPARE( evaluate( "rows" ).toString(), QString( "1:a" ) );
+    }
+};
+
+#endif // TOMAHAWK_TESTJSCONTEXT_H
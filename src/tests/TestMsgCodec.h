@@ -0,0 +1,190 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTMSGCODEC_H
+#define TOMAHAWK_TESTMSGCODEC_H
+
+#include <QtTest>
+
+#include "network/MsgCodec.h"
+
+#include <climits>
+
+
+class TestMsgCodec : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QVariant nested( int depth )
+    {
+        QVariant v = 42;
+        for ( int i = 0; i < depth; i++ )
+            v = QVariantList() << v;
+        return v;
+    }
+
+    // what a DB op with files looks like
+    static QVariantMap op()
+    {
+        QVariantList files;
+        for ( int i = 0; i < 3; i++ )
+        {
+            QVariantMap file;
+            file[ "id" ] = i;
+            file[ "url" ] = QString( "/music/%1.mp3" ).arg( i );
+            file[ "mtime" ] = 1400000000 + i;
+            file[ "artist" ] = QString::fromUtf8( "Bj\xc3\xb6rk" );
+            file[ "album" ] = "track"; // a dictionary word as value
+            file[ "duration" ] = 212.5;
+            file[ "hash" ] = QByteArray( "\x00\x01\xff", 3 );
+            file[ "unknownkey" ] = true;
+            files << file;
+        }
+
+        QVariantMap m;
+        m[ "command" ] = "addfiles";
+        m[ "guid" ] = "{00000000-0000-0000-0000-000000000001}";
+        m[ "files" ] = files;
+        m[ "deleteAll" ] = false;
+        m[ "empty" ] = QVariantMap();
+        m[ "nothing" ] = QVariant();
+        return m;
+    }
+
+private slots:
+    void testScalars()
+    {
+        QVariantList values;
+        values << QVariant() << true << false
+               << 0 << 1 << -1 << 127 << 128 << INT_MAX << INT_MIN
+               << qint64( LLONG_MAX ) << qint64( LLONG_MIN ) << qint64( 1 ) + INT_MAX
+               << 0.0 << -1.5 << 3.141592653589793 << 1e300
+               << QString() << "addfiles" << QString::fromUtf8( "\xe2\x99\xab unicode" )
+               << QByteArray() << QByteArray( "\x00\x80\xff", 3 );
+
+        foreach ( const QVariant& v, values )
+        {
+            bool ok = false;
+            const QVariant decoded = MsgCodec::decode( MsgCodec::encode( v ), &ok );
+            QVERIFY2( ok, qPrintable( v.toString() ) );
+            QCOMPARE( decoded, v );
+        }
+    }
+
+    void testRoundTrip()
+    {
+        const QVariantMap m = op();
+        const QByteArray data = MsgCodec::encode( m );
+
+        bool ok = false;
+        QCOMPARE( MsgCodec::decode( data, &ok ).toMap(), m );
+        QVERIFY( ok );
+
+        // string lists are sent as lists
+        const QStringList strings = QStringList() << "a" << "b";
+        QCOMPARE( MsgCodec::decode( MsgCodec::encode( strings ), &ok ).toStringList(), strings );
+        QVERIFY( ok );
+    }
+
+    void testTruncated()
+    {
+        const QByteArray data = MsgCodec::encode( op() );
+
+        for ( int i = 0; i < data.size(); i++ )
+        {
+            bool ok = true;
+            const QVariant v = MsgCodec::decode( data.left( i ), &ok );
+            QVERIFY2( !ok, qPrintable( QString( "accepted %1 of %2 bytes" ).arg( i ).arg( data.size() ) ) );
+            QVERIFY( v.isNull() );
+        }
+
+        // trailing garbage
+        bool ok = true;
+        MsgCodec::decode( data + 'x', &ok );
+        QVERIFY( !ok );
+    }
+
+    void testCorrupt()
+    {
+        const QByteArray data = MsgCodec::encode( op() );
+
+        // must not crash or hang, whatever the result
+        qsrand( 42 );
+        for ( int i = 0; i < 2000; i++ )
+        {
+            QByteArray corrupt = data;
+            const int flips = 1 + qrand() % 4;
+            for ( int f = 0; f < flips; f++ )
+                corrupt[ qrand() % corrupt.size() ] = char( qrand() % 256 );
+
+            bool ok;
+            MsgCodec::decode( corrupt, &ok );
+        }
+
+        // counts larger than the remaining data
+        bool ok = true;
+        MsgCodec::decode( QByteArray( "\x01\x07\xff\xff\xff\xff\x0f", 7 ), &ok );
+        QVERIFY( !ok );
+        MsgCodec::decode( QByteArray( "\x01\x06\xff\xff\xff\xff\x0f", 7 ), &ok );
+        QVERIFY( !ok );
+
+        // varint without an end
+        MsgCodec::decode( QByteArray( "\x01\x03" ) + QByteArray( 20, '\xff' ), &ok );
+        QVERIFY( !ok );
+
+        // unknown tag and dictionary index
+        MsgCodec::decode( QByteArray( "\x01\x7f", 2 ), &ok );
+        QVERIFY( !ok );
+        MsgCodec::decode( QByteArray( "\x01\x09\x7f", 3 ), &ok );
+        QVERIFY( !ok );
+    }
+
+    void testVersion()
+    {
+        bool ok = true;
+        MsgCodec::decode( QByteArray(), &ok );
+        QVERIFY( !ok );
+
+        QByteArray data = MsgCodec::encode( 1 );
+        data[ 0 ] = char( MsgCodec::Version + 1 );
+        MsgCodec::decode( data, &ok );
+        QVERIFY( !ok );
+
+        // nothing but an unknown version
+        MsgCodec::decode( data.left( 1 ), &ok );
+        QVERIFY( !ok );
+    }
+
+    void testDepth()
+    {
+        bool ok = false;
+        QCOMPARE( MsgCodec::decode( MsgCodec::encode( nested( 64 ) ), &ok ), nested( 64 ) );
+        QVERIFY( ok );
+
+        MsgCodec::decode( MsgCodec::encode( nested( 65 ) ), &ok );
+        QVERIFY( !ok );
+
+        // deep enough to overflow the stack without the limit
+        QByteArray deep( "\x01", 1 );
+        for ( int i = 0; i < 1000000; i++ )
+            deep += "\x07\x01";
+        MsgCodec::decode( deep, &ok );
+        QVERIFY( !ok );
+    }
+};
+
+#endif // TOMAHAWK_TESTMSGCODEC_H
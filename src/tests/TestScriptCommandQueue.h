@@ -0,0 +1,165 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTSCRIPTCOMMANDQUEUE_H
+#define TOMAHAWK_TESTSCRIPTCOMMANDQUEUE_H
+
+#include <QtTest>
+
+#include "resolvers/ScriptCommand.h"
+#include "resolvers/ScriptCommandQueue.h"
+
+
+/**
+ * Logs when it runs or fails, and runs until finish() is called
+ */
+class QueuedTestCommand : public Tomahawk::ScriptCommand
+{
+Q_OBJECT
+
+public:
+    QueuedTestCommand( const QString& name, Priority priority, const QString& key, QStringList* log )
+        : m_name( name ), m_priority( priority ), m_key( key ), m_log( log ) {}
+
+    Priority priority() const override { return m_priority; }
+    QString supersedeKey() const override { return m_key; }
+
+    void finish() { emit done(); }
+
+signals:
+    void done() override;
+
+protected:
+    void exec() override { *m_log << m_name; }
+    void reportFailure() override { *m_log << m_name + " failed"; }
+
+private:
+    QString m_name;
+    Priority m_priority;
+    QString m_key;
+    QStringList* m_log;
+};
+
+typedef QSharedPointer< QueuedTestCommand > command_ptr;
+
+
+class TestScriptCommandQueue : public QObject
+{
+    Q_OBJECT
+
+private:
+    QStringList log;
+    QHash< QString, command_ptr > commands;
+
+    command_ptr command( const QString& name,
+                         Tomahawk::ScriptCommand::Priority priority = Tomahawk::ScriptCommand::BrowsePriority,
+                         const QString& key = QString() )
+    {
+        command_ptr c( new QueuedTestCommand( name, priority, key, &log ) );
+        commands.insert( name, c );
+        return c;
+    }
+
+    // finishes the command that ran last
+    void finishLast()
+    {
+        QVERIFY( commands.contains( log.last() ) );
+        commands.value( log.last() )->finish();
+    }
+
+private slots:
+    void init()
+    {
+        log.clear();
+        commands.clear();
+    }
+
+    void testPriority()
+    {
+        Tomahawk::ScriptCommandQueue queue;
+        queue.enqueue( command( "running" ) );
+        QCOMPARE( log, QStringList() << "running" );
+
+        queue.enqueue( command( "bulk1", Tomahawk::ScriptCommand::BulkPriority ) );
+        queue.enqueue( command( "browse1" ) );
+        queue.enqueue( command( "interactive1", Tomahawk::ScriptCommand::InteractivePriority ) );
+        queue.enqueue( command( "bulk2", Tomahawk::ScriptCommand::BulkPriority ) );
+        queue.enqueue( command( "interactive2", Tomahawk::ScriptCommand::InteractivePriority ) );
+        queue.enqueue( command( "browse2" ) );
+
+        // nothing else starts while one runs
+        QCOMPARE( log.count(), 1 );
+        QCOMPARE( queue.metrics().value( "waiting" ).toList(), QVariantList() << 2 << 2 << 2 );
+        QCOMPARE( queue.metrics().value( "running" ).toInt(), 1 );
+
+        for ( int i = 0; i < 7; i++ )
+            finishLast();
+
+        QCOMPARE( log, QStringList() << "running" << "interactive1" << "interactive2"
+                                     << "browse1" << "browse2" << "bulk1" << "bulk2" );
+        QCOMPARE( queue.metrics().value( "finished" ).toInt(), 7 );
+        QCOMPARE( queue.metrics().value( "running" ).toInt(), 0 );
+    }
+
+    void testSupersede()
+    {
+        Tomahawk::ScriptCommandQueue queue;
+        queue.enqueue( command( "running", Tomahawk::ScriptCommand::BrowsePriority, "a" ) );
+
+        queue.enqueue( command( "a1", Tomahawk::ScriptCommand::BrowsePriority, "a" ) );
+        queue.enqueue( command( "b1", Tomahawk::ScriptCommand::BrowsePriority, "b" ) );
+        queue.enqueue( command( "none1" ) );
+        queue.enqueue( command( "none2" ) );
+        // running commands are never superseded, waiting ones answer right away
+        QCOMPARE( log, QStringList() << "running" );
+        queue.enqueue( command( "a2", Tomahawk::ScriptCommand::BrowsePriority, "a" ) );
+        QCOMPARE( log, QStringList() << "running" << "a1 failed" );
+
+        // also across priorities
+        queue.enqueue( command( "b2", Tomahawk::ScriptCommand::InteractivePriority, "b" ) );
+        QCOMPARE( log.last(), QString( "b1 failed" ) );
+        QCOMPARE( queue.metrics().value( "superseded" ).toInt(), 2 );
+
+        commands.value( "running" )->finish();
+        for ( int i = 0; i < 4; i++ )
+            finishLast();
+
+        QCOMPARE( log, QStringList() << "running" << "a1 failed" << "b1 failed"
+                                     << "b2" << "none1" << "none2" << "a2" );
+        QCOMPARE( queue.metrics().value( "finished" ).toInt(), 5 );
+    }
+
+    void testMaxRunning()
+    {
+        Tomahawk::ScriptCommandQueue queue;
+        for ( int i = 0; i < 4; i++ )
+            queue.enqueue( command( QString::number( i ) ) );
+        QCOMPARE( log.count(), 1 );
+
+        queue.setMaxRunning( 3 );
+        QCOMPARE( log, QStringList() << "0" << "1" << "2" );
+        QCOMPARE( queue.metrics().value( "running" ).toInt(), 3 );
+
+        commands.value( "1" )->finish();
+        QCOMPARE( log.last(), QString( "3" ) );
+
+        queue.setMaxRunning( 0 );
+        QCOMPARE( queue.maxRunning(), 1 );
+        QCOMPARE( queue.metrics().value( "running" ).toInt(), 3 );
+    }
+};
+
+#endif // TOMAHAWK_TESTSCRIPTCOMMANDQUEUE_H
@@ -0,0 +1,148 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTSHARDEDWEAKHASH_H
+#define TOMAHAWK_TESTSHARDEDWEAKHASH_H
+
+#include <QtTest>
+
+#include "utils/ShardedWeakHash.h"
+
+typedef Tomahawk::Utils::ShardedWeakHash< QString > StringHash;
+
+
+class ShardedWeakHashWorker : public QThread
+{
+public:
+    ShardedWeakHashWorker( StringHash* hash, int offset ) : m_hash( hash ), m_offset( offset ), m_failed( false ) {}
+
+    bool failed() const { return m_failed; }
+
+protected:
+    void run()
+    {
+        for ( int i = 0; i < 2000; i++ )
+        {
+            const QString key = QString::number( ( m_offset + i ) % 500 );
+            QSharedPointer< QString > value( new QString( key ) );
+            m_hash->insert( key, value );
+
+            // another thread may have replaced it meanwhile, but never with something else
+            QSharedPointer< QString > found = m_hash->value( key );
+            if ( !found.isNull() && *found != key )
+                m_failed = true;
+        }
+    }
+
+private:
+    StringHash* m_hash;
+    int m_offset;
+    bool m_failed;
+};
+
+
+class TestShardedWeakHash : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testInsert()
+    {
+        StringHash hash;
+        QSharedPointer< QString > a( new QString( "a" ) );
+        QSharedPointer< QString > b( new QString( "b" ) );
+
+        hash.insert( "a", a );
+        hash.insert( "b", b );
+        QCOMPARE( hash.value( "a" ), a );
+        QCOMPARE( hash.value( "b" ), b );
+        QVERIFY( hash.value( "c" ).isNull() );
+        QVERIFY( !hash.contains( "c" ) );
+
+        // replaces the old value
+        QSharedPointer< QString > a2( new QString( "a2" ) );
+        hash.insert( "a", a2 );
+        QCOMPARE( hash.value( "a" ), a2 );
+
+        hash.remove( "a" );
+        QVERIFY( !hash.contains( "a" ) );
+        QVERIFY( hash.contains( "b" ) );
+    }
+
+    void testWeak()
+    {
+        StringHash hash;
+        QSharedPointer< QString > a( new QString( "a" ) );
+        QWeakPointer< QString > weak = a;
+
+        hash.insert( "a", a );
+        QVERIFY( hash.contains( "a" ) );
+
+        // the hash doesn't keep it alive
+        a.clear();
+        QVERIFY( weak.isNull() );
+        QVERIFY( hash.value( "a" ).isNull() );
+        QVERIFY( !hash.contains( "a" ) );
+    }
+
+    void testPurge()
+    {
+        StringHash hash;
+        QList< QSharedPointer< QString > > alive;
+
+        // enough dead entries for every shard to purge a few times
+        for ( int i = 0; i < 10000; i++ )
+        {
+            const QString key = QString::number( i );
+            QSharedPointer< QString > value( new QString( key ) );
+            hash.insert( key, value );
+            if ( i % 100 == 0 )
+                alive << value;
+        }
+
+        for ( int i = 0; i < 10000; i++ )
+        {
+            const QString key = QString::number( i );
+            QCOMPARE( hash.contains( key ), i % 100 == 0 );
+        }
+
+        foreach ( const QSharedPointer< QString >& value, alive )
+            QCOMPARE( hash.value( *value ), value );
+    }
+
+    void testThreads()
+    {
+        StringHash hash;
+        QList< ShardedWeakHashWorker* > workers;
+        for ( int i = 0; i < 4; i++ )
+            workers << new ShardedWeakHashWorker( &hash, i * 100 );
+
+        foreach ( ShardedWeakHashWorker* worker, workers )
+            worker->start();
+        foreach ( ShardedWeakHashWorker* worker, workers )
+        {
+            QVERIFY( worker->wait( 30000 ) );
+            QVERIFY( !worker->failed() );
+        }
+        qDeleteAll( workers );
+
+        // all values died with the workers' pointers
+        for ( int i = 0; i < 500; i++ )
+            QVERIFY( !hash.contains( QString::number( i ) ) );
+    }
+};
+
+#endif // TOMAHAWK_TESTSHARDEDWEAKHASH_H
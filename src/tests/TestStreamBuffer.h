@@ -0,0 +1,136 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOMAHAWK_TESTSTREAMBUFFER_H
+#define TOMAHAWK_TESTSTREAMBUFFER_H
+
+#include <QtTest>
+
+#include "network/StreamBuffer.h"
+
+
+class TestStreamBuffer : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray block( int block, int size = 100 )
+    {
+        return QByteArray( size, 'a' + block );
+    }
+
+private slots:
+    void testMaxBlocks()
+    {
+        StreamBuffer buffer( 950, 100, 1024 * 1024 );
+        QCOMPARE( buffer.maxBlocks(), 10 );
+
+        QVERIFY( buffer.setBlockSize( 50 ) );
+        QCOMPARE( buffer.maxBlocks(), 19 );
+
+        buffer.addBlock( 0, block( 0, 50 ) );
+        QVERIFY( !buffer.setBlockSize( 100 ) );
+    }
+
+    void testRanges()
+    {
+        StreamBuffer buffer( 1000, 100, 1024 * 1024 );
+        QCOMPARE( buffer.emptyBlockFrom( 0 ), 0 );
+
+        buffer.addBlock( 3, block( 3 ) );
+        buffer.addBlock( 5, block( 5 ) );
+        QVERIFY( buffer.isBlockEmpty( 4 ) );
+        QCOMPARE( buffer.emptyBlockFrom( 3 ), 4 );
+
+        // joins both ranges
+        buffer.addBlock( 4, block( 4 ) );
+        QVERIFY( !buffer.isBlockEmpty( 4 ) );
+        QCOMPARE( buffer.emptyBlockFrom( 3 ), 6 );
+        QCOMPARE( buffer.emptyBlockFrom( 0 ), 0 );
+        QCOMPARE( buffer.emptyBlockFrom( 9 ), 9 );
+        QCOMPARE( buffer.emptyBlockFrom( 42 ), 0 );
+
+        // duplicates are ignored
+        buffer.addBlock( 4, block( 4 ) );
+        QCOMPARE( buffer.received(), qint64( 300 ) );
+
+        for ( int i = 6; i < 10; i++ )
+            buffer.addBlock( i, block( i ) );
+        // wraps around
+        QCOMPARE( buffer.emptyBlockFrom( 5 ), 0 );
+        QVERIFY( !buffer.isComplete() );
+
+        for ( int i = 0; i < 3; i++ )
+            buffer.addBlock( i, block( i ) );
+        QVERIFY( buffer.isComplete() );
+        QCOMPARE( buffer.emptyBlockFrom( 0 ), -1 );
+        QCOMPARE( buffer.received(), qint64( 1000 ) );
+    }
+
+    void testRead()
+    {
+        StreamBuffer buffer( 1000, 100, 1024 * 1024 );
+        buffer.addBlock( 0, block( 0 ) );
+        buffer.addBlock( 1, block( 1 ) );
+        buffer.addBlock( 3, block( 3 ) );
+
+        char data[ 1000 ];
+        // stops at the gap
+        QCOMPARE( buffer.read( 50, data, 1000 ), qint64( 150 ) );
+        QCOMPARE( QByteArray( data, 150 ), block( 0, 50 ) + block( 1 ) );
+
+        QCOMPARE( buffer.read( 250, data, 1000 ), qint64( 0 ) );
+        QCOMPARE( buffer.read( 310, data, 20 ), qint64( 20 ) );
+        QCOMPARE( QByteArray( data, 20 ), block( 3, 20 ) );
+    }
+
+    void testSpill()
+    {
+        StreamBuffer buffer( 1000, 100, 250 );
+
+        buffer.addBlock( 0, block( 0 ) );
+        buffer.addBlock( 1, block( 1 ) );
+        // a short block in the middle of the file
+        buffer.addBlock( 2, block( 2, 60 ) );
+        // block 0 was used least recently
+        QCOMPARE( buffer.memoryUsage(), qint64( 160 ) );
+
+        char data[ 1000 ];
+        QCOMPARE( buffer.read( 100, data, 100 ), qint64( 100 ) );
+
+        // block 1 was just read, so the short block 2 goes next
+        buffer.addBlock( 3, block( 3 ) );
+        QCOMPARE( buffer.memoryUsage(), qint64( 200 ) );
+
+        QCOMPARE( buffer.read( 0, data, 200 ), qint64( 200 ) );
+        QCOMPARE( QByteArray( data, 200 ), block( 0 ) + block( 1 ) );
+        QCOMPARE( buffer.read( 200, data, 60 ), qint64( 60 ) );
+        QCOMPARE( QByteArray( data, 60 ), block( 2, 60 ) );
+
+        for ( int i = 4; i < 10; i++ )
+            buffer.addBlock( i, block( i ) );
+        QVERIFY( buffer.memoryUsage() <= 250 );
+        QVERIFY( buffer.isComplete() );
+
+        QCOMPARE( buffer.read( 300, data, 700 ), qint64( 700 ) );
+        QByteArray expected;
+        for ( int i = 3; i < 10; i++ )
+            expected += block( i );
+        QCOMPARE( QByteArray( data, 700 ), expected );
+    }
+};
+
+#endif // TOMAHAWK_TESTSTREAMBUFFER_H
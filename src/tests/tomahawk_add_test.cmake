@@ -17,7 +17,7 @@ macro(tomahawk_add_test test_class)
     )
 
     target_link_libraries(${TOMAHAWK_TEST_TARGET}
-        Qt5::Core Qt5::Network Qt5::Widgets Qt5::Sql Qt5::Xml Qt5::Test
+        Qt5::Core Qt5::Network Qt5::Qml Qt5::Widgets Qt5::Sql Qt5::Xml Qt5::Test
     )
 
     add_test(NAME ${TOMAHAWK_TEST_TARGET} COMMAND ${TOMAHAWK_TEST_TARGET})
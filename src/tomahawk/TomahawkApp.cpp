@@ -229,10 +229,12 @@ TomahawkApp::init()
 
     Pipeline::instance()->addExternalResolverFactory(
                 std::bind( &JSResolver::factory, std::placeholders::_1,
-                           std::placeholders::_2, std::placeholders::_3 ) );
+                           std::placeholders::_2, std::placeholders::_3,
+                           std::placeholders::_4 ) );
     Pipeline::instance()->addExternalResolverFactory(
                 std::bind( &ScriptResolver::factory, std::placeholders::_1,
-                           std::placeholders::_2, std::placeholders::_3 ) );
+                           std::placeholders::_2, std::placeholders::_3,
+                           std::placeholders::_4 ) );
 
     new ActionCollection( this );
     connect( ActionCollection::instance()->getAction( "quit" ), SIGNAL( triggered() ), SLOT( quit() ), Qt::UniqueConnection );
@@ -0,0 +1,417 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ScanBenchmark.h"
+
+#include "database/Database.h"
+#include "database/DatabaseCollection.h"
+#include "database/DatabaseCommand_AddFiles.h"
+#include "database/DatabaseCommand_AddSource.h"
+#include "utils/TomahawkUtils.h"
+#include "Source.h"
+#include "TomahawkSettings.h"
+
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QThread>
+
+#include <iostream>
+
+#ifndef Q_OS_WIN
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#define TRACKS_PER_ALBUM 10
+#define ALBUMS_PER_ARTIST 5
+// MPEG-1 Layer III, 128 kbit/s, 44.1 kHz: 417 bytes per frame, ~26ms each
+#define MP3_FRAME_SIZE 417
+#define MP3_FRAMES 40
+
+using namespace Tomahawk;
+
+
+/**
+ * Times how long exec() takes to insert the files, without the commit, and
+ * postCommitHook() to update the search index with them
+ */
+class TimedAddFiles : public DatabaseCommand_AddFiles
+{
+public:
+    TimedAddFiles( const QVariantList& files, const source_ptr& source )
+        : DatabaseCommand_AddFiles( files, source ), insertTime( 0 ), indexUpdateTime( 0 ) {}
+
+    void exec( DatabaseImpl* dbi ) override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        DatabaseCommand_AddFiles::exec( dbi );
+        insertTime = timer.elapsed();
+    }
+
+    void postCommitHook() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        DatabaseCommand_AddFiles::postCommitHook();
+        indexUpdateTime = timer.elapsed();
+    }
+
+    qint64 insertTime;
+    qint64 indexUpdateTime;
+};
+
+
+ScanBenchmark::ScanBenchmark( const QString& workDir, int fileCount )
+    : m_workDir( workDir )
+    , m_fileCount( fileCount )
+    , m_tagReaders( DEFAULT_SCANNER_TAG_READERS )
+    , m_keepFiles( false )
+    , m_generateTime( 0 )
+{
+}
+
+
+void
+ScanBenchmark::setTemplateDir( const QString& dir )
+{
+    QDir templateDir( dir );
+    foreach ( const QFileInfo& fi, templateDir.entryInfoList( QDir::Files | QDir::Readable ) )
+    {
+        const QString suffix = fi.suffix().toLower();
+        if ( TomahawkUtils::supportedExtensions().contains( suffix ) && !m_templates.contains( suffix ) )
+            m_templates.insert( suffix, fi.canonicalFilePath() );
+    }
+}
+
+
+bool
+ScanBenchmark::generate()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QStringList suffixes = formats();
+    for ( int i = 0; i < m_fileCount; i++ )
+    {
+        if ( !writeFile( i, suffixes.at( i % suffixes.count() ) ) )
+            return false;
+    }
+
+    m_generateTime = timer.elapsed();
+    return true;
+}
+
+
+QVariantMap
+ScanBenchmark::run()
+{
+    QVariantList runs;
+    runs << runScan( MusicScanner::FileScan, m_files );
+    runs << runScan( MusicScanner::DirScan, QStringList() << QDir( m_workDir ).canonicalPath() );
+
+    QVariantMap m;
+    m[ "files" ] = m_files.count();
+    m[ "formats" ] = formats();
+    m[ "skippedFormats" ] = skippedFormats();
+    m[ "tagReaders" ] = m_tagReaders;
+    m[ "generateTime" ] = m_generateTime;
+    m[ "runs" ] = runs;
+    m[ "insert" ] = runInsert();
+    m[ "peakRss" ] = peakRss();
+
+    if ( !m_keepFiles )
+        TomahawkUtils::removeDirectory( m_workDir );
+
+    return m;
+}
+
+
+QVariantMap
+ScanBenchmark::runScan( MusicScanner::ScanMode mode, const QStringList& paths )
+{
+    MusicScanner scanner( mode, paths, 0 );
+    scanner.setDryRun( true );
+    scanner.setTagReaders( m_tagReaders );
+
+    QThread scannerThread( 0 );
+    scannerThread.start();
+    scanner.moveToThread( &scannerThread );
+    // quit() is thread-safe, and this thread doesn't handle events while it waits
+    QObject::connect( &scanner, SIGNAL( finished() ), &scannerThread, SLOT( quit() ), Qt::DirectConnection );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QMetaObject::invokeMethod( &scanner, "scan", Qt::QueuedConnection );
+    scannerThread.wait();
+
+    const qint64 elapsed = qMax( qint64( 1 ), timer.elapsed() );
+    const QVariantMap stats = scanner.stats();
+
+    QVariantMap m;
+    m[ "mode" ] = mode == MusicScanner::FileScan ? "FileScan" : "DirScan";
+    m[ "scanned" ] = stats.value( "scanned" );
+    m[ "skipped" ] = stats.value( "skipped" );
+    m[ "time" ] = elapsed;
+    m[ "filesPerSecond" ] = stats.value( "scanned" ).toDouble() * 1000.0 / elapsed;
+    m[ "tagReadTime" ] = stats.value( "tagReadTime" );
+    m[ "rss" ] = currentRss();
+
+    return m;
+}
+
+
+QVariantMap
+ScanBenchmark::runInsert()
+{
+    QVariantList files;
+    foreach ( const QString& path, m_files )
+    {
+        const QVariant tags = MusicScanner::readTags( QFileInfo( path ) );
+        if ( !tags.toMap().isEmpty() )
+            files << tags;
+    }
+
+    QVariantMap m;
+    m[ "files" ] = files.count();
+
+    // A database of its own, its search index ends up next to it
+    Database db( QDir( m_workDir ).absoluteFilePath( "benchmark.db" ) );
+    db.loadIndex(); // ready right away
+
+    // The files belong to a peer's source: the local one would need the
+    // accounts and the Servent to tell the peers about them
+    int sourceId = 0;
+    {
+        DatabaseCommand_addSource* cmd = new DatabaseCommand_addSource( "benchmark", "Benchmark" );
+        dbcmd_ptr command( cmd );
+
+        QEventLoop loop;
+        QObject::connect( cmd, &DatabaseCommand_addSource::done, [&sourceId]( unsigned int id, const QString& ) { sourceId = id; } );
+        QObject::connect( cmd, SIGNAL( finished() ), &loop, SLOT( quit() ), Qt::QueuedConnection );
+
+        db.enqueue( command );
+        loop.exec();
+    }
+
+    source_ptr source( new Source( sourceId, "benchmark" ) );
+    collection_ptr collection( new DatabaseCollection( source ) );
+    collection->setWeakRef( collection.toWeakRef() );
+    source->addCollection( collection );
+
+    TimedAddFiles* cmd = new TimedAddFiles( files, source );
+    dbcmd_ptr command( cmd );
+
+    QEventLoop loop;
+    QObject::connect( cmd, SIGNAL( finished() ), &loop, SLOT( quit() ), Qt::QueuedConnection );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    db.enqueue( command );
+    loop.exec();
+
+    m[ "time" ] = timer.elapsed();
+    m[ "dbInsertTime" ] = cmd->insertTime;
+    m[ "indexUpdateTime" ] = cmd->indexUpdateTime;
+    m[ "rss" ] = currentRss();
+
+    return m;
+}
+
+
+bool
+ScanBenchmark::writeFile( int index, const QString& suffix )
+{
+    const int album = index / TRACKS_PER_ALBUM;
+    const int artist = album / ALBUMS_PER_ARTIST;
+    const int track = index % TRACKS_PER_ALBUM + 1;
+
+    const QString artistName = QString( "Benchmark Artist %1" ).arg( artist );
+    const QString albumName = QString( "Benchmark Album %1" ).arg( album );
+    const QString trackName = QString( "Benchmark Track %1" ).arg( index );
+
+    QDir dir( m_workDir );
+    const QString albumPath = QString( "%1/%2" ).arg( artistName ).arg( albumName );
+    if ( !dir.mkpath( albumPath ) )
+    {
+        std::cerr << "Could not create directory " << qPrintable( dir.absoluteFilePath( albumPath ) ) << std::endl;
+        return false;
+    }
+
+    const QString path = dir.absoluteFilePath( QString( "%1/%2 - %3.%4" ).arg( albumPath ).arg( track, 2, 10, QChar( '0' ) ).arg( trackName ).arg( suffix ) );
+    QFile::remove( path );
+
+    bool ok = false;
+    if ( m_templates.contains( suffix ) )
+        ok = QFile::copy( m_templates.value( suffix ), path );
+    else if ( suffix == "flac" )
+        ok = writeEmptyFlac( path );
+    else
+        ok = writeSilentMp3( path );
+
+    if ( !ok )
+    {
+        std::cerr << "Could not write " << qPrintable( path ) << std::endl;
+        return false;
+    }
+
+    const QByteArray fileName = QFile::encodeName( path );
+    TagLib::FileRef f( fileName.constData() );
+    if ( f.isNull() || !f.tag() )
+    {
+        std::cerr << "TagLib can't handle " << qPrintable( path ) << std::endl;
+        return false;
+    }
+
+    f.tag()->setArtist( TagLib::String( artistName.toUtf8().constData(), TagLib::String::UTF8 ) );
+    f.tag()->setAlbum( TagLib::String( albumName.toUtf8().constData(), TagLib::String::UTF8 ) );
+    f.tag()->setTitle( TagLib::String( trackName.toUtf8().constData(), TagLib::String::UTF8 ) );
+    f.tag()->setTrack( track );
+    f.tag()->setYear( 2000 + artist % 20 );
+    if ( !f.save() )
+    {
+        std::cerr << "Could not tag " << qPrintable( path ) << std::endl;
+        return false;
+    }
+
+    m_files << QFileInfo( path ).canonicalFilePath();
+    return true;
+}
+
+
+bool
+ScanBenchmark::writeSilentMp3( const QString& path )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::WriteOnly ) )
+        return false;
+
+    // frame header followed by all-zero side info and main data, decodes to silence
+    QByteArray frame( MP3_FRAME_SIZE, '\0' );
+    frame[ 0 ] = (char)0xFF;
+    frame[ 1 ] = (char)0xFB;
+    frame[ 2 ] = (char)0x90;
+    frame[ 3 ] = (char)0x44;
+
+    for ( int i = 0; i < MP3_FRAMES; i++ )
+    {
+        if ( file.write( frame ) != frame.size() )
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+ScanBenchmark::writeEmptyFlac( const QString& path )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::WriteOnly ) )
+        return false;
+
+    // "fLaC" and a STREAMINFO block, the last metadata block, without any
+    // frames: 4096 samples per block, 44.1 kHz, stereo, 16 bits
+    QByteArray flac( "fLaC" );
+    const char streamInfo[] = {
+        (char)0x80, 0x00, 0x00, 0x22,           // last block, STREAMINFO, 34 bytes
+        0x10, 0x00, 0x10, 0x00,                 // min/max block size
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // min/max frame size, unknown
+        0x0A, (char)0xC4, 0x42, (char)0xF0,     // sample rate, channels, bits per sample
+        0x00, 0x00, 0x00, 0x00                  // no samples
+    };
+    flac.append( streamInfo, sizeof( streamInfo ) );
+    flac.append( QByteArray( 16, '\0' ) ); // MD5 of the (missing) audio
+
+    return file.write( flac ) == flac.size();
+}
+
+
+QStringList
+ScanBenchmark::skippedFormats() const
+{
+    QStringList skipped;
+    const QStringList generated = formats();
+    foreach ( const QString& suffix, TomahawkUtils::supportedExtensions() )
+    {
+        if ( !generated.contains( suffix ) )
+            skipped << suffix;
+    }
+
+    return skipped;
+}
+
+
+QStringList
+ScanBenchmark::formats() const
+{
+    QStringList formats = m_templates.keys();
+    if ( !formats.contains( "flac" ) )
+        formats.prepend( "flac" );
+    if ( !formats.contains( "mp3" ) )
+        formats.prepend( "mp3" );
+
+    return formats;
+}
+
+
+qint64
+ScanBenchmark::currentRss()
+{
+#ifdef Q_OS_LINUX
+    // size and resident set in pages
+    QFile statm( "/proc/self/statm" );
+    if ( !statm.open( QIODevice::ReadOnly ) )
+        return -1;
+
+    const QList< QByteArray > fields = statm.readAll().split( ' ' );
+    bool ok = false;
+    const qint64 pages = fields.value( 1 ).toLongLong( &ok );
+    if ( !ok )
+        return -1;
+
+    return pages * sysconf( _SC_PAGESIZE ) / 1024;
+#else
+    return -1;
+#endif
+}
+
+
+qint64
+ScanBenchmark::peakRss()
+{
+#ifdef Q_OS_WIN
+    return -1;
+#else
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return -1;
+
+    // in kB, except for OS X which reports bytes
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
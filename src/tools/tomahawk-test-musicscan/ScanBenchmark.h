@@ -0,0 +1,76 @@
+/* === This file is part of Tomahawk Player - <http://tomahawk-player.org> ===
+ *
+ *   Tomahawk is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tomahawk is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tomahawk. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCANBENCHMARK_H
+#define SCANBENCHMARK_H
+
+#include "filemetadata/MusicScanner.h"
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+/*
+    Generates a tree of tagged audio files and runs the MusicScanner over it,
+    once in FileScan and once in DirScan mode.
+
+    MP3 and FLAC files are synthesized, all other formats are copied from
+    template files (one per extension) found in the template directory and
+    retagged. Formats without a template are skipped, see skippedFormats(). Scans are dry runs, the database insert and search index update
+    are measured afterwards by adding all files to a database in the work dir.
+
+    Memory is reported in kB: the resident set after each run (Linux only)
+    and the peak of the whole process.
+*/
+class ScanBenchmark
+{
+public:
+    ScanBenchmark( const QString& workDir, int fileCount );
+
+    void setTemplateDir( const QString& dir );
+    void setTagReaders( int readers ) { m_tagReaders = readers; }
+    void setKeepFiles( bool keep ) { m_keepFiles = keep; }
+
+    bool generate();
+    QVariantMap run();
+
+    /**
+     * Supported formats no files are generated for, as there is no template for them
+     */
+    QStringList skippedFormats() const;
+
+private:
+    QVariantMap runScan( MusicScanner::ScanMode mode, const QStringList& paths );
+    QVariantMap runInsert();
+    bool writeFile( int index, const QString& suffix );
+    static bool writeSilentMp3( const QString& path );
+    static bool writeEmptyFlac( const QString& path );
+    QStringList formats() const;
+    static qint64 currentRss();
+    static qint64 peakRss();
+
+    QString m_workDir;
+    int m_fileCount;
+    int m_tagReaders;
+    bool m_keepFiles;
+
+    QMap< QString, QString > m_templates; // suffix -> template file
+    QStringList m_files;
+    qint64 m_generateTime;
+};
+
+#endif // SCANBENCHMARK_H
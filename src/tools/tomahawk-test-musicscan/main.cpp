@@ -1,6 +1,11 @@
 #include"filemetadata/MusicScanner.h"
+#include "utils/Json.h"
+#include "TomahawkSettings.h"
+
+#include "ScanBenchmark.h"
 
 #include <QCoreApplication>
+#include <QDir>
 #include <QFileInfo>
 
 #include <iostream>
@@ -10,19 +15,91 @@ usage()
 {
     std::cout << "Usage:" << std::endl;
     std::cout << "\ttomahawk-test-musicscan <path>" << std::endl;
+    std::cout << "\ttomahawk-test-musicscan --benchmark <count> [--templates <dir>] [--workdir <dir>] [--readers <n>] [--keep]" << std::endl;
     std::cout << std::endl;
     std::cout << "\tpath\tEither an audio file or a directory" << std::endl;
+    std::cout << "\tcount\tNumber of tagged files to generate and scan, results are printed as JSON" << std::endl;
+    std::cout << "\t--templates\tDirectory with one sample file per format (ogg, m4a, wma, ...), mp3 and flac files are generated." << std::endl;
+    std::cout << "\t\t\tAll other formats are skipped unless there is a template for them" << std::endl;
+    std::cout << "\t--workdir\tWhere to generate the files, removed afterwards unless --keep is given" << std::endl;
+    std::cout << "\t--readers\tNumber of tag reader threads" << std::endl;
+}
+
+
+int
+benchmark( const QStringList& args )
+{
+    int count = 0;
+    int readers = DEFAULT_SCANNER_TAG_READERS;
+    bool keep = false;
+    QString templates;
+    QString workDir = QDir::temp().absoluteFilePath( "tomahawk-scan-benchmark" );
+
+    for ( int i = 0; i < args.count(); i++ )
+    {
+        const QString arg = args.at( i );
+        const QString value = i + 1 < args.count() ? args.at( i + 1 ) : QString();
+
+        if ( arg == "--benchmark" )
+            count = value.toInt();
+        else if ( arg == "--templates" )
+            templates = value;
+        else if ( arg == "--workdir" )
+            workDir = value;
+        else if ( arg == "--readers" )
+            readers = value.toInt();
+        else if ( arg == "--keep" )
+        {
+            keep = true;
+            continue;
+        }
+        else
+            continue;
+
+        i++;
+    }
+
+    if ( count <= 0 || readers <= 0 )
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    ScanBenchmark bench( workDir, count );
+    bench.setTagReaders( readers );
+    bench.setKeepFiles( keep );
+    if ( !templates.isEmpty() )
+        bench.setTemplateDir( templates );
+
+    if ( !bench.generate() )
+        return EXIT_FAILURE;
+
+    // stdout is for the results
+    if ( !bench.skippedFormats().isEmpty() )
+        std::cerr << "Skipping formats without a template: " << qPrintable( bench.skippedFormats().join( ", " ) ) << std::endl;
+
+    std::cout << TomahawkUtils::toJson( bench.run() ).constData() << std::endl;
+    return EXIT_SUCCESS;
 }
 
 int
 main( int argc, char* argv[] )
 {
-    if ( argc != 2 )
+    if ( argc < 2 )
     {
         usage();
+        exit(EXIT_FAILURE);
     }
 
     QCoreApplication a( argc, argv );
+
+    // Register needed metatypes
+    qRegisterMetaType< QDir >( "QDir" );
+    qRegisterMetaType< QFileInfo >( "QFileInfo" );
+
+    if ( a.arguments().contains( "--benchmark" ) )
+        return benchmark( a.arguments() );
+
     QFileInfo pathInfo( argv[1] );
 
     if ( !pathInfo.exists() )
@@ -37,10 +114,6 @@ main( int argc, char* argv[] )
     }
     else if ( pathInfo.isDir() )
     {
-        // Register needed metatypes
-        qRegisterMetaType< QDir >( "QDir" );
-        qRegisterMetaType< QFileInfo >( "QFileInfo" );
-
         // Create the MusicScanner instance
         QStringList paths;
         paths << pathInfo.canonicalFilePath();